@@ -7,6 +7,9 @@
         "src/native/nvenc/NvEncoderD3D11.cpp",
         "src/native/main.cpp",
         "src/native/pipeline.cpp",
+        "src/native/pipeline-edge.cpp",
+        "src/native/pipeline-tap.cpp",
+        "src/native/recovery.cpp",
         "src/native/stages/*.cpp",
         "src/native/stages/common/*.cpp",
         "src/native/amf/public/common/**/*.cpp"
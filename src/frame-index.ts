@@ -0,0 +1,98 @@
+/**
+ * This module reads the frame index the native file writer keeps next to raw
+ * video streams (see src/native/stages/common/frame-index.h). Raw video has no
+ * timestamps of its own, so the index is what lets us keep the real timing of
+ * a variable frame rate recording.
+ */
+
+import fs from "fs";
+
+const FRAME_INDEX_MAGIC = "QIDX";
+// Header size by version. Version 1 has no codec and is always H264.
+const HEADER_SIZES: { [version: number]: number } = { 1: 16, 2: 20 };
+const ENTRY_SIZE = 24;
+const KEYFRAME_FLAG = 1;
+
+export interface FrameIndexEntry {
+  offset: number;
+  size: number;
+  keyframe: boolean;
+  // 100ns units since the pipeline started.
+  timestamp: number;
+}
+
+export type IndexCodec = "h264" | "hevc";
+
+// Codec numbers used in the header.
+const CODECS: IndexCodec[] = ["h264", "hevc"];
+
+export interface FrameIndex {
+  width: number;
+  height: number;
+  codec: IndexCodec;
+  entries: FrameIndexEntry[];
+}
+
+/** The name of the index belonging to a raw video file. */
+export const indexFileName = (videoFile: string) => `${videoFile}.index`;
+
+/**
+ * The name of the keyframe index the native demuxer writes next to raw video
+ * that has no frame index of its own.
+ */
+export const keyframeIndexFileName = (videoFile: string) => `${videoFile}.kidx`;
+
+/** Reads a 64 bit little endian integer that is known to fit in a double. */
+const readInt64 = (buffer: Buffer, offset: number) =>
+  buffer.readUInt32LE(offset) + buffer.readInt32LE(offset + 4) * 0x100000000;
+
+/**
+ * Reads the index of a raw video file. Entries pointing past the end of the
+ * video (e.g. after a crash) are ignored. Returns null if there is no usable
+ * index.
+ */
+export const readFrameIndex = (videoFile: string): FrameIndex | null => {
+  const fileName = indexFileName(videoFile);
+  if (!fs.existsSync(fileName) || !fs.existsSync(videoFile)) {
+    return null;
+  }
+  const data = fs.readFileSync(fileName);
+  if (data.length < 8 || data.toString("latin1", 0, 4) !== FRAME_INDEX_MAGIC) {
+    return null;
+  }
+  const version = data.readUInt32LE(4);
+  const headerSize = HEADER_SIZES[version];
+  if (!headerSize || data.length < headerSize) {
+    return null;
+  }
+  const codec = version >= 2 ? CODECS[data.readUInt32LE(16)] : "h264";
+  if (!codec) {
+    return null;
+  }
+
+  const videoSize = fs.statSync(videoFile).size;
+  const entries: FrameIndexEntry[] = [];
+  // A partially written trailing entry is simply skipped.
+  for (let i = headerSize; i + ENTRY_SIZE <= data.length; i += ENTRY_SIZE) {
+    const entry = {
+      offset: readInt64(data, i),
+      size: data.readUInt32LE(i + 8),
+      keyframe: (data.readUInt32LE(i + 12) & KEYFRAME_FLAG) !== 0,
+      timestamp: readInt64(data, i + 16)
+    };
+    if (entry.offset + entry.size > videoSize) {
+      break;
+    }
+    entries.push(entry);
+  }
+
+  if (!entries.length) {
+    return null;
+  }
+  return {
+    width: data.readUInt32LE(8),
+    height: data.readUInt32LE(12),
+    codec,
+    entries
+  };
+};
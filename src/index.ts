@@ -1,7 +1,8 @@
 import { ScreenCapture, ScreenCaptureConfig } from "./screen-capture";
-import { ScreenCaptureImpl } from "./screen-capture-impl";
+import { AudioLevels, PreviewFrame } from "./pipeline-tap";
+import { PipelineStats, ScreenCaptureImpl } from "./screen-capture-impl";
 import { ScreenCaptureSubprocess } from "./screen-capture-subprocess";
-import { postProcessDirectory } from "./post-processing";
+import { postProcessDirectory, RecoveryProgress } from "./post-processing";
 
 /** Creates a screen capture (optionally in a subprocess). */
 const createScreenCapture = (
@@ -13,4 +14,11 @@ const createScreenCapture = (
     : new ScreenCaptureImpl(config);
 };
 
-export { createScreenCapture, postProcessDirectory };
+export {
+  AudioLevels,
+  createScreenCapture,
+  PipelineStats,
+  postProcessDirectory,
+  PreviewFrame,
+  RecoveryProgress
+};
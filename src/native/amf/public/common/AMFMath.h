@@ -33,7 +33,23 @@
 
 #pragma once
 
+#include "../include/core/Platform.h"
 #include <cmath>
+#include <string.h>
+
+// Vector and matrix math runs on SSE2 on x86 and NEON on ARM64, and falls back to plain
+// floats elsewhere or when AMF_MATH_NO_SIMD is defined. The vector paths do the same
+// multiplies and adds in the same order as the scalar ones, so without fused multiply-add
+// contraction both give bit identical results.
+#if !defined(AMF_MATH_NO_SIMD)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define AMF_MATH_SSE 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AMF_MATH_NEON 1
+#endif
+#endif
 
 namespace amf
 {
@@ -62,7 +78,124 @@ namespace amf
     const uint32_t AMF_SWIZZLE_W         = 3;
 
     //---------------------------------------------------------------------------------------------
-    class VectorPOD
+    // Four float lanes. Loads and stores are unaligned: VectorPOD is 16 byte aligned, but
+    // allocators older than C++17 don't promise that for the heap.
+    namespace simd
+    {
+#if defined(AMF_MATH_SSE)
+        typedef __m128 V4;
+        inline V4 Load(const float* p)                  { return _mm_loadu_ps(p); }
+        inline void Store(float* p, V4 a)               { _mm_storeu_ps(p, a); }
+        inline void Store3(float* p, V4 a)
+        {
+            _mm_storel_pi((__m64*)p, a);
+            _mm_store_ss(p + 2, _mm_movehl_ps(a, a));
+        }
+        inline V4 Set(float x, float y, float z, float w) { return _mm_setr_ps(x, y, z, w); }
+        inline V4 Splat(float a)                        { return _mm_set1_ps(a); }
+        inline V4 Add(V4 a, V4 b)                       { return _mm_add_ps(a, b); }
+        inline V4 Sub(V4 a, V4 b)                       { return _mm_sub_ps(a, b); }
+        inline V4 Mul(V4 a, V4 b)                       { return _mm_mul_ps(a, b); }
+        inline V4 Div(V4 a, V4 b)                       { return _mm_div_ps(a, b); }
+        inline V4 Sqrt(V4 a)                            { return _mm_sqrt_ps(a); }
+        inline V4 Negate(V4 a)                          { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+        inline V4 ZeroW(V4 a)                           { return _mm_and_ps(a, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0))); }
+        inline float Lane0(V4 a)                        { return _mm_cvtss_f32(a); }
+        inline float Lane1(V4 a)                        { return _mm_cvtss_f32(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1))); }
+        inline float Lane2(V4 a)                        { return _mm_cvtss_f32(_mm_movehl_ps(a, a)); }
+        inline float Lane3(V4 a)                        { return _mm_cvtss_f32(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3))); }
+        template<int X, int Y, int Z, int W>
+        inline V4 Shuffle(V4 a)                         { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(W, Z, Y, X)); }
+        inline void Transpose(const float* pIn, float* pOut)
+        {
+            __m128 r0 = _mm_loadu_ps(pIn), r1 = _mm_loadu_ps(pIn + 4), r2 = _mm_loadu_ps(pIn + 8), r3 = _mm_loadu_ps(pIn + 12);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(pOut, r0);
+            _mm_storeu_ps(pOut + 4, r1);
+            _mm_storeu_ps(pOut + 8, r2);
+            _mm_storeu_ps(pOut + 12, r3);
+        }
+#elif defined(AMF_MATH_NEON)
+        typedef float32x4_t V4;
+        inline V4 Load(const float* p)                  { return vld1q_f32(p); }
+        inline void Store(float* p, V4 a)               { vst1q_f32(p, a); }
+        inline void Store3(float* p, V4 a)
+        {
+            vst1_f32(p, vget_low_f32(a));
+            vst1q_lane_f32(p + 2, a, 2);
+        }
+        inline V4 Set(float x, float y, float z, float w) { const float v[4] = { x, y, z, w }; return vld1q_f32(v); }
+        inline V4 Splat(float a)                        { return vdupq_n_f32(a); }
+        inline V4 Add(V4 a, V4 b)                       { return vaddq_f32(a, b); }
+        inline V4 Sub(V4 a, V4 b)                       { return vsubq_f32(a, b); }
+        inline V4 Mul(V4 a, V4 b)                       { return vmulq_f32(a, b); }
+        inline V4 Div(V4 a, V4 b)                       { return vdivq_f32(a, b); }
+        inline V4 Sqrt(V4 a)                            { return vsqrtq_f32(a); }
+        inline V4 Negate(V4 a)                          { return vnegq_f32(a); }
+        inline V4 ZeroW(V4 a)                           { return vsetq_lane_f32(0.0f, a, 3); }
+        inline float Lane0(V4 a)                        { return vgetq_lane_f32(a, 0); }
+        inline float Lane1(V4 a)                        { return vgetq_lane_f32(a, 1); }
+        inline float Lane2(V4 a)                        { return vgetq_lane_f32(a, 2); }
+        inline float Lane3(V4 a)                        { return vgetq_lane_f32(a, 3); }
+        template<int X, int Y, int Z, int W>
+        inline V4 Shuffle(V4 a)
+        {
+            float v[4];
+            vst1q_f32(v, a);
+            return Set(v[X], v[Y], v[Z], v[W]);
+        }
+        inline void Transpose(const float* pIn, float* pOut)
+        {
+            // the de-interleaving load reads the columns
+            const float32x4x4_t columns = vld4q_f32(pIn);
+            vst1q_f32(pOut, columns.val[0]);
+            vst1q_f32(pOut + 4, columns.val[1]);
+            vst1q_f32(pOut + 8, columns.val[2]);
+            vst1q_f32(pOut + 12, columns.val[3]);
+        }
+#else
+        struct V4
+        {
+            float v[4];
+        };
+        inline V4 Set(float x, float y, float z, float w) { V4 r = {{ x, y, z, w }}; return r; }
+        inline V4 Load(const float* p)                  { return Set(p[0], p[1], p[2], p[3]); }
+        inline void Store(float* p, V4 a)               { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; p[3] = a.v[3]; }
+        inline void Store3(float* p, V4 a)              { p[0] = a.v[0]; p[1] = a.v[1]; p[2] = a.v[2]; }
+        inline V4 Splat(float a)                        { return Set(a, a, a, a); }
+        inline V4 Add(V4 a, V4 b)                       { return Set(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]); }
+        inline V4 Sub(V4 a, V4 b)                       { return Set(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]); }
+        inline V4 Mul(V4 a, V4 b)                       { return Set(a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]); }
+        inline V4 Div(V4 a, V4 b)                       { return Set(a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]); }
+        inline V4 Sqrt(V4 a)                            { return Set(sqrtf(a.v[0]), sqrtf(a.v[1]), sqrtf(a.v[2]), sqrtf(a.v[3])); }
+        inline V4 Negate(V4 a)                          { return Set(-a.v[0], -a.v[1], -a.v[2], -a.v[3]); }
+        inline V4 ZeroW(V4 a)                           { return Set(a.v[0], a.v[1], a.v[2], 0.0f); }
+        inline float Lane0(V4 a)                        { return a.v[0]; }
+        inline float Lane1(V4 a)                        { return a.v[1]; }
+        inline float Lane2(V4 a)                        { return a.v[2]; }
+        inline float Lane3(V4 a)                        { return a.v[3]; }
+        template<int X, int Y, int Z, int W>
+        inline V4 Shuffle(V4 a)                         { return Set(a.v[X], a.v[Y], a.v[Z], a.v[W]); }
+        inline void Transpose(const float* pIn, float* pOut)
+        {
+            float t[16];
+            for (int i = 0; i < 4; i++)
+            {
+                t[i * 4 + 0] = pIn[i];
+                t[i * 4 + 1] = pIn[4 + i];
+                t[i * 4 + 2] = pIn[8 + i];
+                t[i * 4 + 3] = pIn[12 + i];
+            }
+            memcpy(pOut, t, sizeof(t));
+        }
+#endif
+        // ((x + y) + z), the order the scalar code adds in
+        inline float Sum3(V4 a)                         { return Lane0(a) + Lane1(a) + Lane2(a); }
+        inline float Sum4(V4 a)                         { return Lane0(a) + Lane1(a) + Lane2(a) + Lane3(a); }
+    }
+
+    //---------------------------------------------------------------------------------------------
+    class AMF_ALIGN(16) VectorPOD
     {
     public:
         float x;
@@ -78,53 +211,41 @@ namespace amf
             x= _x; y = _y; z = _z; w = _w;
         }
 
+        inline simd::V4 Load() const            { return simd::Load(&x); }
+        inline void Store(simd::V4 value)       { simd::Store(&x, value); }
+        static inline VectorPOD FromV4(simd::V4 value)
+        {
+            VectorPOD vector;
+            vector.Store(value);
+            return vector;
+        }
+
         inline VectorPOD& operator-=(const VectorPOD& other)
         {
-            x -=other.x; y -=other.y; z -=other.z; w -=other.w;
+            Store(simd::Sub(Load(), other.Load()));
             return *this;
         }
         inline VectorPOD operator-(const VectorPOD& other) const
         {
-            VectorPOD vector;
-            vector.x = x - other.x;
-            vector.y = y - other.y;
-            vector.z = z - other.z;
-            vector.w = w - other.w;
-            return vector;
+            return FromV4(simd::Sub(Load(), other.Load()));
         }
         inline VectorPOD& operator+=(const VectorPOD& other)
         {
-            x +=other.x; 
-            y +=other.y; 
-            z +=other.z; 
-            w +=other.w;
+            Store(simd::Add(Load(), other.Load()));
             return *this;
         }
         inline VectorPOD operator+(const VectorPOD& other)  const
         {
-            VectorPOD vector;
-            vector.x = x + other.x;
-            vector.y = y + other.y;
-            vector.z = z + other.z;
-            vector.w = w + other.w;
-            return vector;
+            return FromV4(simd::Add(Load(), other.Load()));
         }
 
         inline VectorPOD operator*(const VectorPOD& other)  const
         {
-            VectorPOD vector;
-            vector.x = x * other.x;
-            vector.y = y * other.y;
-            vector.z = z * other.z;
-            vector.w = w * other.w;
-            return vector;
+            return FromV4(simd::Mul(Load(), other.Load()));
         }
         inline VectorPOD operator*=(const VectorPOD& other)
         {
-            x*=other.x; 
-            y*=other.y; 
-            z*=other.z; 
-            w*=other.w;
+            Store(simd::Mul(Load(), other.Load()));
             return *this;
         }
 
@@ -157,17 +278,11 @@ namespace amf
         inline bool operator!=(const VectorPOD& other) const { return !operator==(other); }
         inline VectorPOD Dot3(const VectorPOD& vec) const
         {
-            float fValue = x * vec.x + y * vec.y + z * vec.z;
-            VectorPOD Result;
-            Result.Assign(fValue, fValue, fValue, fValue);
-            return Result;
+            return FromV4(simd::Splat(simd::Sum3(simd::Mul(Load(), vec.Load()))));
         }
         inline VectorPOD Dot4(const VectorPOD& vec) const
         {
-            float fValue = x * vec.x + y * vec.y + z * vec.z + w * vec.w;
-            VectorPOD Result;
-            Result.Assign(fValue, fValue, fValue, fValue);
-            return Result;
+            return FromV4(simd::Splat(simd::Sum4(simd::Mul(Load(), vec.Load()))));
         }
 
         inline VectorPOD LengthSq3()  const
@@ -182,12 +297,7 @@ namespace amf
 
         inline VectorPOD Sqrt()  const
         {
-            VectorPOD Result;
-            Result.x = sqrtf(x);
-            Result.y = sqrtf(y);
-            Result.z = sqrtf(z);
-            Result.w = sqrtf(w);
-            return Result;
+            return FromV4(simd::Sqrt(Load()));
         }	
         inline VectorPOD Length3()  const
         {
@@ -205,11 +315,8 @@ namespace amf
         }
         inline VectorPOD Normalize3()  const
         {
-            float fLength;
-            VectorPOD vResult;
-
-            vResult = Length3();
-            fLength = vResult.x;
+            const simd::V4 v = Load();
+            float fLength = sqrtf(simd::Sum3(simd::Mul(v, v)));
 
             // Prevent divide by zero
             if (fLength > 0) 
@@ -217,31 +324,20 @@ namespace amf
                 fLength = 1.0f / fLength;
             }
             
-            vResult.x = x * fLength;
-            vResult.y = y * fLength;
-            vResult.z = z * fLength;
-            vResult.w = w * fLength;
-            return vResult;
+            return FromV4(simd::Mul(v, simd::Splat(fLength)));
         }
 
         inline VectorPOD Cross3(const VectorPOD& vec) const
         {
-            VectorPOD vResult;
-            vResult.Assign(
-                (y * vec.z) - (z * vec.y), 
-                (z * vec.x) - (x * vec.z), 
-                (x * vec.y) - (y * vec.x), 
-                0.0f);
-            return vResult;
+            const simd::V4 a = Load();
+            const simd::V4 b = vec.Load();
+            return FromV4(simd::ZeroW(simd::Sub(
+                simd::Mul(simd::Shuffle<1, 2, 0, 3>(a), simd::Shuffle<2, 0, 1, 3>(b)),
+                simd::Mul(simd::Shuffle<2, 0, 1, 3>(a), simd::Shuffle<1, 2, 0, 3>(b)))));
         }	
         inline VectorPOD Negate() const
         {
-            VectorPOD Result;
-            Result.x = -x;
-            Result.y = -y;
-            Result.z = -z;
-            Result.w = -w;
-            return Result;
+            return FromV4(simd::Negate(Load()));
         }
 
 		inline VectorPOD operator-() const
@@ -296,12 +392,7 @@ namespace amf
         }
         inline VectorPOD Reciprocal()
         {
-            VectorPOD Result;
-            Result.x = 1.f / x;
-            Result.y = 1.f / y;
-            Result.z = 1.f / z;
-            Result.w = 1.f / w;
-            return Result;
+            return FromV4(simd::Div(simd::Splat(1.f), Load()));
         }
     };
 
@@ -381,12 +472,19 @@ namespace amf
 
         inline Quaternion operator*(const Quaternion& other) const
         {
-            return Quaternion(
-            other.w * x + other.x * w + other.y * z - other.z * y,
-            other.w * y - other.x * z + other.y * w + other.z * x,
-            other.w * z + other.x * y - other.y * x + other.z * w,
-            other.w * w - other.x * x - other.y * y - other.z * z
-            );
+            // other.w * (x, y, z, w) + other.x * (w, -z, y, -x) + other.y * (z, w, -x, -y) + other.z * (-y, x, w, -z)
+            const simd::V4 q = Load();
+            const simd::V4 q1 = simd::Mul(simd::Shuffle<3, 2, 1, 0>(q), simd::Set(1.0f, -1.0f, 1.0f, -1.0f));
+            const simd::V4 q2 = simd::Mul(simd::Shuffle<2, 3, 0, 1>(q), simd::Set(1.0f, 1.0f, -1.0f, -1.0f));
+            const simd::V4 q3 = simd::Mul(simd::Shuffle<1, 0, 3, 2>(q), simd::Set(-1.0f, 1.0f, 1.0f, -1.0f));
+
+            Quaternion result;
+            result.Store(simd::Add(simd::Add(simd::Add(
+                simd::Mul(simd::Splat(other.w), q),
+                simd::Mul(simd::Splat(other.x), q1)),
+                simd::Mul(simd::Splat(other.y), q2)),
+                simd::Mul(simd::Splat(other.z), q3)));
+            return result;
         }
 
         inline const Quaternion& RotateBy(const Quaternion& rotator)
@@ -571,13 +669,25 @@ namespace amf
             return *this;
         }
 
+        // Note the order: row i of the result is n.r[i] applied to this matrix, i.e. n * this in
+        // row vector terms.
         inline Matrix operator*(const Matrix& n) const
         {
-            return Matrix(
-                     k[0]*n.k[0]  + k[4]*n.k[1]  + k[8]*n.k[2]  + k[12]*n.k[3],   k[1]*n.k[0]  + k[5]*n.k[1]  + k[9]*n.k[2]  + k[13]*n.k[3],   k[2]*n.k[0]  + k[6]*n.k[1]  + k[10]*n.k[2]  + k[14]*n.k[3],   k[3]*n.k[0]  + k[7]*n.k[1]  + k[11]*n.k[2]  + k[15]*n.k[3],
-                     k[0]*n.k[4]  + k[4]*n.k[5]  + k[8]*n.k[6]  + k[12]*n.k[7],   k[1]*n.k[4]  + k[5]*n.k[5]  + k[9]*n.k[6]  + k[13]*n.k[7],   k[2]*n.k[4]  + k[6]*n.k[5]  + k[10]*n.k[6]  + k[14]*n.k[7],   k[3]*n.k[4]  + k[7]*n.k[5]  + k[11]*n.k[6]  + k[15]*n.k[7],
-                     k[0]*n.k[8]  + k[4]*n.k[9]  + k[8]*n.k[10] + k[12]*n.k[11],  k[1]*n.k[8]  + k[5]*n.k[9]  + k[9]*n.k[10] + k[13]*n.k[11],  k[2]*n.k[8]  + k[6]*n.k[9]  + k[10]*n.k[10] + k[14]*n.k[11],  k[3]*n.k[8]  + k[7]*n.k[9]  + k[11]*n.k[10] + k[15]*n.k[11],
-                     k[0]*n.k[12] + k[4]*n.k[13] + k[8]*n.k[14] + k[12]*n.k[15],  k[1]*n.k[12] + k[5]*n.k[13] + k[9]*n.k[14] + k[13]*n.k[15],  k[2]*n.k[12] + k[6]*n.k[13] + k[10]*n.k[14] + k[14]*n.k[15],  k[3]*n.k[12] + k[7]*n.k[13] + k[11]*n.k[14] + k[15]*n.k[15]);
+            const simd::V4 r0 = r[0].Load();
+            const simd::V4 r1 = r[1].Load();
+            const simd::V4 r2 = r[2].Load();
+            const simd::V4 r3 = r[3].Load();
+
+            Matrix result;
+            for (int i = 0; i < 4; i++)
+            {
+                result.r[i].Store(simd::Add(simd::Add(simd::Add(
+                    simd::Mul(simd::Splat(n.m[i][0]), r0),
+                    simd::Mul(simd::Splat(n.m[i][1]), r1)),
+                    simd::Mul(simd::Splat(n.m[i][2]), r2)),
+                    simd::Mul(simd::Splat(n.m[i][3]), r3)));
+            }
+            return result;
         }
         inline Matrix operator*=(const Matrix& other)
         {
@@ -586,18 +696,41 @@ namespace amf
         }
 
 
-        inline Vector operator*(const Vector& v)
+        // Transforms the point (v.x, v.y, v.z, 1).
+        inline Vector operator*(const Vector& v) const
+        {
+            return VectorPOD::FromV4(TransformPoint(v.x, v.y, v.z));
+        }
+
+        // Transforms count vectors the way operator*(Vector) does.
+        inline void TransformArray(const VectorPOD* pInput, VectorPOD* pOutput, size_t count) const
         {
-            Vector Z(v.z, v.z, v.z, v.z);
-            Vector Y(v.y, v.y, v.y, v.y);
-            Vector X(v.x, v.x, v.x, v.x);
+            for (size_t i = 0; i < count; i++)
+            {
+                pOutput[i].Store(TransformPoint(pInput[i].x, pInput[i].y, pInput[i].z));
+            }
+        }
 
-            Vector ret;
-            ret = Z * r[2] + r[3];
-            ret = Y * r[1] + ret;
-            ret = X * r[0] + ret;
+        // Transforms count points stored as x, y, z floats, e.g. vertex positions. The strides
+        // are in bytes so the points can sit inside larger vertex structures. Only x, y and z
+        // are written, and the input and output may be the same array.
+        inline void TransformPoints(const float* pInput, size_t inputStride, float* pOutput, size_t outputStride, size_t count) const
+        {
+            const simd::V4 r0 = r[0].Load();
+            const simd::V4 r1 = r[1].Load();
+            const simd::V4 r2 = r[2].Load();
+            const simd::V4 r3 = r[3].Load();
 
-            return ret;
+            const amf_uint8* pIn = (const amf_uint8*)pInput;
+            amf_uint8* pOut = (amf_uint8*)pOutput;
+            for (size_t i = 0; i < count; i++, pIn += inputStride, pOut += outputStride)
+            {
+                const float* pPoint = (const float*)pIn;
+                simd::V4 ret = simd::Add(simd::Mul(simd::Splat(pPoint[2]), r2), r3);
+                ret = simd::Add(simd::Mul(simd::Splat(pPoint[1]), r1), ret);
+                ret = simd::Add(simd::Mul(simd::Splat(pPoint[0]), r0), ret);
+                simd::Store3((float*)pOut, ret);
+            }
         }
 
         void MatrixAffineTransformation(const Vector &Scaling, const Vector &RotationOrigin, const Vector &RotationQuaternion, const Vector &Translation)
@@ -679,25 +812,8 @@ namespace amf
         }
         inline Matrix Transpose() const
         {
-
-            // Original matrix:
-            //
-            //     m00m01m02m03
-            //     m10m11m12m13
-            //     m20m21m22m23
-            //     m30m31m32m33
-
-            Matrix P;
-            P.r[0] = r[0].MergeXY(r[2]); // m00m20m01m21
-            P.r[1] = r[1].MergeXY(r[3]); // m10m30m11m31
-            P.r[2] = r[0].MergeZW(r[2]); // m02m22m03m23
-            P.r[3] = r[1].MergeZW(r[3]); // m12m32m13m33
-
             Matrix MT;
-            MT.r[0] = P.r[0].MergeXY(P.r[1]); // m00m10m20m30
-            MT.r[1] = P.r[0].MergeZW(P.r[1]); // m01m11m21m31
-            MT.r[2] = P.r[2].MergeXY(P.r[3]); // m02m12m22m32
-            MT.r[3] = P.r[2].MergeZW(P.r[3]); // m03m13m23m33
+            simd::Transpose(k, MT.k);
             return MT;
         }
         inline void LookAtLH(Vector& EyePosition, Vector& FocusPosition, Vector& UpDirection)
@@ -1068,6 +1184,15 @@ namespace amf
             return Result;
 
         }
+
+    private:
+        // (x, y, z, 1) * M, adding the rows in the same order as the scalar code did
+        inline simd::V4 TransformPoint(float x, float y, float z) const
+        {
+            simd::V4 ret = simd::Add(simd::Mul(simd::Splat(z), r[2].Load()), r[3].Load());
+            ret = simd::Add(simd::Mul(simd::Splat(y), r[1].Load()), ret);
+            return simd::Add(simd::Mul(simd::Splat(x), r[0].Load()), ret);
+        }
     };
 
     class Pose
@@ -0,0 +1,296 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Streaming latency statistics. The mean and variance are updated with Welford's method so they
+// stay exact over long runs; percentiles come from a histogram with SUB_BUCKETS buckets per
+// power of two, which bounds the error to half a bucket (1/16 of the value) while covering the
+// whole amf_pts range in a few KB. Record is the only writer and publishes each update through a
+// sequence counter, so readers can take a consistent snapshot without ever blocking it.
+
+#include "LatencyStats.h"
+#include "Thread.h"
+#include <math.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace amf;
+
+//-------------------------------------------------------------------------------------------------
+static amf_int32 HighestBit(amf_uint64 value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (amf_int32)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if(_BitScanReverse(&index, (unsigned long)(value >> 32)))
+    {
+        return (amf_int32)index + 32;
+    }
+    _BitScanReverse(&index, (unsigned long)value);
+    return (amf_int32)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+//-------------------------------------------------------------------------------------------------
+AMFLatencyStats::AMFLatencyStats(amf_pts rateWindow) :
+    m_Sequence(0),
+    m_SlotLength(rateWindow / RATE_SLOTS > 0 ? rateWindow / RATE_SLOTS : 1)
+{
+    Reset();
+}
+//-------------------------------------------------------------------------------------------------
+amf_int32 AMFLatencyStats::BucketIndex(amf_uint64 value)
+{
+    if(value < (amf_uint64)SUB_BUCKETS)
+    {
+        return (amf_int32)value;
+    }
+    amf_int32 shift = HighestBit(value) - SUB_BUCKET_BITS;
+    amf_int32 sub = (amf_int32)(value >> shift) & (SUB_BUCKETS - 1);
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+//-------------------------------------------------------------------------------------------------
+amf_pts AMFLatencyStats::BucketValue(amf_int32 bucket)
+{
+    if(bucket < SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    amf_int32 shift = bucket / SUB_BUCKETS - 1;
+    amf_uint64 low = (amf_uint64)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    // The middle of the bucket halves the worst case error.
+    return (amf_pts)(low + ((1ull << shift) >> 1));
+}
+//-------------------------------------------------------------------------------------------------
+void AMFLatencyStats::Record(amf_pts value)
+{
+    Record(value, amf_high_precision_clock());
+}
+//-------------------------------------------------------------------------------------------------
+void AMFLatencyStats::Record(amf_pts value, amf_pts now)
+{
+    if(value < 0)
+    {
+        value = 0;
+    }
+
+    amf_uint32 sequence = m_Sequence.load(std::memory_order_relaxed);
+    m_Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Only this thread writes, so plain loads and stores are enough for the updates.
+    amf_uint64 count = m_Count.load(std::memory_order_relaxed) + 1;
+    double mean = m_Mean.load(std::memory_order_relaxed);
+    double delta = (double)value - mean;
+    mean += delta / (double)count;
+    m_M2.store(m_M2.load(std::memory_order_relaxed) + delta * ((double)value - mean), std::memory_order_relaxed);
+    m_Mean.store(mean, std::memory_order_relaxed);
+    m_Count.store(count, std::memory_order_relaxed);
+
+    if(count == 1 || value < m_Min.load(std::memory_order_relaxed))
+    {
+        m_Min.store(value, std::memory_order_relaxed);
+    }
+    if(value > m_Max.load(std::memory_order_relaxed))
+    {
+        m_Max.store(value, std::memory_order_relaxed);
+    }
+
+    std::atomic<amf_uint64>& bucket = m_Buckets[BucketIndex((amf_uint64)value)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if(count == 1)
+    {
+        m_FirstRecord.store(now, std::memory_order_relaxed);
+    }
+    amf_int64 slot = now / m_SlotLength;
+    amf_int32 index = (amf_int32)(slot % RATE_SLOTS);
+    if(m_SlotIds[index].load(std::memory_order_relaxed) != slot)
+    {
+        m_SlotIds[index].store(slot, std::memory_order_relaxed);
+        m_SlotCounts[index].store(0, std::memory_order_relaxed);
+    }
+    m_SlotCounts[index].store(m_SlotCounts[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    m_Sequence.store(sequence + 2, std::memory_order_release);
+}
+//-------------------------------------------------------------------------------------------------
+void AMFLatencyStats::Reset()
+{
+    amf_uint32 sequence = m_Sequence.load(std::memory_order_relaxed);
+    m_Sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_Count.store(0, std::memory_order_relaxed);
+    m_Mean.store(0, std::memory_order_relaxed);
+    m_M2.store(0, std::memory_order_relaxed);
+    m_Min.store(0, std::memory_order_relaxed);
+    m_Max.store(0, std::memory_order_relaxed);
+    for(amf_int32 i = 0; i < BUCKETS; i++)
+    {
+        m_Buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_FirstRecord.store(0, std::memory_order_relaxed);
+    for(amf_int32 i = 0; i < RATE_SLOTS; i++)
+    {
+        m_SlotIds[i].store(-1, std::memory_order_relaxed);
+        m_SlotCounts[i].store(0, std::memory_order_relaxed);
+    }
+
+    m_Sequence.store(sequence + 2, std::memory_order_release);
+}
+//-------------------------------------------------------------------------------------------------
+void AMFLatencyStats::ReadConsistent(AMFLatencySnapshot* pSnapshot, amf_uint64* pBuckets, amf_pts now) const
+{
+    amf_int64 currentSlot = now / m_SlotLength;
+    amf_int64 oldestSlot = currentSlot - RATE_SLOTS + 1;
+    for(;;)
+    {
+        amf_uint32 before = m_Sequence.load(std::memory_order_acquire);
+        if(before & 1)
+        {
+            amf_sleep(0);
+            continue;
+        }
+
+        amf_uint64 count = m_Count.load(std::memory_order_relaxed);
+        double mean = m_Mean.load(std::memory_order_relaxed);
+        double m2 = m_M2.load(std::memory_order_relaxed);
+        pSnapshot->min = m_Min.load(std::memory_order_relaxed);
+        pSnapshot->max = m_Max.load(std::memory_order_relaxed);
+        for(amf_int32 i = 0; i < BUCKETS; i++)
+        {
+            pBuckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+        }
+        amf_pts firstRecord = m_FirstRecord.load(std::memory_order_relaxed);
+        amf_uint64 recent = 0;
+        for(amf_int32 i = 0; i < RATE_SLOTS; i++)
+        {
+            amf_int64 slot = m_SlotIds[i].load(std::memory_order_relaxed);
+            if(slot >= oldestSlot && slot <= currentSlot)
+            {
+                recent += m_SlotCounts[i].load(std::memory_order_relaxed);
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(m_Sequence.load(std::memory_order_relaxed) != before)
+        {
+            continue;
+        }
+
+        pSnapshot->count = count;
+        pSnapshot->mean = mean;
+        pSnapshot->stddev = count > 1 ? sqrt(m2 / (double)(count - 1)) : 0.0;
+
+        // Don't let a stream that only just started look faster than it is, and don't report
+        // a burst of samples within one slot as an enormous rate.
+        amf_pts windowStart = oldestSlot * m_SlotLength;
+        if(count > 0 && firstRecord > windowStart)
+        {
+            windowStart = firstRecord;
+        }
+        amf_pts elapsed = now - windowStart;
+        if(elapsed < m_SlotLength)
+        {
+            elapsed = m_SlotLength;
+        }
+        pSnapshot->rate = (double)recent * AMF_SECOND / (double)elapsed;
+        return;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+amf_pts AMFLatencyStats::FindPercentile(const amf_uint64* pBuckets, const AMFLatencySnapshot& snapshot, double fraction) const
+{
+    if(snapshot.count == 0)
+    {
+        return 0;
+    }
+    if(fraction < 0.0)
+    {
+        fraction = 0.0;
+    }
+    amf_uint64 rank = (amf_uint64)ceil(fraction * (double)snapshot.count);
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+    if(rank > snapshot.count)
+    {
+        rank = snapshot.count;
+    }
+
+    amf_uint64 seen = 0;
+    for(amf_int32 i = 0; i < BUCKETS; i++)
+    {
+        seen += pBuckets[i];
+        if(seen >= rank)
+        {
+            amf_pts value = BucketValue(i);
+            // The exact extremes are known, so never report past them.
+            if(value < snapshot.min)
+            {
+                return snapshot.min;
+            }
+            if(value > snapshot.max)
+            {
+                return snapshot.max;
+            }
+            return value;
+        }
+    }
+    return snapshot.max;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFLatencyStats::GetSnapshot(AMFLatencySnapshot* pSnapshot) const
+{
+    amf_uint64 buckets[BUCKETS];
+    ReadConsistent(pSnapshot, buckets, amf_high_precision_clock());
+    pSnapshot->p50 = FindPercentile(buckets, *pSnapshot, 0.5);
+    pSnapshot->p90 = FindPercentile(buckets, *pSnapshot, 0.9);
+    pSnapshot->p99 = FindPercentile(buckets, *pSnapshot, 0.99);
+    pSnapshot->p999 = FindPercentile(buckets, *pSnapshot, 0.999);
+}
+//-------------------------------------------------------------------------------------------------
+amf_pts AMFLatencyStats::GetPercentile(double fraction) const
+{
+    AMFLatencySnapshot snapshot;
+    amf_uint64 buckets[BUCKETS];
+    ReadConsistent(&snapshot, buckets, amf_high_precision_clock());
+    return FindPercentile(buckets, snapshot, fraction);
+}
+//-------------------------------------------------------------------------------------------------
@@ -0,0 +1,121 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+///-------------------------------------------------------------------------
+///  @file   LatencyStats.h
+///  @brief  Streaming latency statistics with percentiles and rates
+///-------------------------------------------------------------------------
+#ifndef AMF_LatencyStats_h
+#define AMF_LatencyStats_h
+#pragma once
+
+#include "../include/core/Platform.h"
+#include <atomic>
+
+namespace amf
+{
+    //---------------------------------------------------------------------------------------------
+    // A consistent copy of everything AMFLatencyStats has seen since the last Reset. Durations
+    // are in amf_pts units (100ns).
+    struct AMFLatencySnapshot
+    {
+        amf_uint64  count;
+        double      mean;
+        double      stddev;
+        amf_pts     min;
+        amf_pts     max;
+        // Percentiles are read from the histogram, so they are within about 6% of the real value.
+        amf_pts     p50;
+        amf_pts     p90;
+        amf_pts     p99;
+        amf_pts     p999;
+        // Samples per second over the rate window.
+        double      rate;
+    };
+    //---------------------------------------------------------------------------------------------
+    // Keeps the exact mean and variance (Welford), a log bucketed histogram for percentiles and a
+    // sliding window sample rate for a stream of durations.
+    //
+    // Recording is wait free but there must be only one recording thread per instance. Snapshots
+    // may be taken from any thread; they retry while a Record is in progress.
+    class AMFLatencyStats
+    {
+    public:
+        // Each octave is split into 1 << SUB_BUCKET_BITS buckets.
+        static const amf_int32 SUB_BUCKET_BITS = 3;
+        static const amf_int32 SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+        static const amf_int32 BUCKETS = SUB_BUCKETS * (64 - SUB_BUCKET_BITS);
+        // How many pieces the rate window is split into. The oldest piece is dropped as a whole.
+        static const amf_int32 RATE_SLOTS = 10;
+
+        explicit AMFLatencyStats(amf_pts rateWindow = AMF_SECOND);
+
+        // Records one duration. Negative durations are counted as 0.
+        void Record(amf_pts value);
+        // Same as above with the current amf_high_precision_clock() time supplied by the caller.
+        void Record(amf_pts value, amf_pts now);
+
+        // Forgets everything. Must not race with Record.
+        void Reset();
+
+        void GetSnapshot(AMFLatencySnapshot* pSnapshot) const;
+        // Returns the duration below which the given fraction (0..1) of the samples fall.
+        amf_pts GetPercentile(double fraction) const;
+
+    private:
+        AMFLatencyStats(const AMFLatencyStats&);
+        AMFLatencyStats& operator=(const AMFLatencyStats&);
+
+        static amf_int32 BucketIndex(amf_uint64 value);
+        static amf_pts BucketValue(amf_int32 bucket);
+
+        // Fills everything but the percentiles.
+        void ReadConsistent(AMFLatencySnapshot* pSnapshot, amf_uint64* pBuckets, amf_pts now) const;
+        amf_pts FindPercentile(const amf_uint64* pBuckets, const AMFLatencySnapshot& snapshot, double fraction) const;
+
+        // Odd while Record is updating the fields below.
+        std::atomic<amf_uint32> m_Sequence;
+
+        std::atomic<amf_uint64> m_Count;
+        std::atomic<double>     m_Mean;
+        std::atomic<double>     m_M2;
+        std::atomic<amf_pts>    m_Min;
+        std::atomic<amf_pts>    m_Max;
+        std::atomic<amf_uint64> m_Buckets[BUCKETS];
+
+        amf_pts                 m_SlotLength;
+        std::atomic<amf_pts>    m_FirstRecord;
+        std::atomic<amf_int64>  m_SlotIds[RATE_SLOTS];
+        std::atomic<amf_uint64> m_SlotCounts[RATE_SLOTS];
+    };
+}
+
+#endif // AMF_LatencyStats_h
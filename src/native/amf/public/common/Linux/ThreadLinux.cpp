@@ -54,6 +54,9 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <time.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
@@ -66,8 +69,10 @@
 #endif
 
 #include <sys/types.h>
-#include <semaphore.h>
 #include <pthread.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 
 #include "../AMFSTL.h"
 
@@ -140,20 +145,58 @@ bool AMF_STD_CALL amf_leave_critical_section(amf_handle cs)
     return pthread_mutex_unlock(mutex) == 0;
 }
 //----------------------------------------------------------------------------------------
+// Events and semaphores are built on futexes: setting, resetting, releasing and any wait
+// that doesn't have to block are a single atomic operation, the kernel is only entered to
+// sleep or to wake threads that are known to be sleeping.
+//----------------------------------------------------------------------------------------
+static int futex_wait(amf_int32* address, amf_int32 expected, const timespec* timeout)
+{
+    return syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0);
+}
+//----------------------------------------------------------------------------------------
+static int futex_wake(amf_int32* address, amf_int32 count)
+{
+    return syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+//----------------------------------------------------------------------------------------
+static amf_uint64 monotonic_msec()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((amf_uint64)ts.tv_sec) * 1000 + ((amf_uint64)ts.tv_nsec) / 1000000;
+}
+//----------------------------------------------------------------------------------------
+// Sleeps while *address == expected, until woken or until deadline (msec, monotonic) passes.
+// Returns false once the deadline has passed.
+static bool futex_wait_until(amf_int32* address, amf_int32 expected, amf_ulong timeout, amf_uint64 deadline)
+{
+    if(timeout == AMF_INFINITE)
+    {
+        futex_wait(address, expected, NULL);
+        return true;
+    }
+    amf_uint64 now = monotonic_msec();
+    if(now >= deadline)
+    {
+        return false;
+    }
+    timespec remaining;
+    remaining.tv_sec = (time_t)((deadline - now) / 1000);
+    remaining.tv_nsec = (long)((deadline - now) % 1000) * 1000000;
+    futex_wait(address, expected, &remaining);
+    return true;
+}
+//----------------------------------------------------------------------------------------
 struct MyEvent
 {
     bool m_manual_reset;
-    pthread_cond_t m_cond;
-    pthread_mutex_t m_mutex;
-    bool m_triggered;
+    amf_int32 m_triggered;  // futex word: 1 when set
+    amf_int32 m_waiters;
 };
 //----------------------------------------------------------------------------------------
 
 amf_handle AMF_STD_CALL amf_create_event(bool initially_owned, bool manual_reset, const wchar_t* name)
 {
-    MyEvent* event = new MyEvent;
-
-
     // Linux does not natively support Named Condition variables
     // so raise an error.
     // Implement this using boost (NamedCondition), Qt, or some other framework.
@@ -162,17 +205,10 @@ amf_handle AMF_STD_CALL amf_create_event(bool initially_owned, bool manual_reset
         perror("Named Events not supported under Linux yet");
         exit(1);
     }
+    MyEvent* event = new MyEvent;
     event->m_manual_reset = manual_reset;
-    pthread_cond_t cond_tmp = PTHREAD_COND_INITIALIZER;
-    event->m_cond = cond_tmp;
-    pthread_mutex_t mutex_tmp = PTHREAD_MUTEX_INITIALIZER;
-    event->m_mutex = mutex_tmp;
-
-    event->m_triggered = false;
-    if(initially_owned)
-    {
-        amf_set_event((amf_handle)event);
-    }
+    event->m_triggered = initially_owned ? 1 : 0;
+    event->m_waiters = 0;
 
     return (amf_handle)event;
 }
@@ -180,105 +216,60 @@ amf_handle AMF_STD_CALL amf_create_event(bool initially_owned, bool manual_reset
 bool AMF_STD_CALL amf_delete_event(amf_handle hevent)
 {
     MyEvent* event = (MyEvent*)hevent;
-    int err1 = pthread_mutex_destroy(&event->m_mutex);
-    int err2 = pthread_cond_destroy(&event->m_cond);
     delete event;
-    return err1 == 0 && err2 == 0;
+    return true;
 }
 //----------------------------------------------------------------------------------------
 bool AMF_STD_CALL amf_set_event(amf_handle hevent)
 {
     MyEvent* event = (MyEvent*)hevent;
-    pthread_mutex_lock(&event->m_mutex);
-    event->m_triggered = true;
-    int err1 = pthread_cond_broadcast(&event->m_cond);
-    pthread_mutex_unlock(&event->m_mutex);
-
-    return err1 == 0;
+    if(__atomic_exchange_n(&event->m_triggered, 1, __ATOMIC_SEQ_CST) == 0 &&
+        __atomic_load_n(&event->m_waiters, __ATOMIC_SEQ_CST) != 0)
+    {
+        // an auto reset event releases one waiter, the others would only find it reset again
+        futex_wake(&event->m_triggered, event->m_manual_reset ? INT_MAX : 1);
+    }
+    return true;
 }
 //----------------------------------------------------------------------------------------
 bool AMF_STD_CALL amf_reset_event(amf_handle hevent)
 {
     MyEvent* event = (MyEvent*)hevent;
-    pthread_mutex_lock(&event->m_mutex);
-    event->m_triggered = false;
-    int err = pthread_mutex_unlock(&event->m_mutex);
-
-    return err == 0;
+    __atomic_store_n(&event->m_triggered, 0, __ATOMIC_SEQ_CST);
+    return true;
 }
 //----------------------------------------------------------------------------------------
-static bool AMF_STD_CALL amf_wait_for_event_int(amf_handle hevent, unsigned long timeout, bool bTimeoutErr)
+static bool amf_try_take_event(MyEvent* event)
 {
-    bool ret = true;
-    int err = 0;
-    MyEvent* event = (MyEvent*)hevent;
-    pthread_mutex_lock(&event->m_mutex);
-
-    timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    amf_uint64 start_time = ((amf_uint64)ts.tv_sec) * 1000 + ((amf_uint64)ts.tv_nsec) / 1000000; //to msec
-
     if(event->m_manual_reset)
     {
-        while(!event->m_triggered)
-        {
-            if(timeout == AMF_INFINITE)
-            {
-                err = pthread_cond_wait(&event->m_cond, &event->m_mutex);          //MM todo - timeout is not supported
-                ret = err == 0;
-            }
-            else
-            {
-                clock_gettime(CLOCK_REALTIME, &ts);
-                amf_uint64 current_time = ((amf_uint64)ts.tv_sec) * 1000 + ((amf_uint64)ts.tv_nsec) / 1000000; //to msec
-                if(current_time - start_time > (amf_uint64)timeout)
-                {
-                    ret = bTimeoutErr ? false : true;
-                    break;
-                }
-                amf_uint64 to_wait = start_time + timeout;
-
-                timespec abstime;
-                abstime.tv_sec = (time_t)(to_wait / 1000); // timeout is in millisec
-                abstime.tv_nsec = (time_t)((to_wait - ((amf_uint64)abstime.tv_sec) * 1000) * 1000000); // the rest to nanosec
-
-                err = pthread_cond_timedwait(&event->m_cond, &event->m_mutex, &abstime);
-                ret = err == 0;
-            }
-        }
+        return __atomic_load_n(&event->m_triggered, __ATOMIC_SEQ_CST) != 0;
     }
-    else
+    amf_int32 expected = 1;
+    return __atomic_compare_exchange_n(&event->m_triggered, &expected, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+//----------------------------------------------------------------------------------------
+static bool AMF_STD_CALL amf_wait_for_event_int(amf_handle hevent, unsigned long timeout, bool bTimeoutErr)
+{
+    MyEvent* event = (MyEvent*)hevent;
+    if(amf_try_take_event(event))
     {
-        if(event->m_triggered)
-        {
-            ret = true;
-        }
-        else
-        {
-            if (timeout == AMF_INFINITE) {
-                err = pthread_cond_wait(&event->m_cond, &event->m_mutex);
-            } else {
-                start_time += timeout;
-                timespec abstime;
-                abstime.tv_sec = (time_t) (start_time / 1000); // timeout is in millisec
-                abstime.tv_nsec = (time_t) ((start_time - (amf_uint64) (abstime.tv_sec) * 1000) *
-                                            1000000); // the rest to nanosec
-                err = pthread_cond_timedwait(&event->m_cond, &event->m_mutex, &abstime);
-            }
+        return true;
+    }
 
-            if (bTimeoutErr) {
-                ret = (err == 0);
-            } else {
-                ret = (err == 0 || err == ETIMEDOUT);
-            }
-        }
-        if(ret == true)
+    amf_uint64 deadline = timeout == AMF_INFINITE ? 0 : monotonic_msec() + timeout;
+    bool ret = true;
+    // announce ourselves before looking at the state again, so a set in between sees us
+    __atomic_add_fetch(&event->m_waiters, 1, __ATOMIC_SEQ_CST);
+    while(!amf_try_take_event(event))
+    {
+        if(!futex_wait_until(&event->m_triggered, 0, timeout, deadline))
         {
-            event->m_triggered = false;
+            ret = bTimeoutErr ? false : true;
+            break;
         }
     }
-    pthread_mutex_unlock(&event->m_mutex);
-
+    __atomic_sub_fetch(&event->m_waiters, 1, __ATOMIC_SEQ_CST);
     return ret;
 }
 //----------------------------------------------------------------------------------------
@@ -391,6 +382,13 @@ bool AMF_STD_CALL amf_release_mutex(amf_handle hmutex)
     return pthread_mutex_unlock(mutex) != 0;
 }
 
+//----------------------------------------------------------------------------------------
+struct MySemaphore
+{
+    amf_int32 m_count;      // futex word
+    amf_int32 m_max_count;
+    amf_int32 m_waiters;
+};
 //----------------------------------------------------------------------------------------
 amf_handle AMF_STD_CALL amf_create_semaphore(amf_long iInitCount, amf_long iMaxCount, const wchar_t* /*pName*/)
 {
@@ -399,26 +397,35 @@ amf_handle AMF_STD_CALL amf_create_semaphore(amf_long iInitCount, amf_long iMaxC
         return NULL;
     }
 
-    sem_t* semaphore = new sem_t;
-    if(sem_init(semaphore, 0, iInitCount) != 0)
-    {
-        delete semaphore;
-        return NULL;
-    }
+    MySemaphore* semaphore = new MySemaphore;
+    semaphore->m_count = iInitCount;
+    semaphore->m_max_count = iMaxCount;
+    semaphore->m_waiters = 0;
     return (amf_handle)semaphore;
 }
 //----------------------------------------------------------------------------------------
 bool AMF_STD_CALL amf_delete_semaphore(amf_handle hsemaphore)
 {
-    bool ret = true;
     if(hsemaphore == NULL)
     {
         return true;
     }
-    sem_t* semaphore = (sem_t*)hsemaphore;
-    ret = (0==sem_destroy(semaphore)) ? 1:0;
+    MySemaphore* semaphore = (MySemaphore*)hsemaphore;
     delete semaphore;
-    return ret;
+    return true;
+}
+//----------------------------------------------------------------------------------------
+static bool amf_try_take_semaphore(MySemaphore* semaphore)
+{
+    amf_int32 count = __atomic_load_n(&semaphore->m_count, __ATOMIC_SEQ_CST);
+    while(count > 0)
+    {
+        if(__atomic_compare_exchange_n(&semaphore->m_count, &count, count - 1, true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            return true;
+        }
+    }
+    return false;
 }
 //----------------------------------------------------------------------------------------
 bool AMF_STD_CALL amf_wait_for_semaphore(amf_handle hsemaphore, amf_ulong timeout)
@@ -427,32 +434,26 @@ bool AMF_STD_CALL amf_wait_for_semaphore(amf_handle hsemaphore, amf_ulong timeou
     {
         return true;
     }
-
-    // ulTimeout is in milliseconds
-    long timeout_sec = timeout / 1000;      /* Seconds */;
-    long timeout_nsec = (timeout - (timeout / 1000) * 1000) * 1000000;
-
-    timespec wait_time; //absolute time
-    clock_gettime(CLOCK_REALTIME, &wait_time);
-
-    wait_time.tv_sec += timeout_sec;
-    wait_time.tv_nsec += timeout_nsec;
-
-    if (wait_time.tv_nsec >= 1000000000)
+    MySemaphore* semaphore = (MySemaphore*)hsemaphore;
+    if(amf_try_take_semaphore(semaphore))
     {
-        wait_time.tv_sec++;
-        wait_time.tv_nsec -= 1000000000;
+        return true;
     }
 
-    sem_t* semaphore = (sem_t*)hsemaphore;
-    if(timeout != AMF_INFINITE)
-    {
-        return sem_timedwait (semaphore, &wait_time) == 0; // errno=ETIMEDOUT
-    }
-    else
+    // ulTimeout is in milliseconds
+    amf_uint64 deadline = timeout == AMF_INFINITE ? 0 : monotonic_msec() + timeout;
+    bool ret = true;
+    __atomic_add_fetch(&semaphore->m_waiters, 1, __ATOMIC_SEQ_CST);
+    while(!amf_try_take_semaphore(semaphore))
     {
-        return sem_wait(semaphore) == 0;
+        if(!futex_wait_until(&semaphore->m_count, 0, timeout, deadline))
+        {
+            ret = false;
+            break;
+        }
     }
+    __atomic_sub_fetch(&semaphore->m_waiters, 1, __ATOMIC_SEQ_CST);
+    return ret;
 }
 //----------------------------------------------------------------------------------------
 bool AMF_STD_CALL amf_release_semaphore(amf_handle hsemaphore, amf_long iCount, amf_long* iOldCount)
@@ -461,18 +462,25 @@ bool AMF_STD_CALL amf_release_semaphore(amf_handle hsemaphore, amf_long iCount,
     {
         return true;
     }
-    sem_t* semaphore = (sem_t*)hsemaphore;
+    MySemaphore* semaphore = (MySemaphore*)hsemaphore;
+
+    // like ReleaseSemaphore, fail without changing anything if the count would pass the maximum
+    amf_int32 count = __atomic_load_n(&semaphore->m_count, __ATOMIC_SEQ_CST);
+    do
+    {
+        if(iCount <= 0 || count + iCount > semaphore->m_max_count)
+        {
+            return false;
+        }
+    } while(!__atomic_compare_exchange_n(&semaphore->m_count, &count, count + iCount, true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
 
     if(iOldCount != NULL)
     {
-        int iTmp = 0;
-        sem_getvalue(semaphore, &iTmp);
-        *iOldCount = iTmp;
+        *iOldCount = count;
     }
-
-    for(int i = 0; i < iCount; i++)
+    if(__atomic_load_n(&semaphore->m_waiters, __ATOMIC_SEQ_CST) != 0)
     {
-        sem_post(semaphore);
+        futex_wake(&semaphore->m_count, iCount);
     }
     return true;
 }
@@ -516,6 +524,94 @@ void AMF_STD_CALL amf_sleep(amf_ulong msDelay)
 #endif
 }
 
+//----------------------------------------------------------------------------------------
+struct AMFPreciseTimer
+{
+    int timer;  // timerfd
+    int wake;   // eventfd
+};
+//----------------------------------------------------------------------------------------
+amf_handle AMF_STD_CALL amf_create_precise_timer()
+{
+    AMFPreciseTimer* pTimer = new AMFPreciseTimer;
+    pTimer->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    pTimer->wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(pTimer->timer < 0 || pTimer->wake < 0)
+    {
+        amf_delete_precise_timer(pTimer);
+        return NULL;
+    }
+    return pTimer;
+}
+//----------------------------------------------------------------------------------------
+bool AMF_STD_CALL amf_delete_precise_timer(amf_handle htimer)
+{
+    AMFPreciseTimer* pTimer = (AMFPreciseTimer*)htimer;
+    if(pTimer == NULL)
+    {
+        return false;
+    }
+    if(pTimer->timer >= 0)
+    {
+        close(pTimer->timer);
+    }
+    if(pTimer->wake >= 0)
+    {
+        close(pTimer->wake);
+    }
+    delete pTimer;
+    return true;
+}
+//----------------------------------------------------------------------------------------
+bool AMF_STD_CALL amf_wait_precise_timer(amf_handle htimer, amf_pts delay)
+{
+    AMFPreciseTimer* pTimer = (AMFPreciseTimer*)htimer;
+    if(pTimer == NULL)
+    {
+        return false;
+    }
+    if(delay <= 0)
+    {
+        return true;
+    }
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = delay / 10000000;
+    spec.it_value.tv_nsec = (delay % 10000000) * 100;
+    if(timerfd_settime(pTimer->timer, 0, &spec, NULL) != 0)
+    {
+        return false;
+    }
+
+    struct pollfd fds[2] = {{pTimer->wake, POLLIN, 0}, {pTimer->timer, POLLIN, 0}};
+    while(poll(fds, 2, -1) < 0)
+    {
+        if(errno != EINTR)
+        {
+            return false;
+        }
+    }
+    uint64_t count;
+    if(fds[0].revents & POLLIN)
+    {
+        ssize_t ignored = read(pTimer->wake, &count, sizeof(count));
+        (void)ignored;
+        struct itimerspec disarm = {};
+        timerfd_settime(pTimer->timer, 0, &disarm, NULL);
+        return false;
+    }
+    return read(pTimer->timer, &count, sizeof(count)) == sizeof(count);
+}
+//----------------------------------------------------------------------------------------
+bool AMF_STD_CALL amf_wake_precise_timer(amf_handle htimer)
+{
+    AMFPreciseTimer* pTimer = (AMFPreciseTimer*)htimer;
+    if(pTimer == NULL)
+    {
+        return false;
+    }
+    uint64_t one = 1;
+    return write(pTimer->wake, &one, sizeof(one)) == sizeof(one);
+}
 //----------------------------------------------------------------------------------------
 // memory
 //----------------------------------------------------------------------------------------
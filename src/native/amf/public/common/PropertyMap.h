@@ -0,0 +1,182 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+///-------------------------------------------------------------------------
+///  @file   PropertyMap.h
+///  @brief  AMFPropertyMap and AMFPropertyKey header
+///-------------------------------------------------------------------------
+#ifndef AMF_PropertyMap_h
+#define AMF_PropertyMap_h
+#pragma once
+
+#include "../include/core/Variant.h"
+#include "AMFSTL.h"
+#include <algorithm>
+#include <wchar.h>
+
+namespace amf
+{
+    //---------------------------------------------------------------------------------------------
+    // FNV-1a over the characters of a property name. Hashes the name in place so lookups by a raw
+    // name don't allocate.
+    inline amf_uint32 AMFHashPropertyName(const wchar_t* name)
+    {
+        amf_uint32 hash = 2166136261u;
+        for(; *name != 0; name++)
+        {
+            hash ^= static_cast<amf_uint32>(*name);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+    //---------------------------------------------------------------------------------------------
+    // Returns the process wide copy of name. Equal names always map to the same pointer and the
+    // copy is never freed, so it can be compared by address and kept past the caller's string.
+    const wchar_t* AMF_STD_CALL AMFInternPropertyName(const wchar_t* name);
+    //---------------------------------------------------------------------------------------------
+    // A property name that has been hashed and interned up front. Meant to be created once (e.g.
+    // as a static) for properties read on every frame or packet.
+    class AMFPropertyKey
+    {
+    public:
+        explicit AMFPropertyKey(const wchar_t* name) :
+            m_pName(AMFInternPropertyName(name)),
+            m_Hash(AMFHashPropertyName(name))
+        {
+        }
+
+        const wchar_t* GetName() const { return m_pName; }
+        amf_uint32 GetHash() const { return m_Hash; }
+
+    private:
+        const wchar_t* m_pName;
+        amf_uint32 m_Hash;
+    };
+    //---------------------------------------------------------------------------------------------
+    // Property name to value map kept as flat arrays sorted by name hash. Property storages rarely
+    // hold more than a few dozen entries, so a binary search over packed hashes beats walking a
+    // tree of heap allocated strings. Names are interned on insert; iteration order is by hash.
+    class AMFPropertyMap
+    {
+    public:
+        typedef std::pair<const wchar_t*, AMFVariant>       value_type;
+        typedef amf_vector<value_type>::iterator            iterator;
+        typedef amf_vector<value_type>::const_iterator      const_iterator;
+
+        AMFPropertyMap() : m_Hashes(), m_Entries()
+        {
+        }
+
+        amf_size size() const { return m_Entries.size(); }
+        bool empty() const { return m_Entries.empty(); }
+
+        iterator begin() { return m_Entries.begin(); }
+        iterator end() { return m_Entries.end(); }
+        const_iterator begin() const { return m_Entries.begin(); }
+        const_iterator end() const { return m_Entries.end(); }
+
+        void clear()
+        {
+            m_Hashes.clear();
+            m_Entries.clear();
+        }
+        //-------------------------------------------------------------------------------------------------
+        iterator find(const wchar_t* name)
+        {
+            return m_Entries.begin() + FindIndex(AMFHashPropertyName(name), name, false);
+        }
+        const_iterator find(const wchar_t* name) const
+        {
+            return m_Entries.begin() + FindIndex(AMFHashPropertyName(name), name, false);
+        }
+        iterator find(const amf_wstring& name) { return find(name.c_str()); }
+        const_iterator find(const amf_wstring& name) const { return find(name.c_str()); }
+        // fast path: no hashing and names are compared by address
+        iterator find(const AMFPropertyKey& key)
+        {
+            return m_Entries.begin() + FindIndex(key.GetHash(), key.GetName(), true);
+        }
+        const_iterator find(const AMFPropertyKey& key) const
+        {
+            return m_Entries.begin() + FindIndex(key.GetHash(), key.GetName(), true);
+        }
+        //-------------------------------------------------------------------------------------------------
+        AMFVariant& operator[](const wchar_t* name)
+        {
+            amf_uint32 hash = AMFHashPropertyName(name);
+            amf_size index = FindIndex(hash, name, false);
+            if(index == m_Entries.size())
+            {
+                index = Insert(hash, AMFInternPropertyName(name));
+            }
+            return m_Entries[index].second;
+        }
+        AMFVariant& operator[](const amf_wstring& name) { return (*this)[name.c_str()]; }
+        AMFVariant& operator[](const AMFPropertyKey& key)
+        {
+            amf_size index = FindIndex(key.GetHash(), key.GetName(), true);
+            if(index == m_Entries.size())
+            {
+                index = Insert(key.GetHash(), key.GetName());
+            }
+            return m_Entries[index].second;
+        }
+
+    private:
+        // Returns size() if the name isn't there. Colliding hashes sit next to each other.
+        amf_size FindIndex(amf_uint32 hash, const wchar_t* name, bool interned) const
+        {
+            amf_size index = std::lower_bound(m_Hashes.begin(), m_Hashes.end(), hash) - m_Hashes.begin();
+            for(; index < m_Hashes.size() && m_Hashes[index] == hash; index++)
+            {
+                const wchar_t* entryName = m_Entries[index].first;
+                if(entryName == name || (!interned && wcscmp(entryName, name) == 0))
+                {
+                    return index;
+                }
+            }
+            return m_Entries.size();
+        }
+        amf_size Insert(amf_uint32 hash, const wchar_t* internedName)
+        {
+            amf_size index = std::upper_bound(m_Hashes.begin(), m_Hashes.end(), hash) - m_Hashes.begin();
+            m_Hashes.insert(m_Hashes.begin() + index, hash);
+            m_Entries.insert(m_Entries.begin() + index, value_type(internedName, AMFVariant()));
+            return index;
+        }
+
+        amf_vector<amf_uint32> m_Hashes;
+        amf_vector<value_type> m_Entries;
+    };
+    //---------------------------------------------------------------------------------------------
+    //---------------------------------------------------------------------------------------------
+}
+#endif // AMF_PropertyMap_h
@@ -43,6 +43,7 @@
 #include "InterfaceImpl.h"
 #include "ObservableImpl.h"
 #include "TraceAdapter.h"
+#include "PropertyMap.h"
 #include <limits.h>
 #include <float.h>
 
@@ -115,11 +116,11 @@ namespace amf
             AMF_RETURN_IF_INVALID_POINTER(pDest);
 
             AMF_RESULT err = AMF_OK;
-            for(amf_map<amf_wstring, AMFVariant>::const_iterator it = m_PropertyValues.begin(); it != m_PropertyValues.end(); it++)
+            for(AMFPropertyMap::const_iterator it = m_PropertyValues.begin(); it != m_PropertyValues.end(); it++)
             {
                 if(!overwrite)
                 {
-                    if(pDest->HasProperty(it->first.c_str()))
+                    if(pDest->HasProperty(it->first))
                     {
                         continue;
                     }
@@ -135,17 +136,17 @@ namespace amf
                 {
                     AMFClonablePtr pCloned;
                     err = pClonable->Clone(&pCloned);
-                    AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to duplicate buffer=%s", it->first.c_str());
-                    err = pDest->SetProperty(it->first.c_str(), pCloned);
-                    AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to copy property=%s", it->first.c_str());
+                    AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to duplicate buffer=%s", it->first);
+                    err = pDest->SetProperty(it->first, pCloned);
+                    AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to copy property=%s", it->first);
                 }
                 else
                 */
                 {
-                    err = pDest->SetProperty(it->first.c_str(), it->second);
+                    err = pDest->SetProperty(it->first, it->second);
                     if(err != AMF_INVALID_ARG) // not validated - skip it
                     {
-                        AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to copy property=%s", it->first.c_str());
+                        AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to copy property=%s", it->first);
                     }
                 }
             }
@@ -225,21 +226,13 @@ namespace amf
             AMF_RETURN_IF_INVALID_POINTER(name);
             AMF_RETURN_IF_INVALID_POINTER(pValue);
             AMF_RETURN_IF_FALSE(nameSize != 0, AMF_INVALID_ARG);
-            amf_map<amf_wstring, AMFVariant>::const_iterator found = m_PropertyValues.begin();
-            if(found == m_PropertyValues.end())
+            if(index >= m_PropertyValues.size())
             {
                 return AMF_INVALID_ARG;
             }
-            for( amf_size i = 0; i < index; i++)
-            {
-                found++;
-                if(found == m_PropertyValues.end())
-                {
-                    return AMF_INVALID_ARG;
-                }
-            }
-            size_t copySize = AMF_MIN(nameSize-1, found->first.length());
-            memcpy(name, found->first.c_str(), copySize * sizeof(wchar_t));
+            AMFPropertyMap::const_iterator found = m_PropertyValues.begin() + index;
+            size_t copySize = AMF_MIN(nameSize-1, wcslen(found->first));
+            memcpy(name, found->first, copySize * sizeof(wchar_t));
             name[copySize] = 0;
             AMFVariantCopy(pValue, &found->second);
             return AMF_OK;
@@ -422,7 +415,7 @@ namespace amf
             AMF_RESULT validateResult = ValidateProperty(name, value, &validatedValue);
             if(AMF_OK == validateResult)
             {
-                amf_map<amf_wstring, AMFVariant>::iterator found = m_PropertyValues.find(name);
+                AMFPropertyMap::iterator found = m_PropertyValues.find(name);
                 if(found != m_PropertyValues.end())
                 {
                     if(found->second == validatedValue)
@@ -446,7 +439,7 @@ namespace amf
             AMF_RETURN_IF_INVALID_POINTER(name);
             AMF_RETURN_IF_INVALID_POINTER(pValue);
 
-            amf_map<amf_wstring, AMFVariant>::const_iterator found = m_PropertyValues.find(name);
+            AMFPropertyMap::const_iterator found = m_PropertyValues.find(name);
             if(found != m_PropertyValues.end())
             {
                 AMFVariantCopy(pValue, &found->second);
@@ -499,16 +492,47 @@ namespace amf
             return err;
         }
 
+        //-------------------------------------------------------------------------------------------------
+        // pre-hashed lookup for properties the component reads per frame or packet
+        AMF_RESULT GetPrivateProperty(const AMFPropertyKey& key, AMFVariantStruct* pValue) const
+        {
+            AMF_RETURN_IF_INVALID_POINTER(pValue);
+
+            AMFPropertyMap::const_iterator found = m_PropertyValues.find(key);
+            if(found != m_PropertyValues.end())
+            {
+                AMFVariantCopy(pValue, &found->second);
+                return AMF_OK;
+            }
+            return GetPrivateProperty(key.GetName(), pValue);
+        }
+        //-------------------------------------------------------------------------------------------------
+        template<typename _T>
+        AMF_RESULT GetPrivateProperty(const AMFPropertyKey& key, _T* pValue) const
+        {
+            AMFVariant var;
+            AMF_RESULT err = GetPrivateProperty(key, static_cast<AMFVariantStruct*>(&var));
+            if(err == AMF_OK)
+            {
+                *pValue = static_cast<_T>(var);
+            }
+            return err;
+        }
         //-------------------------------------------------------------------------------------------------
         bool HasPrivateProperty(const wchar_t* name) const
         {
             return m_PropertyValues.find(name) != m_PropertyValues.end();
         }
         //-------------------------------------------------------------------------------------------------
+        bool HasPrivateProperty(const AMFPropertyKey& key) const
+        {
+            return m_PropertyValues.find(key) != m_PropertyValues.end();
+        }
+        //-------------------------------------------------------------------------------------------------
         class AMFPropertyInfoImpl * m_pPropertiesInfo;
         amf_size m_szPropertiesInfoCount;
 
-        amf_map<amf_wstring, AMFVariant> m_PropertyValues;
+        AMFPropertyMap m_PropertyValues;
     private:
         AMFPropertyStorageExImpl(const AMFPropertyStorageExImpl&);
         AMFPropertyStorageExImpl& operator=(const AMFPropertyStorageExImpl&);
@@ -42,6 +42,7 @@
 #include "InterfaceImpl.h"
 #include "ObservableImpl.h"
 #include "TraceAdapter.h"
+#include "PropertyMap.h"
 
 namespace amf
 {
@@ -80,8 +81,7 @@ namespace amf
             AMF_RETURN_IF_INVALID_POINTER(pName);
             AMF_RETURN_IF_INVALID_POINTER(pValue);
 
-            amf_wstring name(pName);
-            amf_map<amf_wstring, AMFVariant>::const_iterator found = m_PropertyValues.find(name);
+            AMFPropertyMap::const_iterator found = m_PropertyValues.find(pName);
             if(found != m_PropertyValues.end())
             {
                 AMFVariantCopy(pValue, &found->second);
@@ -96,6 +96,39 @@ namespace amf
             return m_PropertyValues.find(pName) != m_PropertyValues.end();
         }
         //-------------------------------------------------------------------------------------------------
+        // pre-hashed lookups for properties read per frame or packet; not part of the interface
+        AMF_RESULT GetProperty(const AMFPropertyKey& key, AMFVariantStruct* pValue) const
+        {
+            AMF_RETURN_IF_INVALID_POINTER(pValue);
+
+            AMFPropertyMap::const_iterator found = m_PropertyValues.find(key);
+            if(found != m_PropertyValues.end())
+            {
+                AMFVariantCopy(pValue, &found->second);
+                return AMF_OK;
+            }
+            return AMF_NOT_FOUND;
+        }
+        //-------------------------------------------------------------------------------------------------
+        template<typename _T>
+        AMF_RESULT GetProperty(const AMFPropertyKey& key, _T* pValue) const
+        {
+            AMF_RETURN_IF_INVALID_POINTER(pValue);
+
+            AMFPropertyMap::const_iterator found = m_PropertyValues.find(key);
+            if(found != m_PropertyValues.end())
+            {
+                *pValue = static_cast<_T>(found->second);
+                return AMF_OK;
+            }
+            return AMF_NOT_FOUND;
+        }
+        //-------------------------------------------------------------------------------------------------
+        bool HasProperty(const AMFPropertyKey& key) const
+        {
+            return m_PropertyValues.find(key) != m_PropertyValues.end();
+        }
+        //-------------------------------------------------------------------------------------------------
         virtual amf_size    AMF_STD_CALL GetPropertyCount() const
         {
             return m_PropertyValues.size();
@@ -106,21 +139,13 @@ namespace amf
             AMF_RETURN_IF_INVALID_POINTER(pName);
             AMF_RETURN_IF_INVALID_POINTER(pValue);
             AMF_RETURN_IF_FALSE(nameSize != 0, AMF_INVALID_ARG);
-            amf_map<amf_wstring, AMFVariant>::const_iterator found = m_PropertyValues.begin();
-            if(found == m_PropertyValues.end())
+            if(index >= m_PropertyValues.size())
             {
                 return AMF_INVALID_ARG;
             }
-            for( amf_size i = 0; i < index; i++)
-            {
-                found++;
-                if(found == m_PropertyValues.end())
-                {
-                    return AMF_INVALID_ARG;
-                }
-            }
-            size_t copySize = AMF_MIN(nameSize-1, found->first.length());
-            memcpy(pName, found->first.c_str(), copySize * sizeof(wchar_t));
+            AMFPropertyMap::const_iterator found = m_PropertyValues.begin() + index;
+            size_t copySize = AMF_MIN(nameSize-1, wcslen(found->first));
+            memcpy(pName, found->first, copySize * sizeof(wchar_t));
             pName[copySize] = 0;
             AMFVariantCopy(pValue, &found->second);
             return AMF_OK;
@@ -137,30 +162,30 @@ namespace amf
             deep;
             AMF_RETURN_IF_INVALID_POINTER(pDest);
             AMF_RESULT err = AMF_OK;
-            amf_map<amf_wstring, AMFVariant>::const_iterator it = m_PropertyValues.begin();
+            AMFPropertyMap::const_iterator it = m_PropertyValues.begin();
 
             for(; it != m_PropertyValues.end(); it++)
             {
-                if(!HasProperty(it->first.c_str())) // ignore properties which aren't accessible
+                if(!HasProperty(it->first)) // ignore properties which aren't accessible
                 {
                     continue;
                 }
 
                 if(!overwrite)
                 {
-                    if(pDest->HasProperty(it->first.c_str()))
+                    if(pDest->HasProperty(it->first))
                     {
                         continue;
                     }
                 }
                 {
-                    err = pDest->SetProperty(it->first.c_str(), it->second);
+                    err = pDest->SetProperty(it->first, it->second);
                 }
                 if(err == AMF_ACCESS_DENIED)
                 {
                     continue;
                 }
-                AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to copy property=%s", it->first.c_str());
+                AMF_RETURN_IF_FAILED(err, L"AddTo() - failed to copy property=%s", it->first);
             }
             return AMF_OK;
         }        
@@ -190,7 +215,7 @@ namespace amf
         //-------------------------------------------------------------------------------------------------
     protected:
         //-------------------------------------------------------------------------------------------------
-        amf_map<amf_wstring, AMFVariant> m_PropertyValues;
+        AMFPropertyMap m_PropertyValues;
     };
     //---------------------------------------------------------------------------------------------
     //---------------------------------------------------------------------------------------------
@@ -88,6 +88,12 @@ extern "C"
     void        AMF_CDECL_CALL amf_increase_timer_precision();
     void        AMF_CDECL_CALL amf_restore_timer_precision();
 
+    // threads: precise timer - one shot, high resolution, waits can be woken early from another thread
+    amf_handle  AMF_CDECL_CALL amf_create_precise_timer();
+    bool        AMF_CDECL_CALL amf_delete_precise_timer(amf_handle htimer);
+    bool        AMF_CDECL_CALL amf_wait_precise_timer(amf_handle htimer, amf_pts delay); // false if woken early
+    bool        AMF_CDECL_CALL amf_wake_precise_timer(amf_handle htimer);
+
     amf_handle  AMF_CDECL_CALL amf_load_library(const wchar_t* filename);
     void*       AMF_CDECL_CALL amf_get_proc_address(amf_handle module, const char* procName);
     int         AMF_CDECL_CALL amf_free_library(amf_handle module);
@@ -634,13 +640,18 @@ namespace amf
         }
     };
     //----------------------------------------------------------------
+    // Sleeps on a high resolution timer for most of a wait and spins only for the tail. The spin
+    // window follows the wake-up latency observed on earlier waits, so it stays short where the OS
+    // timer is accurate.
     class AMFPreciseWaiter
     {
     public:
-        AMFPreciseWaiter() : m_WaitEvent(), m_bCancel(false)
+        AMFPreciseWaiter() : m_hTimer(amf_create_precise_timer()), m_bCancel(false), m_WakeLatency(AMF_SECOND / 1000)
         {}
         virtual ~AMFPreciseWaiter()
-        {}
+        {
+            amf_delete_precise_timer(m_hTimer);
+        }
         amf_pts Wait(amf_pts waittime)
         {
             if (waittime < 0)
@@ -650,19 +661,17 @@ namespace amf
             m_bCancel = false;
             amf_pts start = amf_high_precision_clock();
             amf_pts waited = 0;
-            int count = 0; 
-            while(!m_bCancel)
+            while(!m_bCancel && waited < waittime)
             {
-                count++;
-                if(!m_WaitEvent.LockTimeout(1))
+                if(m_hTimer != NULL)
                 {
-                    break;
+                    amf_wait_precise_timer(m_hTimer, waittime - waited);
                 }
-                waited = amf_high_precision_clock() - start;
-                if(waited >= waittime)
+                else
                 {
-                    break;
+                    amf_sleep(1);
                 }
+                waited = amf_high_precision_clock() - start;
             }
             return waited;
         }
@@ -671,23 +680,36 @@ namespace amf
             m_bCancel = false;
             amf_pts start = amf_high_precision_clock();
             amf_pts waited = 0;
-            int count = 0;
             while (!m_bCancel && waited < waittime)
             {
-                if (waittime - waited < 2 * AMF_SECOND / 1000)// last 2 ms burn CPU for precision
+                amf_pts spinWindow = GetSpinWindow();
+                if (waittime - waited <= spinWindow)
                 {
-                    for (int i = 0; i < 1000; i++)
+                    for (int i = 0; i < 100; i++)
                     {
-                        count++;
 #ifdef _WIN32
                         YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+                        __builtin_ia32_pause();
 #endif
                     }
-
                 }
-                else if (!m_WaitEvent.LockTimeout(1))
+                else if (m_hTimer == NULL)
                 {
-                    	break;
+                    amf_sleep(1);
+                }
+                else
+                {
+                    amf_pts sleep = waittime - waited - spinWindow;
+                    amf_pts sleepStart = amf_high_precision_clock();
+                    if (amf_wait_precise_timer(m_hTimer, sleep))
+                    {
+                        // how late the timer fired, averaged over 8 waits; a preempted wake-up
+                        // says nothing about the timer, so it only counts up to the largest window
+                        amf_pts late = amf_high_precision_clock() - sleepStart - sleep;
+                        late = late < 0 ? 0 : late > AMF_SECOND / 500 ? AMF_SECOND / 500 : late;
+                        m_WakeLatency += (late - m_WakeLatency) / 8;
+                    }
                 }
 
                 waited = amf_high_precision_clock() - start;
@@ -697,10 +719,21 @@ namespace amf
         void Cancel()
         {
             m_bCancel = true;
+            amf_wake_precise_timer(m_hTimer);
         }
     protected:
-        AMFEvent m_WaitEvent;
-        bool m_bCancel;
+        // twice the usual lateness leaves room for jitter
+        amf_pts GetSpinWindow() const
+        {
+            const amf_pts minWindow = AMF_SECOND / 20000;   // 50 us
+            const amf_pts maxWindow = AMF_SECOND / 500;     // 2 ms, what was always spun before
+            amf_pts window = m_WakeLatency * 2;
+            return window < minWindow ? minWindow : window > maxWindow ? maxWindow : window;
+        }
+
+        amf_handle m_hTimer;
+        volatile bool m_bCancel;
+        amf_pts m_WakeLatency;
     };
     //----------------------------------------------------------------
 } // namespace amf
@@ -33,6 +33,7 @@
 #include "../include/core/Factory.h"
 #include "Thread.h"
 #include "TraceAdapter.h"
+#include "TraceDeferred.h"
 
 #pragma warning(disable: 4251)
 #pragma warning(disable: 4996)
@@ -129,8 +130,14 @@ AMF_RESULT AMF_CDECL_CALL amf::AMFTraceEnableAsync(bool enable)
     return GetTrace()->TraceEnableAsync(enable);
 }
 //------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_CDECL_CALL amf::AMFTraceEnableDeferred(bool enable)
+{
+    return AMFTraceDeferredEnable(enable);
+}
+//------------------------------------------------------------------------------------------------
 AMF_RESULT AMF_CDECL_CALL amf::AMFTraceFlush()
 {
+    AMFTraceDeferredFlush();
     return GetTrace()->TraceFlush();
 }
 //------------------------------------------------------------------------------------------------
@@ -139,19 +146,35 @@ void AMF_CDECL_CALL amf::AMFTraceW(const wchar_t* src_path, amf_int32 line, amf_
 {
     if(countArgs <= 0)
     {
-        GetTrace()->Trace(src_path, line, level, scope, format, NULL);
+        if(!AMFTraceDefer(src_path, line, level, scope, countArgs, format, NULL))
+        {
+            GetTrace()->Trace(src_path, line, level, scope, format, NULL);
+        }
     }
     else
     {
         va_list vl;
         va_start(vl, format);
 
-        GetTrace()->Trace(src_path, line, level, scope, format, &vl);
+        // the deferred path consumes the arguments, so the direct one needs a fresh copy
+        va_list direct;
+        va_copy(direct, vl);
+        if(!AMFTraceDefer(src_path, line, level, scope, countArgs, format, &vl))
+        {
+            GetTrace()->Trace(src_path, line, level, scope, format, &direct);
+        }
+        va_end(direct);
 
         va_end(vl);
     }
 }
 //------------------------------------------------------------------------------------------------
+void AMF_STD_CALL amf::AMFTraceWriteDirect(const wchar_t* src_path, amf_int32 line, amf_int32 level, const wchar_t* scope,
+            const wchar_t* message)
+{
+    GetTrace()->Trace(src_path, line, level, scope, message, NULL);
+}
+//------------------------------------------------------------------------------------------------
 AMF_RESULT AMF_CDECL_CALL amf::AMFTraceSetPath(const wchar_t* path)
 {
     return GetTrace()->SetPath(path);
@@ -97,6 +97,27 @@ extern "C"
 {
 AMF_RESULT AMF_CDECL_CALL AMFTraceEnableAsync(bool enable);
 
+/**
+*******************************************************************************
+*   AMFTraceEnableDeferred
+*
+*   @brief
+*       Enable or disable deferred mode
+*
+*  In deferred mode AMFTraceW doesn't format anything on the calling thread. It copies the format
+*  pointer and the raw arguments (including the contents of string arguments) into a lock-free
+*  ring owned by that thread and returns. A trace thread started by this module formats the
+*  records and passes the messages on to the tracer, so tracing at debug level costs working
+*  threads a few memory copies. Messages are dropped, and the drop counted in the trace, if a
+*  thread outruns its ring.
+*
+*  Calls are counted like AMFTraceEnableAsync. When the count drops to 0 the trace thread is
+*  stopped and everything queued is written on the calling thread, so disable deferred mode
+*  before the AMF runtime is unloaded. AMFTraceFlush also writes everything queued so far.
+*******************************************************************************
+*/
+AMF_RESULT AMF_CDECL_CALL AMFTraceEnableDeferred(bool enable);
+
 /**
 *******************************************************************************
 *   AMFDebugSetDebugger
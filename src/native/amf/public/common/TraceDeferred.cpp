@@ -0,0 +1,715 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Deferred trace backend. AMFTraceW normally formats the message on the calling thread before the
+// tracer sees it. In deferred mode the caller only copies the format pointer and the raw
+// arguments into a single producer ring owned by its thread; a trace thread formats the records
+// and hands the finished messages to the tracer. Writers see the trace thread's id and the time
+// the record was formatted, which trails the real call by at most AMF_TRACE_POLL_MS.
+
+#include "TraceDeferred.h"
+#include "TraceAdapter.h"
+#include "Thread.h"
+#include <atomic>
+#include <string.h>
+
+#pragma warning(disable: 4996)
+
+using namespace amf;
+
+namespace
+{
+    const amf_size      AMF_TRACE_RING_SIZE = 64 * 1024;    // per producer thread
+    const amf_size      AMF_TRACE_MAX_ARGS = 16;            // including '*' widths and precisions
+    const amf_size      AMF_TRACE_MAX_STRING = 2048;        // characters copied per string argument
+    const amf_ulong     AMF_TRACE_POLL_MS = 20;
+
+    //---------------------------------------------------------------------------------------------
+    enum AMFTraceArgType
+    {
+        AMF_TRACE_ARG_INT,
+        AMF_TRACE_ARG_LONG,
+        AMF_TRACE_ARG_INT64,
+        AMF_TRACE_ARG_SIZE,
+        AMF_TRACE_ARG_DOUBLE,
+        AMF_TRACE_ARG_POINTER,
+        AMF_TRACE_ARG_WSTRING,
+        AMF_TRACE_ARG_STRING,
+        AMF_TRACE_ARG_NONE,     // %n: consumes a pointer, prints nothing
+    };
+    //---------------------------------------------------------------------------------------------
+    // One conversion of a printf format, following the rules of the wide amf_wprintfCore: %s is a
+    // wide string unless prefixed with h, %S is a narrow string unless prefixed with l or w.
+    struct AMFTraceSpec
+    {
+        const wchar_t*  begin;      // the '%'
+        const wchar_t*  end;        // one past the conversion character
+        amf_size        stars;
+        AMFTraceArgType type;
+    };
+    //---------------------------------------------------------------------------------------------
+    bool HasModifier(const wchar_t* begin, const wchar_t* end, const wchar_t* modifier)
+    {
+        amf_size length = wcslen(modifier);
+        for(const wchar_t* p = begin; p + length <= end; p++)
+        {
+            if(wcsncmp(p, modifier, length) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    //---------------------------------------------------------------------------------------------
+    // Finds the next conversion at or after p. Returns false when there is none.
+    bool NextSpec(const wchar_t* p, AMFTraceSpec& spec)
+    {
+        static const wchar_t conversions[] = L"cCdiouxXeEfgGaAnpsSZ";
+        for(; *p != 0; p++)
+        {
+            if(*p != L'%')
+            {
+                continue;
+            }
+            if(p[1] == L'%')
+            {
+                p++;
+                continue;
+            }
+            const wchar_t* conversion = p + 1;
+            spec.stars = 0;
+            for(; *conversion != 0 && wcschr(conversions, *conversion) == NULL; conversion++)
+            {
+                if(*conversion == L'*')
+                {
+                    spec.stars++;
+                }
+            }
+            if(*conversion == 0)
+            {
+                return false;
+            }
+            spec.begin = p;
+            spec.end = conversion + 1;
+
+            const wchar_t* modifiers = p + 1;
+            switch(*conversion)
+            {
+            case L'c':
+            case L'C':
+                spec.type = AMF_TRACE_ARG_INT;
+                break;
+            case L's':
+                spec.type = HasModifier(modifiers, conversion, L"h") ? AMF_TRACE_ARG_STRING : AMF_TRACE_ARG_WSTRING;
+                break;
+            case L'S':
+                spec.type = HasModifier(modifiers, conversion, L"l") || HasModifier(modifiers, conversion, L"w") ?
+                    AMF_TRACE_ARG_WSTRING : AMF_TRACE_ARG_STRING;
+                break;
+            case L'e':
+            case L'E':
+            case L'f':
+            case L'g':
+            case L'G':
+            case L'a':
+            case L'A':
+                spec.type = AMF_TRACE_ARG_DOUBLE;
+                break;
+            case L'p':
+            case L'Z':
+                spec.type = AMF_TRACE_ARG_POINTER;
+                break;
+            case L'n':
+                spec.type = AMF_TRACE_ARG_NONE;
+                break;
+            default:
+                if(HasModifier(modifiers, conversion, L"ll") || HasModifier(modifiers, conversion, L"I64") ||
+                    HasModifier(modifiers, conversion, L"j"))
+                {
+                    spec.type = AMF_TRACE_ARG_INT64;
+                }
+                else if(HasModifier(modifiers, conversion, L"I32"))
+                {
+                    spec.type = AMF_TRACE_ARG_INT;
+                }
+                else if(HasModifier(modifiers, conversion, L"I") || HasModifier(modifiers, conversion, L"z") ||
+                    HasModifier(modifiers, conversion, L"t"))
+                {
+                    spec.type = AMF_TRACE_ARG_SIZE;
+                }
+                else if(HasModifier(modifiers, conversion, L"l"))
+                {
+                    spec.type = AMF_TRACE_ARG_LONG;
+                }
+                else
+                {
+                    spec.type = AMF_TRACE_ARG_INT;
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+    //---------------------------------------------------------------------------------------------
+    // Records are 8 byte aligned and laid out as header, arguments, then copied strings. Copied
+    // strings are addressed by offset from the start of the record.
+    struct AMFTraceRecordHeader
+    {
+        amf_uint32      size;           // 0 marks padding up to the end of the ring
+        amf_int32       line;
+        amf_int32       level;
+        amf_uint32      argCount;
+        const wchar_t*  srcPath;
+        const wchar_t*  format;         // NULL when the format was copied
+        amf_uint32      formatOffset;
+        amf_uint32      scopeOffset;    // 0 when there is no scope
+    };
+
+    struct AMFTraceRecordArg
+    {
+        amf_uint32      type;
+        amf_uint32      offset;         // of the copied string, 0 for a NULL string
+        union
+        {
+            amf_int64   i;
+            double      d;
+            const void* p;
+        } value;
+    };
+
+    inline amf_size AlignRecord(amf_size size)
+    {
+        return (size + 7) & ~static_cast<amf_size>(7);
+    }
+    //---------------------------------------------------------------------------------------------
+    // Single producer, single consumer byte ring. Head and tail only ever grow; positions in the
+    // buffer are taken modulo its size.
+    class AMFTraceRing
+    {
+    public:
+        AMFTraceRing() : m_Head(0), m_Tail(0), m_Dropped(0), m_Orphaned(false)
+        {
+        }
+
+        // producer: returns NULL (and counts a drop) if there is no room
+        amf_uint8* Reserve(amf_size size)
+        {
+            amf_size head = m_Head.load(std::memory_order_relaxed);
+            amf_size tail = m_Tail.load(std::memory_order_acquire);
+            amf_size offset = head % AMF_TRACE_RING_SIZE;
+            amf_size padding = AMF_TRACE_RING_SIZE - offset < size ? AMF_TRACE_RING_SIZE - offset : 0;
+            if(padding + size > AMF_TRACE_RING_SIZE - (head - tail))
+            {
+                m_Dropped.fetch_add(1, std::memory_order_relaxed);
+                return NULL;
+            }
+            if(padding != 0)
+            {
+                reinterpret_cast<AMFTraceRecordHeader*>(m_Buffer + offset)->size = 0;
+                m_Reserved = padding + size;
+                return m_Buffer;
+            }
+            m_Reserved = size;
+            return m_Buffer + offset;
+        }
+        // producer: publishes the record returned by Reserve; true if the ring just passed half full
+        bool Commit()
+        {
+            amf_size head = m_Head.load(std::memory_order_relaxed);
+            amf_size used = head + m_Reserved - m_Tail.load(std::memory_order_relaxed);
+            m_Head.store(head + m_Reserved, std::memory_order_release);
+            return used >= AMF_TRACE_RING_SIZE / 2 && used - m_Reserved < AMF_TRACE_RING_SIZE / 2;
+        }
+        // consumer: next record or NULL
+        const AMFTraceRecordHeader* Front()
+        {
+            amf_size tail = m_Tail.load(std::memory_order_relaxed);
+            amf_size head = m_Head.load(std::memory_order_acquire);
+            while(tail != head)
+            {
+                amf_size offset = tail % AMF_TRACE_RING_SIZE;
+                const AMFTraceRecordHeader* pRecord = reinterpret_cast<const AMFTraceRecordHeader*>(m_Buffer + offset);
+                if(pRecord->size != 0)
+                {
+                    return pRecord;
+                }
+                tail += AMF_TRACE_RING_SIZE - offset;
+                m_Tail.store(tail, std::memory_order_release);
+            }
+            return NULL;
+        }
+        // consumer: releases the record returned by Front
+        void Pop()
+        {
+            amf_size tail = m_Tail.load(std::memory_order_relaxed);
+            const AMFTraceRecordHeader* pRecord = reinterpret_cast<const AMFTraceRecordHeader*>(m_Buffer + tail % AMF_TRACE_RING_SIZE);
+            m_Tail.store(tail + pRecord->size, std::memory_order_release);
+        }
+        bool IsEmpty() const
+        {
+            return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_relaxed);
+        }
+        amf_uint32 TakeDropped()
+        {
+            return m_Dropped.exchange(0, std::memory_order_relaxed);
+        }
+        void Orphan()
+        {
+            m_Orphaned.store(true, std::memory_order_release);
+        }
+        bool IsOrphaned() const
+        {
+            return m_Orphaned.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<amf_size>   m_Head;
+        std::atomic<amf_size>   m_Tail;
+        std::atomic<amf_uint32> m_Dropped;
+        std::atomic<bool>       m_Orphaned;
+        amf_size                m_Reserved;     // producer only
+        AMF_ALIGN(8) amf_uint8  m_Buffer[AMF_TRACE_RING_SIZE];
+    };
+    //---------------------------------------------------------------------------------------------
+    class AMFTraceDeferred : public AMFThread
+    {
+    public:
+        AMFTraceDeferred() : m_EnableCount(0), m_bEnabled(false), m_Wake(false, false)
+        {
+        }
+
+        bool IsEnabled() const
+        {
+            return m_bEnabled.load(std::memory_order_acquire);
+        }
+
+        AMF_RESULT Enable(bool enable)
+        {
+            AMFLock lock(&m_EnableSync);
+            if(enable)
+            {
+                if(m_EnableCount++ == 0)
+                {
+                    m_bEnabled.store(true, std::memory_order_release);
+                    if(!Start())
+                    {
+                        m_EnableCount = 0;
+                        m_bEnabled.store(false, std::memory_order_release);
+                        return AMF_FAIL;
+                    }
+                }
+            }
+            else if(m_EnableCount > 0 && --m_EnableCount == 0)
+            {
+                m_bEnabled.store(false, std::memory_order_release);
+                RequestStop();
+                m_Wake.SetEvent();
+                WaitForStop();
+                Drain();
+            }
+            return AMF_OK;
+        }
+
+        void Register(AMFTraceRing* pRing)
+        {
+            AMFLock lock(&m_Sync);
+            m_Rings.push_back(pRing);
+        }
+
+        void Wake()
+        {
+            m_Wake.SetEvent();
+        }
+
+        // formats and writes every queued record, frees rings whose threads have exited
+        void Drain()
+        {
+            AMFLock lock(&m_Sync);
+            for(amf_list<AMFTraceRing*>::iterator it = m_Rings.begin(); it != m_Rings.end();)
+            {
+                AMFTraceRing* pRing = *it;
+                bool orphaned = pRing->IsOrphaned();
+                for(const AMFTraceRecordHeader* pRecord = pRing->Front(); pRecord != NULL; pRecord = pRing->Front())
+                {
+                    Write(pRecord);
+                    pRing->Pop();
+                }
+                amf_uint32 dropped = pRing->TakeDropped();
+                if(dropped != 0)
+                {
+                    amf_wstring message = amf_string_format(L"%u deferred trace messages dropped, ring full", dropped);
+                    AMFTraceWriteDirect(AMF_UNICODE(__FILE__), __LINE__, AMF_TRACE_WARNING, L"AMFTrace", message.c_str());
+                }
+                if(orphaned && pRing->IsEmpty())
+                {
+                    delete pRing;
+                    it = m_Rings.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        virtual void Run()
+        {
+            while(!StopRequested())
+            {
+                m_Wake.LockTimeout(AMF_TRACE_POLL_MS);
+                Drain();
+            }
+        }
+
+    private:
+        static void Write(const AMFTraceRecordHeader* pRecord)
+        {
+            const amf_uint8* pBase = reinterpret_cast<const amf_uint8*>(pRecord);
+            const AMFTraceRecordArg* pArgs = reinterpret_cast<const AMFTraceRecordArg*>(pRecord + 1);
+            const wchar_t* format = pRecord->format != NULL ? pRecord->format : reinterpret_cast<const wchar_t*>(pBase + pRecord->formatOffset);
+            const wchar_t* scope = pRecord->scopeOffset != 0 ? reinterpret_cast<const wchar_t*>(pBase + pRecord->scopeOffset) : NULL;
+            if(pRecord->format == NULL)
+            {
+                // a finished message
+                AMFTraceWriteDirect(pRecord->srcPath, pRecord->line, pRecord->level, scope, format);
+                return;
+            }
+
+            amf_wstring message;
+            const wchar_t* literal = format;
+            amf_uint32 arg = 0;
+            AMFTraceSpec spec;
+            while(NextSpec(literal, spec) && arg + spec.stars + 1 <= pRecord->argCount)
+            {
+                int stars[2] = {0, 0};
+                for(amf_size i = 0; i < spec.stars; i++, arg++)
+                {
+                    if(i < 2)
+                    {
+                        stars[i] = static_cast<int>(pArgs[arg].value.i);
+                    }
+                }
+                amf_wstring segment(literal, spec.end);
+                const AMFTraceRecordArg& value = pArgs[arg++];
+                switch(value.type)
+                {
+                case AMF_TRACE_ARG_INT:
+                    message += FormatSpec(segment, stars, spec.stars, static_cast<int>(value.value.i));
+                    break;
+                case AMF_TRACE_ARG_LONG:
+                    message += FormatSpec(segment, stars, spec.stars, static_cast<long>(value.value.i));
+                    break;
+                case AMF_TRACE_ARG_INT64:
+                    message += FormatSpec(segment, stars, spec.stars, static_cast<long long>(value.value.i));
+                    break;
+                case AMF_TRACE_ARG_SIZE:
+                    message += FormatSpec(segment, stars, spec.stars, static_cast<size_t>(value.value.i));
+                    break;
+                case AMF_TRACE_ARG_DOUBLE:
+                    // long doubles were narrowed when they were queued
+                    segment.erase(std::remove(segment.end() - (spec.end - spec.begin), segment.end(), L'L'), segment.end());
+                    message += FormatSpec(segment, stars, spec.stars, value.value.d);
+                    break;
+                case AMF_TRACE_ARG_POINTER:
+                    segment[segment.length() - 1] = L'p';
+                    message += FormatSpec(segment, stars, spec.stars, value.value.p);
+                    break;
+                case AMF_TRACE_ARG_WSTRING:
+                case AMF_TRACE_ARG_STRING:
+                    message += FormatSpec(segment, stars, spec.stars, value.offset != 0 ? pBase + value.offset : NULL);
+                    break;
+                default:
+                    message += amf_string_format(amf_wstring(literal, spec.begin).c_str());
+                    break;
+                }
+                literal = spec.end;
+            }
+            if(NextSpec(literal, spec))
+            {
+                // more conversions than queued arguments: keep the rest as is
+                message += literal;
+            }
+            else
+            {
+                message += amf_string_format(literal);
+            }
+            AMFTraceWriteDirect(pRecord->srcPath, pRecord->line, pRecord->level, scope, message.c_str());
+        }
+
+        template<typename _T>
+        static amf_wstring FormatSpec(const amf_wstring& segment, const int* stars, amf_size starCount, _T value)
+        {
+            switch(starCount)
+            {
+            case 0:
+                return amf_string_format(segment.c_str(), value);
+            case 1:
+                return amf_string_format(segment.c_str(), stars[0], value);
+            default:
+                return amf_string_format(segment.c_str(), stars[0], stars[1], value);
+            }
+        }
+
+        AMFCriticalSection          m_EnableSync;
+        amf_long                    m_EnableCount;
+        std::atomic<bool>           m_bEnabled;
+        AMFCriticalSection          m_Sync;         // rings and consuming them
+        amf_list<AMFTraceRing*>     m_Rings;
+        AMFEvent                    m_Wake;
+    };
+    //---------------------------------------------------------------------------------------------
+    AMFTraceDeferred& GetDeferred()
+    {
+        // never destroyed: thread exit may still orphan rings during shutdown
+        static AMFTraceDeferred* s_pDeferred = new AMFTraceDeferred();
+        return *s_pDeferred;
+    }
+    //---------------------------------------------------------------------------------------------
+    // Owns the calling thread's ring. The ring itself outlives the thread until it's drained.
+    class AMFTraceRingOwner
+    {
+    public:
+        AMFTraceRingOwner() : m_pRing(NULL)
+        {
+        }
+        ~AMFTraceRingOwner()
+        {
+            if(m_pRing != NULL)
+            {
+                m_pRing->Orphan();
+            }
+        }
+        AMFTraceRing* Get()
+        {
+            if(m_pRing == NULL)
+            {
+                m_pRing = new AMFTraceRing();
+                GetDeferred().Register(m_pRing);
+            }
+            return m_pRing;
+        }
+    private:
+        AMFTraceRing* m_pRing;
+    };
+
+    thread_local AMFTraceRingOwner t_RingOwner;
+    //---------------------------------------------------------------------------------------------
+    // string argument captured on the calling thread, copied once the record is reserved
+    struct AMFTraceCapturedString
+    {
+        const void* pData;
+        amf_size    bytes;      // including the terminator
+    };
+
+    amf_size CapturedLength(const wchar_t* str)
+    {
+        amf_size length = 0;
+        while(length < AMF_TRACE_MAX_STRING && str[length] != 0)
+        {
+            length++;
+        }
+        return length;
+    }
+
+    amf_size CapturedLength(const char* str)
+    {
+        amf_size length = 0;
+        while(length < AMF_TRACE_MAX_STRING && str[length] != 0)
+        {
+            length++;
+        }
+        return length;
+    }
+
+    void CopyCaptured(amf_uint8* pDest, const AMFTraceCapturedString& str, amf_size charSize)
+    {
+        memcpy(pDest, str.pData, str.bytes - charSize);
+        memset(pDest + str.bytes - charSize, 0, charSize);
+    }
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL amf::AMFTraceDeferredEnable(bool enable)
+{
+    return GetDeferred().Enable(enable);
+}
+//-------------------------------------------------------------------------------------------------
+void AMF_STD_CALL amf::AMFTraceDeferredFlush()
+{
+    GetDeferred().Drain();
+}
+//-------------------------------------------------------------------------------------------------
+bool AMF_STD_CALL amf::AMFTraceDefer(const wchar_t* src_path, amf_int32 line, amf_int32 level, const wchar_t* scope,
+    amf_int32 countArgs, const wchar_t* format, va_list* pArglist)
+{
+    AMFTraceDeferred& deferred = GetDeferred();
+    if(!deferred.IsEnabled())
+    {
+        return false;
+    }
+
+    AMFTraceRecordArg args[AMF_TRACE_MAX_ARGS];
+    AMFTraceCapturedString strings[AMF_TRACE_MAX_ARGS];
+    amf_size charSizes[AMF_TRACE_MAX_ARGS];
+    amf_uint32 argCount = 0;
+    amf_size stringBytes = 0;
+
+    AMFTraceCapturedString copiedFormat = {format, (CapturedLength(format) + 1) * sizeof(wchar_t)};
+    bool copyFormat = countArgs <= 0 || pArglist == NULL;
+    if(copyFormat)
+    {
+        stringBytes += AlignRecord(copiedFormat.bytes);
+    }
+    AMFTraceCapturedString copiedScope = {scope, 0};
+    if(scope != NULL)
+    {
+        copiedScope.bytes = (CapturedLength(scope) + 1) * sizeof(wchar_t);
+        stringBytes += AlignRecord(copiedScope.bytes);
+    }
+
+    AMFTraceSpec spec;
+    for(const wchar_t* p = format; !copyFormat && NextSpec(p, spec) && argCount + spec.stars + 1 <= AMF_TRACE_MAX_ARGS; p = spec.end)
+    {
+        for(amf_size i = 0; i < spec.stars; i++, argCount++)
+        {
+            args[argCount].type = AMF_TRACE_ARG_INT;
+            args[argCount].offset = 0;
+            args[argCount].value.i = va_arg(*pArglist, int);
+        }
+        AMFTraceRecordArg& arg = args[argCount];
+        arg.type = spec.type;
+        arg.offset = 0;
+        strings[argCount].pData = NULL;
+        switch(spec.type)
+        {
+        case AMF_TRACE_ARG_INT:
+            arg.value.i = va_arg(*pArglist, int);
+            break;
+        case AMF_TRACE_ARG_LONG:
+            arg.value.i = va_arg(*pArglist, long);
+            break;
+        case AMF_TRACE_ARG_INT64:
+            arg.value.i = va_arg(*pArglist, long long);
+            break;
+        case AMF_TRACE_ARG_SIZE:
+            arg.value.i = static_cast<amf_int64>(va_arg(*pArglist, size_t));
+            break;
+        case AMF_TRACE_ARG_DOUBLE:
+            if(HasModifier(spec.begin, spec.end, L"L"))
+            {
+                arg.value.d = static_cast<double>(va_arg(*pArglist, long double));
+            }
+            else
+            {
+                arg.value.d = va_arg(*pArglist, double);
+            }
+            break;
+        case AMF_TRACE_ARG_WSTRING:
+            strings[argCount].pData = va_arg(*pArglist, const wchar_t*);
+            charSizes[argCount] = sizeof(wchar_t);
+            if(strings[argCount].pData != NULL)
+            {
+                strings[argCount].bytes = (CapturedLength(static_cast<const wchar_t*>(strings[argCount].pData)) + 1) * sizeof(wchar_t);
+                stringBytes += AlignRecord(strings[argCount].bytes);
+            }
+            break;
+        case AMF_TRACE_ARG_STRING:
+            strings[argCount].pData = va_arg(*pArglist, const char*);
+            charSizes[argCount] = sizeof(char);
+            if(strings[argCount].pData != NULL)
+            {
+                strings[argCount].bytes = CapturedLength(static_cast<const char*>(strings[argCount].pData)) + 1;
+                stringBytes += AlignRecord(strings[argCount].bytes);
+            }
+            break;
+        default:
+            arg.value.p = va_arg(*pArglist, const void*);
+            break;
+        }
+        argCount++;
+    }
+
+    amf_size size = sizeof(AMFTraceRecordHeader) + argCount * sizeof(AMFTraceRecordArg) + stringBytes;
+    if(size > AMF_TRACE_RING_SIZE / 4)
+    {
+        // too big to queue without starving the ring, trace it the slow way
+        return false;
+    }
+
+    AMFTraceRing* pRing = t_RingOwner.Get();
+    amf_uint8* pRecord = pRing->Reserve(size);
+    if(pRecord == NULL)
+    {
+        return true;
+    }
+
+    AMFTraceRecordHeader* pHeader = reinterpret_cast<AMFTraceRecordHeader*>(pRecord);
+    pHeader->size = static_cast<amf_uint32>(size);
+    pHeader->line = line;
+    pHeader->level = level;
+    pHeader->argCount = argCount;
+    pHeader->srcPath = src_path;
+    pHeader->format = copyFormat ? NULL : format;
+    pHeader->formatOffset = 0;
+    pHeader->scopeOffset = 0;
+
+    amf_size offset = sizeof(AMFTraceRecordHeader) + argCount * sizeof(AMFTraceRecordArg);
+    if(copyFormat)
+    {
+        CopyCaptured(pRecord + offset, copiedFormat, sizeof(wchar_t));
+        pHeader->formatOffset = static_cast<amf_uint32>(offset);
+        offset += AlignRecord(copiedFormat.bytes);
+    }
+    if(scope != NULL)
+    {
+        CopyCaptured(pRecord + offset, copiedScope, sizeof(wchar_t));
+        pHeader->scopeOffset = static_cast<amf_uint32>(offset);
+        offset += AlignRecord(copiedScope.bytes);
+    }
+    AMFTraceRecordArg* pArgs = reinterpret_cast<AMFTraceRecordArg*>(pHeader + 1);
+    for(amf_uint32 i = 0; i < argCount; i++)
+    {
+        pArgs[i] = args[i];
+        if((args[i].type == AMF_TRACE_ARG_WSTRING || args[i].type == AMF_TRACE_ARG_STRING) && strings[i].pData != NULL)
+        {
+            CopyCaptured(pRecord + offset, strings[i], charSizes[i]);
+            pArgs[i].offset = static_cast<amf_uint32>(offset);
+            offset += AlignRecord(strings[i].bytes);
+        }
+    }
+
+    if(pRing->Commit())
+    {
+        deferred.Wake();
+    }
+    return true;
+}
+//-------------------------------------------------------------------------------------------------
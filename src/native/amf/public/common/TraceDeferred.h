@@ -0,0 +1,64 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+///-------------------------------------------------------------------------
+///  @file   TraceDeferred.h
+///  @brief  Deferred trace backend used by TraceAdapter
+///-------------------------------------------------------------------------
+#ifndef AMF_TraceDeferred_h
+#define AMF_TraceDeferred_h
+#pragma once
+
+#include "../include/core/Result.h"
+#include <stdarg.h>
+
+namespace amf
+{
+    //---------------------------------------------------------------------------------------------
+    // Turns deferred mode on or off. Calls are counted like AMFTraceEnableAsync.
+    AMF_RESULT AMF_STD_CALL AMFTraceDeferredEnable(bool enable);
+    //---------------------------------------------------------------------------------------------
+    // Queues a trace call on the calling thread's ring without formatting it. Returns false if
+    // deferred mode is off and the call has to go to the tracer directly. With countArgs <= 0
+    // format is the finished message and is copied; otherwise only the pointer is kept, so
+    // src_path and format must be string literals (which the AMFTrace macros guarantee).
+    bool AMF_STD_CALL AMFTraceDefer(const wchar_t* src_path, amf_int32 line, amf_int32 level, const wchar_t* scope,
+        amf_int32 countArgs, const wchar_t* format, va_list* pArglist);
+    //---------------------------------------------------------------------------------------------
+    // Formats and writes everything queued so far on the calling thread.
+    void AMF_STD_CALL AMFTraceDeferredFlush();
+    //---------------------------------------------------------------------------------------------
+    // Hands a finished message straight to the tracer, bypassing deferred mode. Implemented in
+    // TraceAdapter.cpp.
+    void AMF_STD_CALL AMFTraceWriteDirect(const wchar_t* src_path, amf_int32 line, amf_int32 level, const wchar_t* scope,
+        const wchar_t* message);
+}
+#endif // AMF_TraceDeferred_h
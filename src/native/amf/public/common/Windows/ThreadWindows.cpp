@@ -226,6 +226,83 @@ void AMF_CDECL_CALL amf_sleep(amf_ulong delay)
 #endif
 }
 //----------------------------------------------------------------------------------------
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+struct AMFPreciseTimer
+{
+    HANDLE hTimer;
+    HANDLE hWake;
+};
+//----------------------------------------------------------------------------------------
+amf_handle AMF_CDECL_CALL amf_create_precise_timer()
+{
+    // high resolution timers need Windows 10 1803, older versions get the regular timer resolution
+    HANDLE hTimer = ::CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if(hTimer == NULL)
+    {
+        hTimer = ::CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+    }
+    if(hTimer == NULL)
+    {
+        return NULL;
+    }
+    AMFPreciseTimer* pTimer = new AMFPreciseTimer;
+    pTimer->hTimer = hTimer;
+    pTimer->hWake = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+    return pTimer;
+}
+//----------------------------------------------------------------------------------------
+bool AMF_CDECL_CALL amf_delete_precise_timer(amf_handle htimer)
+{
+    AMFPreciseTimer* pTimer = (AMFPreciseTimer*)htimer;
+    if(pTimer == NULL)
+    {
+        return false;
+    }
+    ::CloseHandle(pTimer->hTimer);
+    ::CloseHandle(pTimer->hWake);
+    delete pTimer;
+    return true;
+}
+//----------------------------------------------------------------------------------------
+bool AMF_CDECL_CALL amf_wait_precise_timer(amf_handle htimer, amf_pts delay)
+{
+    AMFPreciseTimer* pTimer = (AMFPreciseTimer*)htimer;
+    if(pTimer == NULL)
+    {
+        return false;
+    }
+    if(delay <= 0)
+    {
+        return true;
+    }
+    LARGE_INTEGER dueTime;
+    dueTime.QuadPart = -delay; // negative is relative, both are in 100 ns units
+    if(!::SetWaitableTimer(pTimer->hTimer, &dueTime, 0, NULL, NULL, FALSE))
+    {
+        return false;
+    }
+    HANDLE handles[2] = {pTimer->hWake, pTimer->hTimer};
+    if(::WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1)
+    {
+        ::CancelWaitableTimer(pTimer->hTimer);
+        return false;
+    }
+    return true;
+}
+//----------------------------------------------------------------------------------------
+bool AMF_CDECL_CALL amf_wake_precise_timer(amf_handle htimer)
+{
+    AMFPreciseTimer* pTimer = (AMFPreciseTimer*)htimer;
+    if(pTimer == NULL)
+    {
+        return false;
+    }
+    return ::SetEvent(pTimer->hWake) != FALSE;
+}
+//----------------------------------------------------------------------------------------
 amf_pts AMF_CDECL_CALL amf_high_precision_clock()
 {
     static int state = 0;
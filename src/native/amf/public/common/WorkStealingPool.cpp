@@ -0,0 +1,148 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// Workers sleep on one shared auto-reset event. A SetEvent wakes a single worker, so a worker
+// that finds more queued work after taking a task passes the wake-up on; a burst of submissions
+// ends up waking as many workers as there are tasks without every Submit waking all of them.
+
+#include "WorkStealingPool.h"
+#include <thread>
+
+using namespace amf;
+
+// How long an idle worker sleeps before looking at the deques again, in case a wake-up was missed.
+#define IDLE_WAIT_MS    100
+
+//-------------------------------------------------------------------------------------------------
+AMFWorkStealingPool::AMFWorkStealingPool(amf_size threadCount)
+    : m_WorkEvent(false, false),
+      m_iNextWorker(0),
+      m_iQueued(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+        {
+            threadCount = 4;
+        }
+    }
+    for (amf_size i = 0; i < threadCount; i++)
+    {
+        m_Workers.push_back(new Worker(this, i));
+    }
+    // only start once every deque exists, workers look at all of them
+    for (amf_size i = 0; i < m_Workers.size(); i++)
+    {
+        m_Workers[i]->Start();
+    }
+}
+//-------------------------------------------------------------------------------------------------
+AMFWorkStealingPool::~AMFWorkStealingPool()
+{
+    for (amf_size i = 0; i < m_Workers.size(); i++)
+    {
+        m_Workers[i]->RequestStop();
+    }
+    for (amf_size i = 0; i < m_Workers.size(); i++)
+    {
+        m_WorkEvent.SetEvent();
+        m_Workers[i]->WaitForStop();
+    }
+    for (amf_size i = 0; i < m_Workers.size(); i++)
+    {
+        Worker* pWorker = m_Workers[i];
+        for (amf_deque<Task*>::iterator it = pWorker->m_Tasks.begin(); it != pWorker->m_Tasks.end(); it++)
+        {
+            delete *it;
+        }
+        delete pWorker;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void AMFWorkStealingPool::Submit(Task* pTask)
+{
+    Worker* pWorker = m_Workers[m_iNextWorker++ % m_Workers.size()];
+    {
+        AMFLock lock(&pWorker->m_sync);
+        pWorker->m_Tasks.push_back(pTask);
+    }
+    m_iQueued++;
+    m_WorkEvent.SetEvent();
+}
+//-------------------------------------------------------------------------------------------------
+AMFWorkStealingPool::Task* AMFWorkStealingPool::TakeTask(amf_size index)
+{
+    Worker* pOwn = m_Workers[index];
+    {
+        AMFLock lock(&pOwn->m_sync);
+        if (!pOwn->m_Tasks.empty())
+        {
+            Task* pTask = pOwn->m_Tasks.front();
+            pOwn->m_Tasks.pop_front();
+            return pTask;
+        }
+    }
+    // steal the task the owner would have got to last
+    for (amf_size i = 1; i < m_Workers.size(); i++)
+    {
+        Worker* pVictim = m_Workers[(index + i) % m_Workers.size()];
+        AMFLock lock(&pVictim->m_sync);
+        if (!pVictim->m_Tasks.empty())
+        {
+            Task* pTask = pVictim->m_Tasks.back();
+            pVictim->m_Tasks.pop_back();
+            return pTask;
+        }
+    }
+    return NULL;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFWorkStealingPool::WorkerLoop(amf_size index)
+{
+    Worker* pWorker = m_Workers[index];
+    while (!pWorker->StopRequested())
+    {
+        Task* pTask = TakeTask(index);
+        if (pTask == NULL)
+        {
+            m_WorkEvent.Lock(IDLE_WAIT_MS);
+            continue;
+        }
+        if (--m_iQueued > 0)
+        {
+            m_WorkEvent.SetEvent();
+        }
+        pTask->Run();
+        delete pTask;
+    }
+}
@@ -0,0 +1,99 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+///-------------------------------------------------------------------------
+///  @file   WorkStealingPool.h
+///  @brief  Thread pool with per-thread task queues and work stealing
+///-------------------------------------------------------------------------
+#ifndef AMF_WorkStealingPool_h
+#define AMF_WorkStealingPool_h
+#pragma once
+
+#include "Thread.h"
+#include "AMFSTL.h"
+#include <atomic>
+
+namespace amf
+{
+    //---------------------------------------------------------------------------------------------
+    // A fixed set of worker threads that each own a deque of tasks. Submit deals tasks out to the
+    // deques in turn. A worker runs its own tasks from the front and, once it runs out, steals from
+    // the back of the others, so a run of slow tasks on one deque doesn't hold up the rest.
+    class AMFWorkStealingPool
+    {
+    public:
+        class Task
+        {
+        public:
+            virtual ~Task() {}
+            virtual void Run() = 0;
+        };
+
+        // 0 starts one thread per logical core.
+        explicit AMFWorkStealingPool(amf_size threadCount = 0);
+        // Waits for the running tasks. Tasks that haven't started are deleted without running.
+        ~AMFWorkStealingPool();
+
+        // The pool owns the task from here on and deletes it once it has run.
+        void Submit(Task* pTask);
+
+        amf_size GetThreadCount() const { return m_Workers.size(); }
+
+    private:
+        AMFWorkStealingPool(const AMFWorkStealingPool&);
+        AMFWorkStealingPool& operator=(const AMFWorkStealingPool&);
+
+        class Worker : public AMFThread
+        {
+        public:
+            Worker(AMFWorkStealingPool* pPool, amf_size index) : m_pPool(pPool), m_iIndex(index) {}
+            virtual void Run() { m_pPool->WorkerLoop(m_iIndex); }
+
+            AMFCriticalSection  m_sync;
+            amf_deque<Task*>    m_Tasks;
+
+        private:
+            AMFWorkStealingPool*    m_pPool;
+            amf_size                m_iIndex;
+        };
+
+        void WorkerLoop(amf_size index);
+        // From the worker's own deque first, then from the others. NULL if there is nothing to do.
+        Task* TakeTask(amf_size index);
+
+        amf_vector<Worker*>     m_Workers;
+        // Set whenever there may be work for a sleeping worker.
+        AMFEvent                m_WorkEvent;
+        std::atomic<amf_size>   m_iNextWorker;
+        std::atomic<amf_int64>  m_iQueued;
+    };
+}
+#endif // AMF_WorkStealingPool_h
@@ -0,0 +1,55 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//-------------------------------------------------------------------------------------------------
+// ContactSheetFFMPEG  interface declaration
+//-------------------------------------------------------------------------------------------------
+#ifndef AMF_ContactSheetFFMPEG_h
+#define AMF_ContactSheetFFMPEG_h
+
+#pragma once
+
+// Samples a recording at evenly spaced points and tiles downscaled frames into one YUV420P
+// surface. Only the keyframe nearest each point is decoded. Init() starts the work and
+// QueryOutput() returns AMF_REPEAT until the sheet is ready, then the surface, then AMF_EOF.
+// The frames are decoded on a thread pool shared by every instance, so for a batch create
+// one component per recording and Init() them all before querying.
+#define FFMPEG_CONTACT_SHEET L"ContactSheetFFMPEG"
+
+#define CONTACT_SHEET_PATH              L"Path"             // string - the recording to sample
+#define CONTACT_SHEET_OUTPUT_PATH       L"OutputPath"       // string - if set, the sheet is also written there as a JPEG
+#define CONTACT_SHEET_COLUMNS           L"Columns"          // amf_int64 (default = 5)
+#define CONTACT_SHEET_ROWS              L"Rows"             // amf_int64 (default = 4)
+#define CONTACT_SHEET_THUMBNAIL_WIDTH   L"ThumbnailWidth"   // amf_int64 (default = 320) - the height follows the video's aspect ratio
+#define CONTACT_SHEET_QUALITY           L"Quality"          // amf_int64 (default = 4) - JPEG quantizer, 2 (best) to 31
+
+#endif //#ifndef AMF_ContactSheetFFMPEG_h
@@ -51,6 +51,7 @@
 //#define FFMPEG_DEMUXER_SYNC_AV                  L"SyncAV"                   // bool (default = false)
 #define FFMPEG_DEMUXER_INDIVIDUAL_STREAM_MODE   L"StreamMode"               // bool (default = true)
 #define FFMPEG_DEMUXER_LISTEN                   L"Listen"                   // bool (default = false)
+#define FFMPEG_DEMUXER_READ_AHEAD               L"ReadAhead"                // amf_int64 (default = 32) - packets read ahead per stream, 0 reads on demand
 
 // for common, video and audio properties see Component.h
 
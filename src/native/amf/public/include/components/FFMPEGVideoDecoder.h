@@ -47,6 +47,8 @@
 #define VIDEO_DECODER_BITRATE              L"BitRate"          // amf_int64 (default = 0)
 #define VIDEO_DECODER_FRAMERATE            L"FrameRate"        // AMFRate
 #define VIDEO_DECODER_SEEK_POSITION        L"SeekPosition"     // amf_int64 (default = 0)
+#define VIDEO_DECODER_THREAD_COUNT         L"ThreadCount"      // amf_int64 (default = 0) - number of decoding threads, 0 = one per CPU core
+#define VIDEO_DECODER_THREAD_TYPE          L"ThreadType"       // amf_int64 (default = 0) - 1 = frame threads, 2 = slice threads, 3 = either, 0 = choose per codec
 
 #define VIDEO_DECODER_COLOR_TRANSFER_CHARACTERISTIC L"ColorTransferChar"    // amf_int64(AMF_COLOR_TRANSFER_CHARACTERISTIC_ENUM); default = AMF_COLOR_TRANSFER_CHARACTERISTIC_UNDEFINED, ISO/IEC 23001-8_2013  7.2
 
@@ -89,6 +89,51 @@ void Ambi2Stereo::loadTabulatedHRTFs(){
     m_convolution = new convolution(IRTABLEN,responseLength);
     m_convolution->init();
 
+    // getResponses weights each virtual speaker by cos/sin of the difference between the
+    // head and speaker angles. Expanding those differences splits every weight into a
+    // head part and a speaker part, so the responses for any head position are
+    // combinations of these fixed sums of the speaker responses H (see mixBasis):
+    //   0: H   1: cos(theta)cos(phi) H   2: cos(theta)sin(phi) H   3: sin(theta)cos(phi) H
+    //   4: sin(theta)sin(phi) H   5: cos(phi) H   6: sin(phi) H
+    // The speaker responses come from the table for inSampleRate, so this is done once here.
+    for (int ear = 0; ear < 2; ear++){
+        for (int b = 0; b < HRTF_BASIS; b++){
+            BasisResponses[ear][b] = new float[responseLength];
+            memset(BasisResponses[ear][b], 0, responseLength*sizeof(float));
+        }
+        for (int n = 0; n < IRTABLEN; n++){
+            float *response = ear == 0 ? vSpkrNresponse_L[n] : vSpkrNresponse_R[n];
+            float ct = (float)cos(theta[n] * PI / 180.0);
+            float st = (float)sin(theta[n] * PI / 180.0);
+            float cp = (float)cos(phi[n] * PI / 180.0);
+            float sp = (float)sin(phi[n] * PI / 180.0);
+            float weights[HRTF_BASIS] = { 1.0f, ct*cp, ct*sp, st*cp, st*sp, cp, sp };
+            for (int b = 0; b < HRTF_BASIS; b++){
+                for (unsigned int i = 0; i < responseLength; i++){
+                    BasisResponses[ear][b][i] += weights[b] * response[i];
+                }
+            }
+        }
+    }
+
+    // Spectra are linear in the responses, so the same combinations of the basis spectra
+    // give the response spectra.
+    partitioned = m_convolution->initPartitioned(bufSize);
+    if (partitioned){
+        amf_size spectrumLength = m_convolution->spectrumLength();
+        for (int ear = 0; ear < 2; ear++){
+            for (int b = 0; b < HRTF_BASIS; b++){
+                BasisSpectra[ear][b] = new float[spectrumLength];
+                m_convolution->computeResponseSpectrum(BasisResponses[ear][b], BasisSpectra[ear][b]);
+            }
+        }
+        for (int k = 0; k < 8; k++){
+            ResponseSpectra[k] = new float[spectrumLength];
+        }
+        for (int k = 0; k < 2; k++){
+            EarSpectrum[k] = new float[m_convolution->blockSpectrumLength()];
+        }
+    }
 }
 
 Ambi2Stereo::Ambi2Stereo(AMF_AMBISONIC2SRENDERER_MODE_ENUM decodemethod, amf_int64 inSampleRate_) :
@@ -96,6 +141,8 @@ inSampleRate(inSampleRate_)
 {
     m_convolution = NULL;
     method = decodemethod;
+    partitioned = false;
+    mixedTheta = mixedPhi = NAN;
 
     bufSize = 64;
     prevHeadTheta = prevHeadPhi = 0.0;
@@ -105,6 +152,10 @@ inSampleRate(inSampleRate_)
         vSpkrNresponse_L[n] = NULL;
         vSpkrNresponse_R[n] = NULL;
     }
+    memset(BasisResponses, 0, sizeof(BasisResponses));
+    memset(BasisSpectra, 0, sizeof(BasisSpectra));
+    memset(ResponseSpectra, 0, sizeof(ResponseSpectra));
+    memset(EarSpectrum, 0, sizeof(EarSpectrum));
 
     switch (method){
     case AMF_AMBISONIC2SRENDERER_MODE_SIMPLE:
@@ -147,6 +198,16 @@ Ambi2Stereo::~Ambi2Stereo()
         }
         vSpkrNresponse_R[n] = NULL;
     }
+    for (int ear = 0; ear < 2; ear++){
+        for (int b = 0; b < HRTF_BASIS; b++){
+            delete[] BasisResponses[ear][b];
+            delete[] BasisSpectra[ear][b];
+        }
+        delete[] EarSpectrum[ear];
+    }
+    for (int k = 0; k < 8; k++){
+        delete[] ResponseSpectra[k];
+    }
     delete LeftResponseW;
     delete LeftResponseX;
     delete LeftResponseY;
@@ -189,10 +250,6 @@ void Ambi2Stereo::getResponses(float thetaHead, float phiHead,
 
 
     float p = 0.5; // Cardiod
-    //area radius 1 cardiod = (2.0 / 3.0)*PI
-    //area radius 1 circle = PI
-    //ratio circle / cardiod = 3 / 2
-    const float scale = (float)( (3.0 / 2.0) / 20.0 );
 
     float W0 = (float)( p*sqrt(2.0) );
     float X0 = (1 - p)*Xcoeff;
@@ -209,42 +266,9 @@ void Ambi2Stereo::getResponses(float thetaHead, float phiHead,
     
     case AMF_AMBISONIC2SRENDERER_MODE_HRTF_AMD0:
     case AMF_AMBISONIC2SRENDERER_MODE_HRTF_MIT1:
-
-        W0 = (float)( p*sqrt(2.0) );
-
-        memset(Wresponse, 0, sizeof(float)*responseLength);
-        memset(Xresponse, 0, sizeof(float)*responseLength);
-        memset(Yresponse, 0, sizeof(float)*responseLength);
-        memset(Zresponse, 0, sizeof(float)*responseLength);
-
-        for (int n = 0; n < 20; n++){
-
-            X0 = (float)((1 - p)*cos((thetaHead - theta[n])*PI / 180.0) * cos((phiHead - phi[n])*PI / 180.0));
-            Y0 = (float)((1 - p)*sin((thetaHead - theta[n])*PI / 180.0) * cos((phiHead - phi[n])*PI / 180.0));
-            Z0 = (float)((1 - p)*sin((phiHead - phi[n])*PI / 180.0));
-
-            switch (channel){
-            case 0:
-                for (unsigned int i = 0; i < responseLength; i++){
-                    Wresponse[i] += W0*vSpkrNresponse_L[n][i] * scale;
-                    Xresponse[i] += X0*vSpkrNresponse_L[n][i] * scale;
-                    Yresponse[i] += Y0*vSpkrNresponse_L[n][i] * scale;
-                    Zresponse[i] += Z0*vSpkrNresponse_L[n][i] * scale;
-                }
-                break;
-            case 1:
-                for (unsigned int i = 0; i < responseLength; i++){
-                    Wresponse[i] += W0*vSpkrNresponse_R[n][i] * scale;
-                    Xresponse[i] += X0*vSpkrNresponse_R[n][i] * scale;
-                    Yresponse[i] += Y0*vSpkrNresponse_R[n][i] * scale;
-                    Zresponse[i] += Z0*vSpkrNresponse_R[n][i] * scale;
-                }
-                break;
-            default:
-                break;
-            }
+        if (channel == 0 || channel == 1){
+            mixBasis(BasisResponses[channel], responseLength, thetaHead, phiHead, Wresponse, Xresponse, Yresponse, Zresponse);
         }
-
         break;
     //case AMF_AMBISONIC2SRENDERER_MODE_HRTF_MIT1:
 
@@ -255,6 +279,59 @@ void Ambi2Stereo::getResponses(float thetaHead, float phiHead,
     }
 }
 
+void Ambi2Stereo::mixBasis(float **basis, amf_size length, float thetaHead, float phiHead,
+    float *Wresponse, float *Xresponse, float *Yresponse, float *Zresponse)
+{
+    // Each virtual speaker n is weighted by the cardioid pattern at the head angle minus
+    // the speaker angle. With
+    //   cos(a - b) = cos(a)cos(b) + sin(a)sin(b) and sin(a - b) = sin(a)cos(b) - cos(a)sin(b)
+    // the sums over n collapse onto the basis built in loadTabulatedHRTFs.
+    float p = 0.5; // Cardiod
+    //area radius 1 cardiod = (2.0 / 3.0)*PI
+    //area radius 1 circle = PI
+    //ratio circle / cardiod = 3 / 2
+    const float scale = (float)( (3.0 / 2.0) / 20.0 );
+    float W0 = (float)( p*sqrt(2.0) ) * scale;
+    float q = (1 - p) * scale;
+
+    float ct = (float)cos(thetaHead*PI / 180.0);
+    float st = (float)sin(thetaHead*PI / 180.0);
+    float cp = (float)cos(phiHead*PI / 180.0);
+    float sp = (float)sin(phiHead*PI / 180.0);
+
+    for (amf_size i = 0; i < length; i++){
+        Wresponse[i] = W0*basis[0][i];
+        Xresponse[i] = q*(ct*cp*basis[1][i] + ct*sp*basis[2][i] + st*cp*basis[3][i] + st*sp*basis[4][i]);
+        Yresponse[i] = q*(st*cp*basis[1][i] + st*sp*basis[2][i] - ct*cp*basis[3][i] - ct*sp*basis[4][i]);
+        Zresponse[i] = q*(sp*basis[5][i] - cp*basis[6][i]);
+    }
+}
+
+void Ambi2Stereo::processBlockFFT(float thetaHead, float phiHead, float **Data, float *left, float *right)
+{
+    if (thetaHead != mixedTheta || phiHead != mixedPhi){
+        amf_size spectrumLength = m_convolution->spectrumLength();
+        mixBasis(BasisSpectra[0], spectrumLength, thetaHead, phiHead, ResponseSpectra[0], ResponseSpectra[1], ResponseSpectra[2], ResponseSpectra[3]);
+        mixBasis(BasisSpectra[1], spectrumLength, thetaHead, phiHead, ResponseSpectra[4], ResponseSpectra[5], ResponseSpectra[6], ResponseSpectra[7]);
+        mixedTheta = thetaHead;
+        mixedPhi = phiHead;
+    }
+
+    // W, X, Y and Z feed both ears, so each is transformed once and the four convolutions
+    // for an ear are summed before transforming back.
+    for (int k = 0; k < 4; k++){
+        m_convolution->pushInput(k, Data[k]);
+    }
+    float *out[2] = { left, right };
+    for (int ear = 0; ear < 2; ear++){
+        memset(EarSpectrum[ear], 0, sizeof(float)*m_convolution->blockSpectrumLength());
+        for (int k = 0; k < 4; k++){
+            m_convolution->multiplyAccumulate(k, ResponseSpectra[ear * 4 + k], EarSpectrum[ear]);
+        }
+        m_convolution->inverse(EarSpectrum[ear], out[ear]);
+    }
+}
+
 void Ambi2Stereo::process(float newtheta, float newphi, int nSamples, float *W, float *X, float *Y, float *Z, float *left, float *right)
 {
     float theta = prevHeadTheta;
@@ -309,9 +386,23 @@ void Ambi2Stereo::process(float newtheta, float newphi, int nSamples, float *W,
     else {
 
         for (long i = 0; i < nSamples; i += bufSize){
+            if (partitioned){
+                processBlockFFT(theta, phi, Data, left + i, right + i);
+                theta += deltaTheta;
+                phi += deltaPhi;
+                for (int ii = 0; ii < 8; ii++){
+                    Data[ii] += bufSize;
+                }
+                continue;
+            }
+
             amf_size nProcessed;
-            getResponses(theta, phi, 0, LeftResponseW, LeftResponseX, LeftResponseY, LeftResponseZ);
-            getResponses(theta, phi, 1, RightResponseW, RightResponseX, RightResponseY, RightResponseZ);
+            if (theta != mixedTheta || phi != mixedPhi){
+                getResponses(theta, phi, 0, LeftResponseW, LeftResponseX, LeftResponseY, LeftResponseZ);
+                getResponses(theta, phi, 1, RightResponseW, RightResponseX, RightResponseY, RightResponseZ);
+                mixedTheta = theta;
+                mixedPhi = phi;
+            }
             theta += deltaTheta;
             phi += deltaPhi;
 
@@ -43,6 +43,7 @@ using namespace amf;
 #define MAX_SPEAKERS 40
 //#define EAR_FWD_AMBI_ANGLE 45.0
 #define EAR_FWD_AMBI_ANGLE 45
+#define HRTF_BASIS 7
 
 namespace amf
 {
@@ -62,6 +63,11 @@ namespace amf
         void getResponses(float theta, float phi,
             int channel,
             float *Wresponse, float *Xresponse, float *Yresponse, float *Zresponse);
+        // Combines one ear's basis responses (or their spectra) into the W/X/Y/Z responses
+        // for a head position.
+        void mixBasis(float **basis, amf_size length, float thetaHead, float phiHead,
+            float *Wresponse, float *Xresponse, float *Yresponse, float *Zresponse);
+        void processBlockFFT(float thetaHead, float phiHead, float **Data, float *left, float *right);
 
         unsigned int bufSize;
         float *OutData[8];
@@ -70,6 +76,18 @@ namespace amf
 
         convolution *m_convolution;
 
+        // Per ear, the virtual speaker responses summed with weights that only depend on the
+        // speaker positions, and their spectra. See loadTabulatedHRTFs.
+        float *BasisResponses[2][HRTF_BASIS];
+        float *BasisSpectra[2][HRTF_BASIS];
+        // Head position the current responses were mixed for.
+        float mixedTheta, mixedPhi;
+
+        // Partitioned FFT convolution state, used whenever bufSize allows it.
+        bool partitioned;
+        float *ResponseSpectra[8];
+        float *EarSpectrum[2];
+
     public:
         Ambi2Stereo(AMF_AMBISONIC2SRENDERER_MODE_ENUM  method, amf_int64 inSampleRate);
         ~Ambi2Stereo();
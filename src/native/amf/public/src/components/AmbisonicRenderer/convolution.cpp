@@ -23,40 +23,200 @@
 #include "public/include/core/Interface.h"
 #include "public/include/core/Data.h"
 #include <stdio.h>
+#include <math.h>
 #include "convolution.h"
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <immintrin.h>
+#define CONVOLUTION_SSE 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CONVOLUTION_AVX2
+#elif defined(__GNUC__)
+#define CONVOLUTION_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CONVOLUTION_NEON 1
+#endif
+
+#define CONVOLUTION_PI 3.1415926535897932384626433
+
+// FIR kernels
+//
+// All kernels work on several outputs at once and add the taps to each output in the same
+// order as the scalar loop, so the SSE kernel is bit exact and the FMA kernels only differ
+// by the rounding the fused multiply-add skips.
+
+static void firScalar(const float *x, const float *resp, int first, int last, float *out, amf_size count){
+    for (amf_size j = 0; j < count; j++){
+        float sum = 0.0f;
+        for (int k = first; k < last; k++){
+            sum += x[(int)j - k] * resp[k];
+        }
+        out[j] = sum;
+    }
+}
+
+#ifdef CONVOLUTION_SSE
+static void firSSE(const float *x, const float *resp, int first, int last, float *out, amf_size count){
+    amf_size j = 0;
+    for (; j + 16 <= count; j += 16){
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        const float *xj = x + j;
+        for (int k = first; k < last; k++){
+            __m128 r = _mm_set1_ps(resp[k]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(xj - k), r));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(xj - k + 4), r));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(xj - k + 8), r));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(xj - k + 12), r));
+        }
+        _mm_storeu_ps(out + j, acc0);
+        _mm_storeu_ps(out + j + 4, acc1);
+        _mm_storeu_ps(out + j + 8, acc2);
+        _mm_storeu_ps(out + j + 12, acc3);
+    }
+    firScalar(x + j, resp, first, last, out + j, count - j);
+}
+
+CONVOLUTION_AVX2 static void firAVX2(const float *x, const float *resp, int first, int last, float *out, amf_size count){
+    amf_size j = 0;
+    for (; j + 32 <= count; j += 32){
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        const float *xj = x + j;
+        for (int k = first; k < last; k++){
+            __m256 r = _mm256_broadcast_ss(resp + k);
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(xj - k), r, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(xj - k + 8), r, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(xj - k + 16), r, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(xj - k + 24), r, acc3);
+        }
+        _mm256_storeu_ps(out + j, acc0);
+        _mm256_storeu_ps(out + j + 8, acc1);
+        _mm256_storeu_ps(out + j + 16, acc2);
+        _mm256_storeu_ps(out + j + 24, acc3);
+    }
+    firSSE(x + j, resp, first, last, out + j, count - j);
+}
+
+static bool cpuHasAVX2(){
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7){
+        return false;
+    }
+    __cpuid(info, 1);
+    // FMA, and the OS saving the AVX registers.
+    if ((info[2] & (1 << 12)) == 0 || (info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6){
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+#ifdef CONVOLUTION_NEON
+static void firNEON(const float *x, const float *resp, int first, int last, float *out, amf_size count){
+    amf_size j = 0;
+    for (; j + 16 <= count; j += 16){
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        float32x4_t acc2 = vdupq_n_f32(0.0f);
+        float32x4_t acc3 = vdupq_n_f32(0.0f);
+        const float *xj = x + j;
+        for (int k = first; k < last; k++){
+            float32x4_t r = vdupq_n_f32(resp[k]);
+            acc0 = vfmaq_f32(acc0, vld1q_f32(xj - k), r);
+            acc1 = vfmaq_f32(acc1, vld1q_f32(xj - k + 4), r);
+            acc2 = vfmaq_f32(acc2, vld1q_f32(xj - k + 8), r);
+            acc3 = vfmaq_f32(acc3, vld1q_f32(xj - k + 12), r);
+        }
+        vst1q_f32(out + j, acc0);
+        vst1q_f32(out + j + 4, acc1);
+        vst1q_f32(out + j + 8, acc2);
+        vst1q_f32(out + j + 12, acc3);
+    }
+    firScalar(x + j, resp, first, last, out + j, count - j);
+}
+#endif
+
 convolution::convolution(int nChannels, int responseLength){
     m_nChannels = nChannels;
     m_ResponseLength = responseLength;
     m_sampHistPos = NULL;
-    m_SampleHistory = NULL;
+    m_HistoryLength = 0;
+    m_HistoryStorage = NULL;
+    m_History = NULL;
+
+    m_FirKernel = firScalar;
+#if defined(CONVOLUTION_SSE)
+    m_FirKernel = cpuHasAVX2() ? firAVX2 : firSSE;
+#elif defined(CONVOLUTION_NEON)
+    m_FirKernel = firNEON;
+#endif
+
+    m_BlockLength = 0;
+    m_Partitions = 0;
+    m_BinStride = 0;
+    m_BitReverse = NULL;
+    m_TwiddleCos = NULL;
+    m_TwiddleSin = NULL;
+    m_RealCos = NULL;
+    m_RealSin = NULL;
+    m_PrevInput = NULL;
+    m_InputSpectra = NULL;
+    m_InputPos = NULL;
+    m_Scratch = NULL;
+    m_ResponseScratch = NULL;
 }
 
 bool convolution::init(){
     m_sampHistPos = new int[m_nChannels];
+    memset(m_sampHistPos, 0, m_nChannels*sizeof(int));
 
-    m_SampleHistory = new float*[m_nChannels];
-    
-    for (int i = 0; i < m_nChannels; i++){
-        m_SampleHistory[i] = new float[m_ResponseLength];
-        memset(m_SampleHistory[i], 0, m_ResponseLength*sizeof(float));
-    }
+    // Blocks longer than the response are split, so this always holds the response plus
+    // one block, rounded up to keep every channel aligned.
+    m_HistoryLength = (2 * m_ResponseLength - 1 + 15) & ~(amf_size)15;
+    amf_size floats = m_nChannels * 2 * m_HistoryLength;
+    m_HistoryStorage = new float[floats + 16];
+    m_History = (float *)(((amf_size)m_HistoryStorage + 63) & ~(amf_size)63);
+    memset(m_History, 0, floats*sizeof(float));
 
-    return(m_sampHistPos != NULL && m_SampleHistory != NULL);
+    return(m_sampHistPos != NULL && m_History != NULL);
 
 }
 
 convolution::~convolution(){
-    if (m_sampHistPos != NULL){
-        delete m_sampHistPos;
-    }
-    if (m_SampleHistory != NULL){
+    delete[] m_sampHistPos;
+    delete[] m_HistoryStorage;
+    if (m_PrevInput != NULL){
         for (int i = 0; i < m_nChannels; i++){
-            if (m_SampleHistory[i] != NULL)
-                delete m_SampleHistory[i];
+            delete[] m_PrevInput[i];
+            delete[] m_InputSpectra[i];
         }
-        delete m_SampleHistory;
+        delete[] m_PrevInput;
+        delete[] m_InputSpectra;
     }
+    delete[] m_BitReverse;
+    delete[] m_TwiddleCos;
+    delete[] m_TwiddleSin;
+    delete[] m_RealCos;
+    delete[] m_RealSin;
+    delete[] m_InputPos;
+    delete[] m_Scratch;
+    delete[] m_ResponseScratch;
 }
 
 
@@ -70,20 +230,273 @@ void convolution::timeDomainCPU(
     amf_size datalength,
     amf_size convlength)
 {
-    int bufPos = m_sampHistPos[chanIdx];
-    bufPos = bufPos % convlength;
-    float *histBuf = m_SampleHistory[chanIdx];
+    amf_size H = m_HistoryLength;
+    if (convlength > (amf_size)m_ResponseLength){
+        convlength = m_ResponseLength;
+    }
+    if (lastNonZero > convlength){
+        lastNonZero = (amf_uint32)convlength;
+    }
+    float *histBuf = m_History + chanIdx * 2 * H;
+
+    for (amf_size done = 0; done < datalength;){
+        amf_size count = datalength - done < convlength ? datalength - done : convlength;
+
+        // Append the block to both copies of the history.
+        amf_size bufPos = m_sampHistPos[chanIdx];
+        amf_size first = H - bufPos < count ? H - bufPos : count;
+        memcpy(histBuf + bufPos, in + done, first*sizeof(float));
+        memcpy(histBuf + bufPos + H, in + done, first*sizeof(float));
+        memcpy(histBuf, in + done + first, (count - first)*sizeof(float));
+        memcpy(histBuf + H, in + done + first, (count - first)*sizeof(float));
+        bufPos = (bufPos + count) % H;
+        m_sampHistPos[chanIdx] = (int)bufPos;
+
+        // The newest H samples end just before bufPos + H, so the oldest sample of this
+        // block sits count samples before that and every tap can reach back from it.
+        const float *x = histBuf + bufPos + H - count;
+        m_FirKernel(x, resp, (int)firstNonZero, (int)lastNonZero, out + done, count);
+        done += count;
+    }
+}
+
+// Partitioned convolution
+//
+// Every block of blockLength (B) input samples is appended to the previous block and the 2B
+// samples are transformed. Multiplying that by the spectrum of a B sample slice of the response
+// and transforming back gives 2B samples, of which the last B are the exact linear convolution
+// (overlap-save). Slice p of the response is applied to the input spectrum from p blocks ago, so
+// a response of P slices costs one forward and one inverse transform per block plus P complex
+// multiply-accumulates, instead of B * P * B multiplies in the time domain.
+//
+// The 2B point real transforms are done as B point complex transforms of the even and odd
+// samples. Spectra hold bins 0..B as all real parts followed by all imaginary parts.
 
-    // circular buffer....
-    for (amf_size i = 0; i < datalength; i++){
-        histBuf[(bufPos + i) % convlength] = in[i];
+bool convolution::initPartitioned(amf_size blockLength){
+    if (blockLength < 4 || (blockLength & (blockLength - 1)) != 0 || m_PrevInput != NULL){
+        return false;
     }
+    amf_size M = blockLength;
+    m_BlockLength = blockLength;
+    m_Partitions = (m_ResponseLength + blockLength - 1) / blockLength;
+    m_BinStride = (blockLength + 1 + 3) & ~(amf_size)3;
 
-    for (amf_size j = 0; j < datalength; j++){
-        out[j] = 0.0;
-        for (int k = (int)firstNonZero; k < (int)lastNonZero; k++){
-            out[j] += histBuf[(bufPos + j - k + convlength) % convlength] * resp[k];
+    int bits = 0;
+    while (((amf_size)1 << bits) < M){
+        bits++;
+    }
+    m_BitReverse = new amf_uint32[M];
+    for (amf_size i = 0; i < M; i++){
+        amf_uint32 reversed = 0;
+        for (int b = 0; b < bits; b++){
+            reversed |= (amf_uint32)((i >> b) & 1) << (bits - 1 - b);
         }
+        m_BitReverse[i] = reversed;
+    }
+    m_TwiddleCos = new float[M / 2];
+    m_TwiddleSin = new float[M / 2];
+    for (amf_size k = 0; k < M / 2; k++){
+        m_TwiddleCos[k] = (float)cos(2.0 * CONVOLUTION_PI * k / M);
+        m_TwiddleSin[k] = (float)sin(2.0 * CONVOLUTION_PI * k / M);
+    }
+    m_RealCos = new float[M + 1];
+    m_RealSin = new float[M + 1];
+    for (amf_size k = 0; k <= M; k++){
+        m_RealCos[k] = (float)cos(CONVOLUTION_PI * k / M);
+        m_RealSin[k] = (float)sin(CONVOLUTION_PI * k / M);
+    }
+
+    m_PrevInput = new float*[m_nChannels];
+    m_InputSpectra = new float*[m_nChannels];
+    m_InputPos = new int[m_nChannels];
+    for (int i = 0; i < m_nChannels; i++){
+        m_PrevInput[i] = new float[M];
+        memset(m_PrevInput[i], 0, M*sizeof(float));
+        m_InputSpectra[i] = new float[spectrumLength()];
+        memset(m_InputSpectra[i], 0, spectrumLength()*sizeof(float));
+        m_InputPos[i] = 0;
+    }
+    m_Scratch = new float[4 * M];
+    m_ResponseScratch = new float[spectrumLength() + blockSpectrumLength()];
+    memset(m_ResponseScratch, 0, (spectrumLength() + blockSpectrumLength())*sizeof(float));
+    return true;
+}
+
+void convolution::fft(float *re, float *im, bool inverse){
+    amf_size M = m_BlockLength;
+    for (amf_size i = 0; i < M; i++){
+        amf_size j = m_BitReverse[i];
+        if (i < j){
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (amf_size size = 2; size <= M; size *= 2){
+        amf_size half = size / 2;
+        amf_size step = M / size;
+        for (amf_size start = 0; start < M; start += size){
+            for (amf_size k = 0; k < half; k++){
+                float wr = m_TwiddleCos[k * step];
+                float wi = inverse ? m_TwiddleSin[k * step] : -m_TwiddleSin[k * step];
+                amf_size a = start + k;
+                amf_size b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+void convolution::forwardReal(const float *in, float *spectrum){
+    amf_size M = m_BlockLength;
+    float *zr = m_Scratch;
+    float *zi = m_Scratch + M;
+    for (amf_size k = 0; k < M; k++){
+        zr[k] = in[2 * k];
+        zi[k] = in[2 * k + 1];
+    }
+    fft(zr, zi, false);
+
+    // Split the transform of the packed samples into the transforms of the even (E) and odd
+    // (O) samples and combine them into bins 0..M of the full transform.
+    float *re = spectrum;
+    float *im = spectrum + m_BinStride;
+    for (amf_size k = 0; k <= M; k++){
+        amf_size a = k % M;
+        amf_size b = (M - k) % M;
+        float Er = (zr[a] + zr[b]) * 0.5f;
+        float Ei = (zi[a] - zi[b]) * 0.5f;
+        float Or = (zi[a] + zi[b]) * 0.5f;
+        float Oi = (zr[b] - zr[a]) * 0.5f;
+        re[k] = Er + m_RealCos[k] * Or + m_RealSin[k] * Oi;
+        im[k] = Ei + m_RealCos[k] * Oi - m_RealSin[k] * Or;
+    }
+}
+
+void convolution::inverse(const float *acc, float *out){
+    amf_size M = m_BlockLength;
+    const float *re = acc;
+    const float *im = acc + m_BinStride;
+    float *zr = m_Scratch;
+    float *zi = m_Scratch + M;
+    for (amf_size k = 0; k < M; k++){
+        float Er = (re[k] + re[M - k]) * 0.5f;
+        float Ei = (im[k] - im[M - k]) * 0.5f;
+        float Dr = (re[k] - re[M - k]) * 0.5f;
+        float Di = (im[k] + im[M - k]) * 0.5f;
+        float Or = Dr * m_RealCos[k] - Di * m_RealSin[k];
+        float Oi = Dr * m_RealSin[k] + Di * m_RealCos[k];
+        zr[k] = Er - Oi;
+        zi[k] = Ei + Or;
+    }
+    fft(zr, zi, true);
+
+    // Only the second half of the 2B samples is free of wrap around.
+    float scale = 1.0f / M;
+    for (amf_size k = M / 2; k < M; k++){
+        out[2 * k - M] = zr[k] * scale;
+        out[2 * k + 1 - M] = zi[k] * scale;
+    }
+}
+
+void convolution::computeResponseSpectrum(const float *resp, float *spectrum){
+    amf_size M = m_BlockLength;
+    float *frame = m_Scratch + 2 * M;
+    memset(spectrum, 0, spectrumLength()*sizeof(float));
+    for (amf_size p = 0; p < m_Partitions; p++){
+        amf_size begin = p * M;
+        amf_size count = (amf_size)m_ResponseLength - begin < M ? (amf_size)m_ResponseLength - begin : M;
+        memset(frame, 0, 2 * M*sizeof(float));
+        memcpy(frame, resp + begin, count*sizeof(float));
+        forwardReal(frame, spectrum + p * 2 * m_BinStride);
+    }
+}
+
+void convolution::pushInput(int chanIdx, const float *in){
+    amf_size M = m_BlockLength;
+    float *frame = m_Scratch + 2 * M;
+    memcpy(frame, m_PrevInput[chanIdx], M*sizeof(float));
+    memcpy(frame + M, in, M*sizeof(float));
+    memcpy(m_PrevInput[chanIdx], in, M*sizeof(float));
+
+    m_InputPos[chanIdx] = (m_InputPos[chanIdx] + 1) % (int)m_Partitions;
+    forwardReal(frame, m_InputSpectra[chanIdx] + m_InputPos[chanIdx] * 2 * m_BinStride);
+}
+
+static void complexMultiplyAccumulate(const float *x, const float *h, float *acc, amf_size stride){
+    const float *xr = x;
+    const float *xi = x + stride;
+    const float *hr = h;
+    const float *hi = h + stride;
+    float *ar = acc;
+    float *ai = acc + stride;
+#ifdef CONVOLUTION_SSE
+    // stride is a multiple of 4 and the padding bins are zero.
+    for (amf_size b = 0; b < stride; b += 4){
+        __m128 XR = _mm_loadu_ps(xr + b);
+        __m128 XI = _mm_loadu_ps(xi + b);
+        __m128 HR = _mm_loadu_ps(hr + b);
+        __m128 HI = _mm_loadu_ps(hi + b);
+        __m128 AR = _mm_add_ps(_mm_loadu_ps(ar + b), _mm_sub_ps(_mm_mul_ps(XR, HR), _mm_mul_ps(XI, HI)));
+        __m128 AI = _mm_add_ps(_mm_loadu_ps(ai + b), _mm_add_ps(_mm_mul_ps(XR, HI), _mm_mul_ps(XI, HR)));
+        _mm_storeu_ps(ar + b, AR);
+        _mm_storeu_ps(ai + b, AI);
+    }
+#else
+    for (amf_size b = 0; b < stride; b++){
+        ar[b] += xr[b] * hr[b] - xi[b] * hi[b];
+        ai[b] += xr[b] * hi[b] + xi[b] * hr[b];
+    }
+#endif
+}
+
+void convolution::multiplyAccumulate(int chanIdx, const float *spectrum, float *acc){
+    int P = (int)m_Partitions;
+    amf_size partitionLength = 2 * m_BinStride;
+    for (int p = 0; p < P; p++){
+        int slot = (m_InputPos[chanIdx] - p + P) % P;
+        complexMultiplyAccumulate(m_InputSpectra[chanIdx] + slot * partitionLength, spectrum + p * partitionLength, acc, m_BinStride);
+    }
+}
+
+void convolution::frequencyDomainCPU(
+    float *resp,
+    amf_uint32 firstNonZero,
+    amf_uint32 lastNonZero,
+    float *in,
+    float *out,
+    int chanIdx,
+    amf_size datalength,
+    amf_size convlength)
+{
+    amf_size M = m_BlockLength;
+    if (datalength != M || convlength > m_Partitions * M){
+        timeDomainCPU(resp, firstNonZero, lastNonZero, in, out, chanIdx, datalength, convlength);
+        return;
+    }
+
+    pushInput(chanIdx, in);
+
+    // Only transform and apply the slices that have taps in them.
+    int P = (int)m_Partitions;
+    amf_size partitionLength = 2 * m_BinStride;
+    float *frame = m_Scratch + 2 * M;
+    float *acc = m_ResponseScratch + spectrumLength();
+    memset(acc, 0, partitionLength*sizeof(float));
+    for (int p = (int)(firstNonZero / M); p <= (int)(lastNonZero / M) && p < P; p++){
+        amf_size begin = p * M;
+        amf_size count = convlength - begin < M ? convlength - begin : M;
+        memset(frame, 0, 2 * M*sizeof(float));
+        memcpy(frame, resp + begin, count*sizeof(float));
+        float *slice = m_ResponseScratch + p * partitionLength;
+        forwardReal(frame, slice);
+
+        int slot = (m_InputPos[chanIdx] - p + P) % P;
+        complexMultiplyAccumulate(m_InputSpectra[chanIdx] + slot * partitionLength, slice, acc, m_BinStride);
     }
-    m_sampHistPos[chanIdx] += (int)datalength;
+    inverse(acc, out);
 }
@@ -33,12 +33,64 @@ public:
 void timeDomainCPU( float *resp, amf_uint32 firstNonZero, amf_uint32 lastNonZero, float *in, float *out, int chanIdx,
                       amf_size datalength, amf_size convlength);
 
+    // Uniformly partitioned overlap-save convolution. The response is split into blocks of
+    // blockLength samples, each of which is kept as a spectrum, and every channel keeps the
+    // spectra of its recent input blocks. blockLength must be a power of two; returns false
+    // otherwise, in which case only timeDomainCPU can be used.
+    bool initPartitioned(amf_size blockLength);
+
+    // Same contract as timeDomainCPU, but datalength must be the block length passed to
+    // initPartitioned. The response spectrum is computed on every call, so callers that reuse
+    // responses should use the functions below instead.
+    void frequencyDomainCPU(float *resp, amf_uint32 firstNonZero, amf_uint32 lastNonZero, float *in, float *out, int chanIdx,
+                      amf_size datalength, amf_size convlength);
+
+    // Floats needed to hold the spectrum of a response.
+    amf_size spectrumLength() const { return m_Partitions * 2 * m_BinStride; }
+    // Floats needed to hold the spectrum of one output block.
+    amf_size blockSpectrumLength() const { return 2 * m_BinStride; }
+    // Spectra are linear in the response, so a weighted sum of spectra is the spectrum of the
+    // weighted sum of their responses.
+    void computeResponseSpectrum(const float *resp, float *spectrum);
+    // Adds the next block of input for a channel.
+    void pushInput(int chanIdx, const float *in);
+    // Adds the channel's recent input convolved with the response to an output spectrum.
+    void multiplyAccumulate(int chanIdx, const float *spectrum, float *acc);
+    // Turns an output spectrum into blockLength samples.
+    void inverse(const float *acc, float *out);
+
 private:
     int m_nChannels;
     int m_ResponseLength;
 
+    // Each channel's history is stored twice in a row (2 * m_HistoryLength floats), so the
+    // newest m_HistoryLength samples can always be read without wrapping around. All channels
+    // share one 64 byte aligned allocation.
     int *m_sampHistPos;
-    float **m_SampleHistory;
+    amf_size m_HistoryLength;
+    float *m_HistoryStorage;
+    float *m_History;
+
+    // out[j] = sum of x[j - k] * resp[k] for k in [first, last).
+    typedef void (*FirKernel)(const float *x, const float *resp, int first, int last, float *out, amf_size count);
+    FirKernel m_FirKernel;
 
+    void fft(float *re, float *im, bool inverse);
+    void forwardReal(const float *in, float *spectrum);
 
+    amf_size m_BlockLength;
+    amf_size m_Partitions;
+    // Bins per spectrum (blockLength + 1) rounded up to a multiple of 4.
+    amf_size m_BinStride;
+    amf_uint32 *m_BitReverse;
+    float *m_TwiddleCos;
+    float *m_TwiddleSin;
+    float *m_RealCos;
+    float *m_RealSin;
+    // Per channel: the previous input block and a ring of m_Partitions input spectra.
+    float **m_PrevInput;
+    float **m_InputSpectra;
+    int *m_InputPos;
+    float *m_Scratch;
+    float *m_ResponseScratch;
 };
@@ -37,6 +37,7 @@
 #include "AudioEncoderFFMPEGImpl.h"
 #include "FileDemuxerFFMPEGImpl.h"
 #include "FileMuxerFFMPEGImpl.h"
+#include "ContactSheetFFMPEGImpl.h"
 
 
 //define export declaration
@@ -92,6 +93,10 @@ extern "C"
         {
             *ppComponent = new amf::AMFInterfaceMultiImpl< amf::AMFVideoDecoderFFMPEGImpl, amf::AMFComponent, amf::AMFContext* >(pContext);
         }
+        else if (name == FFMPEG_CONTACT_SHEET)
+        {
+            *ppComponent = new amf::AMFInterfaceMultiImpl< amf::AMFContactSheetFFMPEGImpl, amf::AMFComponent, amf::AMFContext* >(pContext);
+        }
         
 
         if (*ppComponent)
@@ -0,0 +1,555 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+// A contact sheet decodes one frame per tile: the keyframe at or before each sample point, found
+// through the demuxer's index, so the cost doesn't grow with the length of the recording. The
+// tiles are tasks on a work stealing pool shared by all instances; every task borrows a
+// demuxer/decoder pair from its sheet and hands it back, so a sheet opens the recording about as
+// many times as there are threads working on it rather than once per tile.
+
+#include "ContactSheetFFMPEGImpl.h"
+#include "ContactSheetScale.h"
+#include "FileDemuxerFFMPEGImpl.h"
+#include "VideoDecoderFFMPEGImpl.h"
+#include "UtilsFFMPEG.h"
+
+#include "public/include/core/Context.h"
+#include "public/include/core/Trace.h"
+#include "public/common/TraceAdapter.h"
+#include "public/common/DataStream.h"
+#include "public/include/components/FFMPEGFileDemuxer.h"
+#include "public/include/components/FFMPEGVideoDecoder.h"
+
+#define AMF_FACILITY L"AMFContactSheetFFMPEGImpl"
+
+using namespace amf;
+
+// the packets a reader may skip after a seek before giving up on a tile
+#define MAX_PACKETS_PER_TILE    16
+// the decoder calls it takes at most to drain one keyframe
+#define MAX_DECODE_CALLS        16
+
+namespace
+{
+    //-------------------------------------------------------------------------------------------------
+    // The pool is created by the first initialized instance and destroyed with the last, so no
+    // threads outlive the components (or get torn down while the library unloads).
+    AMFCriticalSection      s_PoolSync;
+    AMFWorkStealingPool*    s_pPool = NULL;
+    amf_int32               s_iPoolUsers = 0;
+
+    AMFWorkStealingPool* AcquirePool()
+    {
+        AMFLock lock(&s_PoolSync);
+        if (s_pPool == NULL)
+        {
+            s_pPool = new AMFWorkStealingPool();
+        }
+        s_iPoolUsers++;
+        return s_pPool;
+    }
+    //-------------------------------------------------------------------------------------------------
+    void ReleasePool()
+    {
+        AMFLock lock(&s_PoolSync);
+        if (--s_iPoolUsers == 0)
+        {
+            delete s_pPool;
+            s_pPool = NULL;
+        }
+    }
+    //-------------------------------------------------------------------------------------------------
+    class TileTask : public AMFWorkStealingPool::Task
+    {
+    public:
+        TileTask(AMFContactSheetJob* pJob, amf_int32 tile, amf_pts pts) : m_pJob(pJob), m_iTile(tile), m_pts(pts) {}
+        virtual void Run()  { m_pJob->DecodeTile(m_iTile, m_pts); }
+
+    private:
+        AMFContactSheetJobPtr   m_pJob;
+        amf_int32               m_iTile;
+        amf_pts                 m_pts;
+    };
+    //-------------------------------------------------------------------------------------------------
+    void FillPlane(AMFPlane* pPlane, amf_uint8 value)
+    {
+        amf_uint8* pLine = static_cast<amf_uint8*>(pPlane->GetNative());
+        for (amf_int32 y = 0; y < pPlane->GetHeight(); y++)
+        {
+            memset(pLine, value, pPlane->GetWidth());
+            pLine += pPlane->GetHPitch();
+        }
+    }
+}
+
+
+//
+//
+// AMFContactSheetJob
+//
+//
+
+//-------------------------------------------------------------------------------------------------
+AMFContactSheetJob::AMFContactSheetJob(AMFContext* pContext, const amf_wstring& path)
+  : m_pContext(pContext),
+    m_Path(path),
+    m_iQuality(0),
+    m_eDecoderFormat(AMF_SURFACE_UNKNOWN),
+    m_FrameSize(AMFConstructSize(0, 0)),
+    m_iColumns(1),
+    m_iThumbnailWidth(0),
+    m_iThumbnailHeight(0),
+    m_iRemaining(0),
+    m_bCancelled(false),
+    m_bDone(false)
+{
+}
+//-------------------------------------------------------------------------------------------------
+AMFContactSheetJob::~AMFContactSheetJob()
+{
+    for (amf_size i = 0; i < m_IdleReaders.size(); i++)
+    {
+        Reader* pReader = m_IdleReaders[i];
+        if (pReader->pDecoder != NULL)
+        {
+            pReader->pDecoder->Terminate();
+        }
+        pReader->pDemuxer->Terminate();
+        delete pReader;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFContactSheetJob::Open(amf_pts* pDuration, AMFSize* pFrameSize)
+{
+    // the reader that finds out about the recording is kept for the first tile
+    Reader* pReader = new Reader();
+    AMF_RESULT res = CreateReader(pReader);
+    if (res != AMF_OK)
+    {
+        delete pReader;
+        return res;
+    }
+    *pDuration = AMFMediaSourcePtr(pReader->pDemuxer)->GetDuration();
+    *pFrameSize = m_FrameSize;
+
+    ReleaseReader(pReader);
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFContactSheetJob::Start(amf_int32 columns, amf_int32 rows, amf_int32 thumbnailWidth, amf_int32 thumbnailHeight,
+                                     const amf_wstring& outputPath, amf_int32 quality)
+{
+    m_iColumns = columns;
+    m_iThumbnailWidth = thumbnailWidth;
+    m_iThumbnailHeight = thumbnailHeight;
+    m_OutputPath = outputPath;
+    m_iQuality = quality;
+    m_iRemaining = columns * rows;
+
+    AMF_RESULT res = m_pContext->AllocSurface(AMF_MEMORY_HOST, AMF_SURFACE_YUV420P, columns * thumbnailWidth, rows * thumbnailHeight, &m_pSheet);
+    AMF_RETURN_IF_FAILED(res, L"Start() - AllocSurface failed");
+
+    // tiles without a frame stay black
+    FillPlane(m_pSheet->GetPlane(AMF_PLANE_Y), 0);
+    FillPlane(m_pSheet->GetPlane(AMF_PLANE_U), 128);
+    FillPlane(m_pSheet->GetPlane(AMF_PLANE_V), 128);
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFContactSheetJob::DecodeTile(amf_int32 tile, amf_pts pts)
+{
+    if (!m_bCancelled)
+    {
+        Reader* pReader = AcquireReader();
+        if (pReader != NULL)
+        {
+            AMFSurfacePtr pFrame;
+            AMF_RESULT res = ReadKeyframe(pReader, pts, &pFrame);
+            if (res != AMF_OK)
+            {
+                AMFTraceWarning(AMF_FACILITY, L"DecodeTile() - no frame for tile %d of %s: %s", tile, m_Path.c_str(), AMFGetResultText(res));
+            }
+            else if (!m_bCancelled)
+            {
+                DrawTile(tile, pFrame);
+            }
+            ReleaseReader(pReader);
+        }
+    }
+
+    if (--m_iRemaining == 0)
+    {
+        if (!m_bCancelled && !m_OutputPath.empty())
+        {
+            AMF_RESULT res = WriteJpeg();
+            if (res != AMF_OK)
+            {
+                AMFTraceError(AMF_FACILITY, L"DecodeTile() - failed to write %s: %s", m_OutputPath.c_str(), AMFGetResultText(res));
+            }
+        }
+        m_bDone = true;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFContactSheetJob::CreateReader(Reader* pReader)
+{
+    pReader->pDemuxer = new AMFInterfaceMultiImpl< AMFFileDemuxerFFMPEGImpl, AMFComponentEx, AMFContext* >(m_pContext);
+    pReader->pDemuxer->SetProperty(FFMPEG_DEMUXER_PATH, m_Path.c_str());
+    // every read follows a seek, anything read ahead would be thrown away
+    pReader->pDemuxer->SetProperty(FFMPEG_DEMUXER_READ_AHEAD, 0);
+    AMF_RETURN_IF_FAILED(pReader->pDemuxer->Init(AMF_SURFACE_UNKNOWN, 0, 0), L"CreateReader() - failed to open %s", m_Path.c_str());
+
+    pReader->iVideoIndex = -1;
+    for (amf_int32 i = 0; i < pReader->pDemuxer->GetOutputCount(); i++)
+    {
+        AMFOutputPtr pOutput;
+        amf_int64 type = AMF_STREAM_UNKNOWN;
+        if (pReader->pDemuxer->GetOutput(i, &pOutput) == AMF_OK
+            && pOutput->GetProperty(AMF_STREAM_TYPE, &type) == AMF_OK
+            && type == AMF_STREAM_VIDEO)
+        {
+            pReader->pVideo = pOutput;
+            pReader->iVideoIndex = i;
+            break;
+        }
+    }
+    AMF_RETURN_IF_FALSE(pReader->pVideo != NULL, AMF_NOT_FOUND, L"CreateReader() - %s has no video", m_Path.c_str());
+    pReader->pVideo->SetProperty(AMF_STREAM_ENABLED, true);
+
+    amf_int64 codecID = 0;
+    amf_int64 codecFFMPEG = 0;
+    amf_int64 format = AMF_SURFACE_UNKNOWN;
+    AMFRate frameRate = AMFConstructRate(25, 1);
+    AMFVariant extraData;
+    pReader->pVideo->GetProperty(AMF_STREAM_CODEC_ID, &codecID);
+    pReader->pVideo->GetProperty(FFMPEG_DEMUXER_VIDEO_CODEC, &codecFFMPEG);
+    pReader->pVideo->GetProperty(AMF_STREAM_VIDEO_FORMAT, &format);
+    pReader->pVideo->GetProperty(AMF_STREAM_VIDEO_FRAME_RATE, &frameRate);
+    pReader->pVideo->GetProperty(AMF_STREAM_VIDEO_FRAME_SIZE, &m_FrameSize);
+    pReader->pVideo->GetProperty(AMF_STREAM_EXTRA_DATA, &extraData);
+
+    // the demuxer reports 8 bit 4:2:0 as NV12. The h264/hevc software decoders produce YUV420P,
+    // which the decoder hands over without a copy; anything else is converted to NV12 by it.
+    AMF_RETURN_IF_FALSE(format == AMF_SURFACE_NV12, AMF_NOT_SUPPORTED, L"CreateReader() - %s isn't 8 bit 4:2:0", m_Path.c_str());
+    m_eDecoderFormat = (codecFFMPEG == AV_CODEC_ID_H264 || codecFFMPEG == AV_CODEC_ID_HEVC) ? AMF_SURFACE_YUV420P : AMF_SURFACE_NV12;
+
+    pReader->pDecoder = new AMFInterfaceMultiImpl< AMFVideoDecoderFFMPEGImpl, AMFComponent, AMFContext* >(m_pContext);
+    pReader->pDecoder->SetProperty(VIDEO_DECODER_CODEC_ID, codecID);
+    pReader->pDecoder->SetProperty(VIDEO_DECODER_FRAMERATE, frameRate);
+    pReader->pDecoder->SetProperty(VIDEO_DECODER_EXTRA_DATA, extraData);
+    // the tiles are decoded in parallel already, and frame threads would only add latency to
+    // a single keyframe
+    pReader->pDecoder->SetProperty(VIDEO_DECODER_THREAD_COUNT, 1);
+    AMF_RETURN_IF_FAILED(pReader->pDecoder->Init(m_eDecoderFormat, m_FrameSize.width, m_FrameSize.height), L"CreateReader() - decoder Init failed");
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMFContactSheetJob::Reader* AMFContactSheetJob::AcquireReader()
+{
+    {
+        AMFLock lock(&m_sync);
+        if (!m_IdleReaders.empty())
+        {
+            Reader* pReader = m_IdleReaders.back();
+            m_IdleReaders.pop_back();
+            return pReader;
+        }
+    }
+
+    Reader* pReader = new Reader();
+    if (CreateReader(pReader) != AMF_OK)
+    {
+        delete pReader;
+        return NULL;
+    }
+    return pReader;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFContactSheetJob::ReleaseReader(Reader* pReader)
+{
+    AMFLock lock(&m_sync);
+    m_IdleReaders.push_back(pReader);
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFContactSheetJob::ReadKeyframe(Reader* pReader, amf_pts pts, AMFSurface** ppFrame)
+{
+    AMFMediaSourcePtr pSource(pReader->pDemuxer);
+    AMF_RETURN_IF_FAILED(pSource->Seek(pts, AMF_SEEK_PREV_KEYFRAME, pReader->iVideoIndex));
+
+    // the first packet after a keyframe seek is the keyframe
+    AMFDataPtr pPacket;
+    AMF_RESULT res = AMF_OK;
+    for (amf_int32 i = 0; i < MAX_PACKETS_PER_TILE && pPacket == NULL; i++)
+    {
+        res = pReader->pVideo->QueryOutput(&pPacket);
+        if (res != AMF_OK && res != AMF_REPEAT)
+        {
+            return res;
+        }
+    }
+    AMF_RETURN_IF_FALSE(pPacket != NULL, AMF_EOF, L"ReadKeyframe() - no packet at %lld", pts);
+
+    // a single packet is decoded by draining; Flush() readies the decoder for the next one
+    pReader->pDecoder->Flush();
+    AMF_RETURN_IF_FAILED(pReader->pDecoder->SubmitInput(pPacket));
+    pReader->pDecoder->Drain();
+
+    AMFDataPtr pFrame;
+    for (amf_int32 i = 0; i < MAX_DECODE_CALLS && pFrame == NULL; i++)
+    {
+        res = pReader->pDecoder->QueryOutput(&pFrame);
+        if (res != AMF_OK && res != AMF_REPEAT)
+        {
+            break;
+        }
+    }
+    AMF_RETURN_IF_FALSE(pFrame != NULL, AMF_EOF, L"ReadKeyframe() - the keyframe at %lld didn't decode", pts);
+
+    AMFSurfacePtr pSurface(pFrame);
+    *ppFrame = pSurface.Detach();
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFContactSheetJob::DrawTile(amf_int32 tile, AMFSurface* pFrame)
+{
+    const amf_int32 left = (tile % m_iColumns) * m_iThumbnailWidth;
+    const amf_int32 top = (tile / m_iColumns) * m_iThumbnailHeight;
+
+    AMFPlane* pSheetPlanes[3] = { m_pSheet->GetPlane(AMF_PLANE_Y), m_pSheet->GetPlane(AMF_PLANE_U), m_pSheet->GetPlane(AMF_PLANE_V) };
+    amf_uint8* pTiles[3];
+    for (int i = 0; i < 3; i++)
+    {
+        const amf_int32 shift = (i == 0) ? 0 : 1;
+        pTiles[i] = static_cast<amf_uint8*>(pSheetPlanes[i]->GetNative())
+            + amf_size(top >> shift) * pSheetPlanes[i]->GetHPitch() + (left >> shift);
+    }
+
+    AMFPlane* pY = pFrame->GetPlane(AMF_PLANE_Y);
+    AMFContactSheetScalePlane(static_cast<const amf_uint8*>(pY->GetNative()), pY->GetHPitch(), pY->GetWidth(), pY->GetHeight(), 1,
+        &pTiles[0], pSheetPlanes[0]->GetHPitch(), m_iThumbnailWidth, m_iThumbnailHeight, AMFContactSheetLumaLevels());
+
+    const amf_int32 chromaWidth = m_iThumbnailWidth / 2;
+    const amf_int32 chromaHeight = m_iThumbnailHeight / 2;
+    if (pFrame->GetFormat() == AMF_SURFACE_NV12)
+    {
+        AMFPlane* pUV = pFrame->GetPlane(AMF_PLANE_UV);
+        AMFContactSheetScalePlane(static_cast<const amf_uint8*>(pUV->GetNative()), pUV->GetHPitch(), pUV->GetWidth(), pUV->GetHeight(), 2,
+            &pTiles[1], pSheetPlanes[1]->GetHPitch(), chromaWidth, chromaHeight, AMFContactSheetChromaLevels());
+    }
+    else
+    {
+        for (int i = 1; i < 3; i++)
+        {
+            AMFPlane* pPlane = pFrame->GetPlane(i == 1 ? AMF_PLANE_U : AMF_PLANE_V);
+            AMFContactSheetScalePlane(static_cast<const amf_uint8*>(pPlane->GetNative()), pPlane->GetHPitch(), pPlane->GetWidth(), pPlane->GetHeight(), 1,
+                &pTiles[i], pSheetPlanes[i]->GetHPitch(), chromaWidth, chromaHeight, AMFContactSheetChromaLevels());
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFContactSheetJob::WriteJpeg()
+{
+    AVCodec* pCodec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    AMF_RETURN_IF_FALSE(pCodec != NULL, AMF_CODEC_NOT_SUPPORTED, L"WriteJpeg() - no MJPEG encoder");
+
+    AVCodecContext* pCodecContext = avcodec_alloc_context3(pCodec);
+    AVFrame* pFrame = av_frame_alloc();
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+    pCodecContext->width = m_pSheet->GetPlane(AMF_PLANE_Y)->GetWidth();
+    pCodecContext->height = m_pSheet->GetPlane(AMF_PLANE_Y)->GetHeight();
+    pCodecContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    pCodecContext->time_base.num = 1;
+    pCodecContext->time_base.den = 25;
+    pCodecContext->flags |= AV_CODEC_FLAG_QSCALE;
+    pCodecContext->global_quality = FF_QP2LAMBDA * m_iQuality;
+
+    AMF_RESULT res = AMF_FAIL;
+    if (avcodec_open2(pCodecContext, pCodec, NULL) == 0)
+    {
+        pFrame->format = pCodecContext->pix_fmt;
+        pFrame->width = pCodecContext->width;
+        pFrame->height = pCodecContext->height;
+        pFrame->quality = pCodecContext->global_quality;
+        pFrame->pts = 0;
+        const AMF_PLANE_TYPE planes[3] = { AMF_PLANE_Y, AMF_PLANE_U, AMF_PLANE_V };
+        for (int i = 0; i < 3; i++)
+        {
+            AMFPlane* pPlane = m_pSheet->GetPlane(planes[i]);
+            pFrame->data[i] = static_cast<uint8_t*>(pPlane->GetNative());
+            pFrame->linesize[i] = pPlane->GetHPitch();
+        }
+
+        if (avcodec_send_frame(pCodecContext, pFrame) == 0
+            && avcodec_send_frame(pCodecContext, NULL) == 0
+            && avcodec_receive_packet(pCodecContext, &packet) == 0)
+        {
+            AMFDataStreamPtr pStream;
+            res = AMFDataStream::OpenDataStream(m_OutputPath.c_str(), AMFSO_WRITE, AMFFS_EXCLUSIVE, &pStream);
+            if (res == AMF_OK)
+            {
+                amf_size written = 0;
+                res = pStream->Write(packet.data, packet.size, &written);
+                pStream->Close();
+            }
+        }
+    }
+
+    av_packet_unref(&packet);
+    av_frame_free(&pFrame);
+    avcodec_free_context(&pCodecContext);
+    return res;
+}
+
+
+//
+//
+// AMFContactSheetFFMPEGImpl
+//
+//
+
+//-------------------------------------------------------------------------------------------------
+AMFContactSheetFFMPEGImpl::AMFContactSheetFFMPEGImpl(AMFContext* pContext)
+  : m_pContext(pContext),
+    m_pPool(NULL),
+    m_bDelivered(false)
+{
+    AMFPrimitivePropertyInfoMapBegin
+        AMFPropertyInfoWString(CONTACT_SHEET_PATH, L"Recording", L"", true),
+        AMFPropertyInfoWString(CONTACT_SHEET_OUTPUT_PATH, L"JPEG Output", L"", true),
+        AMFPropertyInfoInt64(CONTACT_SHEET_COLUMNS, L"Columns", 5, 1, 64, true),
+        AMFPropertyInfoInt64(CONTACT_SHEET_ROWS, L"Rows", 4, 1, 64, true),
+        AMFPropertyInfoInt64(CONTACT_SHEET_THUMBNAIL_WIDTH, L"Thumbnail Width", 320, 64, 1920, true),
+        AMFPropertyInfoInt64(CONTACT_SHEET_QUALITY, L"Quality", 4, 2, 31, true),
+    AMFPrimitivePropertyInfoMapEnd
+
+    InitFFMPEG();
+}
+//-------------------------------------------------------------------------------------------------
+AMFContactSheetFFMPEGImpl::~AMFContactSheetFFMPEGImpl()
+{
+    Terminate();
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFContactSheetFFMPEGImpl::Init(AMF_SURFACE_FORMAT /*format*/, amf_int32 /*width*/, amf_int32 /*height*/)
+{
+    AMFLock lock(&m_sync);
+
+    Terminate();
+
+    amf_wstring path;
+    amf_wstring outputPath;
+    amf_int64 columns = 5;
+    amf_int64 rows = 4;
+    amf_int64 thumbnailWidth = 320;
+    amf_int64 quality = 4;
+    AMF_RETURN_IF_FAILED(GetPropertyWString(CONTACT_SHEET_PATH, &path));
+    GetPropertyWString(CONTACT_SHEET_OUTPUT_PATH, &outputPath);
+    GetProperty(CONTACT_SHEET_COLUMNS, &columns);
+    GetProperty(CONTACT_SHEET_ROWS, &rows);
+    GetProperty(CONTACT_SHEET_THUMBNAIL_WIDTH, &thumbnailWidth);
+    GetProperty(CONTACT_SHEET_QUALITY, &quality);
+    AMF_RETURN_IF_FALSE(!path.empty(), AMF_INVALID_ARG, L"Init() - no recording set");
+
+    AMFContactSheetJobPtr pJob(new AMFContactSheetJob(m_pContext, path));
+    amf_pts duration = 0;
+    AMFSize frameSize = AMFConstructSize(0, 0);
+    AMF_RETURN_IF_FAILED(pJob->Open(&duration, &frameSize));
+    AMF_RETURN_IF_FALSE(frameSize.width > 0 && frameSize.height > 0, AMF_INVALID_FORMAT, L"Init() - %s has no frame size", path.c_str());
+
+    // keep 4:2:0 chroma whole
+    const amf_int32 width = amf_int32(thumbnailWidth) & ~1;
+    const amf_int32 height = AMF_MAX(amf_int32(amf_int64(width) * frameSize.height / frameSize.width) & ~1, 2);
+    AMF_RETURN_IF_FAILED(pJob->Start(amf_int32(columns), amf_int32(rows), width, height, outputPath, amf_int32(quality)));
+
+    m_pJob = pJob;
+    m_pPool = AcquirePool();
+    m_bDelivered = false;
+
+    // sample the middle of each of the equal parts of the recording
+    const amf_int32 tiles = amf_int32(columns * rows);
+    for (amf_int32 i = 0; i < tiles; i++)
+    {
+        m_pPool->Submit(new TileTask(m_pJob, i, duration * (2 * i + 1) / (2 * tiles)));
+    }
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFContactSheetFFMPEGImpl::ReInit(amf_int32 width, amf_int32 height)
+{
+    Terminate();
+    return Init(AMF_SURFACE_UNKNOWN, width, height);
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFContactSheetFFMPEGImpl::Terminate()
+{
+    AMFLock lock(&m_sync);
+
+    // queued tiles of a cancelled job finish without decoding
+    if (m_pJob != NULL)
+    {
+        m_pJob->Cancel();
+        m_pJob = NULL;
+    }
+    if (m_pPool != NULL)
+    {
+        ReleasePool();
+        m_pPool = NULL;
+    }
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFContactSheetFFMPEGImpl::QueryOutput(AMFData** ppData)
+{
+    AMF_RETURN_IF_FALSE(ppData != NULL, AMF_INVALID_ARG, L"QueryOutput() - ppData == NULL");
+    *ppData = NULL;
+
+    AMFLock lock(&m_sync);
+    AMF_RETURN_IF_FALSE(m_pJob != NULL, AMF_NOT_INITIALIZED, L"QueryOutput() - not initialized");
+
+    if (!m_pJob->IsDone())
+    {
+        return AMF_REPEAT;
+    }
+    if (m_bDelivered)
+    {
+        return AMF_EOF;
+    }
+
+    *ppData = m_pJob->GetSheet();
+    (*ppData)->Acquire();
+    m_bDelivered = true;
+    return AMF_OK;
+}
@@ -0,0 +1,155 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "public/include/components/Component.h"
+#include "public/include/components/FFMPEGContactSheet.h"
+#include "public/common/PropertyStorageExImpl.h"
+#include "public/common/WorkStealingPool.h"
+#include "public/include/core/Context.h"
+
+#include <atomic>
+
+
+namespace amf
+{
+
+    //-------------------------------------------------------------------------------------------------
+    // One contact sheet: the recording it comes from, the surface the tiles are drawn into and the
+    // demuxer/decoder pairs the tile tasks share. The tasks hold a reference, so it stays alive
+    // until the last one has finished even if the component is terminated first.
+    class AMFContactSheetJob : public AMFInterfaceImpl<AMFInterface>
+    {
+    public:
+        AMFContactSheetJob(AMFContext* pContext, const amf_wstring& path);
+        virtual ~AMFContactSheetJob();
+
+        // opens the recording and returns what the sheet layout depends on
+        AMF_RESULT  Open(amf_pts* pDuration, AMFSize* pFrameSize);
+        // allocates the sheet, the thumbnail size must keep the chroma planes whole (even numbers)
+        AMF_RESULT  Start(amf_int32 columns, amf_int32 rows, amf_int32 thumbnailWidth, amf_int32 thumbnailHeight,
+                          const amf_wstring& outputPath, amf_int32 quality);
+
+        // decodes the keyframe at or before pts and draws it into the given tile
+        void        DecodeTile(amf_int32 tile, amf_pts pts);
+
+        void        Cancel()        { m_bCancelled = true; }
+        bool        IsDone() const  { return m_bDone; }
+        AMFSurface* GetSheet()      { return m_pSheet; }
+
+    private:
+        struct Reader
+        {
+            AMFComponentExPtr   pDemuxer;
+            AMFOutputPtr        pVideo;
+            amf_int32           iVideoIndex;
+            AMFComponentPtr     pDecoder;
+        };
+
+        AMF_RESULT  CreateReader(Reader* pReader);
+        Reader*     AcquireReader();
+        void        ReleaseReader(Reader* pReader);
+
+        AMF_RESULT  ReadKeyframe(Reader* pReader, amf_pts pts, AMFSurface** ppFrame);
+        void        DrawTile(amf_int32 tile, AMFSurface* pFrame);
+        AMF_RESULT  WriteJpeg();
+
+        AMFContextPtr           m_pContext;
+        amf_wstring             m_Path;
+        amf_wstring             m_OutputPath;
+        amf_int32               m_iQuality;
+
+        // the format the recording decodes to without conversion, YUV420P or NV12
+        AMF_SURFACE_FORMAT      m_eDecoderFormat;
+        AMFSize                 m_FrameSize;
+
+        AMFSurfacePtr           m_pSheet;
+        amf_int32               m_iColumns;
+        amf_int32               m_iThumbnailWidth;
+        amf_int32               m_iThumbnailHeight;
+
+        // readers not in use by a task, there are never more than the tasks running at once
+        AMFCriticalSection      m_sync;
+        amf_vector<Reader*>     m_IdleReaders;
+
+        std::atomic<amf_int32>  m_iRemaining;
+        std::atomic<bool>       m_bCancelled;
+        std::atomic<bool>       m_bDone;
+    };
+    typedef AMFInterfacePtr_T<AMFContactSheetJob>    AMFContactSheetJobPtr;
+
+    //-------------------------------------------------------------------------------------------------
+
+    class AMFContactSheetFFMPEGImpl : 
+        public AMFInterfaceBase,
+        public AMFPropertyStorageExImpl<AMFComponent>
+    {
+
+    public:
+        // interface access
+        AMF_BEGIN_INTERFACE_MAP
+            AMF_INTERFACE_MULTI_ENTRY(AMFComponent)
+            AMF_INTERFACE_CHAIN_ENTRY(AMFPropertyStorageExImpl<AMFComponent>)
+        AMF_END_INTERFACE_MAP
+
+
+        AMFContactSheetFFMPEGImpl(AMFContext* pContext);
+        virtual ~AMFContactSheetFFMPEGImpl();
+
+        // AMFComponent interface
+        virtual AMF_RESULT  AMF_STD_CALL  Init(AMF_SURFACE_FORMAT format, amf_int32 width, amf_int32 height);
+        virtual AMF_RESULT  AMF_STD_CALL  ReInit(amf_int32 width, amf_int32 height);
+        virtual AMF_RESULT  AMF_STD_CALL  Terminate();
+        virtual AMF_RESULT  AMF_STD_CALL  Drain()                                                       {  return AMF_OK;  };
+        virtual AMF_RESULT  AMF_STD_CALL  Flush()                                                       {  return AMF_OK;  };
+
+        virtual AMF_RESULT  AMF_STD_CALL  SubmitInput(AMFData* /*pData*/)                               {  return AMF_NOT_SUPPORTED;  };
+        virtual AMF_RESULT  AMF_STD_CALL  QueryOutput(AMFData** ppData);
+        virtual AMFContext* AMF_STD_CALL  GetContext()                                                  {  return m_pContext;  };
+        virtual AMF_RESULT  AMF_STD_CALL  SetOutputDataAllocatorCB(AMFDataAllocatorCB* /*callback*/)    {  return AMF_OK;  };
+        virtual AMF_RESULT  AMF_STD_CALL  GetCaps(AMFCaps** /*ppCaps*/)                                 {  return AMF_NOT_SUPPORTED;  };
+        virtual AMF_RESULT  AMF_STD_CALL  Optimize(AMFComponentOptimizationCallback* /*pCallback*/)     {  return AMF_OK;  };
+
+    private:
+        mutable AMFCriticalSection  m_sync;
+
+        AMFContextPtr           m_pContext;
+        AMFContactSheetJobPtr   m_pJob;
+        // shared by every instance, see AcquirePool()
+        AMFWorkStealingPool*    m_pPool;
+        bool                    m_bDelivered;
+
+        AMFContactSheetFFMPEGImpl(const AMFContactSheetFFMPEGImpl&);
+        AMFContactSheetFFMPEGImpl& operator=(const AMFContactSheetFFMPEGImpl&);
+    };
+    
+}
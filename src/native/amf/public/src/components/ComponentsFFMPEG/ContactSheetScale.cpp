@@ -0,0 +1,152 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "ContactSheetScale.h"
+#include "public/common/AMFSTL.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CONTACT_SHEET_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define CONTACT_SHEET_NEON 1
+#endif
+
+using namespace amf;
+
+// the row sums are 16 bit, so no more than 256 source rows go into one output row
+#define MAX_ROWS_PER_SUM        256
+
+namespace
+{
+    //-------------------------------------------------------------------------------------------------
+    // Recordings use video range, JPEG full range: 16..235 (luma) and 16..240 (chroma) are
+    // stretched to 0..255 while scaling.
+    struct LevelTables
+    {
+        amf_uint8 luma[256];
+        amf_uint8 chroma[256];
+
+        LevelTables()
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                const int y = ((i - 16) * 255 + 109) / 219;
+                const int c = 128 + ((i - 128) * 255 + (i < 128 ? -112 : 112)) / 224;
+                luma[i] = amf_uint8(AMF_MIN(AMF_MAX(y, 0), 255));
+                chroma[i] = amf_uint8(AMF_MIN(AMF_MAX(c, 0), 255));
+            }
+        }
+    };
+    const LevelTables s_Levels;
+    //-------------------------------------------------------------------------------------------------
+    // Adds count bytes to count 16 bit sums.
+    void AccumulateRow(const amf_uint8* pRow, amf_uint16* pSums, amf_int32 count)
+    {
+        amf_int32 x = 0;
+#if defined(CONTACT_SHEET_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 16 <= count; x += 16)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(pRow + x));
+            __m128i lo = _mm_loadu_si128((const __m128i*)(pSums + x));
+            __m128i hi = _mm_loadu_si128((const __m128i*)(pSums + x + 8));
+            _mm_storeu_si128((__m128i*)(pSums + x), _mm_add_epi16(lo, _mm_unpacklo_epi8(pixels, zero)));
+            _mm_storeu_si128((__m128i*)(pSums + x + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(pixels, zero)));
+        }
+#elif defined(CONTACT_SHEET_NEON)
+        for (; x + 8 <= count; x += 8)
+        {
+            vst1q_u16(pSums + x, vaddw_u8(vld1q_u16(pSums + x), vld1_u8(pRow + x)));
+        }
+#endif
+        for (; x < count; x++)
+        {
+            pSums[x] += pRow[x];
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void amf::AMFContactSheetScalePlane(const amf_uint8* pSrc, amf_int32 srcPitch, amf_int32 srcWidth, amf_int32 srcHeight,
+                                    amf_int32 channels, amf_uint8* const* ppDst, amf_int32 dstPitch, amf_int32 dstWidth,
+                                    amf_int32 dstHeight, const amf_uint8* pLevels)
+{
+    amf_vector<amf_int32> columns(dstWidth + 1);
+    for (amf_int32 x = 0; x <= dstWidth; x++)
+    {
+        columns[x] = amf_int32(amf_int64(x) * srcWidth / dstWidth);
+    }
+
+    amf_vector<amf_uint16> sums(srcWidth * channels);
+    for (amf_int32 y = 0; y < dstHeight; y++)
+    {
+        amf_int32 first = amf_int32(amf_int64(y) * srcHeight / dstHeight);
+        amf_int32 last = amf_int32(amf_int64(y + 1) * srcHeight / dstHeight);
+        last = AMF_MIN(AMF_MAX(last, first + 1), first + MAX_ROWS_PER_SUM);
+        const amf_int32 rows = last - first;
+
+        memset(&sums[0], 0, sums.size() * sizeof(amf_uint16));
+        for (amf_int32 row = first; row < last; row++)
+        {
+            AccumulateRow(pSrc + amf_size(row) * srcPitch, &sums[0], srcWidth * channels);
+        }
+
+        for (amf_int32 c = 0; c < channels; c++)
+        {
+            amf_uint8* pOut = ppDst[c] + amf_size(y) * dstPitch;
+            for (amf_int32 x = 0; x < dstWidth; x++)
+            {
+                const amf_int32 begin = columns[x];
+                const amf_int32 end = AMF_MAX(columns[x + 1], begin + 1);
+                amf_uint32 total = 0;
+                for (amf_int32 col = begin; col < end; col++)
+                {
+                    total += sums[col * channels + c];
+                }
+                const amf_uint32 count = amf_uint32((end - begin) * rows);
+                pOut[x] = pLevels[(total + count / 2) / count];
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+const amf_uint8* amf::AMFContactSheetLumaLevels()
+{
+    return s_Levels.luma;
+}
+//-------------------------------------------------------------------------------------------------
+const amf_uint8* amf::AMFContactSheetChromaLevels()
+{
+    return s_Levels.chroma;
+}
@@ -0,0 +1,51 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "public/include/core/Platform.h"
+
+namespace amf
+{
+    //-------------------------------------------------------------------------------------------------
+    // Box filter: every output sample is the average of the source samples it covers, remapped
+    // through pLevels. The source has `channels` interleaved samples per pixel (2 for the chroma
+    // plane of NV12), each going to its own output plane. Independent of FFmpeg, so that it can be
+    // tested and timed on its own.
+    void AMFContactSheetScalePlane(const amf_uint8* pSrc, amf_int32 srcPitch, amf_int32 srcWidth, amf_int32 srcHeight,
+                                   amf_int32 channels, amf_uint8* const* ppDst, amf_int32 dstPitch, amf_int32 dstWidth,
+                                   amf_int32 dstHeight, const amf_uint8* pLevels);
+
+    // Recordings use video range, JPEG full range: these stretch 16..235 (luma) and 16..240
+    // (chroma) to 0..255.
+    const amf_uint8* AMFContactSheetLumaLevels();
+    const amf_uint8* AMFContactSheetChromaLevels();
+}
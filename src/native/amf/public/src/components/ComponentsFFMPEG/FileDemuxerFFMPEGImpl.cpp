@@ -142,10 +142,101 @@ static const sFormatMap[] =
 };
 
 
-void  ClearPacket(AVPacket* pPacket)
+//
+//
+// AMFPacketPool
+//
+//
+
+//-------------------------------------------------------------------------------------------------
+AMFPacketPool::AMFPacketPool()
 {
+}
+//-------------------------------------------------------------------------------------------------
+AMFPacketPool::~AMFPacketPool()
+{
+    for (amf_vector<AVPacket*>::iterator it = m_FreePackets.begin(); it != m_FreePackets.end(); ++it)
+    {
+        av_packet_free(&*it);
+    }
+    for (amf_vector<PacketReference*>::iterator it = m_FreeReferences.begin(); it != m_FreeReferences.end(); ++it)
+    {
+        delete *it;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+AVPacket* AMFPacketPool::Get()
+{
+    AMFLock lock(&m_sync);
+    if (m_FreePackets.empty())
+    {
+        return av_packet_alloc();
+    }
+    AVPacket* pPacket = m_FreePackets.back();
+    m_FreePackets.pop_back();
+    return pPacket;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFPacketPool::Recycle(AVPacket* pPacket)
+{
+    if (pPacket == NULL)
+    {
+        return;
+    }
     av_packet_unref(pPacket);
-    delete pPacket;
+
+    AMFLock lock(&m_sync);
+    m_FreePackets.push_back(pPacket);
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFPacketPool::WrapPacket(AMFContext* pContext, const AVPacket* pPacket, AMFBuffer** ppBuffer)
+{
+    AVPacket* pRef = Get();
+    AMF_RETURN_IF_FALSE(pRef != NULL, AMF_OUT_OF_MEMORY, L"WrapPacket() - av_packet_alloc failed");
+    if (av_packet_ref(pRef, pPacket) < 0)
+    {
+        Recycle(pRef);
+        return AMF_OUT_OF_MEMORY;
+    }
+
+    PacketReference* pReference = NULL;
+    {
+        AMFLock lock(&m_sync);
+        if (m_FreeReferences.empty())
+        {
+            pReference = new PacketReference(this);
+        }
+        else
+        {
+            pReference = m_FreeReferences.back();
+            m_FreeReferences.pop_back();
+        }
+    }
+    pReference->m_pPacket = pRef;
+
+    // released by the reference once the buffer goes away
+    Acquire();
+
+    AMF_RESULT err = pContext->CreateBufferFromHostNative(pRef->data, pRef->size, ppBuffer, pReference);
+    if (err != AMF_OK)
+    {
+        pReference->OnBufferDataRelease(NULL);
+    }
+    return err;
+}
+//-------------------------------------------------------------------------------------------------
+void AMF_STD_CALL AMFPacketPool::PacketReference::OnBufferDataRelease(AMFBuffer* /*pBuffer*/)
+{
+    // returning the last reference can destroy the pool together 
+    // with this object, so nothing is touched after Release()
+    AMFPacketPool* pPool = m_pPool;
+    pPool->Recycle(m_pPacket);
+    m_pPacket = NULL;
+    {
+        AMFLock lock(&pPool->m_sync);
+        pPool->m_FreeReferences.push_back(this);
+    }
+    pPool->Release();
 }
 
 
@@ -216,7 +307,7 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::AMFOutputDemuxerImpl::QueryOu
     err = m_pHost->BufferFromPacket(packet, &buf);
     if (err != AMF_OK)
     {
-        ClearPacket(packet);
+        m_pHost->ClearPacket(packet);
         return err;
     }
 
@@ -224,7 +315,7 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::AMFOutputDemuxerImpl::QueryOu
     *ppData = buf;
     (*ppData)->Acquire();
 
-    ClearPacket(packet);
+    m_pHost->ClearPacket(packet);
 
     m_iPacketCount++;
     return AMF_OK;
@@ -239,7 +330,7 @@ AMF_RESULT  AMFFileDemuxerFFMPEGImpl::AMFOutputDemuxerImpl::CachePacket(AVPacket
 
     if(!m_bEnabled)
     { 
-        ClearPacket(pPacket);
+        m_pHost->ClearPacket(pPacket);
         return AMF_FAIL;
     }
        // add the packet to the cache...
@@ -251,7 +342,7 @@ void  AMFFileDemuxerFFMPEGImpl::AMFOutputDemuxerImpl::ClearPacketCache()
 {
     for (amf_list<AVPacket*>::iterator it = m_packetsCache.begin(); it != m_packetsCache.end(); ++it)
     {
-        ClearPacket(*it);
+        m_pHost->ClearPacket(*it);
     }
     m_packetsCache.clear();
 }
@@ -453,8 +544,15 @@ AMFFileDemuxerFFMPEGImpl::AMFFileDemuxerFFMPEGImpl(AMFContext* pContext)
     m_bStreamingMode(true),
     m_iVideoStreamIndexFFmpeg(-1),
     m_iAudioStreamIndexFFmpeg(-1),
-    m_bTerminated(true)
+    m_bTerminated(true),
 //    m_bSyncAV(false)
+    m_pPacketPool(new AMFPacketPool()),
+    m_ReadAheadThread(this),
+    m_PacketReadyEvent(false, false),
+    m_SpaceFreedEvent(false, false),
+    m_iReadAheadPackets(32),
+    m_bReadAheadEof(false),
+    m_bReadAheadRunning(false)
 {
     g_AMFFactory.Init();
 
@@ -468,7 +566,8 @@ AMFFileDemuxerFFMPEGImpl::AMFFileDemuxerFFMPEGImpl(AMFContext* pContext)
 //        AMFPropertyInfoBool(FFMPEG_DEMUXER_SYNC_AV, L"Sync Audio and Video by PTS", false, false),
         AMFPropertyInfoBool(FFMPEG_DEMUXER_CHECK_MVC, L"Check MVC", true, false),
         AMFPropertyInfoBool(FFMPEG_DEMUXER_INDIVIDUAL_STREAM_MODE, L"Stream mode", true, false),
-        AMFPropertyInfoBool(FFMPEG_DEMUXER_LISTEN, L"Listen", false, false)
+        AMFPropertyInfoBool(FFMPEG_DEMUXER_LISTEN, L"Listen", false, false),
+        AMFPropertyInfoInt64(FFMPEG_DEMUXER_READ_AHEAD, L"Read ahead packets per stream", 32, 0, 4096, false)
         
     AMFPrimitivePropertyInfoMapEnd
 
@@ -643,6 +742,8 @@ AMF_RESULT AMF_STD_CALL AMFFileDemuxerFFMPEGImpl::Seek(amf_pts ptsPos, AMF_SEEK_
         stream_index = av_find_default_stream_index(m_pInputContext);
     }
 
+    amf_int64 iPacketCount = 0;
+
 //    bool validDuration = (m_pInputContext->duration != AV_NOPTS_VALUE);
 //    if(validDuration)
     {
@@ -650,8 +751,25 @@ AMF_RESULT AMF_STD_CALL AMFFileDemuxerFFMPEGImpl::Seek(amf_pts ptsPos, AMF_SEEK_
         AVStream*  ist    = m_pInputContext->streams[stream_index];
         int64_t    offset = av_rescale_q(ptsPos, AMF_TIME_BASE_Q, ist->time_base);
 
-        // AVSEEK_FLAG_BACKWARD means that we need packet before ptsPos
-        int ret = av_seek_frame(m_pInputContext, stream_index, offset, flags);
+        // the read-ahead thread must not touch the context while seeking,
+        // and whatever it read before the seek is stale
+        StopReadAhead();
+
+        // with a keyframe index this is a binary search and a byte seek,
+        // decoding then starts from the keyframe as the buffers are marked
+        // with "Seeking" until ptsPos is reached
+        const AMFKeyframeIndex::Keyframe* pKeyframe = m_KeyframeIndex.FindKeyframe(ptsPos, eType == AMF_SEEK_NEXT_KEYFRAME);
+
+        int ret = 0;
+        if (pKeyframe != NULL)
+        {
+            ret = av_seek_frame(m_pInputContext, -1, pKeyframe->offset, AVSEEK_FLAG_BYTE);
+        }
+        else
+        {
+            // AVSEEK_FLAG_BACKWARD means that we need packet before ptsPos
+            ret = av_seek_frame(m_pInputContext, stream_index, offset, flags);
+        }
         if (ret<0)
         {
             // sometimes failed av_seek_frame cause further av_read functions return errors too.
@@ -662,9 +780,16 @@ AMF_RESULT AMF_STD_CALL AMFFileDemuxerFFMPEGImpl::Seek(amf_pts ptsPos, AMF_SEEK_
         else
         {
             ClearCachedPackets();
+            if (pKeyframe != NULL)
+            {
+                iPacketCount = (amf_int64)pKeyframe->frame;
+            }
         }
+        // restart the read-ahead whichever way the seek went, after a reopen
+        // this does nothing if Open already started it
+        StartReadAhead();
     }
-    m_iPacketCount = 0;
+    m_iPacketCount = iPacketCount;
     m_ptsPosition = ptsPos;
 
     ReadRangeSettings();
@@ -756,6 +881,10 @@ amf_uint64 AMF_STD_CALL AMFFileDemuxerFFMPEGImpl::GetFrameFromPts(amf_pts pts)
     AMFLock lock(&m_sync);
     if (m_pInputContext)
     {
+        if (m_KeyframeIndex.HasFrameTimes())
+        {
+            return m_KeyframeIndex.GetFrameFromPts(pts);
+        }
         if (m_iVideoStreamIndexFFmpeg != -1)
         {
             const AVStream *ist = m_pInputContext->streams[m_iVideoStreamIndexFFmpeg];
@@ -771,6 +900,10 @@ amf_pts AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::GetPtsFromFrame(amf_uint64 iFram
     AMFLock lock(&m_sync);
     if (m_pInputContext)
     {
+        if (m_KeyframeIndex.HasFrameTimes())
+        {
+            return m_KeyframeIndex.GetPtsFromFrame(iFrame);
+        }
         if (m_iVideoStreamIndexFFmpeg != -1)
         {
             const AVStream *ist = m_pInputContext->streams[m_iVideoStreamIndexFFmpeg];
@@ -824,6 +957,7 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::Open()
     
     GetPropertyWString(FFMPEG_DEMUXER_URL, &Url);
     GetPropertyWString(FFMPEG_DEMUXER_PATH, &Path);
+    const bool bLocalFile = Url.empty();
 
     amf_string convertedfilename;
     bool bListen = false;
@@ -928,6 +1062,18 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::Open()
     }
     m_OutputStreams = outputStreams;
 
+    if (bLocalFile)
+    {
+        LoadKeyframeIndex(Path);
+        if (!m_KeyframeIndex.IsEmpty())
+        {
+            m_ptsDuration = GetPtsFromFrame(m_KeyframeIndex.GetFrameCount());
+        }
+    }
+
+    GetProperty(FFMPEG_DEMUXER_READ_AHEAD, &m_iReadAheadPackets);
+    StartReadAhead();
+
     
     
     if (m_pInputContext->streams[m_iVideoStreamIndexFFmpeg]->codec->codec_id == AV_CODEC_ID_H264)
@@ -977,11 +1123,14 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::Close()
 {
     AMFLock lock(&m_sync);
 
+    StopReadAhead();
+
     if (m_pInputContext != NULL)
     {
         avformat_close_input(&m_pInputContext);
         m_pInputContext = NULL;
     }
+    m_KeyframeIndex.Clear();
 
     ClearCachedPackets();
 
@@ -1001,16 +1150,15 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::ReadPacket(AVPacket **packet)
 {
     *packet = NULL;
 
-    AVPacket  pkt ={};
-    pkt.dts = AV_NOPTS_VALUE;
-    pkt.pts = AV_NOPTS_VALUE;
+    AVPacket* pPacket = NULL;
 //    amf_pts currTime = amf_high_precision_clock();
-    if (m_bForceEof || av_read_frame(m_pInputContext, &pkt) < 0) 
+    if (m_bForceEof || ReadRawPacket(&pPacket) != AMF_OK) 
     {
 //        AMFTraceInfo(AMF_FACILITY, L"ReadPacket() - EOF, END");
         return AMF_EOF;
     }
 //    amf_pts readDuration = amf_high_precision_clock() - currTime;
+    AVPacket& pkt = *pPacket;
 
     AVStream *ist = m_pInputContext->streams[pkt.stream_index];
     int64_t wrap = 1LL << ist->pts_wrap_bits;
@@ -1038,6 +1186,12 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::ReadPacket(AVPacket **packet)
                 pkt.dts -= ist->first_dts;
             }
         }
+        // the recorder's index has the real time of every frame
+        if (m_KeyframeIndex.HasFrameTimes() && (amf_uint64)m_iPacketCount < m_KeyframeIndex.GetFrameCount())
+        {
+            pkt.dts = av_rescale_q(m_KeyframeIndex.GetPtsFromFrame(m_iPacketCount), AMF_TIME_BASE_Q, ist->time_base);
+            pkt.pts = pkt.dts;
+        }
         m_iPacketCount++;
     }
     else
@@ -1064,16 +1218,220 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::ReadPacket(AVPacket **packet)
     }
     if (OutOfRange())
     {
+        ClearPacket(pPacket);
         return AMF_EOF;
     }
 
 
-    *packet = new AVPacket;
-    memcpy(*packet, &pkt, sizeof(pkt));
+    *packet = pPacket;
 
     return AMF_OK;
 }
 //-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::ReadRawPacket(AVPacket **packet)
+{
+    *packet = NULL;
+
+    if (!m_bReadAheadRunning)
+    {
+        AVPacket* pPacket = m_pPacketPool->Get();
+        AMF_RETURN_IF_FALSE(pPacket != NULL, AMF_OUT_OF_MEMORY, L"ReadRawPacket() - av_packet_alloc failed");
+        if (av_read_frame(m_pInputContext, pPacket) < 0)
+        {
+            ClearPacket(pPacket);
+            return AMF_EOF;
+        }
+        *packet = pPacket;
+        return AMF_OK;
+    }
+
+    while (true)
+    {
+        {
+            AMFLock lock(&m_ReadAheadSync);
+            if (!m_ReadAheadQueue.empty())
+            {
+                *packet = m_ReadAheadQueue.front();
+                m_ReadAheadQueue.pop_front();
+                m_ReadAheadQueued[(*packet)->stream_index]--;
+                m_SpaceFreedEvent.SetEvent();
+                return AMF_OK;
+            }
+            if (m_bReadAheadEof)
+            {
+                return AMF_EOF;
+            }
+        }
+        m_PacketReadyEvent.Lock();
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::ClearPacket(AVPacket* pPacket)
+{
+    m_pPacketPool->Recycle(pPacket);
+}
+//-------------------------------------------------------------------------------------------------
+void AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::StartReadAhead()
+{
+    if (m_bReadAheadRunning || m_pInputContext == NULL || m_iReadAheadPackets <= 0)
+    {
+        return;
+    }
+    // formats that discover streams while reading reallocate the stream 
+    // array under the consumer's feet, so those are read on demand
+    if ((m_pInputContext->ctx_flags & AVFMTCTX_NOHEADER) != 0)
+    {
+        return;
+    }
+
+    m_ReadAheadQueued.assign(m_pInputContext->nb_streams, 0);
+    m_bReadAheadEof = false;
+    m_PacketReadyEvent.ResetEvent();
+    m_SpaceFreedEvent.ResetEvent();
+
+    m_bReadAheadRunning = m_ReadAheadThread.Start();
+    if (!m_bReadAheadRunning)
+    {
+        AMFTraceWarning(AMF_FACILITY, L"StartReadAhead() - failed to start the thread, reading on demand");
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::StopReadAhead()
+{
+    if (!m_bReadAheadRunning)
+    {
+        return;
+    }
+
+    m_ReadAheadThread.RequestStop();
+    m_SpaceFreedEvent.SetEvent();
+    m_ReadAheadThread.WaitForStop();
+    m_bReadAheadRunning = false;
+
+    AMFLock lock(&m_ReadAheadSync);
+    for (amf_list<AVPacket*>::iterator it = m_ReadAheadQueue.begin(); it != m_ReadAheadQueue.end(); ++it)
+    {
+        ClearPacket(*it);
+    }
+    m_ReadAheadQueue.clear();
+    m_bReadAheadEof = false;
+}
+//-------------------------------------------------------------------------------------------------
+void AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::LoadKeyframeIndex(const amf_wstring& path)
+{
+    m_KeyframeIndex.Clear();
+
+    const char* format = m_pInputContext->iformat->name;
+    if (strcmp(format, "h264") != 0 && strcmp(format, "hevc") != 0)
+    {
+        return;
+    }
+
+    const amf_pts start = amf_high_precision_clock();
+    const wchar_t* source = L"recorder index";
+    if (m_KeyframeIndex.LoadRecorderIndex(path) != AMF_OK)
+    {
+        source = L"sidecar";
+        if (m_KeyframeIndex.LoadSidecar(path) != AMF_OK)
+        {
+            source = L"stream scan";
+            if (BuildKeyframeIndex() != AMF_OK)
+            {
+                m_KeyframeIndex.Clear();
+                return;
+            }
+            m_KeyframeIndex.SaveSidecar(path);
+        }
+    }
+    AMFTraceInfo(AMF_FACILITY, L"LoadKeyframeIndex() - %d frames from %s in %5.2f ms", (int)m_KeyframeIndex.GetFrameCount(), source,
+        float(amf_high_precision_clock() - start) / AMF_MILLISECOND);
+}
+//-------------------------------------------------------------------------------------------------
+// one pass over the stream, recording where every keyframe starts
+AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::BuildKeyframeIndex()
+{
+    AMF_RETURN_IF_FALSE(m_iVideoStreamIndexFFmpeg != -1, AMF_NOT_FOUND, L"BuildKeyframeIndex() - no video stream");
+
+    const AVStream* ist = m_pInputContext->streams[m_iVideoStreamIndexFFmpeg];
+    const double ptsPerFrame = GetPtsPerFrame(ist);
+
+    AMF_RESULT err = AMF_OK;
+    AVPacket* pPacket = m_pPacketPool->Get();
+    AMF_RETURN_IF_FALSE(pPacket != NULL, AMF_OUT_OF_MEMORY, L"BuildKeyframeIndex() - av_packet_alloc failed");
+    while (av_read_frame(m_pInputContext, pPacket) >= 0)
+    {
+        if (pPacket->stream_index == m_iVideoStreamIndexFFmpeg)
+        {
+            const bool keyframe = (pPacket->flags & AV_PKT_FLAG_KEY) != 0;
+            if (keyframe && pPacket->pos < 0)
+            {
+                err = AMF_NOT_SUPPORTED;
+                break;
+            }
+            const amf_uint64 frame = m_KeyframeIndex.GetFrameCount();
+            m_KeyframeIndex.AddFrame(static_cast<amf_pts>(frame * ptsPerFrame + 0.5), pPacket->pos, keyframe);
+        }
+        av_packet_unref(pPacket);
+    }
+    ClearPacket(pPacket);
+
+    // back to the start for reading
+    int ret = av_seek_frame(m_pInputContext, -1, 0, AVSEEK_FLAG_BYTE);
+    AMF_RETURN_IF_FALSE(ret >= 0, AMF_FAIL, L"BuildKeyframeIndex() - failed to rewind the stream");
+    return m_KeyframeIndex.IsEmpty() ? AMF_NOT_FOUND : err;
+}
+//-------------------------------------------------------------------------------------------------
+// runs on m_ReadAheadThread: keeps up to m_iReadAheadPackets packets per stream
+// queued so that the consumer doesn't wait on the file.  The consumer always
+// takes the oldest packet, so a stream with a full window can only hold the
+// reader up until the packets in front of it have been taken.
+void AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::ReadAheadLoop()
+{
+    AVPacket* pPacket = NULL;
+    while (!m_ReadAheadThread.StopRequested())
+    {
+        // the thread stays up at the end of the file until it's stopped
+        if (m_bReadAheadEof)
+        {
+            m_SpaceFreedEvent.Lock();
+            continue;
+        }
+        if (pPacket == NULL)
+        {
+            pPacket = m_pPacketPool->Get();
+            if (pPacket == NULL || av_read_frame(m_pInputContext, pPacket) < 0)
+            {
+                ClearPacket(pPacket);
+                pPacket = NULL;
+
+                AMFLock lock(&m_ReadAheadSync);
+                m_bReadAheadEof = true;
+                m_PacketReadyEvent.SetEvent();
+                continue;
+            }
+        }
+
+        {
+            AMFLock lock(&m_ReadAheadSync);
+            if (pPacket->stream_index >= (int)m_ReadAheadQueued.size())
+            {
+                m_ReadAheadQueued.resize(pPacket->stream_index + 1, 0);
+            }
+            amf_int32& queued = m_ReadAheadQueued[pPacket->stream_index];
+            if (queued < m_iReadAheadPackets)
+            {
+                m_ReadAheadQueue.push_back(pPacket);
+                queued++;
+                pPacket = NULL;
+                m_PacketReadyEvent.SetEvent();
+                continue;
+            }
+        }
+        m_SpaceFreedEvent.Lock();
+    }
+    ClearPacket(pPacket);
+}
+//-------------------------------------------------------------------------------------------------
 AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::FindNextPacket(amf_int32 streamIndex, AVPacket **packet, bool saveSkipped)
 {
     // clear the return pointer in case we 
@@ -1183,6 +1541,15 @@ AMF_RESULT AMF_STD_CALL  AMFFileDemuxerFFMPEGImpl::BufferFromPacket(const AVPack
     AMF_RETURN_IF_FALSE(ppBuffer != NULL, AMF_INVALID_ARG, L"BufferFromPacket() - buffer pointer not passed in");
 
 
+    // reference counted packets are wrapped as they are, the buffer keeps
+    // a reference to the payload until it's released
+    if (pPacket->buf != NULL)
+    {
+        AMF_RESULT err = m_pPacketPool->WrapPacket(m_pContext, pPacket, ppBuffer);
+        AMF_RETURN_IF_FAILED(err, L"BufferFromPacket() - WrapPacket failed");
+        return UpdateBufferProperties(*ppBuffer, pPacket);
+    }
+
     // Reproduce FFMPEG packet allocate logic (file libavcodec/avpacket.c function av_packet_duplicate)
     // ...
     //    data = av_malloc(pkt->size + FF_INPUT_BUFFER_PADDING_SIZE);
@@ -36,9 +36,11 @@
 #include "public/include/components/FFMPEGFileDemuxer.h"
 #include "public/include/components/MediaSource.h"
 #include "public/common/PropertyStorageExImpl.h"
+#include "public/common/Thread.h"
 #include "public/include/core/Context.h"
 
 #include "H264Mp4ToAnnexB.h"
+#include "KeyframeIndex.h"
 
 extern "C"
 {
@@ -61,6 +63,40 @@ extern "C"
 namespace amf
 {
 
+    //-------------------------------------------------------------------------------------------------
+    // Recycles AVPacket shells so that reading a packet doesn't allocate one, and wraps packet
+    // payloads in AMFBuffers by holding a reference to them instead of copying.
+    // The pool stays alive for as long as any buffer it wrapped does.
+    class AMFPacketPool : public AMFInterfaceImpl<AMFInterface>
+    {
+    public:
+        AMFPacketPool();
+        virtual ~AMFPacketPool();
+
+        AVPacket*   Get();
+        void        Recycle(AVPacket* pPacket);
+
+        AMF_RESULT  WrapPacket(AMFContext* pContext, const AVPacket* pPacket, AMFBuffer** ppBuffer);
+
+    protected:
+        class PacketReference : public AMFBufferObserver
+        {
+        public:
+            PacketReference(AMFPacketPool* pPool) : m_pPool(pPool), m_pPacket(NULL) {}
+            virtual ~PacketReference() {}
+
+            virtual void AMF_STD_CALL  OnBufferDataRelease(AMFBuffer* pBuffer);
+
+            AMFPacketPool*  m_pPool;
+            AVPacket*       m_pPacket;
+        };
+
+        AMFCriticalSection              m_sync;
+        amf_vector<AVPacket*>           m_FreePackets;
+        amf_vector<PacketReference*>    m_FreeReferences;
+    };
+    typedef AMFInterfacePtr_T<AMFPacketPool>    AMFPacketPoolPtr;
+
     //-------------------------------------------------------------------------------------------------
 
     class AMFFileDemuxerFFMPEGImpl : 
@@ -111,6 +147,18 @@ namespace amf
         typedef AMFInterfacePtr_T<AMFOutputDemuxerImpl>    AMFOutputDemuxerImplPtr;
     //-------------------------------------------------------------------------------------------------
 
+        // reads packets from the file ahead of the consumer, see ReadAheadLoop
+        class AMFReadAheadThread : public AMFThread
+        {
+        public:
+            AMFReadAheadThread(AMFFileDemuxerFFMPEGImpl* pHost) : m_pHost(pHost) {}
+            virtual void Run()  { m_pHost->ReadAheadLoop(); }
+
+        protected:
+            AMFFileDemuxerFFMPEGImpl*   m_pHost;
+        };
+    //-------------------------------------------------------------------------------------------------
+
         class AMFVideoOutputDemuxerImpl :
             public AMFOutputDemuxerImpl
         {
@@ -190,6 +238,13 @@ namespace amf
 
         // helper functions
         AMF_RESULT AMF_STD_CALL  ReadPacket(AVPacket **packet);
+        AMF_RESULT AMF_STD_CALL  ReadRawPacket(AVPacket **packet);
+        void       AMF_STD_CALL  ClearPacket(AVPacket* pPacket);
+        void       AMF_STD_CALL  StartReadAhead();
+        void       AMF_STD_CALL  StopReadAhead();
+        void       AMF_STD_CALL  ReadAheadLoop();
+        void       AMF_STD_CALL  LoadKeyframeIndex(const amf_wstring& path);
+        AMF_RESULT AMF_STD_CALL  BuildKeyframeIndex();
         AMF_RESULT AMF_STD_CALL  FindNextPacket(amf_int32 streamIndex, AVPacket **packet, bool saveSkipped);
         bool       AMF_STD_CALL  OutOfRange();
         void       AMF_STD_CALL  ClearCachedPackets();
@@ -244,6 +299,23 @@ namespace amf
         amf::H264Mp4ToAnnexB    m_H264Mp4ToAnnexB;
 #endif
 
+        // only for raw elementary streams, which have no index of their own
+        AMFKeyframeIndex        m_KeyframeIndex;
+
+        AMFPacketPoolPtr        m_pPacketPool;
+
+        // read-ahead state - the queue and counters are shared 
+        // with the read-ahead thread under m_ReadAheadSync
+        AMFReadAheadThread      m_ReadAheadThread;
+        AMFCriticalSection      m_ReadAheadSync;
+        AMFEvent                m_PacketReadyEvent;
+        AMFEvent                m_SpaceFreedEvent;
+        amf_list<AVPacket*>     m_ReadAheadQueue;
+        amf_vector<amf_int32>   m_ReadAheadQueued;      // packets queued per ffmpeg stream
+        amf_int64               m_iReadAheadPackets;    // window per stream
+        bool                    m_bReadAheadEof;
+        bool                    m_bReadAheadRunning;
+
 
         AMFFileDemuxerFFMPEGImpl(const AMFFileDemuxerFFMPEGImpl&);
         AMFFileDemuxerFFMPEGImpl& operator=(const AMFFileDemuxerFFMPEGImpl&);
@@ -309,7 +309,7 @@ AMFFileMuxerFFMPEGImpl::AMFFileMuxerFFMPEGImpl(AMFContext* pContext)
     m_bTerminated(true),
     m_bForceEof(false),
     m_iViewFrameCount(0),
-    m_ptsStatTime(0)
+    m_ptsLastViewWrite(0)
 {
     g_AMFFactory.Init();
 
@@ -692,7 +692,8 @@ AMF_RESULT AMF_STD_CALL  AMFFileMuxerFFMPEGImpl::Open()
         m_bEofList[i] = false;
     }
     m_iViewFrameCount = 0;
-    m_ptsStatTime = 0;
+    m_ptsLastViewWrite = 0;
+    m_ViewWriteIntervals.Reset();
     return AMF_OK;
 }
 //-------------------------------------------------------------------------------------------------
@@ -799,18 +800,20 @@ AMF_RESULT AMF_STD_CALL  AMFFileMuxerFFMPEGImpl::WriteData(AMFData* pData, amf_i
 #endif
         if(ost->codec->codec_type == AVMEDIA_TYPE_VIDEO)
         {
-            if(m_iViewFrameCount == 0)
+            if(m_iViewFrameCount > 0)
             {
-                m_ptsStatTime = currentTime;
+                m_ViewWriteIntervals.Record(currentTime - m_ptsLastViewWrite, currentTime);
             }
+            m_ptsLastViewWrite = currentTime;
             m_iViewFrameCount++;            
+#if FAKE_MUXING
             if((m_iViewFrameCount % 100) == 0)
             {
-#if FAKE_MUXING
-                AMFTraceWarning(AMF_FACILITY, L" FPS=%5.2f", (double)100 * AMF_SECOND / (currentTime - m_ptsStatTime));
-#endif
-                m_ptsStatTime = currentTime;
+                AMFLatencySnapshot stats;
+                m_ViewWriteIntervals.GetSnapshot(&stats);
+                AMFTraceWarning(AMF_FACILITY, L" FPS=%5.2f interval p99=%5.2fms", stats.rate, double(stats.p99) / 10000.);
             }
+#endif
         }
 //        AMFTraceWarning(AMF_FACILITY, L"WritePacket() %s in_pts=%" LPRId64 L"pts=%" LPRId64 L"time=%5.2f",
 //            ost->codec->codec_type == AVMEDIA_TYPE_VIDEO ? L"video" : L"audio",
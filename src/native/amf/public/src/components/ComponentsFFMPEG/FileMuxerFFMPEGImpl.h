@@ -51,6 +51,7 @@ extern "C"
 #include "public/include/components/Component.h"
 #include "public/include/components/FFMPEGFileMuxer.h"
 #include "public/common/PropertyStorageExImpl.h"
+#include "public/common/LatencyStats.h"
 #include "public/include/core/Context.h"
 
 
@@ -189,7 +190,9 @@ namespace amf
         AMFFileMuxerFFMPEGImpl& operator=(const AMFFileMuxerFFMPEGImpl&);
 
         amf_int64               m_iViewFrameCount;
-        amf_pts                 m_ptsStatTime;
+        amf_pts                 m_ptsLastViewWrite;
+        // Time between consecutive video packets, which also gives the write rate.
+        AMFLatencyStats         m_ViewWriteIntervals;
     };
 
  //   typedef AMFInterfacePtr_T<AMFFileMuxerFFMPEGImpl>    AMFFileMuxerFFMPEGPtr;
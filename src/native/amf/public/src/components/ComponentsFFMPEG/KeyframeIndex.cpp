@@ -0,0 +1,303 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "KeyframeIndex.h"
+#include "public/common/DataStream.h"
+#include "public/common/TraceAdapter.h"
+#include <algorithm>
+#include <string.h>
+
+using namespace amf;
+
+#define AMF_FACILITY L"AMFKeyframeIndex"
+
+namespace
+{
+    // The recorder's frame index, as its file writer lays it out. The component only reads the
+    // file, so it keeps its own copy of the format rather than depending on the recorder's code.
+    const char          RECORDER_INDEX_MAGIC[4] = {'Q', 'I', 'D', 'X'};
+    // version 2 added the codec to the header
+    const amf_uint32    RECORDER_INDEX_VERSION = 2;
+    const amf_uint32    RECORDER_INDEX_KEYFRAME = 1;
+
+    const char          SIDECAR_MAGIC[4] = {'Q', 'K', 'F', 'X'};
+    const amf_uint32    SIDECAR_VERSION = 1;
+
+#pragma pack(push, 1)
+    // followed by one RecorderIndexEntry per frame, little endian
+    struct RecorderIndexHeader
+    {
+        char        magic[4];
+        amf_uint32  version;
+        amf_uint32  width;
+        amf_uint32  height;
+        amf_uint32  codec;
+    };
+
+    struct RecorderIndexEntry
+    {
+        amf_uint64  offset;
+        amf_uint32  size;
+        amf_uint32  flags;
+        // in 100ns units since the recording started
+        amf_int64   timestamp;
+    };
+
+    // followed by keyframeCount AMFKeyframeIndex::Keyframe, little endian
+    struct SidecarHeader
+    {
+        char        magic[4];
+        amf_uint32  version;
+        // size of the stream when it was indexed, a sidecar for anything else is stale
+        amf_int64   streamSize;
+        amf_uint64  frameCount;
+        amf_uint64  keyframeCount;
+    };
+#pragma pack(pop)
+
+    //-------------------------------------------------------------------------------------------------
+    AMF_RESULT ReadWholeFile(const amf_wstring& path, amf_vector<amf_uint8>& data)
+    {
+        AMFDataStreamPtr pStream;
+        AMF_RESULT res = AMFDataStream::OpenDataStream(path.c_str(), AMFSO_READ, AMFFS_SHARE_READ_WRITE, &pStream);
+        if (res != AMF_OK)
+        {
+            return res;
+        }
+        amf_int64 size = 0;
+        AMF_RETURN_IF_FAILED(pStream->GetSize(&size));
+
+        data.resize((amf_size)size);
+        amf_size read = 0;
+        if (size > 0)
+        {
+            AMF_RETURN_IF_FAILED(pStream->Read(&data[0], (amf_size)size, &read));
+        }
+        data.resize(read);
+        return AMF_OK;
+    }
+    //-------------------------------------------------------------------------------------------------
+    amf_int64 GetFileSize(const amf_wstring& path)
+    {
+        AMFDataStreamPtr pStream;
+        amf_int64 size = -1;
+        if (AMFDataStream::OpenDataStream(path.c_str(), AMFSO_READ, AMFFS_SHARE_READ_WRITE, &pStream) == AMF_OK)
+        {
+            pStream->GetSize(&size);
+        }
+        return size;
+    }
+    //-------------------------------------------------------------------------------------------------
+    bool KeyframeBefore(const AMFKeyframeIndex::Keyframe& keyframe, amf_pts pts)
+    {
+        return keyframe.pts < pts;
+    }
+    //-------------------------------------------------------------------------------------------------
+    bool PtsBeforeKeyframe(amf_pts pts, const AMFKeyframeIndex::Keyframe& keyframe)
+    {
+        return pts < keyframe.pts;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+AMFKeyframeIndex::AMFKeyframeIndex()
+    : m_iFrameCount(0)
+{
+}
+//-------------------------------------------------------------------------------------------------
+void AMFKeyframeIndex::Clear()
+{
+    m_Keyframes.clear();
+    m_FramePts.clear();
+    m_iFrameCount = 0;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFKeyframeIndex::LoadRecorderIndex(const amf_wstring& streamPath)
+{
+    Clear();
+
+    amf_vector<amf_uint8> data;
+    AMF_RESULT res = ReadWholeFile(streamPath + L".index", data);
+    if (res != AMF_OK)
+    {
+        return res;
+    }
+    const amf_int64 streamSize = GetFileSize(streamPath);
+
+    // version 1 headers have no codec
+    RecorderIndexHeader header = {};
+    const amf_size headerSizeV1 = sizeof(header) - sizeof(header.codec);
+    if (data.size() < headerSizeV1)
+    {
+        return AMF_INVALID_FORMAT;
+    }
+    memcpy(&header, &data[0], headerSizeV1);
+    if (memcmp(header.magic, RECORDER_INDEX_MAGIC, sizeof(header.magic)) != 0 || header.version == 0 || header.version > RECORDER_INDEX_VERSION)
+    {
+        return AMF_INVALID_FORMAT;
+    }
+    const amf_size headerSize = header.version == 1 ? headerSizeV1 : sizeof(header);
+
+    // entries past the end of the stream (e.g. after a crash) are ignored,
+    // as is a partially written trailing entry
+    const amf_size count = data.size() < headerSize ? 0 : (data.size() - headerSize) / sizeof(RecorderIndexEntry);
+    m_FramePts.reserve(count);
+    amf_int64 firstTimestamp = 0;
+    for (amf_size i = 0; i < count; i++)
+    {
+        RecorderIndexEntry entry;
+        memcpy(&entry, &data[headerSize + i * sizeof(entry)], sizeof(entry));
+        if ((amf_int64)(entry.offset + entry.size) > streamSize)
+        {
+            break;
+        }
+        if (i == 0)
+        {
+            firstTimestamp = entry.timestamp;
+        }
+        // recorder timestamps are already in 100ns units
+        AddFrame(entry.timestamp - firstTimestamp, (amf_int64)entry.offset, (entry.flags & RECORDER_INDEX_KEYFRAME) != 0);
+        m_FramePts.push_back(entry.timestamp - firstTimestamp);
+    }
+
+    if (m_Keyframes.empty())
+    {
+        Clear();
+        return AMF_NOT_FOUND;
+    }
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFKeyframeIndex::LoadSidecar(const amf_wstring& streamPath)
+{
+    Clear();
+
+    amf_vector<amf_uint8> data;
+    AMF_RESULT res = ReadWholeFile(streamPath + L".kidx", data);
+    if (res != AMF_OK)
+    {
+        return res;
+    }
+
+    SidecarHeader header;
+    if (data.size() < sizeof(header))
+    {
+        return AMF_INVALID_FORMAT;
+    }
+    memcpy(&header, &data[0], sizeof(header));
+    if (memcmp(header.magic, SIDECAR_MAGIC, sizeof(header.magic)) != 0 || header.version != SIDECAR_VERSION ||
+        data.size() != sizeof(header) + header.keyframeCount * sizeof(Keyframe))
+    {
+        return AMF_INVALID_FORMAT;
+    }
+    if (header.streamSize != GetFileSize(streamPath) || header.keyframeCount == 0)
+    {
+        return AMF_NOT_FOUND;
+    }
+
+    m_Keyframes.resize((amf_size)header.keyframeCount);
+    memcpy(&m_Keyframes[0], &data[sizeof(header)], m_Keyframes.size() * sizeof(Keyframe));
+    m_iFrameCount = header.frameCount;
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMFKeyframeIndex::SaveSidecar(const amf_wstring& streamPath) const
+{
+    AMF_RETURN_IF_FALSE(!m_Keyframes.empty(), AMF_NOT_INITIALIZED, L"SaveSidecar() - nothing to save");
+
+    SidecarHeader header;
+    memcpy(header.magic, SIDECAR_MAGIC, sizeof(header.magic));
+    header.version = SIDECAR_VERSION;
+    header.streamSize = GetFileSize(streamPath);
+    header.frameCount = m_iFrameCount;
+    header.keyframeCount = m_Keyframes.size();
+
+    AMFDataStreamPtr pStream;
+    AMF_RESULT res = AMFDataStream::OpenDataStream((streamPath + L".kidx").c_str(), AMFSO_WRITE, AMFFS_EXCLUSIVE, &pStream);
+    AMF_RETURN_IF_FAILED(res, L"SaveSidecar() - failed to create %s.kidx", streamPath.c_str());
+
+    amf_size written = 0;
+    AMF_RETURN_IF_FAILED(pStream->Write(&header, sizeof(header), &written));
+    AMF_RETURN_IF_FAILED(pStream->Write(&m_Keyframes[0], m_Keyframes.size() * sizeof(Keyframe), &written));
+    return pStream->Close();
+}
+//-------------------------------------------------------------------------------------------------
+void AMFKeyframeIndex::AddFrame(amf_pts pts, amf_int64 offset, bool keyframe)
+{
+    if (keyframe)
+    {
+        Keyframe entry = {pts, offset, m_iFrameCount};
+        m_Keyframes.push_back(entry);
+    }
+    m_iFrameCount++;
+}
+//-------------------------------------------------------------------------------------------------
+const AMFKeyframeIndex::Keyframe* AMFKeyframeIndex::FindKeyframe(amf_pts pts, bool bAfter) const
+{
+    if (m_Keyframes.empty())
+    {
+        return NULL;
+    }
+    if (bAfter)
+    {
+        amf_vector<Keyframe>::const_iterator it = std::lower_bound(m_Keyframes.begin(), m_Keyframes.end(), pts, KeyframeBefore);
+        return it == m_Keyframes.end() ? &m_Keyframes.back() : &*it;
+    }
+    amf_vector<Keyframe>::const_iterator it = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), pts, PtsBeforeKeyframe);
+    return it == m_Keyframes.begin() ? &m_Keyframes.front() : &*(it - 1);
+}
+//-------------------------------------------------------------------------------------------------
+amf_uint64 AMFKeyframeIndex::GetFrameFromPts(amf_pts pts) const
+{
+    if (m_FramePts.empty())
+    {
+        return 0;
+    }
+    amf_vector<amf_pts>::const_iterator it = std::upper_bound(m_FramePts.begin(), m_FramePts.end(), pts);
+    return it == m_FramePts.begin() ? 0 : (amf_uint64)(it - m_FramePts.begin() - 1);
+}
+//-------------------------------------------------------------------------------------------------
+amf_pts AMFKeyframeIndex::GetPtsFromFrame(amf_uint64 frame) const
+{
+    if (m_FramePts.empty())
+    {
+        return 0;
+    }
+    if (frame < m_FramePts.size())
+    {
+        return m_FramePts[(amf_size)frame];
+    }
+    // past the end, continue at the average frame rate
+    const amf_size last = m_FramePts.size() - 1;
+    const amf_pts  average = last > 0 ? m_FramePts[last] / (amf_pts)last : 0;
+    return m_FramePts[last] + (amf_pts)(frame - last) * average;
+}
@@ -0,0 +1,83 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2018 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "public/include/core/Platform.h"
+#include "public/include/core/Result.h"
+#include "public/common/AMFSTL.h"
+
+namespace amf
+{
+    //-------------------------------------------------------------------------------------------------
+    // Where the keyframes of a raw elementary stream start, so that seeking is a binary search
+    // and a byte seek instead of ffmpeg scanning the stream (raw .h264/.hevc has no index of its
+    // own). It comes from the recorder's frame index (<file>.index, see stages/common/frame-index.h)
+    // when there is one, which also gives the real timestamp of every frame. Otherwise the demuxer
+    // builds it on the first open and keeps it in a sidecar (<file>.kidx) for the next one.
+    class AMFKeyframeIndex
+    {
+    public:
+        struct Keyframe
+        {
+            amf_pts     pts;        // since the first frame
+            amf_int64   offset;     // byte position of the frame in the stream
+            amf_uint64  frame;
+        };
+
+        AMFKeyframeIndex();
+
+        void        Clear();
+        bool        IsEmpty() const                         { return m_Keyframes.empty(); }
+        // whether the pts of every frame is known, rather than only of the keyframes
+        bool        HasFrameTimes() const                   { return !m_FramePts.empty(); }
+        amf_uint64  GetFrameCount() const                   { return m_iFrameCount; }
+
+        AMF_RESULT  LoadRecorderIndex(const amf_wstring& streamPath);
+        AMF_RESULT  LoadSidecar(const amf_wstring& streamPath);
+        AMF_RESULT  SaveSidecar(const amf_wstring& streamPath) const;
+
+        // building - frames have to be added in stream order
+        void        AddFrame(amf_pts pts, amf_int64 offset, bool keyframe);
+
+        // the last keyframe at or before pts, or with bAfter the first one at or after it
+        const Keyframe* FindKeyframe(amf_pts pts, bool bAfter) const;
+
+        // these need frame times
+        amf_uint64  GetFrameFromPts(amf_pts pts) const;
+        amf_pts     GetPtsFromFrame(amf_uint64 frame) const;
+
+    private:
+        amf_vector<Keyframe>    m_Keyframes;
+        amf_vector<amf_pts>     m_FramePts;
+        amf_uint64              m_iFrameCount;
+    };
+}
@@ -39,6 +39,8 @@
 #include "public/common/TraceAdapter.h"
 #include "public/include/components/ColorSpace.h"
 
+#include <thread>
+
 #define AMF_FACILITY L"AMFVideoDecoderFFMPEGImpl"
 
 extern "C"
@@ -48,6 +50,97 @@ extern "C"
 
 using namespace amf;
 
+// extra bytes after the last plane, for decoders that read a little past the end of the picture
+#define FRAME_POOL_BUFFER_PADDING   128
+
+//-------------------------------------------------------------------------------------------------
+AMFDecodedFramePool::AMFDecodedFramePool()
+  : m_pPool(NULL),
+    m_iBufferSize(0)
+{
+}
+//-------------------------------------------------------------------------------------------------
+AMFDecodedFramePool::~AMFDecodedFramePool()
+{
+    Clear();
+}
+//-------------------------------------------------------------------------------------------------
+bool AMFDecodedFramePool::IsSupported(AVPixelFormat avFormat, AMF_SURFACE_FORMAT eFormat)
+{
+    switch (eFormat)
+    {
+    case AMF_SURFACE_YUV420P:
+        return (avFormat == AV_PIX_FMT_YUV420P) || (avFormat == AV_PIX_FMT_YUVJ420P);
+    case AMF_SURFACE_NV12:
+        return avFormat == AV_PIX_FMT_NV12;
+    case AMF_SURFACE_GRAY8:
+        return avFormat == AV_PIX_FMT_GRAY8;
+    default:
+        return false;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+int AMFDecodedFramePool::GetBuffer(AVCodecContext* pCodecContext, AVFrame* pFrame)
+{
+    int width = pFrame->width;
+    int height = pFrame->height;
+    int linesizeAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(pCodecContext, &width, &height, linesizeAlign);
+
+    // a 128 byte luma pitch satisfies every linesize alignment the decoders ask for,
+    // also for the chroma planes of 4:2:0 which use half of it
+    const int pitch = FFALIGN(width, 128);
+    height = FFALIGN(height, 2);
+
+    const int lumaSize = pitch * height;
+    const int chromaSize = (pFrame->format == AV_PIX_FMT_GRAY8) ? 0 : lumaSize / 2;
+    const int size = lumaSize + chromaSize + FRAME_POOL_BUFFER_PADDING;
+    {
+        AMFLock lock(&m_sync);
+        if (m_pPool == NULL || m_iBufferSize != size)
+        {
+            // buffers still in use keep the old pool alive until they are returned
+            av_buffer_pool_uninit(&m_pPool);
+            m_pPool = av_buffer_pool_init(size, NULL);
+            m_iBufferSize = size;
+        }
+        pFrame->buf[0] = (m_pPool != NULL) ? av_buffer_pool_get(m_pPool) : NULL;
+    }
+    if (pFrame->buf[0] == NULL)
+    {
+        return AVERROR(ENOMEM);
+    }
+
+    // same layout as a host surface with hPitch = pitch and vPitch = height
+    uint8_t* pData = pFrame->buf[0]->data;
+    pFrame->data[0] = pData;
+    pFrame->linesize[0] = pitch;
+    if (pFrame->format == AV_PIX_FMT_NV12)
+    {
+        pFrame->data[1] = pData + lumaSize;
+        pFrame->linesize[1] = pitch;
+    }
+    else if (pFrame->format != AV_PIX_FMT_GRAY8)
+    {
+        pFrame->data[1] = pData + lumaSize;
+        pFrame->linesize[1] = pitch / 2;
+        pFrame->data[2] = pFrame->data[1] + lumaSize / 4;
+        pFrame->linesize[2] = pitch / 2;
+    }
+    pFrame->extended_data = pFrame->data;
+
+    // marks the frame as one that can be wrapped
+    pFrame->opaque = this;
+    return 0;
+}
+//-------------------------------------------------------------------------------------------------
+void AMFDecodedFramePool::Clear()
+{
+    AMFLock lock(&m_sync);
+    av_buffer_pool_uninit(&m_pPool);
+    m_iBufferSize = 0;
+}
+
 
 //-------------------------------------------------------------------------------------------------
 AMFVideoDecoderFFMPEGImpl::AMFVideoDecoderFFMPEGImpl(AMFContext* pContext)
@@ -55,7 +148,10 @@ AMFVideoDecoderFFMPEGImpl::AMFVideoDecoderFFMPEGImpl(AMFContext* pContext)
     m_bDecodingEnabled(true),
     m_bForceEof(false),
     m_pCodecContext(NULL),
+    m_pFrame(NULL),
     m_SeekPts(0),
+    m_bDrainSent(false),
+    m_bLastAVPacketRead(false),
     m_iLastDataOffset(0),
     m_ptsLastDataOffset(0),
     m_videoFrameSubmitCount(0),
@@ -73,6 +169,8 @@ AMFVideoDecoderFFMPEGImpl::AMFVideoDecoderFFMPEGImpl(AMFContext* pContext)
         AMFPropertyInfoInt64(VIDEO_DECODER_BITRATE, L"Bitrate", 0, 0, INT_MAX, true),
         AMFPropertyInfoRate(VIDEO_DECODER_FRAMERATE, L"Frame rate", 25, 1, false),
         AMFPropertyInfoInt64(VIDEO_DECODER_SEEK_POSITION, L"Seek Position", 0, 0, INT_MAX, true),
+        AMFPropertyInfoInt64(VIDEO_DECODER_THREAD_COUNT, L"Thread Count", 0, 0, 256, true),
+        AMFPropertyInfoInt64(VIDEO_DECODER_THREAD_TYPE, L"Thread Type", 0, 0, FF_THREAD_FRAME | FF_THREAD_SLICE, true),
     AMFPrimitivePropertyInfoMapEnd
 
     InitFFMPEG();
@@ -113,6 +211,7 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::Init(AMF_SURFACE_FORMAT form
     
     // allocate the codec context
     m_pCodecContext = avcodec_alloc_context3(codec);
+    m_pFrame = av_frame_alloc();
 
     av_init_packet(&m_avpkt);
 
@@ -142,45 +241,73 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::Init(AMF_SURFACE_FORMAT form
     AMFSize framesize = { width, height };
     SetProperty(VIDEO_DECODER_RESOLUTION, framesize);
 
-    m_pCodecContext->thread_count = 8;
-//    m_pCodecContext->thread_count = std::thread::hardware_concurrency();
+    amf_int64 threadCount = 0;
+    GetProperty(VIDEO_DECODER_THREAD_COUNT, &threadCount);
+    amf_int64 threadType = 0;
+    GetProperty(VIDEO_DECODER_THREAD_TYPE, &threadType);
+
+    m_pCodecContext->thread_count = (int)threadCount;
+    if (threadCount == 0)
+    {
+        m_pCodecContext->thread_count = std::thread::hardware_concurrency();
+        if (m_pCodecContext->thread_count == 0)
+        {
+            m_pCodecContext->thread_count = 8;
+        }
 #ifdef _WIN32
-    //query the number of CPU HW cores
-    DWORD len = 0;
-    GetLogicalProcessorInformation(NULL, &len);
-    amf_int32 count = len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
-    SYSTEM_LOGICAL_PROCESSOR_INFORMATION* pBuffer = new SYSTEM_LOGICAL_PROCESSOR_INFORMATION[count];
-    if (pBuffer)
-    {
-        GetLogicalProcessorInformation(pBuffer, &len);
-        count = len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
-        amf_int32 iCores = 0;
-        for (amf_int32 idx = 0; idx < count; idx++)
+        //query the number of CPU HW cores
+        DWORD len = 0;
+        GetLogicalProcessorInformation(NULL, &len);
+        amf_int32 count = len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION* pBuffer = new SYSTEM_LOGICAL_PROCESSOR_INFORMATION[count];
+        if (pBuffer)
         {
-            if (pBuffer[idx].Relationship == RelationProcessorCore)
+            GetLogicalProcessorInformation(pBuffer, &len);
+            count = len / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+            amf_int32 iCores = 0;
+            for (amf_int32 idx = 0; idx < count; idx++)
             {
-                iCores++;
+                if (pBuffer[idx].Relationship == RelationProcessorCore)
+                {
+                    iCores++;
+                }
             }
+            m_pCodecContext->thread_count = iCores;
+            delete pBuffer;
         }
-        m_pCodecContext->thread_count = iCores;
-        delete pBuffer;
-    }
 #endif
+    }
+
+    // the thread types the codec supports, narrowed down to the requested ones
+    int threadTypes = 0;
+    if (m_pCodecContext->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)
+    {
+        threadTypes |= FF_THREAD_FRAME;
+    }
+    if (m_pCodecContext->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)
+    {
+        threadTypes |= FF_THREAD_SLICE;
+    }
 
     //todo, expand to more codes
     bool bImage = (codecID == AV_CODEC_ID_EXR) || (codecID == AV_CODEC_ID_PNG);
 
-    if (bImage && (m_pCodecContext->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS))
+    if (threadType != 0)
     {
-        m_pCodecContext->thread_type = FF_THREAD_SLICE;
+        threadTypes &= (int)threadType;
     }
-    else if (m_pCodecContext->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)
+    else if (bImage && (threadTypes & FF_THREAD_SLICE))
     {
-        m_pCodecContext->thread_type = FF_THREAD_FRAME;
+        threadTypes = FF_THREAD_SLICE;
     }
-    else if (m_pCodecContext->codec->capabilities & AV_CODEC_CAP_SLICE_THREADS)
+    else if (threadTypes & FF_THREAD_FRAME)
+    {
+        threadTypes = FF_THREAD_FRAME;
+    }
+
+    if (threadTypes != 0)
     {
-        m_pCodecContext->thread_type = FF_THREAD_SLICE;
+        m_pCodecContext->thread_type = threadTypes;
     }
     else
     {
@@ -189,6 +316,16 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::Init(AMF_SURFACE_FORMAT form
 
     m_eFormat = format; //get from demuxer
 
+    // decode straight into memory that QueryOutput() can return as a surface
+    if (m_pOutputDataCallback == NULL && (codec->capabilities & AV_CODEC_CAP_DR1))
+    {
+        m_pCodecContext->opaque = this;
+        m_pCodecContext->get_buffer2 = GetBuffer2;
+#if LIBAVCODEC_VERSION_MAJOR < 59
+        m_pCodecContext->thread_safe_callbacks = 1;
+#endif
+    }
+
 //    avcodec_set_dimensions(m_pCodecContext, m_pCodecContext->width, m_pCodecContext->height);
 //    ff_set_dimensions(m_pCodecContext, m_pCodecContext->width, m_pCodecContext->height);
     amf_int64 ret = av_image_check_size2(m_pCodecContext->width, m_pCodecContext->height, m_pCodecContext->max_pixels, AV_PIX_FMT_NONE, 0, m_pCodecContext);
@@ -229,6 +366,8 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::Terminate()
 
     // clear the internally stored buffer
     m_pInputData = nullptr;
+    m_pLastInputData = nullptr;
+    m_bDrainSent = false;
 
     // clean-up codec related items
     if (m_pCodecContext != NULL)
@@ -240,6 +379,9 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::Terminate()
         m_pCodecContext = NULL;
         m_SeekPts = 0;
     }
+    av_frame_free(&m_pFrame);
+    // surfaces still wrapping decoded frames keep their memory until they are released
+    m_FramePool.Clear();
     m_ptsLastDataOffset = 0;
     m_iLastDataOffset = 0;
 
@@ -267,6 +409,13 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::Flush()
     m_pInputData = nullptr;
     m_bForceEof = false;
 
+    // drop the frames still in the decoder, which also ends a drain
+    if (m_pCodecContext != NULL)
+    {
+        avcodec_flush_buffers(m_pCodecContext);
+    }
+    m_bDrainSent = false;
+
     return AMF_OK;
 }
 //-------------------------------------------------------------------------------------------------
@@ -321,68 +470,76 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::QueryOutput(AMFData** ppData
     {
         return m_bForceEof ? AMF_EOF : AMF_OK;
     }
-    // if we requested to drain, see if we have any more packets
-    if (m_bForceEof && !m_pInputData)
-    {
-        return AMF_EOF;
-    }
+    // the surface returned last time holds its own reference to the frame
+    av_frame_unref(m_pFrame);
 
-    // if the input buffer is empty, we need more data
-    if (!m_pInputData)
+    bool bInputConsumed = false;
+    if (m_pInputData != NULL)
     {
-        return AMF_REPEAT;
-    }
-    AMF_RESULT err = AMF_OK;
-    int got_picture = 0;
-    AMFBufferPtr pInBuffer(m_pInputData);
-
-    uint8_t* pMemIn = NULL;
-    amf_size uiMemSizeIn = 0;
-    amf_pts pts = 0;
-    amf_pts duration = 0;
+        AMFBufferPtr pInBuffer(m_pInputData);
 
-    if (pInBuffer != NULL)
-    {
-        pMemIn = static_cast<uint8_t*>(pInBuffer->GetNative());
-        uiMemSizeIn = pInBuffer->GetSize();
-        pts = pInBuffer->GetPts();
-        duration = pInBuffer->GetDuration();
-    }
-    AVFrame picture;  //MM: the memory allocated from preset buffers - no need to free
-    memset(&picture, 0, sizeof(picture));
-    av_frame_unref(&picture);
+        av_init_packet(&m_avpkt);
+        m_avpkt.data = static_cast<uint8_t*>(pInBuffer->GetNative());
+        m_avpkt.size = int(pInBuffer->GetSize());
 
-    m_avpkt.size = int(uiMemSizeIn);
-    m_avpkt.data = (uint8_t *)pMemIn;
+        bool bAVPacketRead = ReadAVPacketInfo(pInBuffer, &m_avpkt);
+        if (!bAVPacketRead)
+        {
+            // let the decoder carry the buffer pts over to the frame
+            m_avpkt.pts = pInBuffer->GetPts();
+            m_avpkt.dts = AV_NOPTS_VALUE;
+        }
 
-    bool bAVPacketRead = ReadAVPacketInfo(pInBuffer, &m_avpkt);
+        // an empty packet would start draining the decoder, so it is just dropped
+        int ret = (m_avpkt.size > 0) ? avcodec_send_packet(m_pCodecContext, &m_avpkt) : 0;
 
-    int ret = avcodec_decode_video2(m_pCodecContext, &picture, &got_picture, &m_avpkt);
-    m_pInputData = nullptr;
-
-    if (got_picture)
+        // AVERROR(EAGAIN): the decoder is full, keep the buffer until a frame has been taken out
+        if (ret != AVERROR(EAGAIN))
+        {
+            m_pInputData = nullptr;
+            bInputConsumed = true;
+            if (ret < 0)
+            {
+                return AMF_FAIL;
+            }
+            if (m_avpkt.size > 0)
+            {
+                m_pLastInputData = pInBuffer;
+                m_bLastAVPacketRead = bAVPacketRead;
+            }
+        }
+    }
+    else if (m_bForceEof && !m_bDrainSent)
     {
-        m_videoFrameQueryCount++;
+        // with frame threads the decoder holds on to several frames, which only come out on a drain
+        avcodec_send_packet(m_pCodecContext, NULL);
+        m_bDrainSent = true;
     }
 
+    int ret = avcodec_receive_frame(m_pCodecContext, m_pFrame);
+    if (ret == AVERROR(EAGAIN))
+    {
+        return bInputConsumed ? AMF_OK : AMF_REPEAT;
+    }
+    if (ret == AVERROR_EOF)
+    {
+        return AMF_EOF;
+    }
     if (ret < 0)
     {
         return AMF_FAIL;
     }
-    amf_pts picPts = pts;
+    m_videoFrameQueryCount++;
 
-    if (got_picture && bAVPacketRead)
+    AVFrame& picture = *m_pFrame;
+    amf_pts picPts = picture.pts;
+    if (m_bLastAVPacketRead)
     {
-        picPts = GetPtsFromFFMPEG(pInBuffer, &picture);
+        picPts = GetPtsFromFFMPEG(m_pLastInputData, &picture);
     }
-
-    if (!got_picture)
+    else if (picPts == AV_NOPTS_VALUE)
     {
-        if (m_bForceEof)
-        {
-            return AMF_EOF;
-        }
-        return AMF_OK;
+        picPts = (m_pLastInputData != NULL) ? m_pLastInputData->GetPts() : 0;
     }
 
     if (picPts < m_SeekPts)
@@ -397,6 +554,47 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::QueryOutput(AMFData** ppData
 
     AMF_RETURN_IF_FALSE(picture.linesize[0] > 0, AMF_FAIL, L"FFmpeg failed to return line size")
     AMFSurfacePtr pSurfaceOut;
+    AMF_RESULT err = AMF_NOT_SUPPORTED;
+    if (picture.opaque == &m_FramePool && m_pOutputDataCallback == NULL)
+    {
+        err = WrapFrame(m_pFrame, &pSurfaceOut);
+    }
+    if (err != AMF_OK)
+    {
+        err = CopyFrame(picture, pSurfaceOut);
+        AMF_RETURN_IF_FAILED(err, L"CopyFrame() failed");
+    }
+
+    pSurfaceOut->SetPts(picPts);
+
+    amf_pts duration = (m_pLastInputData != NULL) ? m_pLastInputData->GetDuration() : 0;
+    if (duration == 0)
+    {
+        duration = amf_pts(AMF_SECOND * m_FrameRate.den / m_FrameRate.num);
+    }
+    pSurfaceOut->SetDuration(duration);
+
+    AMF_FRAME_TYPE eFrameType = AMF_FRAME_PROGRESSIVE;
+    if (picture.interlaced_frame)
+    {
+        eFrameType = picture.top_field_first ? AMF_FRAME_INTERLEAVED_EVEN_FIRST : AMF_FRAME_INTERLEAVED_ODD_FIRST;
+        // unsupported???
+        //AMF_FRAME_FIELD_SINGLE_EVEN                = 3,
+        //AMF_FRAME_FIELD_SINGLE_ODD                = 4,
+    }
+
+    pSurfaceOut->SetFrameType(eFrameType);
+
+    *ppData = pSurfaceOut;
+    (*ppData)->Acquire();
+
+    // keep being called until the drain has returned every frame
+    return m_bForceEof ? AMF_REPEAT : AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::CopyFrame(AVFrame& picture, AMFSurfacePtr& pSurfaceOut)
+{
+    AMF_RESULT err = AMF_OK;
     if (m_pOutputDataCallback != NULL)
     {
         err = m_pOutputDataCallback->AllocSurface(AMF_MEMORY_HOST, m_eFormat, m_pCodecContext->width, m_pCodecContext->height, 0, 0, &pSurfaceOut);
@@ -680,47 +878,57 @@ AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::QueryOutput(AMFData** ppData
             }
         }
     }
-    double frame_time = (double)pts / AMF_SECOND;
-
-    pSurfaceOut->SetPts(picPts);
-
-
-    if (duration == 0)
+    return AMF_OK;
+}
+//-------------------------------------------------------------------------------------------------
+AMF_RESULT AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::WrapFrame(AVFrame* pFrame, AMFSurface** ppSurface)
+{
+    // the planes have to be where a host surface expects them, which cropping
+    // the top or left of the picture can change
+    amf_int32 hPitch = pFrame->linesize[0];
+    amf_int32 vPitch = pFrame->height;
+    if (m_eFormat != AMF_SURFACE_GRAY8)
     {
-        duration = amf_pts(AMF_SECOND * m_FrameRate.den / m_FrameRate.num);
-    }
-    pSurfaceOut->SetDuration(duration);
+        ptrdiff_t lumaSize = pFrame->data[1] - pFrame->data[0];
+        if (lumaSize <= 0 || (lumaSize % hPitch) != 0)
+        {
+            return AMF_NOT_SUPPORTED;
+        }
+        vPitch = amf_int32(lumaSize / hPitch);
 
-    AMF_FRAME_TYPE eFrameType = AMF_FRAME_PROGRESSIVE;
-    if (picture.interlaced_frame)
-    {
-        eFrameType = picture.top_field_first ? AMF_FRAME_INTERLEAVED_EVEN_FIRST : AMF_FRAME_INTERLEAVED_ODD_FIRST;
-        // unsupported???
-        //AMF_FRAME_FIELD_SINGLE_EVEN                = 3,
-        //AMF_FRAME_FIELD_SINGLE_ODD                = 4,
+        if (m_eFormat == AMF_SURFACE_NV12 && pFrame->linesize[1] != hPitch)
+        {
+            return AMF_NOT_SUPPORTED;
+        }
+        if (m_eFormat == AMF_SURFACE_YUV420P &&
+            (pFrame->linesize[1] != hPitch / 2 || pFrame->linesize[2] != hPitch / 2 ||
+             pFrame->data[2] - pFrame->data[1] != ptrdiff_t(hPitch / 2) * (vPitch / 2)))
+        {
+            return AMF_NOT_SUPPORTED;
+        }
     }
 
-    pSurfaceOut->SetFrameType(eFrameType);
-
-    *ppData = pSurfaceOut;
-    (*ppData)->Acquire();
+    AVFrame* pReference = av_frame_clone(pFrame);
+    AMF_RETURN_IF_FALSE(pReference != NULL, AMF_OUT_OF_MEMORY, L"av_frame_clone() failed");
 
-    if (got_picture)
+    FrameReference* pObserver = new FrameReference(pReference);
+    AMF_RESULT err = m_pContext->CreateSurfaceFromHostNative(m_eFormat, pFrame->width, pFrame->height, hPitch, vPitch,
+        pFrame->data[0], ppSurface, pObserver);
+    if (err != AMF_OK)
     {
-        // return AMF_REPEAT;
+        delete pObserver;
     }
-    if (m_bForceEof)
+    return err;
+}
+//-------------------------------------------------------------------------------------------------
+int AMFVideoDecoderFFMPEGImpl::GetBuffer2(AVCodecContext* pCodecContext, AVFrame* pFrame, int flags)
+{
+    AMFVideoDecoderFFMPEGImpl* pThis = static_cast<AMFVideoDecoderFFMPEGImpl*>(pCodecContext->opaque);
+    if (AMFDecodedFramePool::IsSupported((AVPixelFormat)pFrame->format, pThis->m_eFormat))
     {
-        if (got_picture)
-        {
-            return AMF_REPEAT;
-        }
-        else
-        {
-            return AMF_EOF;
-        }
+        return pThis->m_FramePool.GetBuffer(pCodecContext, pFrame);
     }
-    return AMF_OK;
+    return avcodec_default_get_buffer2(pCodecContext, pFrame, flags);
 }
 //-------------------------------------------------------------------------------------------------
 void AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::OnPropertyChanged(const wchar_t* pName)
@@ -743,6 +951,7 @@ void AMF_STD_CALL  AMFVideoDecoderFFMPEGImpl::OnPropertyChanged(const wchar_t* p
             {
                 avcodec_flush_buffers(m_pCodecContext);
             }
+            m_bDrainSent = false;
             m_SeekPts = seekPts;
         }
     }
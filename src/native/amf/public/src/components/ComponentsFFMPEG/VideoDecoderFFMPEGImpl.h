@@ -46,6 +46,7 @@ extern "C"
 
     #include "libavformat/avformat.h"
     #include "libavcodec/avcodec.h"
+    #include "libavutil/buffer.h"
 
 #if defined(_MSC_VER)
 #pragma warning(pop)
@@ -56,6 +57,27 @@ extern "C"
 namespace amf
 {
 
+    //-------------------------------------------------------------------------------------------------
+    // Picture memory handed to the decoder through get_buffer2. The planes are laid out back to
+    // back the way CreateSurfaceFromHostNative expects them, so decoded frames can be returned as
+    // surfaces without copying. GetBuffer() is called from the decoder threads.
+    class AMFDecodedFramePool
+    {
+    public:
+        AMFDecodedFramePool();
+        ~AMFDecodedFramePool();
+
+        static bool IsSupported(AVPixelFormat avFormat, AMF_SURFACE_FORMAT eFormat);
+
+        int         GetBuffer(AVCodecContext* pCodecContext, AVFrame* pFrame);
+        void        Clear();
+
+    private:
+        AMFCriticalSection  m_sync;
+        AVBufferPool*       m_pPool;
+        int                 m_iBufferSize;
+    };
+
     //-------------------------------------------------------------------------------------------------
 
     class AMFVideoDecoderFFMPEGImpl : 
@@ -98,6 +120,23 @@ namespace amf
         amf_pts    AMF_STD_CALL  GetPtsFromFFMPEG(AMFBuffer* pBuffer, AVFrame *pFrame);
         AMF_RESULT AMF_STD_CALL  CopyFrameRGB_FP16(amf_uint8* pMemOut, amf_uint8* pMemIn, amf_int32 iPixelFormat,
                                     amf_size uPitchIn, amf_size uPitchOut, amf_size uWidth, amf_size uHeight);
+        AMF_RESULT AMF_STD_CALL  CopyFrame(AVFrame& picture, AMFSurfacePtr& pSurfaceOut);
+        AMF_RESULT AMF_STD_CALL  WrapFrame(AVFrame* pFrame, AMFSurface** ppSurface);
+
+        static int               GetBuffer2(AVCodecContext* pCodecContext, AVFrame* pFrame, int flags);
+
+        // holds a reference to a decoded frame for as long as the surface wrapping it exists
+        class FrameReference : public AMFSurfaceObserver
+        {
+        public:
+            FrameReference(AVFrame* pFrame) : m_pFrame(pFrame) {}
+            virtual ~FrameReference()   { av_frame_free(&m_pFrame); }
+
+            virtual void AMF_STD_CALL  OnSurfaceDataRelease(AMFSurface* /*pSurface*/)    { delete this; }
+
+        private:
+            AVFrame*    m_pFrame;
+        };
 
     private:
         mutable AMFCriticalSection  m_sync;
@@ -108,10 +147,16 @@ namespace amf
 
         AVPacket                m_avpkt;
         AVCodecContext*         m_pCodecContext;
+        AVFrame*                m_pFrame;
+        AMFDecodedFramePool     m_FramePool;
         amf_pts                 m_SeekPts;
+        bool                    m_bDrainSent;
 
         AMFBufferPtr            pExtraData;
         AMFBufferPtr            m_pInputData;
+        // the last buffer sent to the decoder - frames come out later than their packets go in
+        AMFBufferPtr            m_pLastInputData;
+        bool                    m_bLastAVPacketRead;
         amf_size                m_iLastDataOffset;
         amf_pts                 m_ptsLastDataOffset;
 
@@ -36,6 +36,7 @@
 #include <string>
 
 #include "public/include/core/Platform.h"
+#include "public/common/LatencyStats.h"
 
 namespace amf
 {
@@ -46,10 +47,6 @@ namespace amf
 		CaptureStats()
 			: m_outfileFilename("")
 			, m_summary("")
-			, m_minDuration(MAXLONG)
-			, m_maxDuration(0)
-			, m_averageDuration(-1)
-			, m_samples(0)
 		{
 		}
 
@@ -65,25 +62,24 @@ namespace amf
 
 		void Reinit()
 		{
-			m_minDuration		=  MAXLONG;
-			m_maxDuration		=  0;
-			m_averageDuration	= -1;
-			m_samples = 0;
+			m_durations.Reset();
 		}
 
 		void Terminate()
 		{
-			amf_pts tmp;
+			AMFLatencySnapshot snapshot;
+			m_durations.GetSnapshot(&snapshot);
+
 			std::ofstream file;
 			file.open(m_outfileFilename);
 			file << m_summary << std::endl;
-			tmp = m_averageDuration / 10000; // to ms
-			file << "\t" << "Average Duration (ms) " << tmp << std::endl;
-			tmp = m_minDuration / 10000; // to ms
-			file << "\t" << "Minimum Duration (ms) " << tmp << std::endl;
-			tmp = m_maxDuration / 10000; // to ms
-			file << "\t" << "Maximum Duration (ms) " << tmp << std::endl;
-			file << "\t" << "Samples               " << m_samples << std::endl;
+			file << "\t" << "Average Duration (ms) " << snapshot.mean / 10000 << std::endl; // to ms
+			file << "\t" << "Std Deviation (ms)    " << snapshot.stddev / 10000 << std::endl;
+			file << "\t" << "Minimum Duration (ms) " << snapshot.min / 10000.0 << std::endl;
+			file << "\t" << "Median Duration (ms)  " << snapshot.p50 / 10000.0 << std::endl;
+			file << "\t" << "P99 Duration (ms)     " << snapshot.p99 / 10000.0 << std::endl;
+			file << "\t" << "Maximum Duration (ms) " << snapshot.max / 10000.0 << std::endl;
+			file << "\t" << "Samples               " << snapshot.count << std::endl;
 			file.close();
 		}
 
@@ -94,28 +90,19 @@ namespace amf
 			{
 				return;
 			}
-			//
-			if (duration < m_minDuration)
-			{
-				m_minDuration = duration;
-			}
-			if (duration > m_maxDuration)
-			{
-				m_maxDuration = duration;
-			}
-			//
-			m_averageDuration = (m_averageDuration < 0) ? duration : (m_averageDuration + duration) / 2;
-			m_samples++;
+			m_durations.Record(duration);
+		}
+
+		void GetSnapshot(AMFLatencySnapshot* pSnapshot) const
+		{
+			m_durations.GetSnapshot(pSnapshot);
 		}
 
 	private:
 		std::string m_outfileFilename;
 		std::string m_summary;
 
-		amf_pts m_minDuration;
-		amf_pts m_maxDuration;
-		amf_pts m_averageDuration;
-		unsigned m_samples;
+		AMFLatencyStats m_durations;
 	};
 }
 
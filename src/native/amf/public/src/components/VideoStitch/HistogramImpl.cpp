@@ -32,6 +32,7 @@
 #include "HistogramImpl.h"
 #include "public/include/core/Compute.h"
 #include "public/common/TraceAdapter.h"
+#include "public/common/WorkStealingPool.h"
 #include "public/include/core/Context.h"
 #define _ATL_DISABLE_NOTHROW_NEW
 
@@ -48,10 +49,6 @@ using namespace DirectX;
 #define AMF_FACILITY L"Histogram"
 #define MAX_CORNERS     100
 
-#define __global
-#define __local
-#define barrier(x)
-
 inline static amf_uint32 AlignValue(amf_uint32 value, amf_uint32 alignment)
 {
     return ((value + (alignment - 1)) & ~(alignment - 1));
@@ -80,32 +77,10 @@ amf::AMF_KERNEL_ID   m_KernelBuildLUTCenterIdDX11 = -1;
 amf::AMF_KERNEL_ID   m_KernelBuildShiftsIdDX11 = -1;
 
 //#define RGB_COLORSPACE
-#define LUT_CURVE_TABLE_SIZE    20
 
 extern AMF_RESULT  RegisterKernelsDX11();
 
-#pragma pack(push, 1)
-struct HistogramParameters
-{
-    amf_int32 maxDistanceBetweenPeaks[3];
-    amf_int32 whiteCutOffY;
-    amf_int32 blackCutOffY;
-    amf_int32 borderHistWidth; //TODO make image size - dependent
-    float   alphaLUT;
-    float   lutCurveTable[LUT_CURVE_TABLE_SIZE]; // curve from 0 to 1
-    amf_int32 align1;
-};
-#pragma pack(pop)
-
 static amf_int32 CrossCorrelation(amf_int32 *data1, amf_int32 *data2, amf_int32 maxdelay);
-static float OneCrossCorrelation(
-    __global amf_int32 *data1,    // [in]
-    __global amf_int32 *data2,    // [in]
-    amf_int32 col,
-    amf_int32 delay,
-    amf_int32 maxdelay,
-    __global HistogramParameters *params
-    );
 
 // static parameters
 static HistogramParameters params = {
@@ -119,12 +94,11 @@ static HistogramParameters params = {
 static amf_int32 minStretchValue = 10000;
 static amf_int32 borderForStretch = 0;
 
-static void BuildOneLUT(amf_int32 col, float brightness, float *lut, float *prev, HistogramParameters *params, amf_int32 frameCount);
 static void FilterData(amf_int32 *data,amf_int32 *dataPrev,  amf_int32 count, amf_int32 frameCount);
 static void FilterDataInplace(amf_int32 *data, amf_int32 count);
 
 //-------------------------------------------------------------------------------------------------
-HistogramImpl::HistogramImpl() : m_iFrameCount(0)
+HistogramImpl::HistogramImpl() : m_pPool(NULL), m_iFrameCount(0)
 {
 }
 //-------------------------------------------------------------------------------------------------
@@ -223,7 +197,7 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Init(AMFCompute* pDevice, AMFContext* pCo
             {
                 float* lut = (float*)pBufferLUTNone->GetNative() + channel * 5 * 3 * HIST_SIZE + side * 3 * HIST_SIZE + col * HIST_SIZE;
 
-                BuildOneLUT(col, 0.0f, lut, NULL, &params, 0);
+                StitchColorBalance::BuildOneLUT(col, 0.0f, lut, NULL, params, 0);
             }
         }
     }
@@ -285,26 +259,22 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Init(AMFCompute* pDevice, AMFContext* pCo
         AMF_RETURN_IF_FAILED(res, L"ZeroBuffer() failed");
     }
 #else
+    // histograms are counted on the CPU by Build
+    res = m_pContext->AllocBuffer(AMF_MEMORY_HOST, histogramSize, &m_pHistograms);
+    AMF_RETURN_IF_FAILED(res, L"AllocBuffer() failed");
+    memset(m_pHistograms->GetNative(), 0, histogramSize);
+
     if (m_pDevice->GetMemoryType() == AMF_MEMORY_DX11)
     {
         m_bUseDX11NativeBuffer = true;
         D3D11_BUFFER_DESC desc = {};
-        desc.ByteWidth = (UINT)histogramSize;
+        desc.ByteWidth = (UINT)lutSize;
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
         desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE;
         desc.MiscFlags = 0;
         desc.StructureByteStride = 0;
 
-        res = CreateBufferFromDX11Native(&desc, NULL, &m_pHistogramsDX11);  //no cpu version for histogram creation
-        AMF_RETURN_IF_FAILED(res, L"CreateBufferFromDX11Native() failed");
-        res = ClearBuffer(m_pHistogramsDX11);
-        AMF_RETURN_IF_FAILED(res, L"AllocBuffer() failed");
-
-        res = m_pContext->AllocBuffer(AMF_MEMORY_HOST, histogramSize, &m_pHistograms);
-        AMF_RETURN_IF_FAILED(res, L"AllocBuffer() failed");
-
-        desc.ByteWidth = (UINT)lutSize;
         D3D11_SUBRESOURCE_DATA InitData = { 0 };
         InitData.pSysMem = pBufferLUTNone->GetNative();
         res = CreateBufferFromDX11Native(&desc, &InitData, &m_pBufferLUTNoneDX11);
@@ -312,15 +282,15 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Init(AMFCompute* pDevice, AMFContext* pCo
     }
     else
     {
-        res = m_pContext->AllocBuffer(m_pDevice->GetMemoryType(), histogramSize, &m_pHistograms);
-        amf_uint8 nullData = 0;
-        res = m_pDevice->FillBuffer(m_pHistograms, 0, m_pHistograms->GetSize(), &nullData, sizeof(nullData));
-        AMF_RETURN_IF_FAILED(res, L"AllocBuffer() failed");
-
         m_pBufferLUTNone = pBufferLUTNone;
         m_pBufferLUTNone->Convert(m_pDevice->GetMemoryType());
     }
 
+    if (m_pPool == NULL)
+    {
+        m_pPool = new AMFWorkStealingPool();
+    }
+
     AMF_MEMORY_TYPE memoryType = AMF_MEMORY_HOST;
 
     res = m_pContext->AllocBuffer(memoryType, brightnessSize, &m_pBrightness);
@@ -379,6 +349,11 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Terminate()
     m_pKernelBuildShifts = NULL;
     m_pDevice = NULL;
     m_pContext = NULL;
+    if (m_pPool != NULL)
+    {
+        delete m_pPool;
+        m_pPool = NULL;
+    }
 #if DUMP_HISTOGRAM
     m_pAllFile = NULL; 
     m_pInputFiles.clear(); 
@@ -390,6 +365,26 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Terminate()
 AMF_RESULT AMF_STD_CALL HistogramImpl::Build(amf_int32 channel, AMFSurface* pSrcSurface, AMFRect border, AMFSurface* pBorderMap)
 {
     AMF_RESULT res = AMF_OK;
+#if !GPU_ACCELERATION
+    res = pSrcSurface->Convert(AMF_MEMORY_HOST);
+    AMF_RETURN_IF_FAILED(res, L"Convert(AMF_MEMORY_HOST) failed");
+
+    res = pBorderMap->Convert(AMF_MEMORY_HOST);
+    AMF_RETURN_IF_FAILED(res, L"Convert(AMF_MEMORY_HOST) failed");
+
+    {
+        AMFPlanePtr planeY = pSrcSurface->GetPlane(AMF_PLANE_Y);
+        AMFPlanePtr planeUV = pSrcSurface->GetPlane(AMF_PLANE_UV);
+        AMFPlanePtr planeMap = pBorderMap->GetPlaneAt(0);
+
+        // every input counts into its own channel, so inputs can build concurrently
+        StitchColorBalance::AccumulateNV12((amf_int32*)m_pHistograms->GetNative(), channel,
+            (const amf_uint8*)planeY->GetNative(), planeY->GetHPitch(),
+            (const amf_uint8*)planeUV->GetNative(), planeUV->GetHPitch(),
+            planeY->GetWidth(), planeY->GetHeight(),
+            (const amf_uint8*)planeMap->GetNative(), planeMap->GetHPitch(), planeMap->GetWidth(), planeMap->GetHeight());
+    }
+#else
     // convert to OpenCL /MCL
     AMF_MEMORY_TYPE oldType = pSrcSurface->GetMemoryType();
     res = pSrcSurface->Convert(m_pDevice->GetMemoryType());
@@ -458,6 +453,7 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Build(amf_int32 channel, AMFSurface* pSrc
         AMF_RETURN_IF_FAILED(m_pDevice->FlushQueue());
     }
 #endif    
+#endif // #if !GPU_ACCELERATION
     return AMF_OK;
 }
 
@@ -581,308 +577,6 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Convert(bool bColorBalance, amf_int32 cha
     return AMF_OK;
 }
 
-//--------------------------------------------------------------------------------------------------------------------
-void BuildOneLUT(amf_int32 col, float brightness, __global float *lut, __global float *prev, __global struct HistogramParameters *params, amf_int32 frameCount)
-{
-    for(amf_int32 k=0; k < HIST_SIZE; k++)
-    {
-        float lutCurr = brightness;
-        if(col == 0)
-        {
-            if(k < params->blackCutOffY)
-            {
-                lutCurr = 0.0f;
-            }
-            else if(k < LUT_CURVE_TABLE_SIZE + params->blackCutOffY)
-            {
-                lutCurr *= 1.0f - params->lutCurveTable[k - params->blackCutOffY];
-            }
-            else if(k > params->whiteCutOffY)
-            {
-                lutCurr = 0.0f;
-            }
-            else if(k >= params->whiteCutOffY - LUT_CURVE_TABLE_SIZE)
-            {
-                lutCurr *= params->lutCurveTable[k - (params->whiteCutOffY - LUT_CURVE_TABLE_SIZE) ];
-            }
-        }
-
-        lutCurr += (float)k /255.f;
-
-        if(prev != NULL)
-        {
-            float lutPrev = prev[k];
-            if(frameCount != 0 )
-            {
-                lutCurr = lutPrev + params->alphaLUT * ( lutCurr - lutPrev);
-            }
-            prev[k] = lutCurr;
-        }
-        lut[k] = lutCurr;
-   }
-}
-
-#define MY_SIGN(a) (a == 0 ? 0 : (a < 0 ? -1 : 1)  )
-//-------------------------------------------------------------------------------------------------
-void BuildShifts(
-    __global float  *pShifts,
-    __global amf_int32 *pHistogram,
-    __global int *pCorners,
-    __global int *pParams,
-    amf_int32 corners,
-    amf_int32 frameCount
-)
-{
-    __global struct HistogramParameters *params = (__global struct HistogramParameters *)pParams;
-    for(amf_int32 corner = 0; corner < corners; corner++)
-    {
-        __global struct Corner* it_corner = (__global struct Corner*)pCorners + corner;
-
-        for(amf_int32 col = 0; col < 3; col++)
-        {
-            for(amf_int32 side = 0; side < it_corner->count; side++)
-            {
-                __local float corrs[HIST_SIZE * 2];
-
-                for(amf_int32 i = 0; i < HIST_SIZE *2; i++)
-                {
-                    corrs[i] = 0;
-                }
-                __global amf_int32* pHist[3];
-
-                for(amf_int32 i = 0; i < it_corner->count; i++)
-                {
-                    pHist[i] = pHistogram + it_corner->channel[i] * 4 * 3 * HIST_SIZE  + it_corner->corner[i] * HIST_SIZE * 3 +  col * HIST_SIZE;
-                }
-
-                int h1 = 0;
-                int h2 = 0;
-                if(it_corner->count == 3)
-                { 
-                    if(side == 0)
-                    {
-                        h1 = 0;
-                        h2 = 1;
-                    }
-                    else if(side == 1)
-                    {
-                        h1 = 1;
-                        h2 = 2;
-                    }
-                    else if(side == 2)
-                    {
-                        h1 = 2;
-                        h2 = 0;
-                    }
-                }
-                if(it_corner->count == 2)
-                {
-                    if(side == 0)
-                    { 
-                        h1 = 0;
-                        h2 = 1;
-                    }
-                    else 
-                    { 
-                        h1 = 1;
-                        h2 = 0;
-                    }
-                }
-
-                for(amf_int32 delay = 0; delay < params->maxDistanceBetweenPeaks[col] * 2; delay++)
-                {
-                    barrier  (CLK_LOCAL_MEM_FENCE);
-                    float shift =  OneCrossCorrelation(pHist[h1], pHist[h2], col, delay, params->maxDistanceBetweenPeaks[col], params);;
-                    float weight = 1.0f;
-                    corrs[delay] = shift * weight;
-                    barrier  (CLK_LOCAL_MEM_FENCE);
-                }
-                if(it_corner->index == 1)
-                {
-                    int a = 1;
-                }
-                float corrMax = -1.0e5f;
-                for(amf_int32 i = 0; i < params->maxDistanceBetweenPeaks[col] * 2; i++)
-                {
-                    if(corrMax < corrs[i])
-                    {
-                        corrMax = corrs[i];
-                        pShifts[corner * 3 * it_corner->count + col * it_corner->count + side] = (float)i - params->maxDistanceBetweenPeaks[col];
-                    }
-                }
-            }
-        }
-    }
-}
-
-//-------------------------------------------------------------------------------------------------
-static void BuildLUT(
-    __global float *pLUT,        ///< [out] histogram data  - 256 x 3 for RG, G and B
-    __global float *pLUTPrev,    ///< [in] histogram data  - 256 x 3 for RG, G and B
-    __global float *pBrightness,
-    __global float  *pShifts,
-    __global int *pCorners,
-    __global int *pParams,
-    amf_int32 corners,
-    amf_int32 frameCount
-)
-{
-    __global struct HistogramParameters *params = (__global struct HistogramParameters *)pParams;
-    for(amf_int32 corner = 0; corner < corners; corner++)
-    {
-        __global struct Corner* it_corner = (__global struct Corner*)pCorners + corner;
-
-        for(int col = 0; col < 3; col++)
-        {
-            float       brightness[3];
-            brightness[0] = 0;
-            brightness[1] = 0;
-            brightness[2] = 0;
-            int shiftOffset = corner * 3 * it_corner->count + col * it_corner->count;
-
-            if(it_corner->count == 2)
-            {
-                brightness[0] =  pShifts[shiftOffset + 0] / 2.0f;
-                brightness[1] =  pShifts[shiftOffset + 1] / 2.0f;
-            }
-            else if(it_corner->count == 3)
-            {
-
-                int shiftMaxIndex = 0;
-                int shiftMinIndex = HIST_SIZE *2;
-                float shiftMin = 10000.0f;
-                float shiftMax = 0.0f;
-
-
-                for(int side = 0; side < it_corner->count; side++)
-                {
-                    if(fabs(shiftMin) > fabs(pShifts[shiftOffset + side]))
-                    {
-                        shiftMin = pShifts[shiftOffset + side];
-                        shiftMinIndex = side;
-                    }
-                    if(fabs(shiftMax) < fabs(pShifts[shiftOffset + side]))
-                    {
-                        shiftMax = pShifts[shiftOffset + side];
-                        shiftMaxIndex = side;
-                    }
-                }
-                int shiftMinIndexSecond = 0;
-                for(int side = 0; side < it_corner->count; side++)
-                {
-                    if(side != shiftMinIndex && side != shiftMaxIndex)
-                    {
-                        shiftMinIndexSecond = side;
-                        break;
-                    }
-                }
-
-                shiftMin = pShifts[shiftOffset + shiftMinIndex];
-                float shiftMinSecond = pShifts[shiftOffset + shiftMinIndexSecond];
-
-                if(shiftMinIndex == 0 )
-                {
-                    brightness[0] =  shiftMin/ 2.0f;
-                    brightness[1] =  - shiftMin / 2.0f;
-
-                    if(shiftMinIndexSecond == 1)
-                    {
-                        brightness[2] = -shiftMinSecond *2.0f / 3.0f - shiftMin/ 2.0f;
-
-                        brightness[0] += shiftMinSecond / 3.0f;
-                        brightness[1] += shiftMinSecond / 3.0f;
-                    }
-                    else
-                    {
-                        brightness[2] = shiftMinSecond *2.0f / 3.0f + shiftMin/ 2.0f;
-
-                        brightness[0] -= shiftMinSecond / 3.0f;
-                        brightness[1] -= shiftMinSecond / 3.0f;
-                    }
-
-                }
-                else  if(shiftMinIndex == 1 )
-                {
-                    brightness[1] =  shiftMin/ 2.0f;
-                    brightness[2] =  -shiftMin / 2.0f;
-
-                    if(shiftMinIndexSecond == 0)
-                    {
-                        brightness[0] = shiftMinSecond *2.0f / 3.0f + shiftMin/ 2.0f;
-
-                        brightness[1] -=  shiftMinSecond / 3.0f;
-                        brightness[2] -=  shiftMinSecond / 3.0f;
-                    }
-                    else
-                    {
-                        brightness[0] = -shiftMinSecond *2.0f / 3.0f - shiftMin/ 2.0f;
-
-                        brightness[1] +=  shiftMinSecond / 3.0f;
-                        brightness[2] +=  shiftMinSecond / 3.0f;
-                    }
-                }
-                else if(shiftMinIndex ==  2)
-                {
-                    brightness[2] =  shiftMin/ 2.0f;
-                    brightness[0] =  - shiftMin / 2.0f;
-
-                    if(shiftMinIndexSecond == 0)
-                    {
-                        brightness[1] = -shiftMinSecond *2.0f / 3.0f - shiftMin/ 2.0f;
-
-                        brightness[2] +=  shiftMinSecond / 3.0f;
-                        brightness[0] +=  shiftMinSecond / 3.0f;
-                    }
-                    else // 1
-                    {
-                        brightness[1] = shiftMinSecond *2.0f / 3.0f + shiftMin/ 2.0f;
-
-                        brightness[2] -=  shiftMinSecond / 3.0f;
-                        brightness[0] -=  shiftMinSecond / 3.0f;
-                    }
-                }
-            }
-
-            for(amf_int32 i = 0; i < it_corner->count; i++)
-            { 
-                __global float *lut  = pLUT + it_corner->channel[i] * 3 *5 * HIST_SIZE + it_corner->corner[i] * 3* HIST_SIZE + col * HIST_SIZE;
-                __global float *lutPrev = pLUTPrev + it_corner->channel[i] * 3 *5 * HIST_SIZE + it_corner->corner[i] * 3* HIST_SIZE + col * HIST_SIZE;
-                BuildOneLUT( col, brightness[i] / 255.f,  lut, lutPrev, params, frameCount);
-                pBrightness[it_corner->channel[i] * 4 *3 + it_corner->corner[i] *3 + col]  = brightness[i];
-            }
-        }
-    }
-}
-
-//--------------------------------------------------------------------------------------------------------------------
-static void BuildLUTCenter(
-    __global float *pLUT,        ///< [out] histogram data  - 256 x 3 for RG, G and B
-    __global float *pLUTPrev,    ///< [in] histogram data  - 256 x 3 for RG, G and B
-    __global float *pBrightness,
-    __global int *pParams,
-    amf_int32 channels,
-    amf_int32 frameCount
-)
-{
-    __global struct HistogramParameters *params = (__global struct HistogramParameters *)pParams;
-    for(amf_int32 channel = 0; channel < channels; channel++)
-    {
-        for(amf_int32 col = 0; col < 3; col++)
-        {
-            float brightnessCenter = 0;
-            for( amf_int32 side = 0; side < 4; side++)
-            {
-                brightnessCenter +=  pBrightness[channel * 4 * 3 + side *3 + col];
-            }
-            brightnessCenter/=4.0f;
-
-            __global float *lutCenter  = pLUT + channel * 3 *5 * HIST_SIZE + 4 * 3* HIST_SIZE + col * HIST_SIZE;
-            __global float *lutPrevCenter = pLUTPrev + channel * 3 *5 * HIST_SIZE + 4 * 3* HIST_SIZE + col * HIST_SIZE;
-            BuildOneLUT( col, brightnessCenter / 255.f,  lutCenter, lutPrevCenter, params, frameCount);
-        }
-    }
-}
-
 //--------------------------------------------------------------------------------------------------------------------
 static amf_int32 CrossCorrelation(amf_int32 *data1, amf_int32 *data2, amf_int32 maxdelay)
 {
@@ -1025,9 +719,9 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Adjust(amf_int32 count, RibList   &ribs,
         AMF_RETURN_IF_FAILED(res, L"Convert() failed");
 #endif
     }
+#if GPU_ACCELERATION
     if ((m_pShifts == NULL) || (m_pShiftsDX11 == NULL))
     {
-#if GPU_ACCELERATION
         if (m_bUseDX11NativeBuffer)
         {
             if (m_pShiftsDX11 == NULL)
@@ -1049,11 +743,8 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Adjust(amf_int32 count, RibList   &ribs,
             res = m_pContext->AllocBuffer(m_pDevice->GetMemoryType(), corners.size() * 3 * corners[0].count * sizeof(float), &m_pShifts);
             AMF_RETURN_IF_FAILED(res, L"AllocBuffer() failed");
         }
-#else
-        amf_int32 len = (UINT)corners.size() * 3 * corners[0].count * sizeof(float);
-        res = m_pContext->AllocBuffer(AMF_MEMORY_HOST, len, &m_pShifts);
-#endif
     }
+#endif
 #if DUMP_HISTOGRAM
     if(m_iFrameCount == 0 && m_pAllFile != NULL)
     {
@@ -1212,44 +903,14 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Adjust(amf_int32 count, RibList   &ribs,
     AMF_RETURN_IF_FAILED(m_pDevice->FlushQueue());
 
 #else // #if GPU_ACCELERATION
-    if (m_pDevice->GetMemoryType() == AMF_MEMORY_DX11)
-    {
-        res = CopyBuffer(m_pHistograms, m_pHistogramsDX11);
-        AMF_RETURN_IF_FAILED(res, L"CopyBuffer() failed");
-    }
-
-    AMFDataPtr pData;
-    res = m_pHistograms->Duplicate(AMF_MEMORY_HOST, &pData);
+    // Build counted straight into the host histograms, and the LUTs and brightness live on the
+    // host, so there is nothing to copy before or after.
+    res = m_pBufferLUT->Convert(AMF_MEMORY_HOST);
     AMF_RETURN_IF_FAILED(res, L"Convert(AMF_MEMORY_HOST) failed");
-    AMFBufferPtr pHistograms(pData);
-    AMFDataPtr pDataPrev;
 
-    AMFDataPtr pDataShifts;
-    res = m_pShifts->Duplicate(AMF_MEMORY_HOST, &pDataShifts);
-    AMF_RETURN_IF_FAILED(res, L"Convert(AMF_MEMORY_HOST) failed");
-    AMFBufferPtr pDataShiftsHost(pDataShifts);
-
-    AMFDataPtr pBrightnessData;
-    res = m_pBrightness->Duplicate(AMF_MEMORY_HOST, &pBrightnessData);
-    AMF_RETURN_IF_FAILED(res, L"Convert(AMF_MEMORY_HOST) failed");
-    AMFBufferPtr pBrightnessHost(pBrightnessData);
-    
-    
-
-    amf_int32  *pOutHist = (amf_int32*)pHistograms->GetNative();
-    float      *pShifts = (float *)pDataShiftsHost->GetNative();
-    float      *pBrightness = (float *)pBrightnessHost->GetNative();
-    
-
-    m_pBufferLUT->Convert(AMF_MEMORY_HOST);
-    m_pBufferLUTPrev->Convert(AMF_MEMORY_HOST);
-
-    float* pLUT = (float*)m_pBufferLUT->GetNative();
-    float* pLUTPrev = (float*)m_pBufferLUTPrev->GetNative();
-
-    BuildShifts(pShifts,pOutHist, (amf_int32 *)m_pCorners->GetNative(), (amf_int32 *)&params, (amf_int32)corners.size(), (amf_int32)m_iFrameCount);
-    BuildLUT(pLUT, pLUTPrev, pBrightness, pShifts, (amf_int32 *)m_pCorners->GetNative(), (amf_int32 *)&params, (amf_int32)corners.size(), (amf_int32)m_iFrameCount);
-    BuildLUTCenter(pLUT,pLUTPrev, pBrightness, (amf_int32 *)&params, count, (amf_int32)m_iFrameCount);
+    m_ColorBalance.Adjust(corners, count, (amf_int32*)m_pHistograms->GetNative(),
+        (float*)m_pBufferLUT->GetNative(), (float*)m_pBufferLUTPrev->GetNative(), (float*)m_pBrightness->GetNative(),
+        params, (amf_int32)m_iFrameCount, m_pPool);
 
     m_pBufferLUT->Convert(m_pDevice->GetMemoryType());
 
@@ -1257,17 +918,7 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Adjust(amf_int32 count, RibList   &ribs,
 //    m_pAllFile = NULL;
     m_pInputFiles.clear();
 #endif
-    if(m_pDevice->GetMemoryType() == AMF_MEMORY_DX11)
-    {
-        res = ClearBuffer(m_pHistogramsDX11);
-    }
-    else
-    {
-        amf_uint8 pattern = 0;
-        res = m_pDevice->FillBuffer(m_pHistograms, 0, m_pHistograms->GetSize(), &pattern, sizeof(pattern));
-    }
-    AMF_RETURN_IF_FAILED(res, L"ZeroBuffer() failed");
-    AMF_RETURN_IF_FAILED(m_pDevice->FlushQueue());
+    memset(m_pHistograms->GetNative(), 0, m_pHistograms->GetSize());
 
 #endif // #if GPU_ACCELERATION
     m_iFrameCount++;
@@ -1275,82 +926,6 @@ AMF_RESULT AMF_STD_CALL HistogramImpl::Adjust(amf_int32 count, RibList   &ribs,
 }
 
 
-//-------------------------------------------------------------------------------------------------
-static float OneCrossCorrelation(
-    __global amf_int32 *data1,    // [in]
-    __global amf_int32 *data2,    // [in]
-    amf_int32 col,
-    amf_int32 delay,
-    amf_int32 maxdelay,
-    __global HistogramParameters *params
-    )
-{
-    float r = 0;
-    float x[HIST_SIZE];
-    float y[HIST_SIZE];
-
-    for(amf_int32 i = 0; i < HIST_SIZE; i++)
-    {
-        if(i > params->blackCutOffY || i < params->whiteCutOffY)
-        {
-            x[i]  = (float)data1[i];
-            y[i]  = (float)data2[i];
-        }
-        else
-        {
-            x[i]  = 0;
-            y[i]  = 0;
-        }
-    }
-
-    if(delay  - maxdelay < maxdelay)
-    {
-        // Calculate the mean of the two series x[], y[]
-        float mx = 0;
-        float my = 0;   
-        for (amf_int32 i=0 ; i < HIST_SIZE; i++) 
-        {
-            mx += x[i];
-            my += y[i];
-        }
-        mx /= HIST_SIZE;
-        my /= HIST_SIZE;
-        for (amf_int32 i=0; i < HIST_SIZE; i++) 
-        {
-            x[i] -= mx;
-            y[i] -= my;
-        }
-        // Calculate the denominator
-        float sx = 0;
-        float sy = 0;
-        for (amf_int32 i = 0; i < HIST_SIZE; i++) 
-        {
-            sx += x[i] * x[i];
-            sy += y[i] * y[i];
-        }
-        float denom = sqrtf(sx*sy);
-
-        // Calculate the correlation
-        float sxy = 0;
-        for (int i = 0; i < HIST_SIZE; i++) 
-        {
-            int j = i + delay  - maxdelay;
-            
-            if (j < 0 || j >= HIST_SIZE)
-            {
-                continue;
-            }
-            else
-            {
-                sxy += x[i] * y[j];
-            }
-                
-        }
-        r = (float)(sxy / denom);
-    }
-    return r;
-}
-
 //-------------------------------------------------------------------------------------------------
 static void FilterDataInplace(amf_int32 *data,amf_int32 count)
 {
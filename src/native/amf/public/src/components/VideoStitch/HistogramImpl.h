@@ -51,39 +51,11 @@
 #include "public/common/AMFFactory.h"
 #include <atlbase.h>
 #include <d3d11.h>
+#include "StitchColorBalance.h"
 
-
-#define HIST_SIZE   256
 namespace amf
 {
 
-#pragma pack(push, 1)
-struct Rib
-{
-    amf_int32 channel1;
-    amf_int32 side1;        // 0 - left, 1, top, 2 - right, 3 - bottom
-    amf_int32 channel2;
-    amf_int32 side2;        // 0 - left, 1, top, 2 - right, 3 - bottom
-    amf_int32 index;
-};
-#pragma pack(pop)
-
-#pragma pack(push, 1)
-struct Corner
-{
-    amf_int32 count;
-	amf_int32 align1[3];
-    amf_int32 channel[4];
-    amf_int32 corner[4];    // 0 - lt, 1 - rt, 2 - rb, 3 - lb
-    amf_int32 index;
-    float     pos[3];
-};
-
-#pragma pack(pop)
-
-typedef std::vector<Rib> RibList;
-typedef std::vector<Corner> CornerList;
-
 typedef ATL::CComPtr<ID3D11Buffer> ID3D11BufferPtr;
 
 class HistogramImpl : public AMFInterfaceImpl<AMFInterface>
@@ -106,6 +78,10 @@ private:
     AMF_RESULT ClearBuffer(ID3D11BufferPtr pBuffer);
     AMF_RESULT CopyBuffer(AMFBufferPtr pDst, ID3D11BufferPtr pSrc);
 
+    // CPU color balancing, used when GPU_ACCELERATION is 0
+    StitchColorBalance    m_ColorBalance;
+    AMFWorkStealingPool*  m_pPool;
+
     AMFContextPtr         m_pContext;
     AMFComputePtr         m_pDevice;
     AMFComputeKernelPtr   m_pKernelHistogram;
@@ -0,0 +1,572 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#include "StitchColorBalance.h"
+#include "public/common/Thread.h"
+#include "public/common/WorkStealingPool.h"
+#include <math.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STITCH_COLOR_SSE 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define STITCH_COLOR_NEON 1
+#endif
+
+using namespace amf;
+
+#define AMF_FACILITY L"StitchColorBalance"
+
+// shifts tried per pass over a histogram, four per vector
+#define DELAYS_PER_PASS     16
+// room for delays up to a whole histogram either way
+#define MAX_DELAY           HIST_SIZE
+#define PADDED_SIZE         (HIST_SIZE + MAX_DELAY * 2 + DELAYS_PER_PASS)
+
+namespace
+{
+    //-------------------------------------------------------------------------------------------------
+    // The zero mean series OneCrossCorrelation used to rebuild for every delay.
+    void CenterHistogram(const amf_int32* pData, const HistogramParameters& params, float* pOut, float& sumSq)
+    {
+        for (amf_int32 i = 0; i < HIST_SIZE; i++)
+        {
+            pOut[i] = (i > params.blackCutOffY || i < params.whiteCutOffY) ? (float)pData[i] : 0.0f;
+        }
+        float mean = 0;
+        for (amf_int32 i = 0; i < HIST_SIZE; i++)
+        {
+            mean += pOut[i];
+        }
+        mean /= HIST_SIZE;
+        for (amf_int32 i = 0; i < HIST_SIZE; i++)
+        {
+            pOut[i] -= mean;
+        }
+        sumSq = 0;
+        for (amf_int32 i = 0; i < HIST_SIZE; i++)
+        {
+            sumSq += pOut[i] * pOut[i];
+        }
+    }
+    //-------------------------------------------------------------------------------------------------
+    // pCorr[d] = sum over i of x[i] * y[i + d - maxDelay], for d in [0, delays) rounded up to
+    // DELAYS_PER_PASS. y is padded with zeros so that every delay runs over all of x; adding the
+    // zero products doesn't change a sum, and each lane adds in increasing i like the scalar loop.
+    void CrossCorrelate(const float* x, const float* y, amf_int32 maxDelay, amf_int32 delays, float* pCorr)
+    {
+        AMF_ALIGN(16) float yPadded[PADDED_SIZE];
+        memset(yPadded, 0, sizeof(yPadded));
+        memcpy(yPadded + maxDelay, y, HIST_SIZE * sizeof(float));
+
+        for (amf_int32 first = 0; first < delays; first += DELAYS_PER_PASS)
+        {
+#if defined(STITCH_COLOR_SSE)
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+            __m128 acc2 = _mm_setzero_ps();
+            __m128 acc3 = _mm_setzero_ps();
+            for (amf_int32 i = 0; i < HIST_SIZE; i++)
+            {
+                const __m128 xi = _mm_set1_ps(x[i]);
+                const float* p = yPadded + first + i;
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(xi, _mm_loadu_ps(p)));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(xi, _mm_loadu_ps(p + 4)));
+                acc2 = _mm_add_ps(acc2, _mm_mul_ps(xi, _mm_loadu_ps(p + 8)));
+                acc3 = _mm_add_ps(acc3, _mm_mul_ps(xi, _mm_loadu_ps(p + 12)));
+            }
+            _mm_storeu_ps(pCorr + first, acc0);
+            _mm_storeu_ps(pCorr + first + 4, acc1);
+            _mm_storeu_ps(pCorr + first + 8, acc2);
+            _mm_storeu_ps(pCorr + first + 12, acc3);
+#elif defined(STITCH_COLOR_NEON)
+            // vmlaq_f32 may fuse, which would round differently from the scalar code
+            float32x4_t acc0 = vdupq_n_f32(0.0f);
+            float32x4_t acc1 = vdupq_n_f32(0.0f);
+            float32x4_t acc2 = vdupq_n_f32(0.0f);
+            float32x4_t acc3 = vdupq_n_f32(0.0f);
+            for (amf_int32 i = 0; i < HIST_SIZE; i++)
+            {
+                const float32x4_t xi = vdupq_n_f32(x[i]);
+                const float* p = yPadded + first + i;
+                acc0 = vaddq_f32(acc0, vmulq_f32(xi, vld1q_f32(p)));
+                acc1 = vaddq_f32(acc1, vmulq_f32(xi, vld1q_f32(p + 4)));
+                acc2 = vaddq_f32(acc2, vmulq_f32(xi, vld1q_f32(p + 8)));
+                acc3 = vaddq_f32(acc3, vmulq_f32(xi, vld1q_f32(p + 12)));
+            }
+            vst1q_f32(pCorr + first, acc0);
+            vst1q_f32(pCorr + first + 4, acc1);
+            vst1q_f32(pCorr + first + 8, acc2);
+            vst1q_f32(pCorr + first + 12, acc3);
+#else
+            for (amf_int32 d = first; d < first + DELAYS_PER_PASS; d++)
+            {
+                float sum = 0;
+                for (amf_int32 i = 0; i < HIST_SIZE; i++)
+                {
+                    sum += x[i] * yPadded[d + i];
+                }
+                pCorr[d] = sum;
+            }
+#endif
+        }
+    }
+    //-------------------------------------------------------------------------------------------------
+    inline void CountBlock(amf_int32* pChannel, amf_uint8 mapData, amf_int32 blockX, amf_int32 blockY,
+        const amf_uint8* pY, amf_int32 pitchY, const amf_uint8* pUV, amf_int32 pitchUV,
+        amf_int32 width, amf_int32 height)
+    {
+        amf_int32 sideX = -1;
+        amf_int32 sideY = -1;
+        if ((mapData & 1) != 0)
+        {
+            sideX = 0;
+        }
+        if ((mapData & 2) != 0)
+        {
+            sideX = 1;
+        }
+        if ((mapData & 4) != 0)
+        {
+            sideY = 2;
+        }
+        if ((mapData & 8) != 0)
+        {
+            sideY = 3;
+        }
+        amf_int32* pHistX = sideX >= 0 ? pChannel + sideX * 3 * HIST_SIZE : NULL;
+        amf_int32* pHistY = sideY >= 0 ? pChannel + sideY * 3 * HIST_SIZE : NULL;
+
+        // a map entry covers 8x8 luma, 4x4 chroma; odd edges read the last row / column like the
+        // kernel's clamping sampler does
+        const amf_int32 lastX = AMF_MIN(blockX * 4 + 4, (width + 1) / 2);
+        const amf_int32 lastY = AMF_MIN(blockY * 4 + 4, (height + 1) / 2);
+        for (amf_int32 uy = blockY * 4; uy < lastY; uy++)
+        {
+            const amf_uint8* pRowY0 = pY + (amf_size)(uy * 2) * pitchY;
+            const amf_uint8* pRowY1 = pY + (amf_size)AMF_MIN(uy * 2 + 1, height - 1) * pitchY;
+            const amf_uint8* pRowUV = pUV + (amf_size)uy * pitchUV;
+            for (amf_int32 ux = blockX * 4; ux < lastX; ux++)
+            {
+                const amf_int32 x0 = ux * 2;
+                const amf_int32 x1 = AMF_MIN(x0 + 1, width - 1);
+                const amf_uint8 y0 = pRowY0[x0];
+                const amf_uint8 y1 = pRowY0[x1];
+                const amf_uint8 y2 = pRowY1[x0];
+                const amf_uint8 y3 = pRowY1[x1];
+                const amf_uint8 u = pRowUV[x0];
+                const amf_uint8 v = pRowUV[x0 + 1];
+                if (pHistX != NULL)
+                {
+                    pHistX[y0]++;
+                    pHistX[y1]++;
+                    pHistX[y2]++;
+                    pHistX[y3]++;
+                    pHistX[HIST_SIZE + u]++;
+                    pHistX[HIST_SIZE * 2 + v]++;
+                }
+                if (pHistY != NULL)
+                {
+                    pHistY[y0]++;
+                    pHistY[y1]++;
+                    pHistY[y2]++;
+                    pHistY[y3]++;
+                    pHistY[HIST_SIZE + u]++;
+                    pHistY[HIST_SIZE * 2 + v]++;
+                }
+            }
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+class StitchColorBalance::ShiftTask : public AMFWorkStealingPool::Task
+{
+public:
+    ShiftTask(StitchColorBalance& owner, amf_size corner, amf_int32 col, const amf_int32* pHistograms,
+        const HistogramParameters& params, std::atomic<amf_size>& pending, AMFEvent& done) :
+        m_Owner(owner), m_iCorner(corner), m_iCol(col), m_pHistograms(pHistograms), m_Params(params),
+        m_Pending(pending), m_Done(done) {}
+
+    virtual void Run()
+    {
+        m_Owner.BuildShifts(m_iCorner, m_iCol, m_pHistograms, m_Params);
+        if (--m_Pending == 0)
+        {
+            m_Done.SetEvent();
+        }
+    }
+
+private:
+    StitchColorBalance&         m_Owner;
+    amf_size                    m_iCorner;
+    amf_int32                   m_iCol;
+    const amf_int32*            m_pHistograms;
+    const HistogramParameters&  m_Params;
+    std::atomic<amf_size>&      m_Pending;
+    AMFEvent&                   m_Done;
+};
+
+//-------------------------------------------------------------------------------------------------
+StitchColorBalance::StitchColorBalance()
+{
+}
+//-------------------------------------------------------------------------------------------------
+void StitchColorBalance::AccumulateNV12(amf_int32* pHistograms, amf_int32 channel,
+    const amf_uint8* pY, amf_int32 pitchY, const amf_uint8* pUV, amf_int32 pitchUV,
+    amf_int32 width, amf_int32 height,
+    const amf_uint8* pMap, amf_int32 pitchMap, amf_int32 widthMap, amf_int32 heightMap)
+{
+    amf_int32* pChannel = pHistograms + channel * 4 * 3 * HIST_SIZE;
+    const amf_int32 blocksX = AMF_MIN(widthMap, (width + 7) / 8);
+    const amf_int32 blocksY = AMF_MIN(heightMap, (height + 7) / 8);
+
+    for (amf_int32 blockY = 0; blockY < blocksY; blockY++)
+    {
+        const amf_uint8* pMapRow = pMap + (amf_size)blockY * pitchMap;
+        amf_int32 blockX = 0;
+#if defined(STITCH_COLOR_SSE) || defined(STITCH_COLOR_NEON)
+        // Only the blocks along the seams have border bits, skip the rest sixteen at a time.
+        for (; blockX + 16 <= blocksX; blockX += 16)
+        {
+#if defined(STITCH_COLOR_SSE)
+            const __m128i sides = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pMapRow + blockX)), _mm_set1_epi8(0x0F));
+            const bool empty = _mm_movemask_epi8(_mm_cmpeq_epi8(sides, _mm_setzero_si128())) == 0xFFFF;
+#else
+            const uint8x16_t sides = vandq_u8(vld1q_u8(pMapRow + blockX), vdupq_n_u8(0x0F));
+            const bool empty = vmaxvq_u8(sides) == 0;
+#endif
+            if (empty)
+            {
+                continue;
+            }
+            for (amf_int32 i = blockX; i < blockX + 16; i++)
+            {
+                if ((pMapRow[i] & 0x0F) != 0)
+                {
+                    CountBlock(pChannel, pMapRow[i], i, blockY, pY, pitchY, pUV, pitchUV, width, height);
+                }
+            }
+        }
+#endif
+        for (; blockX < blocksX; blockX++)
+        {
+            if ((pMapRow[blockX] & 0x0F) != 0)
+            {
+                CountBlock(pChannel, pMapRow[blockX], blockX, blockY, pY, pitchY, pUV, pitchUV, width, height);
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void StitchColorBalance::BuildOneLUT(amf_int32 col, float brightness, float* pLUT, float* pPrev,
+    const HistogramParameters& params, amf_int32 frameCount)
+{
+    for (amf_int32 k = 0; k < HIST_SIZE; k++)
+    {
+        float lutCurr = brightness;
+        if (col == 0)
+        {
+            if (k < params.blackCutOffY)
+            {
+                lutCurr = 0.0f;
+            }
+            else if (k < LUT_CURVE_TABLE_SIZE + params.blackCutOffY)
+            {
+                lutCurr *= 1.0f - params.lutCurveTable[k - params.blackCutOffY];
+            }
+            else if (k > params.whiteCutOffY)
+            {
+                lutCurr = 0.0f;
+            }
+            else if (k >= params.whiteCutOffY - LUT_CURVE_TABLE_SIZE)
+            {
+                lutCurr *= params.lutCurveTable[k - (params.whiteCutOffY - LUT_CURVE_TABLE_SIZE)];
+            }
+        }
+
+        lutCurr += (float)k / 255.f;
+
+        if (pPrev != NULL)
+        {
+            float lutPrev = pPrev[k];
+            if (frameCount != 0)
+            {
+                lutCurr = lutPrev + params.alphaLUT * (lutCurr - lutPrev);
+            }
+            pPrev[k] = lutCurr;
+        }
+        pLUT[k] = lutCurr;
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void StitchColorBalance::Adjust(const CornerList& corners, amf_int32 channels, const amf_int32* pHistograms,
+    float* pLUT, float* pLUTPrev, float* pBrightness,
+    const HistogramParameters& params, amf_int32 frameCount, AMFWorkStealingPool* pPool)
+{
+    if (corners.empty())
+    {
+        return;
+    }
+    if (corners.size() != m_Corners.size() || memcmp(&corners[0], &m_Corners[0], corners.size() * sizeof(Corner)) != 0)
+    {
+        Plan(corners);
+    }
+
+    // Luma tries 180 shifts against 40 for chroma, so hand out corner / color pairs rather
+    // than whole colors to keep the threads even.
+    const amf_size items = m_Plans.size() * 3;
+    if (pPool == NULL || pPool->GetThreadCount() < 2 || items < 2)
+    {
+        for (amf_size item = 0; item < items; item++)
+        {
+            BuildShifts(item / 3, (amf_int32)(item % 3), pHistograms, params);
+        }
+    }
+    else
+    {
+        std::atomic<amf_size> pending(items);
+        AMFEvent done;
+        for (amf_size item = 0; item < items; item++)
+        {
+            pPool->Submit(new ShiftTask(*this, item / 3, (amf_int32)(item % 3), pHistograms, params, pending, done));
+        }
+        done.Lock();
+    }
+
+    // the rest is a few LUTs per corner, cheaper than waking the pool
+    for (amf_size corner = 0; corner < m_Plans.size(); corner++)
+    {
+        for (amf_int32 col = 0; col < 3; col++)
+        {
+            BuildLUT(corner, col, pLUT, pLUTPrev, pBrightness, params, frameCount);
+        }
+    }
+
+    for (amf_int32 channel = 0; channel < channels; channel++)
+    {
+        for (amf_int32 col = 0; col < 3; col++)
+        {
+            float brightnessCenter = 0;
+            for (amf_int32 side = 0; side < 4; side++)
+            {
+                brightnessCenter += pBrightness[channel * 4 * 3 + side * 3 + col];
+            }
+            brightnessCenter /= 4.0f;
+
+            const amf_size offset = channel * 3 * 5 * HIST_SIZE + 4 * 3 * HIST_SIZE + col * HIST_SIZE;
+            BuildOneLUT(col, brightnessCenter / 255.f, pLUT + offset, pLUTPrev + offset, params, frameCount);
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void StitchColorBalance::Plan(const CornerList& corners)
+{
+    m_Corners.assign(corners.begin(), corners.end());
+    m_Plans.resize(corners.size());
+    m_Shifts.assign(corners.size() * 3 * 4, 0.0f);
+
+    for (amf_size i = 0; i < corners.size(); i++)
+    {
+        const Corner& corner = corners[i];
+        CornerPlan& plan = m_Plans[i];
+        memset(&plan, 0, sizeof(plan));
+        plan.count = AMF_MIN(AMF_MAX(corner.count, 0), 4);
+        for (amf_int32 cam = 0; cam < plan.count; cam++)
+        {
+            plan.histOffset[cam] = corner.channel[cam] * 4 * 3 * HIST_SIZE + corner.corner[cam] * 3 * HIST_SIZE;
+        }
+        // each camera against the next one around the corner
+        if (plan.count == 2 || plan.count == 3)
+        {
+            for (amf_int32 side = 0; side < plan.count; side++)
+            {
+                plan.pair[side][0] = side;
+                plan.pair[side][1] = (side + 1) % plan.count;
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void StitchColorBalance::BuildShifts(amf_size corner, amf_int32 col, const amf_int32* pHistograms, const HistogramParameters& params)
+{
+    const CornerPlan& plan = m_Plans[corner];
+    const amf_int32 maxDelay = AMF_MIN(params.maxDistanceBetweenPeaks[col], MAX_DELAY);
+    const amf_int32 delays = maxDelay * 2;
+
+    AMF_ALIGN(16) float centered[4][HIST_SIZE];
+    float sumSq[4];
+    for (amf_int32 cam = 0; cam < plan.count; cam++)
+    {
+        CenterHistogram(pHistograms + plan.histOffset[cam] + col * HIST_SIZE, params, centered[cam], sumSq[cam]);
+    }
+
+    AMF_ALIGN(16) float corrs[MAX_DELAY * 2 + DELAYS_PER_PASS];
+    for (amf_int32 side = 0; side < plan.count; side++)
+    {
+        const amf_int32 h1 = plan.pair[side][0];
+        const amf_int32 h2 = plan.pair[side][1];
+        CrossCorrelate(centered[h1], centered[h2], maxDelay, delays, corrs);
+
+        const float denom = sqrtf(sumSq[h1] * sumSq[h2]);
+        float corrMax = -1.0e5f;
+        for (amf_int32 i = 0; i < delays; i++)
+        {
+            // NaN for an empty histogram, which never wins and leaves the old shift in place
+            const float r = corrs[i] / denom;
+            if (corrMax < r)
+            {
+                corrMax = r;
+                m_Shifts[corner * 3 * 4 + col * 4 + side] = (float)i - maxDelay;
+            }
+        }
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void StitchColorBalance::BuildLUT(amf_size corner, amf_int32 col, float* pLUT, float* pLUTPrev, float* pBrightness,
+    const HistogramParameters& params, amf_int32 frameCount)
+{
+    const Corner& it_corner = m_Corners[corner];
+    const float* pShifts = &m_Shifts[corner * 3 * 4 + col * 4];
+    const amf_int32 count = m_Plans[corner].count;
+
+    float brightness[4] = {0, 0, 0, 0};
+    if (count == 2)
+    {
+        brightness[0] = pShifts[0] / 2.0f;
+        brightness[1] = pShifts[1] / 2.0f;
+    }
+    else if (count == 3)
+    {
+        int shiftMaxIndex = 0;
+        int shiftMinIndex = HIST_SIZE * 2;
+        float shiftMin = 10000.0f;
+        float shiftMax = 0.0f;
+
+        for (int side = 0; side < count; side++)
+        {
+            if (fabs(shiftMin) > fabs(pShifts[side]))
+            {
+                shiftMin = pShifts[side];
+                shiftMinIndex = side;
+            }
+            if (fabs(shiftMax) < fabs(pShifts[side]))
+            {
+                shiftMax = pShifts[side];
+                shiftMaxIndex = side;
+            }
+        }
+        int shiftMinIndexSecond = 0;
+        for (int side = 0; side < count; side++)
+        {
+            if (side != shiftMinIndex && side != shiftMaxIndex)
+            {
+                shiftMinIndexSecond = side;
+                break;
+            }
+        }
+
+        shiftMin = pShifts[shiftMinIndex];
+        float shiftMinSecond = pShifts[shiftMinIndexSecond];
+
+        // split the smallest shift between its pair and give the third camera the rest
+        if (shiftMinIndex == 0)
+        {
+            brightness[0] = shiftMin / 2.0f;
+            brightness[1] = -shiftMin / 2.0f;
+
+            if (shiftMinIndexSecond == 1)
+            {
+                brightness[2] = -shiftMinSecond * 2.0f / 3.0f - shiftMin / 2.0f;
+
+                brightness[0] += shiftMinSecond / 3.0f;
+                brightness[1] += shiftMinSecond / 3.0f;
+            }
+            else
+            {
+                brightness[2] = shiftMinSecond * 2.0f / 3.0f + shiftMin / 2.0f;
+
+                brightness[0] -= shiftMinSecond / 3.0f;
+                brightness[1] -= shiftMinSecond / 3.0f;
+            }
+        }
+        else if (shiftMinIndex == 1)
+        {
+            brightness[1] = shiftMin / 2.0f;
+            brightness[2] = -shiftMin / 2.0f;
+
+            if (shiftMinIndexSecond == 0)
+            {
+                brightness[0] = shiftMinSecond * 2.0f / 3.0f + shiftMin / 2.0f;
+
+                brightness[1] -= shiftMinSecond / 3.0f;
+                brightness[2] -= shiftMinSecond / 3.0f;
+            }
+            else
+            {
+                brightness[0] = -shiftMinSecond * 2.0f / 3.0f - shiftMin / 2.0f;
+
+                brightness[1] += shiftMinSecond / 3.0f;
+                brightness[2] += shiftMinSecond / 3.0f;
+            }
+        }
+        else if (shiftMinIndex == 2)
+        {
+            brightness[2] = shiftMin / 2.0f;
+            brightness[0] = -shiftMin / 2.0f;
+
+            if (shiftMinIndexSecond == 0)
+            {
+                brightness[1] = -shiftMinSecond * 2.0f / 3.0f - shiftMin / 2.0f;
+
+                brightness[2] += shiftMinSecond / 3.0f;
+                brightness[0] += shiftMinSecond / 3.0f;
+            }
+            else // 1
+            {
+                brightness[1] = shiftMinSecond * 2.0f / 3.0f + shiftMin / 2.0f;
+
+                brightness[2] -= shiftMinSecond / 3.0f;
+                brightness[0] -= shiftMinSecond / 3.0f;
+            }
+        }
+    }
+
+    for (amf_int32 i = 0; i < count; i++)
+    {
+        const amf_size offset = it_corner.channel[i] * 3 * 5 * HIST_SIZE + it_corner.corner[i] * 3 * HIST_SIZE + col * HIST_SIZE;
+        BuildOneLUT(col, brightness[i] / 255.f, pLUT + offset, pLUTPrev + offset, params, frameCount);
+        pBrightness[it_corner.channel[i] * 4 * 3 + it_corner.corner[i] * 3 + col] = brightness[i];
+    }
+}
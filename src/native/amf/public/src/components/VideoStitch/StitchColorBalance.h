@@ -0,0 +1,144 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "public/include/core/Platform.h"
+#include "public/common/AMFSTL.h"
+#include <vector>
+
+#define HIST_SIZE   256
+#define LUT_CURVE_TABLE_SIZE    20
+
+namespace amf
+{
+    class AMFWorkStealingPool;
+
+#pragma pack(push, 1)
+    struct Rib
+    {
+        amf_int32 channel1;
+        amf_int32 side1;        // 0 - left, 1, top, 2 - right, 3 - bottom
+        amf_int32 channel2;
+        amf_int32 side2;        // 0 - left, 1, top, 2 - right, 3 - bottom
+        amf_int32 index;
+    };
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+    struct Corner
+    {
+        amf_int32 count;
+        amf_int32 align1[3];
+        amf_int32 channel[4];
+        amf_int32 corner[4];    // 0 - lt, 1 - rt, 2 - rb, 3 - lb
+        amf_int32 index;
+        float     pos[3];
+    };
+#pragma pack(pop)
+
+    typedef std::vector<Rib> RibList;
+    typedef std::vector<Corner> CornerList;
+
+#pragma pack(push, 1)
+    // Shared with the Histogram kernels, keep the layout in sync with Histogram.cl.
+    struct HistogramParameters
+    {
+        amf_int32 maxDistanceBetweenPeaks[3];
+        amf_int32 whiteCutOffY;
+        amf_int32 blackCutOffY;
+        amf_int32 borderHistWidth; //TODO make image size - dependent
+        float   alphaLUT;
+        float   lutCurveTable[LUT_CURVE_TABLE_SIZE]; // curve from 0 to 1
+        amf_int32 align1;
+    };
+#pragma pack(pop)
+
+    //---------------------------------------------------------------------------------------------
+    // The CPU version of the Histogram kernels. Buffers use the kernel layouts:
+    //   histograms  [channel][side 0..3][color 0..2][HIST_SIZE] amf_int32
+    //   LUTs        [channel][side 0..3, center][color 0..2][HIST_SIZE] float
+    //   brightness  [channel][side 0..3][color 0..2] float
+    //
+    // Adjust finds, for every corner and color, the histogram shift between each pair of cameras
+    // meeting there and spreads it over the cameras as brightness offsets. Everything that only
+    // depends on the corner list is planned once and reused until the list changes, and the
+    // centered histograms are computed once per frame instead of once per tried shift. Shifts are
+    // tried sixteen at a time (SSE2 on x86, NEON on ARM64) in the same summation order as the
+    // scalar code, so the result doesn't depend on the instruction set.
+    class StitchColorBalance
+    {
+    public:
+        StitchColorBalance();
+
+        // Adds the border pixels of one NV12 frame to the histograms of channel, like
+        // StitchHistogramMapNV12. pMap has one byte per 8x8 luma block, bits 0-3 marking the
+        // left, top, right and bottom borders.
+        static void AccumulateNV12(amf_int32* pHistograms, amf_int32 channel,
+            const amf_uint8* pY, amf_int32 pitchY, const amf_uint8* pUV, amf_int32 pitchUV,
+            amf_int32 width, amf_int32 height,
+            const amf_uint8* pMap, amf_int32 pitchMap, amf_int32 widthMap, amf_int32 heightMap);
+
+        // One HIST_SIZE entry LUT for color col offset by brightness, blended into prev (if not
+        // NULL) from the second frame on.
+        static void BuildOneLUT(amf_int32 col, float brightness, float* pLUT, float* pPrev,
+            const HistogramParameters& params, amf_int32 frameCount);
+
+        // The BuildShifts, BuildLUT and BuildLUTCenter kernels in one go. pPool may be NULL to
+        // run on the calling thread.
+        void Adjust(const CornerList& corners, amf_int32 channels, const amf_int32* pHistograms,
+            float* pLUT, float* pLUTPrev, float* pBrightness,
+            const HistogramParameters& params, amf_int32 frameCount, AMFWorkStealingPool* pPool);
+
+    private:
+        class ShiftTask;
+
+        // Camera pairs compared at a corner, as indices into Corner::channel.
+        struct CornerPlan
+        {
+            amf_int32   count;
+            amf_int32   histOffset[4];  // of color 0 in the histograms
+            amf_int32   pair[4][2];
+        };
+
+        void Plan(const CornerList& corners);
+        // Finds the shifts of one corner and color.
+        void BuildShifts(amf_size corner, amf_int32 col, const amf_int32* pHistograms, const HistogramParameters& params);
+        void BuildLUT(amf_size corner, amf_int32 col, float* pLUT, float* pLUTPrev, float* pBrightness,
+            const HistogramParameters& params, amf_int32 frameCount);
+
+        amf_vector<Corner>      m_Corners;
+        amf_vector<CornerPlan>  m_Plans;
+        // [corner][color][side 0..3]. Kept across frames: a pair without any valid shift keeps the
+        // previous one, like the kernel's buffer does.
+        amf_vector<float>       m_Shifts;
+    };
+} // namespace amf
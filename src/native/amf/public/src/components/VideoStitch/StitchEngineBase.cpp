@@ -30,6 +30,8 @@
 // THE SOFTWARE.
 
 #include "StitchEngineBase.h"
+#include "StitchMesh.h"
+#include "public/common/WorkStealingPool.h"
 #include <DirectXMath.h>
 #include <math.h>
 
@@ -37,23 +39,21 @@ using namespace amf;
 using namespace DirectX;
 
 #define AMF_FACILITY L"StitchEngineBase"
-static XMVECTOR CorrectLensCircularFishEye(XMVECTOR src, double hfov, double f, double kz, float &transparency);
-static XMVECTOR CorrectLensRadial(XMVECTOR src, double a, double b, double c);
-static XMVECTOR CorrectLensRadialInverse(XMVECTOR src, double a, double b, double c);
-static float CalcTransparencyTex(float posx, float posy, bool bFullImage, float zoom_z);
 static XMVECTOR CartesianToEquirectangular(XMVECTOR src);
 
 //-------------------------------------------------------------------------------------------------
 StitchEngineBase::StitchEngineBase(AMFContext* pContext) :
 m_pContext(pContext),
 m_iWidthTriangle(128),
-m_iHeightTriangle(128)
+m_iHeightTriangle(128),
+m_pMeshPool(NULL)
 {
 }
 
 //-------------------------------------------------------------------------------------------------
 StitchEngineBase::~StitchEngineBase()
 {
+    delete m_pMeshPool;
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -74,314 +74,67 @@ AMF_RESULT AMF_STD_CALL StitchEngineBase::PrepareMesh(
     AMFSurface **ppBorderMap
     )
 {
-    vertices.clear();
-    verticesRowSize.clear();
-
-    AMF_RESULT res = AMF_OK;
+    static_assert(sizeof(TextureVertex) == sizeof(StitchMeshVertex), "StitchMeshVertex must match TextureVertex");
 
     // get parameters
-    amf_int32 streamCount=0;
-    pStorageMain->GetProperty(AMF_VIDEO_STITCH_INPUTCOUNT, &streamCount);
-
-    double lensCorrK1 = 0.0;
-    res = pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_K1, &lensCorrK1);
-    double lensCorrK2 = 0.0;
-    res = pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_K2, &lensCorrK2);
-    double lensCorrK3 = 0.0;
-    res = pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_K3, &lensCorrK3);
-    double lensCorrOffX = 0.0;
-    res = pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_OFFX, &lensCorrOffX);
-    double lensCorrOffY = 0.0;
-    res = pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_OFFY, &lensCorrOffY);
-    double offset_x = 0;
-    double offset_y = 0;
-    double offset_z = 0;
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_OFFSET_X, &offset_x);
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_OFFSET_Y, &offset_y);
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_SCALE, &offset_z);
-
-    amf_int64 lensCorrectionMode = AMF_VIDEO_STITCH_LENS_RECTILINEAR;
-    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_MODE, &lensCorrectionMode);
-
-    AMFRect crop = {};
-    res = pStorage->GetProperty(AMF_VIDEO_STITCH_CROP, &crop);
-    amf_int32 widthInputOrg  = widthInput;
-    amf_int32 heightInputOrg = heightInput; 
-
-    double crop_offset_x = 0;
-    double crop_offset_y = 0;
-
-    if(crop.Width() > 0 && crop.Height() > 0)
-    {
-        crop_offset_x = 0;
-        crop_offset_y = 0;
-        widthInput = crop.Width();
-        heightInput = crop.Height();
-    }
-
-    offset_x /= widthInputOrg / 2.0;
-    offset_y /= heightInputOrg / 2.0;
-
-    crop_offset_x /= widthInputOrg / 2.0;
-    crop_offset_y /= heightInputOrg / 2.0;
-
-    double pitch = 0.0; 
-    double yaw = 0.0; 
-    double roll = 0.0;
-
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_ANGLE_PITCH, &pitch);
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_ANGLE_YAW, &yaw);
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_ANGLE_ROLL, &roll);
-
-    double hfov = M_PI / 2.0;
-    pStorage->GetProperty(AMF_VIDEO_CAMERA_HFOV, &hfov);
-    
-    if(lensCorrectionMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR)
+    StitchMeshParams params;
+    params.widthInput = widthInput;
+    params.heightInput = heightInput;
+    params.widthOutput = widthOutput;
+    params.heightOutput = heightOutput;
+    params.widthTriangle = m_iWidthTriangle;
+    params.heightTriangle = m_iHeightTriangle;
+
+    pStorageMain->GetProperty(AMF_VIDEO_STITCH_INPUTCOUNT, &params.streamCount);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_K1, &params.lensCorrK1);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_K2, &params.lensCorrK2);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_K3, &params.lensCorrK3);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_OFFX, &params.lensCorrOffX);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_CORR_OFFY, &params.lensCorrOffY);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_OFFSET_X, &params.offsetX);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_OFFSET_Y, &params.offsetY);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_SCALE, &params.scale);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_LENS_MODE, &params.lensMode);
+    pStorage->GetProperty(AMF_VIDEO_STITCH_CROP, &params.crop);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_ANGLE_PITCH, &params.pitch);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_ANGLE_YAW, &params.yaw);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_ANGLE_ROLL, &params.roll);
+    pStorage->GetProperty(AMF_VIDEO_CAMERA_HFOV, &params.hfov);
+
+    if(m_pMeshPool == NULL)
     {
-        offset_z = 1.0 / tan(hfov / 2.0);
+        m_pMeshPool = new AMFWorkStealingPool();
     }
 
-    offset_z = 1.0 - ((double)widthInput/ heightInput) * offset_z;
+    StitchMesh mesh;
+    StitchMeshBuilder::Build(params, mesh, m_pMeshPool);
 
-    double zoom1 = 1.02;
-    double fishEyeZoom = 1.0;
-    switch(lensCorrectionMode)
+    vertices.resize(mesh.vertices.size());
+    if(!vertices.empty())
     {
-    case AMF_VIDEO_STITCH_LENS_RECTILINEAR:
-        lensCorrOffX /= widthInputOrg / 2.0;
-        lensCorrOffY /= heightInputOrg / 2.0;
-        break;
-    case AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME:
-        fishEyeZoom = 2.0;
-        lensCorrOffX /= widthInputOrg / 2.0;
-        lensCorrOffY /= heightInputOrg / 2.0;
-        offset_z *= 1.11;
-        break;
-    case AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR:
-        fishEyeZoom = 2.0;
-        lensCorrOffX /= widthInputOrg / 2.0;
-        lensCorrOffY /= widthInputOrg / 2.0;
-        break;
+        memcpy(&vertices[0], &mesh.vertices[0], vertices.size() * sizeof(TextureVertex));
     }
+    verticesRowSize.assign(mesh.verticesRowSize.begin(), mesh.verticesRowSize.end());
 
-    //---------------------------------------------------------------------------------------------
-    // square texture 
-    //---------------------------------------------------------------------------------------------
-
-    float tex_l = 0.0f;
-    float tex_t = 0.0f;
-    float tex_w = 1.0f;
-    float tex_h = 1.0f;
-
-    float w = 2.0f;
-    float h = 2.0f;
-    float d = 2.0f;
-
-    float l = -1.0f;
-    float t = -1.0f;
-    float f = -1.0f;
-    float r = 1.0f;
-    float b = 1.0f;
-    float e = 1.0f;
-
-    if(crop.Width() > 0 && crop.Height() > 0)
-    {
-        tex_l = (float)crop.left / widthInputOrg;
-        tex_t = (float)crop.top / heightInputOrg;
-
-        tex_w = (float)crop.Width() / widthInputOrg;
-        tex_h = (float)crop.Height() / heightInputOrg;
-    }
+    borderRect = mesh.borderRect;
+    texRect = XMVectorSet(mesh.texRect.v[0], mesh.texRect.v[1], mesh.texRect.v[2], mesh.texRect.v[3]);
+    plane = XMVectorSet(mesh.plane.v[0], mesh.plane.v[1], mesh.plane.v[2], mesh.plane.v[3]);
+    planeCenter = XMVectorSet(mesh.planeCenter.v[0], mesh.planeCenter.v[1], mesh.planeCenter.v[2], mesh.planeCenter.v[3]);
 
-    double aspectX = 1.0f;
-    double aspectY = 1.0f;
-    if(widthInput > heightInput)
-    {
-        aspectX = (float)widthInput / heightInput;
-    }
-    else
+    // sides and corners are only filled in for 2, 4 and 6 camera rigs
+    if(!mesh.corners.empty())
     {
-        aspectY = (float)heightInput / widthInput;
-    }
-
-    //---------------------------------------------------------------------------------------------
-    // Create and set vertex buffer
-    //---------------------------------------------------------------------------------------------
-    XMMATRIX orientation = XMMatrixRotationRollPitchYaw((float)pitch, (float)yaw, (float)roll);
-    XMMATRIX orientationRollPitch = XMMatrixRotationRollPitchYaw((float)pitch, (float)0, (float)roll);
-    XMMATRIX orientationYaw = XMMatrixRotationRollPitchYaw((float)0, (float)yaw, (float)0);
-    XMMATRIX textureReverse = XMMatrixRotationRollPitchYaw((float)0, (float)0, (float)M_PI);
-    XMMATRIX aspect = XMMatrixScaling((float)aspectX , (float)aspectY , 1.0f);
-    XMMATRIX aspectInv = XMMatrixScaling(1.0f/(float)aspectX , 1.0f/(float)aspectY , 1.0f);
-    XMMATRIX translation = XMMatrixTranslation((float)lensCorrOffX, (float)lensCorrOffY, 0);
-    XMMATRIX zoom = XMMatrixTranslation(0, 0, (float)offset_z);
-    XMMATRIX crop_translation = XMMatrixTranslation((float)crop_offset_x, (float)crop_offset_y, 0);
-    
-    // normalized rect
-    double leftB = -1.0;
-    double topB = -1.0;
-    double rightB = 1.0;
-    double bottomB = 1.0;
-
-    // scale
-    leftB /= aspectX;
-    topB /= aspectY;
-    rightB /= aspectX;
-    bottomB /= aspectY;
-
-    // translate XY
-    leftB -= lensCorrOffX;
-    topB -= lensCorrOffY;
-    rightB -= lensCorrOffX;
-    bottomB -= lensCorrOffY;
-
-    // fill DirectX::XMVECTOR* corners
-    switch(streamCount)
-    {
-     case 2:
-     case 4:
-     case 6:
-         corners.resize(4);
-         corners[0] = XMVectorSet( 1.0f, 1.0f, -1.0f, 0.0f); //lt
-         corners[1] = XMVectorSet( -1.0f, 1.0f, -1.0f, 0.0f); //rt
-         corners[2] = XMVectorSet( -1.0f,  -1.0f, -1.0f, 0.0f); //rb
-         corners[3] = XMVectorSet( 1.0f,  -1.0f, -1.0f, 0.0f); //lb
-
-         corners[0] = XMVector3Transform(corners[0], orientation);
-         corners[1] = XMVector3Transform(corners[1], orientation);
-         corners[2] = XMVector3Transform(corners[2], orientation);
-         corners[3] = XMVector3Transform(corners[3], orientation);
-
-         // fill DirectX::XMVECTOR* center of sides
-         sides.resize(4);
-         sides[0] = XMVectorSet( 1.0f,  0.0f, -1.0f, 0.0f); //right
-         sides[1] = XMVectorSet( 0.0f,  1.0f, -1.0f, 0.0f); //bottom
-         sides[2] = XMVectorSet(-1.0f,  0.0f, -1.0f, 0.0f); //left
-         sides[3] = XMVectorSet( 0.0f, -1.0f, -1.0f, 0.0f); //top
-
-         sides[0] = XMVector3Transform(sides[0], orientation);
-         sides[1] = XMVector3Transform(sides[1], orientation);
-         sides[2] = XMVector3Transform(sides[2], orientation);
-         sides[3] = XMVector3Transform(sides[3], orientation);
-
-         break;
-    }
-
-    // scale based on Z
-    leftB /= 1.0 + offset_z;
-    topB /= 1.0 + offset_z;
-    rightB /= 1.0 + offset_z;
-    bottomB /= 1.0 + offset_z;
-
-    // back to image
-    texRect = XMVectorSet(float( (leftB + 1.0) / 2.0),  float((topB + 1.0) / 2.0), float((rightB + 1.0) / 2.0), float((bottomB + 1.0) / 2.0));
-    borderRect.left = amf_int32((leftB + 1.0) / 2.0  * widthInput);
-    borderRect.top = amf_int32((topB + 1.0) / 2.0 * heightInput);
-    borderRect.right = amf_int32((rightB + 1.0) / 2.0 * widthInput);
-    borderRect.bottom = amf_int32((bottomB + 1.0) / 2.0 * heightInput);
-
-    // define camera plane
-    XMVECTOR point1 = XMVectorSet( -1.0f, -1.0f, -1.0f, 0.0f);
-    XMVECTOR point2 = XMVectorSet( 1.0f,  0.0f, -1.0f, 0.0f);
-    XMVECTOR point3 = XMVectorSet( 1.0f,  1.0f, -1.0f, 0.0f);
-
-    point1 = XMVector3Transform(point1, textureReverse);
-    point1 = XMVector3Transform(point1, aspect);
-    point1 = XMVector3Transform(point1, translation); 
-    point1 = XMVector3Transform(point1, zoom); 
-    point1 = XMVector3Transform(point1, orientation); 
-
-    point2 = XMVector3Transform(point2, textureReverse);
-    point2 = XMVector3Transform(point2, aspect);
-    point2 = XMVector3Transform(point2, translation); 
-    point2 = XMVector3Transform(point2, zoom); 
-    point2 = XMVector3Transform(point2, orientation); 
-
-    point3 = XMVector3Transform(point3, textureReverse);
-    point3 = XMVector3Transform(point3, aspect);
-    point3 = XMVector3Transform(point3, translation); 
-    point3 = XMVector3Transform(point3, zoom); 
-    point3 = XMVector3Transform(point3, orientation); 
-
-    plane = XMPlaneFromPoints(point1, point2, point3);
-
-    planeCenter = XMVectorSet( 0.0f, 0.0f, -1.0f, 0.0f);
-    planeCenter = XMVector3Transform(planeCenter, textureReverse);
-    planeCenter = XMVector3Transform(planeCenter, aspect);
-    planeCenter = XMVector3Transform(planeCenter, translation); 
-    planeCenter = XMVector3Transform(planeCenter, zoom); 
-    planeCenter = XMVector3Transform(planeCenter, orientation); 
-
-
-    float radiusCircular = 0;
-    if(widthInput > heightInput)
-    {
-        radiusCircular = tex_w / 2.0f;
-    }
-    else
-    {
-        radiusCircular = tex_h / 2.0f;
-    }
-    radiusCircular*=1.2f;
-
-    for(int y = 0; y <= m_iHeightTriangle; y++)
-    {
-        int countInRow = 0;
-        for(int x = 0; x <= m_iWidthTriangle; x++)
+        corners.resize(mesh.corners.size());
+        for(size_t i = 0; i < mesh.corners.size(); i++)
         {
-            TextureVertex v;
-            float posx = l + (float) x / m_iWidthTriangle * w;
-            float posy = t +(float) y / m_iHeightTriangle * h;
-            float posz = f;
-
-            v.Tex[0] = (tex_l + ((float) x / m_iWidthTriangle) * tex_w);
-            v.Tex[1] = (tex_t + ((float) y / m_iHeightTriangle) * tex_h);
-
-            if(v.Tex[0] < 0 || v.Tex[1] < 0 || v.Tex[0] > 1.0f || v.Tex[1] > 1.0f)
-            {
-                continue;
-            }
-
-          v.Tex[2] = CalcTransparencyTex(v.Tex[0], v.Tex[1], true, 1.0f);
-          XMVECTOR vec= XMVectorSet(posx, posy, posz, 0.0f);
-
-          vec = XMVector3Transform(vec, textureReverse);
-          vec = XMVector3Transform(vec, crop_translation); 
-          vec = XMVector3Transform(vec, translation); 
-          vec = XMVector3Transform(vec, aspect);
-
-          switch(lensCorrectionMode)
-          {
-          case AMF_VIDEO_STITCH_LENS_RECTILINEAR:
-              vec = CorrectLensRadial(vec, lensCorrK1, lensCorrK2, lensCorrK3);
-              break;
-          case AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME:
-              vec = CorrectLensRadialInverse(vec, lensCorrK1, lensCorrK2, lensCorrK3);
-              vec = CorrectLensCircularFishEye(vec, hfov, 1.0, 1.0, v.Tex[2]);
-              break;
-          case AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR:
-              vec = CorrectLensRadialInverse(vec, lensCorrK1, lensCorrK2, lensCorrK3);
-              vec = CorrectLensCircularFishEye(vec, hfov, 1.0, 1.0, v.Tex[2]);
-              break;
-          default:
-              break;
-          }
-
-          vec = XMVector3Transform(vec, zoom); 
-          vec = XMVector3Transform(vec, orientation);
-          v.Pos[0] = XMVectorGetX(vec);
-          v.Pos[1] = XMVectorGetY(vec);
-          v.Pos[2] = XMVectorGetZ(vec);
-          vertices.push_back(v);
-          countInRow++;
+            corners[i] = XMVectorSet(mesh.corners[i].v[0], mesh.corners[i].v[1], mesh.corners[i].v[2], mesh.corners[i].v[3]);
         }
-
-        if(countInRow > 0)
+        sides.resize(mesh.sides.size());
+        for(size_t i = 0; i < mesh.sides.size(); i++)
         {
-            verticesRowSize.push_back(countInRow);
+            sides[i] = XMVectorSet(mesh.sides[i].v[0], mesh.sides[i].v[1], mesh.sides[i].v[2], mesh.sides[i].v[3]);
         }
     }
-
     return AMF_OK;
 }
 
@@ -475,24 +228,6 @@ AMF_RESULT AMF_STD_CALL StitchEngineBase::GetTransform(amf_int32 widthInput, amf
     return AMF_OK;
 }
 
-//-------------------------------------------------------------------------------------------------
-static XMVECTOR CorrectLensRadial(XMVECTOR src, double a, double b, double c)
-{
-    double d = 1.0 - a - b - c; //balanced scale
-    double x = XMVectorGetX(src);
-    double y = XMVectorGetY(src);
-    double r2 = (x*x) + (y*y);
-    double r1 = sqrt(r2);
-    double r3 = r2 * r1;
-    double cDist = d + a * r3 + b * r2 + c * r1;
-    double xd = x * cDist;
-    double yd = y * cDist;
-    double ud = xd;
-    double vd = yd;
-    XMVECTOR dst = XMVectorSet((float)ud, (float)vd, XMVectorGetZ(src), XMVectorGetW(src));
-    return dst;
-}
-
 static void matrix_inv_mult( double m[3][3], double vector[3] )
 {
     register int i;
@@ -547,80 +282,6 @@ static void SetMatrix( double a, double b, double c , double m[3][3], int cl )
     matrix_matrix_mult( dummy, my, m);
 }
 
-static XMVECTOR CorrectLensCircularFishEye(XMVECTOR src , double hfov, double f , double kz, float &transparency)
-{
-    double x = XMVectorGetX(src);
-    double y = XMVectorGetY(src);
-    double z = XMVectorGetZ(src);
-
-    if( fabs(x - 1.0) < 0.001 && fabs(y - 0.0) < 0.001)
-    {
-        int a = 1;
-    }
-    if( fabs(x - 0.0) < 0.001 && fabs(y - 1.0) < 0.001)
-    {
-        int a = 1;
-    }
-
-    double fov2 = hfov / 2.0;
-    double pheta = atan2(y , x);
-
-    double r = sqrt(x * x + y * y) ;
-    double theta = r / f * fov2; // equidistance projection
-
-    double new_r = 1.0;
-    double new_x = 0;
-    double new_y = 0;
-    double new_z = -new_r * cos(theta);
-    
-    if(fabs(theta) > M_PI / 2.0)
-    {
-        transparency = 0.0f;
-        new_x = new_r * sin(theta) * cos(pheta);
-        new_y = new_r * sin(theta) * sin(pheta);
-    }
-    else
-    {
-        transparency = 1.0f;
-        new_x = new_r * sin(theta) * cos(pheta);
-        new_y = new_r * sin(theta) * sin(pheta);
-    }
-
-    XMVECTOR dst = XMVectorSet((float)new_x, (float)new_y, (float)new_z, XMVectorGetW(src));
-    return dst;
-}
-
-//-------------------------------------------------------------------------------------------------
-static XMVECTOR CorrectLensRadialInverse(XMVECTOR src, double a, double b, double c)
-{
-    double d = 1.0 - a - b - c; //balanced scale
-    double x = XMVectorGetX(src) ;
-    double y = XMVectorGetY(src) ;
-    double r2 = (x*x) + (y*y);
-    double r1 = sqrt(r2);
-    double rd = r1;
-    double rs = rd;
-    double f = (((a * rs + b) * rs + c) * rs + d) * rs;
-
-#define MAXITER 100
-#define R_EPS 1.0e-6
-
-    int iter = 0;
-    while( std::abs(f - rd) > R_EPS && iter++ < MAXITER )
-    {
-        rs = rs - (f - rd) / ((( 4 * a * rs + 3 * b) * rs  + 2 * c) * rs + 1 * d);
-        f = (((a * rs + b) * rs + c) * rs + d) * rs;
-    }
-
-    double scale = rd == 0.0  || iter >= MAXITER  ? 1.0 : rs / rd;
-    double xd = x * scale;
-    double yd = y * scale;
-    double ud = xd;
-    double vd = yd;
-    XMVECTOR dst = XMVectorSet((float)ud, (float)vd, XMVectorGetZ(src), XMVectorGetW(src));
-    return dst;
-}
-
 double my_round(double x)
 {
     return (int)x;
@@ -646,113 +307,22 @@ double cubicroot(double num )
 
 DirectX::XMVECTOR StitchEngineBase::CartesianToSpherical(DirectX::XMVECTOR src)
 {
-    double x = XMVectorGetX(src);
-    double y = XMVectorGetY(src);
-    double z = XMVectorGetZ(src);
-    double r = sqrt(x *x + y * y + z * z);
-    double theta = acos(z / r); // elevation
-    double pheta = atan2(y, x); //azimuth
-    XMVECTOR dst = XMVectorSet((float)theta, (float)pheta, (float)r, XMVectorGetW(src));
-    return dst;
+    float pos[3] = { XMVectorGetX(src), XMVectorGetY(src), XMVectorGetZ(src) };
+    float dst[3];
+    StitchMeshBuilder::CartesianToSpherical(pos, dst);
+    return XMVectorSet(dst[0], dst[1], dst[2], XMVectorGetW(src));
 }
 
 XMVECTOR StitchEngineBase::MakeSphere(XMVECTOR src, float centerX,float centerY,float centerZ, float newRadius)
 {
-    double x = XMVectorGetX(src) - centerX;
-    double y = XMVectorGetY(src) - centerY;
-    double z = XMVectorGetZ(src) - centerZ;
-    double r = sqrt(x *x + y * y + z * z);
-    double theta = acos(z / r); // elevation
-    double pheta = atan2(y, x); //azimuth
-    double new_r = newRadius;
-    double new_x = new_r * sin(theta) * cos(pheta);
-    double new_y = new_r * sin(theta) * sin(pheta);
-    double new_z = new_r * cos(theta);
-    XMVECTOR dst = XMVectorSet((float)new_x + centerX, (float)new_y + centerY, (float)new_z + centerZ, XMVectorGetW(src));
-    return dst;
+    float pos[3] = { XMVectorGetX(src), XMVectorGetY(src), XMVectorGetZ(src) };
+    StitchMeshBuilder::MakeSphere(pos, centerX, centerY, centerZ, newRadius);
+    return XMVectorSet(pos[0], pos[1], pos[2], XMVectorGetW(src));
 }
 
 void StitchEngineBase::MakeSphere(TextureVertex &v, float centerX,float centerY,float centerZ, float newRadius)
 {
-    double x = v.Pos[0] - centerX;
-    double y = v.Pos[1] - centerY;
-    double z = v.Pos[2] - centerZ;
-    double r = sqrt(x *x + y * y + z * z);
-    double theta = acos(z / r); // elevation
-    double pheta = atan2(y, x); //azimuth
-    double new_r = newRadius;
-    double new_x = new_r * sin(theta) * cos(pheta);
-    double new_y = new_r * sin(theta) * sin(pheta);
-    double new_z = new_r * cos(theta);
-
-    v.Pos[0] = (float)new_x + centerX;
-    v.Pos[1] = (float)new_y + centerY;
-    v.Pos[2] = (float)new_z + centerZ;
-}
-
-//-------------------------------------------------------------------------------------------------
-float CalcTransparencyTex(float posx, float posy, bool bFullImage, float zoom_z)
-{
-    float transparency = 0.01f;
-    float transparencyBorder = 1.0f;
-
-#if defined(DEBUG_TRANSPARENT)
-    float transparencyMax = 0.3f;
-    float transparencyMin = 0.3f;
-#else
-    float transparencyMax = 1.0f;
-    float transparencyMin = 0.0f;
-#endif
-
-     transparencyBorder /= zoom_z;
-     float transparencyVertex = transparencyMax;
-
-     if(posx < 0 || posx > transparencyBorder )
-     {
-         transparencyVertex *= transparencyMin;
-     } 
-     else if(posx < 0 + transparency)
-     {
-         float x0 = transparency;
-         float x1 = 0;
-         float y0 = transparencyMax;
-         float y1 = transparencyMin;
-         float val = y0 + (y1 - y0) * (posx - x0) / (x1 - x0);
-         transparencyVertex *= val;
-     }
-     else if(posx > transparencyBorder - transparency)
-     {
-         float x0 = transparencyBorder - transparency;
-         float x1 = transparencyBorder;
-         float y0 = transparencyMax;
-         float y1 = transparencyMin;
-         float val = y0 + (y1 - y0) * (posx - x0) / (x1 - x0);
-         transparencyVertex *= val;
-     }
-
-     if(posy < 0 || posy > transparencyBorder )
-     {
-         transparencyVertex = transparencyMin;
-     } 
-     else if(posy < 0 + transparency)
-     {
-         float x0 = transparency;
-         float x1 = 0;
-         float y0 = transparencyMax;
-         float y1 = transparencyMin;
-         float val = y0 + (y1 - y0) * (posy - x0) / (x1 - x0);
-         transparencyVertex *= val;
-     }
-     else if(posy > transparencyBorder - transparency)
-     {
-         float x0 = transparencyBorder - transparency;
-         float x1 = transparencyBorder;
-         float y0 = transparencyMax;
-         float y1 = transparencyMin;
-         float val = y0 + (y1 - y0) * (posy - x0) / (x1 - x0);
-         transparencyVertex *= val;
-     }
-     return transparencyVertex;
+    StitchMeshBuilder::MakeSphere(v.Pos, centerX, centerY, centerZ, newRadius);
 }
 
 //-------------------------------------------------------------------------------------------------
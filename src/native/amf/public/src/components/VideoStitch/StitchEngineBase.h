@@ -42,6 +42,7 @@
 //#define DEBUG_TRANSPARENT
 namespace amf
 {
+class AMFWorkStealingPool;
 
 class StitchEngineBase : public AMFInterfaceImpl<AMFInterface>
 {
@@ -136,6 +137,7 @@ protected:
 
     amf_int32 m_iWidthTriangle;
     amf_int32 m_iHeightTriangle;
+    AMFWorkStealingPool* m_pMeshPool;   // generates mesh rows, created on first use
 };
     typedef AMFInterfacePtr_T<StitchEngineBase> StitchEngineBasePtr;
 } // namespace amf
\ No newline at end of file
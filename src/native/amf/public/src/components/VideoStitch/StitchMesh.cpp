@@ -0,0 +1,753 @@
+﻿// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "StitchMesh.h"
+#include "public/include/components/VideoStitch.h"
+#include "public/common/Thread.h"
+#include "public/common/WorkStealingPool.h"
+#include <math.h>
+#include <string.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define STITCH_MESH_SSE 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define STITCH_MESH_NEON 1
+#endif
+
+using namespace amf;
+
+#define AMF_FACILITY L"StitchMesh"
+
+// rows generated by one pool task
+#define ROWS_PER_BAND       8
+// a 128x128 mesh is about 460KB
+#define MAX_CACHED_MESHES   32
+
+#define STITCH_MESH_PI 3.14159265358979323846
+
+namespace
+{
+    //-------------------------------------------------------------------------------------------------
+    // Row vector matrix with the DirectXMath conventions: v' = v * M, translation in the last row.
+    struct Matrix
+    {
+        float m[4][4];
+    };
+    //-------------------------------------------------------------------------------------------------
+    Matrix Identity()
+    {
+        Matrix r = {};
+        r.m[0][0] = r.m[1][1] = r.m[2][2] = r.m[3][3] = 1.0f;
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    Matrix Multiply(const Matrix& a, const Matrix& b)
+    {
+        Matrix r;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+            }
+        }
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    Matrix Scaling(float x, float y, float z)
+    {
+        Matrix r = Identity();
+        r.m[0][0] = x;
+        r.m[1][1] = y;
+        r.m[2][2] = z;
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    Matrix Translation(float x, float y, float z)
+    {
+        Matrix r = Identity();
+        r.m[3][0] = x;
+        r.m[3][1] = y;
+        r.m[3][2] = z;
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    // XMMatrixRotationRollPitchYaw: roll around Z, then pitch around X, then yaw around Y.
+    Matrix RotationRollPitchYaw(float pitch, float yaw, float roll)
+    {
+        const float cp = cosf(pitch);
+        const float sp = sinf(pitch);
+        const float cy = cosf(yaw);
+        const float sy = sinf(yaw);
+        const float cr = cosf(roll);
+        const float sr = sinf(roll);
+
+        Matrix r = Identity();
+        r.m[0][0] = cr * cy + sr * sp * sy;
+        r.m[0][1] = sr * cp;
+        r.m[0][2] = sr * sp * cy - cr * sy;
+        r.m[1][0] = cr * sp * sy - sr * cy;
+        r.m[1][1] = cr * cp;
+        r.m[1][2] = sr * sy + cr * sp * cy;
+        r.m[2][0] = cp * sy;
+        r.m[2][1] = -sp;
+        r.m[2][2] = cp * cy;
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    // XMVector3Transform: (x, y, z, 1) * M.
+    StitchMeshVector Transform(const Matrix& m, float x, float y, float z)
+    {
+        StitchMeshVector r;
+        for (int i = 0; i < 4; i++)
+        {
+            r.v[i] = x * m.m[0][i] + y * m.m[1][i] + z * m.m[2][i] + m.m[3][i];
+        }
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    StitchMeshVector MakeVector(float x, float y, float z, float w)
+    {
+        StitchMeshVector r = {{x, y, z, w}};
+        return r;
+    }
+    //-------------------------------------------------------------------------------------------------
+    // XMPlaneFromPoints
+    StitchMeshVector PlaneFromPoints(const StitchMeshVector& p1, const StitchMeshVector& p2, const StitchMeshVector& p3)
+    {
+        const float ax = p1.v[0] - p2.v[0], ay = p1.v[1] - p2.v[1], az = p1.v[2] - p2.v[2];
+        const float bx = p1.v[0] - p3.v[0], by = p1.v[1] - p3.v[1], bz = p1.v[2] - p3.v[2];
+        float nx = ay * bz - az * by;
+        float ny = az * bx - ax * bz;
+        float nz = ax * by - ay * bx;
+        const float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        if (length > 0.0f)
+        {
+            nx /= length;
+            ny /= length;
+            nz /= length;
+        }
+        return MakeVector(nx, ny, nz, -(nx * p1.v[0] + ny * p1.v[1] + nz * p1.v[2]));
+    }
+    //-------------------------------------------------------------------------------------------------
+    // Radial distortion with a balanced scale, d = 1 - a - b - c.
+    void CorrectLensRadial(float& x, float& y, double a, double b, double c)
+    {
+        const double d = 1.0 - a - b - c;
+        const double r2 = (double)x * x + (double)y * y;
+        const double r1 = sqrt(r2);
+        const double r3 = r2 * r1;
+        const double cDist = d + a * r3 + b * r2 + c * r1;
+        x = (float)(x * cDist);
+        y = (float)(y * cDist);
+    }
+    //-------------------------------------------------------------------------------------------------
+    // Inverts the radial distortion with Newton's method.
+    void CorrectLensRadialInverse(float& x, float& y, double a, double b, double c)
+    {
+        const int maxIter = 100;
+        const double eps = 1.0e-6;
+
+        const double d = 1.0 - a - b - c;
+        const double rd = sqrt((double)x * x + (double)y * y);
+        double rs = rd;
+        double f = (((a * rs + b) * rs + c) * rs + d) * rs;
+
+        int iter = 0;
+        while (fabs(f - rd) > eps && iter++ < maxIter)
+        {
+            rs = rs - (f - rd) / (((4 * a * rs + 3 * b) * rs + 2 * c) * rs + d);
+            f = (((a * rs + b) * rs + c) * rs + d) * rs;
+        }
+
+        const double scale = rd == 0.0 || iter >= maxIter ? 1.0 : rs / rd;
+        x = (float)(x * scale);
+        y = (float)(y * scale);
+    }
+    //-------------------------------------------------------------------------------------------------
+    // Maps the image plane onto the unit sphere with an equidistant fisheye projection. Points
+    // beyond 90 degrees are made transparent.
+    void CorrectLensCircularFishEye(float& x, float& y, float& z, double hfov, double f, float& transparency)
+    {
+        const double r = sqrt((double)x * x + (double)y * y);
+        const double theta = r / f * (hfov / 2.0);
+        // x / r and y / r are the cosine and sine of the azimuth
+        const double scale = r > 0.0 ? sin(theta) / r : 0.0;
+
+        transparency = fabs(theta) > STITCH_MESH_PI / 2.0 ? 0.0f : 1.0f;
+        x = (float)(x * scale);
+        y = (float)(y * scale);
+        z = (float)(-cos(theta));
+    }
+    //-------------------------------------------------------------------------------------------------
+    // Alpha ramp over the outer 1% of the texture.
+    float CalcTransparencyTex(float posx, float posy)
+    {
+        const float transparency = 0.01f;
+        const float transparencyBorder = 1.0f;
+#if defined(DEBUG_TRANSPARENT)
+        const float transparencyMax = 0.3f;
+        const float transparencyMin = 0.3f;
+#else
+        const float transparencyMax = 1.0f;
+        const float transparencyMin = 0.0f;
+#endif
+        float transparencyVertex = transparencyMax;
+
+        if (posx < 0 || posx > transparencyBorder)
+        {
+            transparencyVertex *= transparencyMin;
+        }
+        else if (posx < transparency)
+        {
+            transparencyVertex *= transparencyMax + (transparencyMin - transparencyMax) * (posx - transparency) / (0 - transparency);
+        }
+        else if (posx > transparencyBorder - transparency)
+        {
+            const float x0 = transparencyBorder - transparency;
+            transparencyVertex *= transparencyMax + (transparencyMin - transparencyMax) * (posx - x0) / (transparencyBorder - x0);
+        }
+
+        if (posy < 0 || posy > transparencyBorder)
+        {
+            transparencyVertex = transparencyMin;
+        }
+        else if (posy < transparency)
+        {
+            transparencyVertex *= transparencyMax + (transparencyMin - transparencyMax) * (posy - transparency) / (0 - transparency);
+        }
+        else if (posy > transparencyBorder - transparency)
+        {
+            const float x0 = transparencyBorder - transparency;
+            transparencyVertex *= transparencyMax + (transparencyMin - transparencyMax) * (posy - x0) / (transparencyBorder - x0);
+        }
+        return transparencyVertex;
+    }
+    //-------------------------------------------------------------------------------------------------
+    // What the row generators share. Only the columns and rows whose texture coordinates fall
+    // inside the image make it into the mesh, and which ones do doesn't depend on the other
+    // coordinate, so every kept row has the same vertices and the output can be laid out up front.
+    struct MeshContext
+    {
+        amf_int64           lensMode;
+        double              k1;
+        double              k2;
+        double              k3;
+        double              hfov;
+        // textureReverse, crop_translation, translation and aspect folded together
+        Matrix              pre;
+        // zoom and orientation folded together
+        Matrix              post;
+
+        amf_vector<float>       posX;   // per kept column
+        amf_vector<float>       texX;
+        amf_vector<float>       posY;   // per kept row
+        amf_vector<float>       texY;
+        float                   posZ;
+
+        StitchMeshVertex*       pVertices;
+    };
+    //-------------------------------------------------------------------------------------------------
+    void GenerateVertex(const MeshContext& ctx, float posx, float posy, StitchMeshVertex& v)
+    {
+        StitchMeshVector vec = Transform(ctx.pre, posx, posy, ctx.posZ);
+        float x = vec.v[0];
+        float y = vec.v[1];
+        float z = vec.v[2];
+
+        switch (ctx.lensMode)
+        {
+        case AMF_VIDEO_STITCH_LENS_RECTILINEAR:
+            CorrectLensRadial(x, y, ctx.k1, ctx.k2, ctx.k3);
+            break;
+        case AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME:
+        case AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR:
+            CorrectLensRadialInverse(x, y, ctx.k1, ctx.k2, ctx.k3);
+            CorrectLensCircularFishEye(x, y, z, ctx.hfov, 1.0, v.Tex[2]);
+            break;
+        default:
+            break;
+        }
+
+        vec = Transform(ctx.post, x, y, z);
+        v.Pos[0] = vec.v[0];
+        v.Pos[1] = vec.v[1];
+        v.Pos[2] = vec.v[2];
+        v.Pos[3] = 0.0f;
+    }
+    //-------------------------------------------------------------------------------------------------
+#if defined(STITCH_MESH_SSE) || defined(STITCH_MESH_NEON)
+#if defined(STITCH_MESH_SSE)
+    typedef __m128 Vec4;
+    inline Vec4 Load(const float* p)            { return _mm_loadu_ps(p); }
+    inline void Store(float* p, Vec4 a)         { _mm_storeu_ps(p, a); }
+    inline Vec4 Splat(float a)                  { return _mm_set1_ps(a); }
+    inline Vec4 Add(Vec4 a, Vec4 b)            { return _mm_add_ps(a, b); }
+    inline Vec4 Mul(Vec4 a, Vec4 b)            { return _mm_mul_ps(a, b); }
+    inline Vec4 Sqrt(Vec4 a)                    { return _mm_sqrt_ps(a); }
+#else
+    typedef float32x4_t Vec4;
+    inline Vec4 Load(const float* p)            { return vld1q_f32(p); }
+    inline void Store(float* p, Vec4 a)         { vst1q_f32(p, a); }
+    inline Vec4 Splat(float a)                  { return vdupq_n_f32(a); }
+    inline Vec4 Add(Vec4 a, Vec4 b)            { return vaddq_f32(a, b); }
+    inline Vec4 Mul(Vec4 a, Vec4 b)            { return vmulq_f32(a, b); }
+    inline Vec4 Sqrt(Vec4 a)                    { return vsqrtq_f32(a); }
+#endif
+    //-------------------------------------------------------------------------------------------------
+    // Four rectilinear vertices of one row. The radial correction runs in single precision here,
+    // which moves vertices by less than 1e-6.
+    void GenerateRectilinear4(const MeshContext& ctx, const float* pPosX, float posy, float x[4], float y[4], float z[4])
+    {
+        const Matrix& pre = ctx.pre;
+        const Matrix& post = ctx.post;
+        const Vec4 px = Load(pPosX);
+
+        Vec4 vx = Add(Mul(px, Splat(pre.m[0][0])), Splat(posy * pre.m[1][0] + ctx.posZ * pre.m[2][0] + pre.m[3][0]));
+        Vec4 vy = Add(Mul(px, Splat(pre.m[0][1])), Splat(posy * pre.m[1][1] + ctx.posZ * pre.m[2][1] + pre.m[3][1]));
+        const Vec4 vz = Add(Mul(px, Splat(pre.m[0][2])), Splat(posy * pre.m[1][2] + ctx.posZ * pre.m[2][2] + pre.m[3][2]));
+
+        const float d = (float)(1.0 - ctx.k1 - ctx.k2 - ctx.k3);
+        const Vec4 r2 = Add(Mul(vx, vx), Mul(vy, vy));
+        const Vec4 r1 = Sqrt(r2);
+        const Vec4 r3 = Mul(r2, r1);
+        const Vec4 dist = Add(Add(Splat(d), Mul(Splat((float)ctx.k1), r3)), Add(Mul(Splat((float)ctx.k2), r2), Mul(Splat((float)ctx.k3), r1)));
+        vx = Mul(vx, dist);
+        vy = Mul(vy, dist);
+
+        for (int i = 0; i < 3; i++)
+        {
+            const Vec4 out = Add(Add(Mul(vx, Splat(post.m[0][i])), Mul(vy, Splat(post.m[1][i]))),
+                                 Add(Mul(vz, Splat(post.m[2][i])), Splat(post.m[3][i])));
+            Store(i == 0 ? x : i == 1 ? y : z, out);
+        }
+    }
+#endif
+    //-------------------------------------------------------------------------------------------------
+    void GenerateRows(const MeshContext& ctx, amf_size first, amf_size last)
+    {
+        const amf_size columns = ctx.posX.size();
+        for (amf_size row = first; row < last; row++)
+        {
+            StitchMeshVertex* pRow = ctx.pVertices + row * columns;
+            const float posy = ctx.posY[row];
+            const float texy = ctx.texY[row];
+            amf_size col = 0;
+#if defined(STITCH_MESH_SSE) || defined(STITCH_MESH_NEON)
+            if (ctx.lensMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR)
+            {
+                float x[4], y[4], z[4];
+                for (; col + 4 <= columns; col += 4)
+                {
+                    GenerateRectilinear4(ctx, &ctx.posX[col], posy, x, y, z);
+                    for (int i = 0; i < 4; i++)
+                    {
+                        StitchMeshVertex& v = pRow[col + i];
+                        v.Pos[0] = x[i];
+                        v.Pos[1] = y[i];
+                        v.Pos[2] = z[i];
+                        v.Pos[3] = 0.0f;
+                        v.Tex[0] = ctx.texX[col + i];
+                        v.Tex[1] = texy;
+                        v.Tex[2] = CalcTransparencyTex(v.Tex[0], texy);
+                    }
+                }
+            }
+#endif
+            for (; col < columns; col++)
+            {
+                StitchMeshVertex& v = pRow[col];
+                v.Tex[0] = ctx.texX[col];
+                v.Tex[1] = texy;
+                v.Tex[2] = CalcTransparencyTex(v.Tex[0], texy);
+                GenerateVertex(ctx, ctx.posX[col], posy, v);
+            }
+        }
+    }
+    //-------------------------------------------------------------------------------------------------
+    class BandTask : public AMFWorkStealingPool::Task
+    {
+    public:
+        BandTask(const MeshContext& ctx, amf_size first, amf_size last, std::atomic<amf_size>& pending, AMFEvent& done) :
+            m_ctx(ctx), m_iFirst(first), m_iLast(last), m_Pending(pending), m_Done(done) {}
+
+        virtual void Run()
+        {
+            GenerateRows(m_ctx, m_iFirst, m_iLast);
+            if (--m_Pending == 0)
+            {
+                m_Done.SetEvent();
+            }
+        }
+
+    private:
+        const MeshContext&      m_ctx;
+        amf_size                m_iFirst;
+        amf_size                m_iLast;
+        std::atomic<amf_size>&  m_Pending;
+        AMFEvent&               m_Done;
+    };
+    //-------------------------------------------------------------------------------------------------
+    amf_uint64 HashBytes(amf_uint64 hash, const void* pData, amf_size size)
+    {
+        // FNV-1a
+        const amf_uint8* p = (const amf_uint8*)pData;
+        for (amf_size i = 0; i < size; i++)
+        {
+            hash = (hash ^ p[i]) * 0x100000001B3ull;
+        }
+        return hash;
+    }
+    //-------------------------------------------------------------------------------------------------
+    struct CacheEntry
+    {
+        amf_uint64          hash;
+        StitchMeshParams    params;
+        StitchMesh          mesh;
+    };
+    // most recently used first
+    AMFCriticalSection      s_CacheSync;
+    amf_list<CacheEntry>    s_Cache;
+}
+
+//-------------------------------------------------------------------------------------------------
+StitchMeshParams::StitchMeshParams() :
+    widthInput(0),
+    heightInput(0),
+    widthOutput(0),
+    heightOutput(0),
+    widthTriangle(128),
+    heightTriangle(128),
+    streamCount(0),
+    lensMode(AMF_VIDEO_STITCH_LENS_RECTILINEAR),
+    lensCorrK1(0.0),
+    lensCorrK2(0.0),
+    lensCorrK3(0.0),
+    lensCorrOffX(0.0),
+    lensCorrOffY(0.0),
+    offsetX(0.0),
+    offsetY(0.0),
+    scale(0.0),
+    pitch(0.0),
+    yaw(0.0),
+    roll(0.0),
+    hfov(STITCH_MESH_PI / 2.0)
+{
+    crop = AMFConstructRect(0, 0, 0, 0);
+}
+//-------------------------------------------------------------------------------------------------
+amf_uint64 StitchMeshParams::Hash() const
+{
+    // field by field so padding never ends up in the hash
+    amf_uint64 hash = 0xCBF29CE484222325ull;
+    hash = HashBytes(hash, &widthInput, sizeof(widthInput));
+    hash = HashBytes(hash, &heightInput, sizeof(heightInput));
+    hash = HashBytes(hash, &widthOutput, sizeof(widthOutput));
+    hash = HashBytes(hash, &heightOutput, sizeof(heightOutput));
+    hash = HashBytes(hash, &widthTriangle, sizeof(widthTriangle));
+    hash = HashBytes(hash, &heightTriangle, sizeof(heightTriangle));
+    hash = HashBytes(hash, &streamCount, sizeof(streamCount));
+    hash = HashBytes(hash, &lensMode, sizeof(lensMode));
+    hash = HashBytes(hash, &crop, sizeof(crop));
+    hash = HashBytes(hash, &lensCorrK1, sizeof(lensCorrK1));
+    hash = HashBytes(hash, &lensCorrK2, sizeof(lensCorrK2));
+    hash = HashBytes(hash, &lensCorrK3, sizeof(lensCorrK3));
+    hash = HashBytes(hash, &lensCorrOffX, sizeof(lensCorrOffX));
+    hash = HashBytes(hash, &lensCorrOffY, sizeof(lensCorrOffY));
+    hash = HashBytes(hash, &offsetX, sizeof(offsetX));
+    hash = HashBytes(hash, &offsetY, sizeof(offsetY));
+    hash = HashBytes(hash, &scale, sizeof(scale));
+    hash = HashBytes(hash, &pitch, sizeof(pitch));
+    hash = HashBytes(hash, &yaw, sizeof(yaw));
+    hash = HashBytes(hash, &roll, sizeof(roll));
+    hash = HashBytes(hash, &hfov, sizeof(hfov));
+    return hash;
+}
+//-------------------------------------------------------------------------------------------------
+bool StitchMeshParams::operator==(const StitchMeshParams& other) const
+{
+    return widthInput == other.widthInput && heightInput == other.heightInput &&
+        widthOutput == other.widthOutput && heightOutput == other.heightOutput &&
+        widthTriangle == other.widthTriangle && heightTriangle == other.heightTriangle &&
+        streamCount == other.streamCount && lensMode == other.lensMode && crop == other.crop &&
+        lensCorrK1 == other.lensCorrK1 && lensCorrK2 == other.lensCorrK2 && lensCorrK3 == other.lensCorrK3 &&
+        lensCorrOffX == other.lensCorrOffX && lensCorrOffY == other.lensCorrOffY &&
+        offsetX == other.offsetX && offsetY == other.offsetY && scale == other.scale &&
+        pitch == other.pitch && yaw == other.yaw && roll == other.roll && hfov == other.hfov;
+}
+
+//-------------------------------------------------------------------------------------------------
+void StitchMeshBuilder::Build(const StitchMeshParams& params, StitchMesh& mesh, AMFWorkStealingPool* pPool)
+{
+    const amf_uint64 hash = params.Hash();
+    {
+        AMFLock lock(&s_CacheSync);
+        for (amf_list<CacheEntry>::iterator it = s_Cache.begin(); it != s_Cache.end(); it++)
+        {
+            if (it->hash == hash && it->params == params)
+            {
+                s_Cache.splice(s_Cache.begin(), s_Cache, it);
+                mesh = s_Cache.front().mesh;
+                return;
+            }
+        }
+    }
+
+    // generate outside of the lock so other cameras can be looked up meanwhile
+    Generate(params, mesh, pPool);
+
+    AMFLock lock(&s_CacheSync);
+    CacheEntry entry;
+    entry.hash = hash;
+    entry.params = params;
+    entry.mesh = mesh;
+    s_Cache.push_front(entry);
+    if (s_Cache.size() > MAX_CACHED_MESHES)
+    {
+        s_Cache.pop_back();
+    }
+}
+//-------------------------------------------------------------------------------------------------
+void StitchMeshBuilder::ClearCache()
+{
+    AMFLock lock(&s_CacheSync);
+    s_Cache.clear();
+}
+//-------------------------------------------------------------------------------------------------
+void StitchMeshBuilder::Generate(const StitchMeshParams& params, StitchMesh& mesh, AMFWorkStealingPool* pPool)
+{
+    mesh.vertices.clear();
+    mesh.verticesRowSize.clear();
+    mesh.sides.clear();
+    mesh.corners.clear();
+
+    const amf_int32 widthInputOrg = params.widthInput;
+    const amf_int32 heightInputOrg = params.heightInput;
+    amf_int32 widthInput = params.widthInput;
+    amf_int32 heightInput = params.heightInput;
+
+    const AMFRect& crop = params.crop;
+    const bool bCrop = crop.Width() > 0 && crop.Height() > 0;
+    if (bCrop)
+    {
+        widthInput = crop.Width();
+        heightInput = crop.Height();
+    }
+
+    // crop is applied through the texture coordinates, so the mesh itself is not moved
+    const double crop_offset_x = 0;
+    const double crop_offset_y = 0;
+
+    double offset_z = params.scale;
+    if (params.lensMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR)
+    {
+        offset_z = 1.0 / tan(params.hfov / 2.0);
+    }
+    offset_z = 1.0 - ((double)widthInput / heightInput) * offset_z;
+
+    double lensCorrOffX = params.lensCorrOffX;
+    double lensCorrOffY = params.lensCorrOffY;
+    switch (params.lensMode)
+    {
+    case AMF_VIDEO_STITCH_LENS_RECTILINEAR:
+        lensCorrOffX /= widthInputOrg / 2.0;
+        lensCorrOffY /= heightInputOrg / 2.0;
+        break;
+    case AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME:
+        lensCorrOffX /= widthInputOrg / 2.0;
+        lensCorrOffY /= heightInputOrg / 2.0;
+        offset_z *= 1.11;
+        break;
+    case AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR:
+        lensCorrOffX /= widthInputOrg / 2.0;
+        lensCorrOffY /= widthInputOrg / 2.0;
+        break;
+    }
+
+    float tex_l = 0.0f;
+    float tex_t = 0.0f;
+    float tex_w = 1.0f;
+    float tex_h = 1.0f;
+    if (bCrop)
+    {
+        tex_l = (float)crop.left / widthInputOrg;
+        tex_t = (float)crop.top / heightInputOrg;
+        tex_w = (float)crop.Width() / widthInputOrg;
+        tex_h = (float)crop.Height() / heightInputOrg;
+    }
+
+    double aspectX = 1.0;
+    double aspectY = 1.0;
+    if (widthInput > heightInput)
+    {
+        aspectX = (float)widthInput / heightInput;
+    }
+    else
+    {
+        aspectY = (float)heightInput / widthInput;
+    }
+
+    const Matrix orientation = RotationRollPitchYaw((float)params.pitch, (float)params.yaw, (float)params.roll);
+    const Matrix textureReverse = RotationRollPitchYaw(0.0f, 0.0f, (float)STITCH_MESH_PI);
+    const Matrix aspect = Scaling((float)aspectX, (float)aspectY, 1.0f);
+    const Matrix translation = Translation((float)lensCorrOffX, (float)lensCorrOffY, 0.0f);
+    const Matrix zoom = Translation(0.0f, 0.0f, (float)offset_z);
+    const Matrix crop_translation = Translation((float)crop_offset_x, (float)crop_offset_y, 0.0f);
+
+    // normalized rect, scaled and moved like the image
+    double leftB = -1.0 / aspectX - lensCorrOffX;
+    double topB = -1.0 / aspectY - lensCorrOffY;
+    double rightB = 1.0 / aspectX - lensCorrOffX;
+    double bottomB = 1.0 / aspectY - lensCorrOffY;
+
+    switch (params.streamCount)
+    {
+    case 2:
+    case 4:
+    case 6:
+        mesh.corners.push_back(Transform(orientation, 1.0f, 1.0f, -1.0f));      // lt
+        mesh.corners.push_back(Transform(orientation, -1.0f, 1.0f, -1.0f));     // rt
+        mesh.corners.push_back(Transform(orientation, -1.0f, -1.0f, -1.0f));    // rb
+        mesh.corners.push_back(Transform(orientation, 1.0f, -1.0f, -1.0f));     // lb
+
+        mesh.sides.push_back(Transform(orientation, 1.0f, 0.0f, -1.0f));        // right
+        mesh.sides.push_back(Transform(orientation, 0.0f, 1.0f, -1.0f));        // bottom
+        mesh.sides.push_back(Transform(orientation, -1.0f, 0.0f, -1.0f));       // left
+        mesh.sides.push_back(Transform(orientation, 0.0f, -1.0f, -1.0f));       // top
+        break;
+    }
+
+    // scale based on Z
+    leftB /= 1.0 + offset_z;
+    topB /= 1.0 + offset_z;
+    rightB /= 1.0 + offset_z;
+    bottomB /= 1.0 + offset_z;
+
+    // back to image
+    mesh.texRect = MakeVector(float((leftB + 1.0) / 2.0), float((topB + 1.0) / 2.0), float((rightB + 1.0) / 2.0), float((bottomB + 1.0) / 2.0));
+    mesh.borderRect.left = amf_int32((leftB + 1.0) / 2.0 * widthInput);
+    mesh.borderRect.top = amf_int32((topB + 1.0) / 2.0 * heightInput);
+    mesh.borderRect.right = amf_int32((rightB + 1.0) / 2.0 * widthInput);
+    mesh.borderRect.bottom = amf_int32((bottomB + 1.0) / 2.0 * heightInput);
+
+    // camera plane
+    const Matrix plane = Multiply(Multiply(Multiply(Multiply(textureReverse, aspect), translation), zoom), orientation);
+    mesh.plane = PlaneFromPoints(Transform(plane, -1.0f, -1.0f, -1.0f), Transform(plane, 1.0f, 0.0f, -1.0f), Transform(plane, 1.0f, 1.0f, -1.0f));
+    mesh.planeCenter = Transform(plane, 0.0f, 0.0f, -1.0f);
+
+    // vertices
+    MeshContext ctx;
+    ctx.lensMode = params.lensMode;
+    ctx.k1 = params.lensCorrK1;
+    ctx.k2 = params.lensCorrK2;
+    ctx.k3 = params.lensCorrK3;
+    ctx.hfov = params.hfov;
+    ctx.pre = Multiply(Multiply(Multiply(textureReverse, crop_translation), translation), aspect);
+    ctx.post = Multiply(zoom, orientation);
+    ctx.posZ = -1.0f;
+
+    const float l = -1.0f;
+    const float t = -1.0f;
+    const float w = 2.0f;
+    const float h = 2.0f;
+    for (amf_int32 x = 0; x <= params.widthTriangle; x++)
+    {
+        const float tex = tex_l + ((float)x / params.widthTriangle) * tex_w;
+        if (tex >= 0 && tex <= 1.0f)
+        {
+            ctx.posX.push_back(l + (float)x / params.widthTriangle * w);
+            ctx.texX.push_back(tex);
+        }
+    }
+    for (amf_int32 y = 0; y <= params.heightTriangle; y++)
+    {
+        const float tex = tex_t + ((float)y / params.heightTriangle) * tex_h;
+        if (tex >= 0 && tex <= 1.0f)
+        {
+            ctx.posY.push_back(t + (float)y / params.heightTriangle * h);
+            ctx.texY.push_back(tex);
+        }
+    }
+    const amf_size columns = ctx.posX.size();
+    const amf_size rows = columns > 0 ? ctx.posY.size() : 0;
+    if (rows == 0)
+    {
+        return;
+    }
+
+    mesh.vertices.resize(rows * columns);
+    mesh.verticesRowSize.assign(rows, (amf_uint32)columns);
+    ctx.pVertices = &mesh.vertices[0];
+
+    const amf_size bands = (rows + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+    // a rectilinear mesh takes about 0.1ms, less than handing it out to the pool does
+    if (pPool == NULL || pPool->GetThreadCount() < 2 || bands < 2 || ctx.lensMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR)
+    {
+        GenerateRows(ctx, 0, rows);
+        return;
+    }
+
+    std::atomic<amf_size> pending(bands);
+    AMFEvent done;
+    for (amf_size band = 0; band < bands; band++)
+    {
+        pPool->Submit(new BandTask(ctx, band * ROWS_PER_BAND, AMF_MIN((band + 1) * ROWS_PER_BAND, rows), pending, done));
+    }
+    done.Lock();
+}
+
+//-------------------------------------------------------------------------------------------------
+void StitchMeshBuilder::MakeSphere(float pos[3], float centerX, float centerY, float centerZ, float newRadius)
+{
+    const double x = pos[0] - centerX;
+    const double y = pos[1] - centerY;
+    const double z = pos[2] - centerZ;
+    const double r = sqrt(x * x + y * y + z * z);
+    const double theta = acos(z / r); // elevation
+    const double pheta = atan2(y, x); // azimuth
+    pos[0] = (float)(newRadius * sin(theta) * cos(pheta)) + centerX;
+    pos[1] = (float)(newRadius * sin(theta) * sin(pheta)) + centerY;
+    pos[2] = (float)(newRadius * cos(theta)) + centerZ;
+}
+//-------------------------------------------------------------------------------------------------
+void StitchMeshBuilder::CartesianToSpherical(const float src[3], float dst[3])
+{
+    const double x = src[0];
+    const double y = src[1];
+    const double z = src[2];
+    const double r = sqrt(x * x + y * y + z * z);
+    dst[0] = (float)acos(z / r);    // elevation
+    dst[1] = (float)atan2(y, x);    // azimuth
+    dst[2] = (float)r;
+}
@@ -0,0 +1,122 @@
+// 
+// Notice Regarding Standards.  AMD does not provide a license or sublicense to
+// any Intellectual Property Rights relating to any standards, including but not
+// limited to any audio and/or video codec technologies such as MPEG-2, MPEG-4;
+// AVC/H.264; HEVC/H.265; AAC decode/FFMPEG; AAC encode/FFMPEG; VC-1; and MP3
+// (collectively, the "Media Technologies"). For clarity, you will pay any
+// royalties due for such third party technologies, which may include the Media
+// Technologies that are owed as a result of AMD providing the Software to you.
+// 
+// MIT license 
+// 
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+#pragma once
+
+#include "public/include/core/Platform.h"
+#include "public/common/AMFSTL.h"
+
+namespace amf
+{
+    class AMFWorkStealingPool;
+
+    //---------------------------------------------------------------------------------------------
+    // Everything the lens-corrected mesh of one camera depends on, as read from its property
+    // storage. Angles are in radians, offsets in pixels; see VideoStitch.h for the properties.
+    struct StitchMeshParams
+    {
+        StitchMeshParams();
+
+        amf_int32   widthInput;
+        amf_int32   heightInput;
+        amf_int32   widthOutput;
+        amf_int32   heightOutput;
+        amf_int32   widthTriangle;      // cells per row
+        amf_int32   heightTriangle;     // cells per column
+        amf_int32   streamCount;
+        amf_int64   lensMode;           // AMF_VIDEO_STITCH_LENS_ENUM
+        AMFRect     crop;
+
+        double      lensCorrK1;
+        double      lensCorrK2;
+        double      lensCorrK3;
+        double      lensCorrOffX;
+        double      lensCorrOffY;
+        double      offsetX;
+        double      offsetY;
+        double      scale;
+        double      pitch;
+        double      yaw;
+        double      roll;
+        double      hfov;
+
+        amf_uint64  Hash() const;
+        bool operator==(const StitchMeshParams& other) const;
+    };
+
+#pragma pack(push, 1)
+    // Same layout as StitchEngineBase::TextureVertex.
+    struct StitchMeshVertex
+    {
+        float Pos[4];   // x, y, z, reserved
+        float Tex[3];   // x, y, alpha
+    };
+#pragma pack(pop)
+
+    struct StitchMeshVector
+    {
+        float v[4];
+    };
+
+    //---------------------------------------------------------------------------------------------
+    // The output of StitchEngineBase::PrepareMesh without the DirectXMath types.
+    struct StitchMesh
+    {
+        amf_vector<StitchMeshVertex>    vertices;
+        amf_vector<amf_uint32>          verticesRowSize;
+        AMFRect                         borderRect;
+        StitchMeshVector                texRect;
+        amf_vector<StitchMeshVector>    sides;
+        amf_vector<StitchMeshVector>    corners;
+        StitchMeshVector                plane;
+        StitchMeshVector                planeCenter;
+    };
+
+    //---------------------------------------------------------------------------------------------
+    // Builds the sphere mesh for one camera on the CPU. Rows are generated in bands on a pool,
+    // and the affine parts of the vertex transform run four vertices at a time (SSE2 on x86, NEON
+    // on ARM64). Built meshes are kept in a small process wide cache, so reinitializing a rig with
+    // the same cameras doesn't generate them again.
+    class StitchMeshBuilder
+    {
+    public:
+        // Returns the cached mesh or generates and caches it. pPool may be NULL to generate on
+        // the calling thread.
+        static void Build(const StitchMeshParams& params, StitchMesh& mesh, AMFWorkStealingPool* pPool);
+        // Always generates, bypassing the cache.
+        static void Generate(const StitchMeshParams& params, StitchMesh& mesh, AMFWorkStealingPool* pPool);
+        static void ClearCache();
+
+        // The spherical helpers StitchEngineBase uses when projecting the mesh.
+        static void MakeSphere(float pos[3], float centerX, float centerY, float centerZ, float newRadius);
+        static void CartesianToSpherical(const float src[3], float dst[3]);
+    };
+} // namespace amf
@@ -5,6 +5,7 @@
 #pragma comment(lib, "dxgi.lib")
 
 #include <iostream>
+#include <cstring>
 
 #include <comdef.h>
 
@@ -25,4 +26,22 @@ struct DataAndSize
 	unsigned size;
 };
 
+/** Deep copy a DataAndSize so it can be queued. Release with releaseDataAndSize. */
+inline void *copyDataAndSize(void *data)
+{
+	DataAndSize *source = (DataAndSize *)data;
+	DataAndSize *copy = new DataAndSize;
+	copy->rawData = new char[source->size];
+	copy->size = source->size;
+	memcpy(copy->rawData, source->rawData, source->size);
+	return copy;
+}
+
+inline void releaseDataAndSize(void *data)
+{
+	DataAndSize *copy = (DataAndSize *)data;
+	delete[](char *) copy->rawData;
+	delete copy;
+}
+
 #endif
\ No newline at end of file
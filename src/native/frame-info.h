@@ -0,0 +1,34 @@
+#ifndef FRAME_INFO_H
+#define FRAME_INFO_H
+
+#include <vector>
+
+#include "stages/common/damage-tracker.h"
+
+/**
+ * Metadata that travels through the pipeline alongside each piece of data.
+ * The pipeline resets it at the start of every iteration and stages fill in
+ * whatever they know about the data they return.
+ */
+struct FrameInfo
+{
+    // Time the frame entered the pipeline, in 100ns units since the pipeline started.
+    long long timestamp = 0;
+
+    // Whether later frames may depend on this one. Dropping a reference frame
+    // corrupts everything up to the next keyframe, so edges try not to.
+    bool reference = true;
+
+    // Whether this frame can be decoded on its own.
+    bool keyframe = false;
+
+    // Whether the content is identical to the previous frame. Encoders running
+    // at a variable frame rate skip these, letting the previous frame's
+    // duration stretch to the next real change.
+    bool repeat = false;
+
+    // Block aligned regions that changed since the previous frame. Empty when
+    // unknown, in which case the whole frame should be treated as changed.
+    std::vector<DamageRect> damage;
+};
+#endif
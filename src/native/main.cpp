@@ -1,14 +1,18 @@
 #include <iostream>
+#include <map>
+#include <thread>
 
 #include <napi.h>
 
 #include "pipeline.h"
+#include "recovery.h"
 #include "nvenc/NvEncoder.h"
 
 class PipelineWrapper : public Napi::ObjectWrap<PipelineWrapper>
 {
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
+    static Napi::Value fromGraph(const Napi::CallbackInfo &info);
     PipelineWrapper(const Napi::CallbackInfo &info);
     ~PipelineWrapper();
 
@@ -22,7 +26,15 @@ private:
     void resume(const Napi::CallbackInfo &info);
     void stop(const Napi::CallbackInfo &info);
     Napi::Value supportsStage(const Napi::CallbackInfo &info);
+    Napi::Value selectVideoEncoder(const Napi::CallbackInfo &info);
     Napi::Value pollErrors(const Napi::CallbackInfo &info);
+    Napi::Value getStats(const Napi::CallbackInfo &info);
+    Napi::Value getStageStats(const Napi::CallbackInfo &info);
+    Napi::Value getTap(const Napi::CallbackInfo &info);
+
+    // The ArrayBuffer over the tap's memory, made by the first getTap call.
+    Napi::Reference<Napi::ArrayBuffer> tapBuffer;
+    PipelineTap *tapBufferTap = nullptr;
 };
 
 Napi::FunctionReference PipelineWrapper::constructor;
@@ -30,6 +42,7 @@ Napi::FunctionReference PipelineWrapper::constructor;
 Napi::Object PipelineWrapper::Init(Napi::Env env, Napi::Object exports)
 {
     Napi::Function func = DefineClass(env, "Pipeline", {
+                                                           StaticMethod("fromGraph", &PipelineWrapper::fromGraph),
                                                            InstanceMethod("addStage", &PipelineWrapper::addStage),
                                                            InstanceMethod("initialize", &PipelineWrapper::initialize),
                                                            InstanceMethod("start", &PipelineWrapper::start),
@@ -38,6 +51,10 @@ Napi::Object PipelineWrapper::Init(Napi::Env env, Napi::Object exports)
                                                            InstanceMethod("resume", &PipelineWrapper::resume),
                                                            InstanceMethod("pollErrors", &PipelineWrapper::pollErrors),
                                                            InstanceMethod("supportsStage", &PipelineWrapper::supportsStage),
+                                                           InstanceMethod("selectVideoEncoder", &PipelineWrapper::selectVideoEncoder),
+                                                           InstanceMethod("getStats", &PipelineWrapper::getStats),
+                                                           InstanceMethod("getStageStats", &PipelineWrapper::getStageStats),
+                                                           InstanceMethod("getTap", &PipelineWrapper::getTap),
                                                        });
 
     constructor = Napi::Persistent(func);
@@ -46,6 +63,23 @@ Napi::Object PipelineWrapper::Init(Napi::Env env, Napi::Object exports)
     return exports;
 };
 
+VideoCodec getVideoCodecFromString(const std::string &codec, Napi::Env &env)
+{
+    if (codec == "h264")
+    {
+        return H264;
+    }
+    else if (codec == "hevc")
+    {
+        return HEVC;
+    }
+    else
+    {
+        Napi::TypeError::New(env, "Unknown video codec").ThrowAsJavaScriptException();
+        return H264;
+    }
+}
+
 PipelineWrapper::PipelineWrapper(const Napi::CallbackInfo &info) : Napi::ObjectWrap<PipelineWrapper>(info)
 {
     Napi::Env env = info.Env();
@@ -71,6 +105,39 @@ PipelineWrapper::PipelineWrapper(const Napi::CallbackInfo &info) : Napi::ObjectW
             config.video.captureCursor = videoConfig.Get("captureCursor").As<Napi::Boolean>();
         }
 
+        if (videoConfig.Has("variableFrameRate"))
+        {
+            config.video.variableFrameRate = videoConfig.Get("variableFrameRate").As<Napi::Boolean>();
+        }
+
+        if (videoConfig.Has("codec"))
+        {
+            config.video.codec = getVideoCodecFromString(std::string(videoConfig.Get("codec").As<Napi::String>()), env);
+        }
+
+        if (videoConfig.Has("bitrate"))
+        {
+            // Any bitrate config turns on the adaptive controller.
+            auto bitrateConfig = videoConfig.Get("bitrate").As<Napi::Object>();
+            config.video.bitrate.adaptive = true;
+            if (bitrateConfig.Has("initial"))
+            {
+                config.video.bitrate.initial = bitrateConfig.Get("initial").As<Napi::Number>();
+            }
+            if (bitrateConfig.Has("min"))
+            {
+                config.video.bitrate.min = bitrateConfig.Get("min").As<Napi::Number>();
+            }
+            if (bitrateConfig.Has("max"))
+            {
+                config.video.bitrate.max = bitrateConfig.Get("max").As<Napi::Number>();
+            }
+            if (bitrateConfig.Has("budget"))
+            {
+                config.video.bitrate.budget = bitrateConfig.Get("budget").As<Napi::Number>();
+            }
+        }
+
         if (videoConfig.Has("source"))
         {
             auto sourceConfig = videoConfig.Get("source").As<Napi::Object>();
@@ -107,6 +174,20 @@ PipelineWrapper::PipelineWrapper(const Napi::CallbackInfo &info) : Napi::ObjectW
         }
     }
 
+    if (configObject.Has("tap"))
+    {
+        auto tapConfig = configObject.Get("tap").As<Napi::Object>();
+        config.tap.enabled = true;
+        if (tapConfig.Has("maxWidth"))
+        {
+            config.tap.maxWidth = tapConfig.Get("maxWidth").As<Napi::Number>();
+        }
+        if (tapConfig.Has("frameRate"))
+        {
+            config.tap.frameRate = tapConfig.Get("frameRate").As<Napi::Number>();
+        }
+    }
+
     if (configObject.Has("output"))
     {
         auto outputConfig = configObject.Get("output").As<Napi::Object>();
@@ -164,21 +245,262 @@ PipelineStageType getStageTypeFromString(std::string &stageType, Napi::Env &env)
     else
     {
         Napi::TypeError::New(env, "Unknown stage type").ThrowAsJavaScriptException();
+        return DESKTOP_DUPLICATION;
     }
 }
+DropPolicy getDropPolicyFromString(const std::string &policy, Napi::Env &env)
+{
+    if (policy == "block")
+    {
+        return BACKPRESSURE_BLOCK;
+    }
+    else if (policy == "dropOldest")
+    {
+        return DROP_OLDEST;
+    }
+    else if (policy == "dropNewest")
+    {
+        return DROP_NEWEST;
+    }
+    else if (policy == "dropNonReference")
+    {
+        return DROP_NON_REFERENCE;
+    }
+    else
+    {
+        Napi::TypeError::New(env, "Unknown drop policy").ThrowAsJavaScriptException();
+        return BACKPRESSURE_BLOCK;
+    }
+}
+
+std::string getDropPolicyName(DropPolicy policy)
+{
+    switch (policy)
+    {
+    case DROP_OLDEST:
+        return "dropOldest";
+    case DROP_NEWEST:
+        return "dropNewest";
+    case DROP_NON_REFERENCE:
+        return "dropNonReference";
+    default:
+        return "block";
+    }
+}
+
 void PipelineWrapper::addStage(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    if (info.Length() != 1 || !info[0].IsString())
+    if (info.Length() < 1 || !info[0].IsString())
     {
         Napi::TypeError::New(env, "Expected string").ThrowAsJavaScriptException();
     }
 
+    // The optional second argument configures the edge leading into this stage.
+    PipelineEdgeConfig edgeConfig;
+    if (info.Length() > 1 && info[1].IsObject())
+    {
+        auto edgeObject = info[1].As<Napi::Object>();
+        if (edgeObject.Has("queueSize"))
+        {
+            edgeConfig.queueSize = edgeObject.Get("queueSize").As<Napi::Number>();
+        }
+        if (edgeObject.Has("policy"))
+        {
+            edgeConfig.policy = getDropPolicyFromString(std::string(edgeObject.Get("policy").As<Napi::String>()), env);
+        }
+    }
+
     Napi::String stageType = info[0].As<Napi::String>();
-    pipeline->addStage(getStageTypeFromString(std::string(stageType), env));
+    pipeline->addStage(getStageTypeFromString(std::string(stageType), env), edgeConfig);
 };
 
+/**
+ * The section of the pipeline config a stage reads its options from.
+ */
+std::string getConfigSection(PipelineStageType stageType)
+{
+    switch (stageType)
+    {
+    case WASAPI:
+        return "audio";
+    case WAV_WRITER:
+    case FILE_WRITER:
+        return "output";
+    default:
+        return "video";
+    }
+}
+
+/**
+ * Copies the properties of options into config[section], without touching
+ * any object the caller passed in. Sections are shared by every stage that
+ * reads them, so a key another node already set to something else is a
+ * conflict, not an override: setBy maps each key set so far to its node.
+ * Returns false with a TypeError pending on a conflict.
+ */
+bool mergeOptions(Napi::Env env, Napi::Object config, const std::string &section, Napi::Object options,
+                  const std::string &node, std::map<std::string, std::string> &setBy)
+{
+    Napi::Object merged = Napi::Object::New(env);
+    if (config.Has(section) && config.Get(section).IsObject())
+    {
+        auto existing = config.Get(section).As<Napi::Object>();
+        auto names = existing.GetPropertyNames();
+        for (unsigned i = 0; i < names.Length(); i++)
+        {
+            merged.Set(names.Get(i), existing.Get(names.Get(i)));
+        }
+    }
+    auto names = options.GetPropertyNames();
+    for (unsigned i = 0; i < names.Length(); i++)
+    {
+        std::string name = names.Get(i).As<Napi::String>();
+        auto key = setBy.find(section + "." + name);
+        if (key != setBy.end() && !merged.Get(name).StrictEquals(options.Get(name)))
+        {
+            Napi::TypeError::New(env, "Nodes " + key->second + " and " + node + " both set " + section + "." + name +
+                                          ", options are shared by every stage reading that section")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        setBy[section + "." + name] = node;
+        merged.Set(name, options.Get(name));
+    }
+    config.Set(section, merged);
+    return true;
+}
+
+/**
+ * Builds a whole pipeline from a description of its graph:
+ *
+ * {
+ *   config: { ... }, // As passed to the constructor.
+ *   nodes: [{ id, stage, options?, thread? }],
+ *   edges: [{ from, to, queueSize?, policy? }]
+ * }
+ *
+ * A node's stage is a stage name, a list of alternatives, or VIDEO_ENCODER for
+ * the fastest encoder. Its options are merged into the config section the stage
+ * reads (video, audio or output), which other stages may read too. Two nodes
+ * setting the same key to different values is an error.
+ */
+Napi::Value PipelineWrapper::fromGraph(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() != 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "Pipeline graph must be an object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Object graph = info[0].As<Napi::Object>();
+    if (!graph.Has("nodes") || !graph.Get("nodes").IsArray())
+    {
+        Napi::TypeError::New(env, "Pipeline graph must have an array of nodes").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object config = Napi::Object::New(env);
+    if (graph.Has("config") && graph.Get("config").IsObject())
+    {
+        auto graphConfig = graph.Get("config").As<Napi::Object>();
+        auto names = graphConfig.GetPropertyNames();
+        for (unsigned i = 0; i < names.Length(); i++)
+        {
+            config.Set(names.Get(i), graphConfig.Get(names.Get(i)));
+        }
+    }
+
+    std::vector<PipelineGraphNode> nodes;
+    std::map<std::string, std::string> optionsSetBy;
+    auto nodeArray = graph.Get("nodes").As<Napi::Array>();
+    for (unsigned i = 0; i < nodeArray.Length(); i++)
+    {
+        auto nodeObject = nodeArray.Get(i).As<Napi::Object>();
+        PipelineGraphNode node;
+        node.id = std::string(nodeObject.Get("id").As<Napi::String>());
+        auto stage = nodeObject.Get("stage");
+        std::vector<std::string> stageNames;
+        if (stage.IsArray())
+        {
+            auto alternatives = stage.As<Napi::Array>();
+            for (unsigned j = 0; j < alternatives.Length(); j++)
+            {
+                stageNames.push_back(std::string(alternatives.Get(j).As<Napi::String>()));
+            }
+        }
+        else
+        {
+            stageNames.push_back(std::string(stage.As<Napi::String>()));
+        }
+        for (auto &name : stageNames)
+        {
+            if (name == "VIDEO_ENCODER")
+            {
+                node.videoEncoder = true;
+            }
+            else
+            {
+                node.stages.push_back(getStageTypeFromString(name, env));
+            }
+        }
+        if (env.IsExceptionPending())
+        {
+            return env.Null();
+        }
+        if (nodeObject.Has("thread"))
+        {
+            node.thread = nodeObject.Get("thread").As<Napi::Number>();
+        }
+        if (nodeObject.Has("options") && nodeObject.Get("options").IsObject())
+        {
+            std::string section = node.videoEncoder || node.stages.empty() ? "video" : getConfigSection(node.stages[0]);
+            auto options = nodeObject.Get("options").As<Napi::Object>();
+            if (!mergeOptions(env, config, section, options, node.id, optionsSetBy))
+            {
+                return env.Null();
+            }
+        }
+        nodes.push_back(node);
+    }
+
+    std::vector<PipelineGraphEdge> edges;
+    auto edgeArray = graph.Has("edges") ? graph.Get("edges").As<Napi::Array>() : Napi::Array::New(env);
+    for (unsigned i = 0; i < edgeArray.Length(); i++)
+    {
+        auto edgeObject = edgeArray.Get(i).As<Napi::Object>();
+        PipelineGraphEdge edge;
+        edge.from = std::string(edgeObject.Get("from").As<Napi::String>());
+        edge.to = std::string(edgeObject.Get("to").As<Napi::String>());
+        if (edgeObject.Has("queueSize"))
+        {
+            edge.config.queueSize = edgeObject.Get("queueSize").As<Napi::Number>();
+        }
+        if (edgeObject.Has("policy"))
+        {
+            edge.config.policy = getDropPolicyFromString(std::string(edgeObject.Get("policy").As<Napi::String>()), env);
+        }
+        edges.push_back(edge);
+    }
+    if (env.IsExceptionPending())
+    {
+        return env.Null();
+    }
+
+    Napi::Object object = constructor.New({config});
+    try
+    {
+        Unwrap(object)->pipeline->addGraph(nodes, edges);
+    }
+    catch (std::exception &e)
+    {
+        Napi::Error::New(env, "Invalid pipeline graph: " + std::string(e.what())).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return object;
+}
+
 void PipelineWrapper::initialize(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
@@ -252,9 +574,197 @@ Napi::Value PipelineWrapper::supportsStage(const Napi::CallbackInfo &info)
     return res;
 }
 
+Napi::Value PipelineWrapper::selectVideoEncoder(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    PipelineStageType stageType;
+    if (!pipeline->selectVideoEncoder(&stageType))
+    {
+        return env.Null();
+    }
+    return Napi::String::New(env, stageType == NVENC ? "NVENC" : "AMF");
+}
+
+Napi::Value PipelineWrapper::getStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    auto edgeStats = pipeline->getStats();
+    Napi::Array edges = Napi::Array::New(env, edgeStats.size());
+    for (unsigned i = 0; i < edgeStats.size(); i++)
+    {
+        auto &stats = edgeStats[i];
+        Napi::Object edge = Napi::Object::New(env);
+        edge.Set("stage", stats.stage);
+        edge.Set("policy", getDropPolicyName(stats.config.policy));
+        edge.Set("queueSize", stats.config.queueSize);
+        edge.Set("depth", stats.depth);
+        edge.Set("maxDepth", stats.maxDepth);
+        edge.Set("pushed", (double)stats.pushed);
+        edge.Set("dropped", (double)stats.dropped);
+        Napi::Array recentDrops = Napi::Array::New(env, stats.recentDrops.size());
+        for (unsigned j = 0; j < stats.recentDrops.size(); j++)
+        {
+            recentDrops[j] = Napi::Number::New(env, stats.recentDrops[j]);
+        }
+        edge.Set("recentDrops", recentDrops);
+        edges[i] = edge;
+    }
+    return edges;
+}
+
+Napi::Value PipelineWrapper::getStageStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    // Latencies are tracked in 100ns units but reported in milliseconds.
+    const double TICKS_PER_MS = 10000;
+    auto stageStats = pipeline->getStageStats();
+    Napi::Array stages = Napi::Array::New(env, stageStats.size());
+    for (unsigned i = 0; i < stageStats.size(); i++)
+    {
+        auto &stats = stageStats[i];
+        Napi::Object stage = Napi::Object::New(env);
+        stage.Set("stage", i);
+        stage.Set("count", (double)stats.count);
+        stage.Set("mean", stats.mean / TICKS_PER_MS);
+        stage.Set("stddev", stats.stddev / TICKS_PER_MS);
+        stage.Set("min", stats.min / TICKS_PER_MS);
+        stage.Set("max", stats.max / TICKS_PER_MS);
+        stage.Set("p50", stats.p50 / TICKS_PER_MS);
+        stage.Set("p90", stats.p90 / TICKS_PER_MS);
+        stage.Set("p99", stats.p99 / TICKS_PER_MS);
+        stage.Set("p999", stats.p999 / TICKS_PER_MS);
+        stage.Set("rate", stats.rate);
+        stages[i] = stage;
+    }
+    return stages;
+}
+
+Napi::Value PipelineWrapper::getTap(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    std::shared_ptr<PipelineTap> tap = pipeline->getTap();
+    if (!tap)
+    {
+        return env.Null();
+    }
+    if (tapBufferTap == tap.get())
+    {
+        return tapBuffer.Value();
+    }
+    // The buffer wraps the tap's memory directly and keeps the tap alive until
+    // it is garbage collected, which may well be after the pipeline is gone.
+    auto *reference = new std::shared_ptr<PipelineTap>(tap);
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(
+        env, tap->data(), tap->size(),
+        [](Napi::Env, void *, std::shared_ptr<PipelineTap> *reference) { delete reference; },
+        reference);
+    tapBuffer = Napi::Persistent(buffer);
+    tapBufferTap = tap.get();
+    return buffer;
+}
+
+/**
+ * State shared by a recoverRecordings call and the thread doing the work.
+ */
+struct RecoveryContext
+{
+    RecoveryContext(Napi::Env env, std::vector<std::string> fileNames, bool complete)
+        : deferred(Napi::Promise::Deferred::New(env)), job(fileNames, 0, complete) {}
+
+    Napi::Promise::Deferred deferred;
+    RecoveryJob job;
+    std::vector<RecoveryResult> results;
+    std::thread thread;
+};
+
+struct RecoveryProgress
+{
+    RecoveryResult result;
+    unsigned done;
+    unsigned total;
+};
+
+Napi::Object getRecoveryResultObject(Napi::Env env, const RecoveryResult &result)
+{
+    Napi::Object object = Napi::Object::New(env);
+    object.Set("fileName", result.fileName);
+    object.Set("error", result.error.size() ? Napi::String::New(env, result.error) : env.Null());
+    object.Set("originalSize", (double)result.originalSize);
+    object.Set("recoveredSize", (double)result.recoveredSize);
+    object.Set("frames", result.frames);
+    object.Set("wrappedFileName", result.wrappedFileName.size() ? Napi::String::New(env, result.wrappedFileName) : env.Null());
+    return object;
+}
+
+/**
+ * recoverRecordings(fileNames, onProgress, complete) repairs the raw files of
+ * interrupted recordings on worker threads (see recovery.h). complete is
+ * optional and set for recordings that were stopped properly. onProgress is
+ * called with {result, done, total} as each file is finished, and the returned
+ * promise resolves to the results of every file, in order.
+ */
+Napi::Value recoverRecordings(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (info.Length() < 2 || !info[0].IsArray() || !info[1].IsFunction())
+    {
+        Napi::TypeError::New(env, "Expected an array of file names and a progress callback").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    std::vector<std::string> fileNames;
+    auto fileArray = info[0].As<Napi::Array>();
+    for (unsigned i = 0; i < fileArray.Length(); i++)
+    {
+        fileNames.push_back(std::string(fileArray.Get(i).As<Napi::String>()));
+    }
+
+    bool complete = info.Length() > 2 && info[2].ToBoolean();
+    auto context = new RecoveryContext(env, fileNames, complete);
+    Napi::Promise promise = context->deferred.Promise();
+    // Runs on the main thread once the worker has released the function.
+    auto progress = Napi::ThreadSafeFunction::New(
+        env, info[1].As<Napi::Function>(), "recoverRecordings", 0, 1, context,
+        [](Napi::Env env, RecoveryContext *context) {
+            context->thread.join();
+            Napi::Array results = Napi::Array::New(env, context->results.size());
+            for (unsigned i = 0; i < context->results.size(); i++)
+            {
+                results[i] = getRecoveryResultObject(env, context->results[i]);
+            }
+            context->deferred.Resolve(results);
+            delete context;
+        });
+
+    context->thread = std::thread([context, progress]() mutable {
+        context->results = context->job.run([&progress](const RecoveryResult &result, unsigned done, unsigned total) {
+            progress.BlockingCall(new RecoveryProgress{result, done, total},
+                                  [](Napi::Env env, Napi::Function callback, RecoveryProgress *progress) {
+                                      Napi::Object object = Napi::Object::New(env);
+                                      object.Set("result", getRecoveryResultObject(env, progress->result));
+                                      object.Set("done", progress->done);
+                                      object.Set("total", progress->total);
+                                      delete progress;
+                                      try
+                                      {
+                                          callback.Call({object});
+                                      }
+                                      catch (Napi::Error &e)
+                                      {
+                                          // Surfaces as an uncaught exception, as it would from plain JavaScript.
+                                          e.ThrowAsJavaScriptException();
+                                      }
+                                  });
+        });
+        progress.Release();
+    });
+    return promise;
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
     PipelineWrapper::Init(env, exports);
+    exports.Set("recoverRecordings", Napi::Function::New(env, recoverRecordings));
     return exports;
 };
 
@@ -437,7 +437,7 @@ void NvEncoder::GetSequenceParams(std::vector<uint8_t> &seqParams)
 	seqParams.insert(seqParams.end(), &spsppsData[0], &spsppsData[spsppsSize]);
 }
 
-void NvEncoder::DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams)
+NVENCSTATUS NvEncoder::EncodePicture(NV_ENC_INPUT_PTR inputBuffer, NV_ENC_PIC_PARAMS *pPicParams)
 {
 	NV_ENC_PIC_PARAMS picParams = {};
 	if (pPicParams)
@@ -452,7 +452,12 @@ void NvEncoder::DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<u
 	picParams.inputHeight = GetEncodeHeight();
 	picParams.outputBitstream = m_vBitstreamOutputBuffer[m_iToSend % m_nEncoderBuffer];
 	picParams.completionEvent = m_vpCompletionEvent[m_iToSend % m_nEncoderBuffer];
-	NVENCSTATUS nvStatus = m_nvenc.nvEncEncodePicture(m_hEncoder, &picParams);
+	return m_nvenc.nvEncEncodePicture(m_hEncoder, &picParams);
+}
+
+void NvEncoder::DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams)
+{
+	NVENCSTATUS nvStatus = EncodePicture(inputBuffer, pPicParams);
 	if (nvStatus == NV_ENC_SUCCESS || nvStatus == NV_ENC_ERR_NEED_MORE_INPUT)
 	{
 		m_iToSend++;
@@ -486,34 +491,94 @@ void NvEncoder::GetEncodedPacket(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer,
 	for (; m_iGot < iEnd; m_iGot++)
 	{
 		WaitForCompletionEvent(m_iGot % m_nEncoderBuffer);
-		NV_ENC_LOCK_BITSTREAM lockBitstreamData = {NV_ENC_LOCK_BITSTREAM_VER};
-		lockBitstreamData.outputBitstream = vOutputBuffer[m_iGot % m_nEncoderBuffer];
-		lockBitstreamData.doNotWait = false;
-		NVENC_API_CALL(m_nvenc.nvEncLockBitstream(m_hEncoder, &lockBitstreamData));
-
-		uint8_t *pData = (uint8_t *)lockBitstreamData.bitstreamBufferPtr;
 		if (vPacket.size() < i + 1)
 		{
 			vPacket.push_back(std::vector<uint8_t>());
 		}
-		vPacket[i].clear();
-		vPacket[i].insert(vPacket[i].end(), &pData[0], &pData[lockBitstreamData.bitstreamSizeInBytes]);
+		LockBitstream(vOutputBuffer, m_iGot % m_nEncoderBuffer, vPacket[i]);
 		i++;
+	}
+}
 
-		NVENC_API_CALL(m_nvenc.nvEncUnlockBitstream(m_hEncoder, lockBitstreamData.outputBitstream));
+void NvEncoder::LockBitstream(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer, int iBuffer, std::vector<uint8_t> &packet)
+{
+	NV_ENC_LOCK_BITSTREAM lockBitstreamData = {NV_ENC_LOCK_BITSTREAM_VER};
+	lockBitstreamData.outputBitstream = vOutputBuffer[iBuffer];
+	lockBitstreamData.doNotWait = false;
+	NVENC_API_CALL(m_nvenc.nvEncLockBitstream(m_hEncoder, &lockBitstreamData));
 
-		if (m_vMappedInputBuffers[m_iGot % m_nEncoderBuffer])
-		{
-			NVENC_API_CALL(m_nvenc.nvEncUnmapInputResource(m_hEncoder, m_vMappedInputBuffers[m_iGot % m_nEncoderBuffer]));
-			m_vMappedInputBuffers[m_iGot % m_nEncoderBuffer] = nullptr;
-		}
+	uint8_t *pData = (uint8_t *)lockBitstreamData.bitstreamBufferPtr;
+	packet.clear();
+	packet.insert(packet.end(), &pData[0], &pData[lockBitstreamData.bitstreamSizeInBytes]);
+
+	NVENC_API_CALL(m_nvenc.nvEncUnlockBitstream(m_hEncoder, lockBitstreamData.outputBitstream));
+
+	if (m_vMappedInputBuffers[iBuffer])
+	{
+		NVENC_API_CALL(m_nvenc.nvEncUnmapInputResource(m_hEncoder, m_vMappedInputBuffers[iBuffer]));
+		m_vMappedInputBuffers[iBuffer] = nullptr;
+	}
+
+	if (m_bMotionEstimationOnly && m_vMappedRefBuffers[iBuffer])
+	{
+		NVENC_API_CALL(m_nvenc.nvEncUnmapInputResource(m_hEncoder, m_vMappedRefBuffers[iBuffer]));
+		m_vMappedRefBuffers[iBuffer] = nullptr;
+	}
+}
+
+void NvEncoder::SubmitFrame(NV_ENC_PIC_PARAMS *pPicParams)
+{
+	if (!IsHWEncoderInitialized())
+	{
+		NVENC_THROW_ERROR("Encoder device not found", NV_ENC_ERR_NO_ENCODE_DEVICE);
+	}
+	// Only this thread moves m_iToSend, so it can be read without the lock.
+	int i = m_iToSend % m_nEncoderBuffer;
+	NV_ENC_MAP_INPUT_RESOURCE mapInputResource = {NV_ENC_MAP_INPUT_RESOURCE_VER};
+	mapInputResource.registeredResource = m_vRegisteredResources[i];
+	NVENC_API_CALL(m_nvenc.nvEncMapInputResource(m_hEncoder, &mapInputResource));
+	m_vMappedInputBuffers[i] = mapInputResource.mappedResource;
+
+	NVENCSTATUS nvStatus = EncodePicture(m_vMappedInputBuffers[i], pPicParams);
+	if (nvStatus != NV_ENC_SUCCESS && nvStatus != NV_ENC_ERR_NEED_MORE_INPUT)
+	{
+		NVENC_THROW_ERROR("nvEncEncodePicture API failed", nvStatus);
+	}
+
+	std::unique_lock<std::mutex> lock(m_asyncMutex);
+	m_iToSend++;
+	m_asyncCondition.notify_all();
+	// The next input frame reuses the buffers of frame m_iToSend - m_nEncoderBuffer.
+	m_asyncCondition.wait(lock, [this] { return m_bCancelWait || m_iToSend - m_iGot < m_nEncoderBuffer; });
+}
 
-		if (m_bMotionEstimationOnly && m_vMappedRefBuffers[m_iGot % m_nEncoderBuffer])
+bool NvEncoder::GetNextPacket(std::vector<uint8_t> &packet)
+{
+	int i;
+	{
+		std::unique_lock<std::mutex> lock(m_asyncMutex);
+		m_asyncCondition.wait(lock, [this] { return m_bCancelWait || m_iGot < m_iToSend; });
+		if (m_bCancelWait)
 		{
-			NVENC_API_CALL(m_nvenc.nvEncUnmapInputResource(m_hEncoder, m_vMappedRefBuffers[m_iGot % m_nEncoderBuffer]));
-			m_vMappedRefBuffers[m_iGot % m_nEncoderBuffer] = nullptr;
+			return false;
 		}
+		i = m_iGot % m_nEncoderBuffer;
 	}
+
+	WaitForCompletionEvent(i);
+	LockBitstream(m_vBitstreamOutputBuffer, i, packet);
+
+	std::lock_guard<std::mutex> lock(m_asyncMutex);
+	m_iGot++;
+	m_asyncCondition.notify_all();
+	return true;
+}
+
+void NvEncoder::CancelWait()
+{
+	std::lock_guard<std::mutex> lock(m_asyncMutex);
+	m_bCancelWait = true;
+	m_asyncCondition.notify_all();
 }
 
 bool NvEncoder::Reconfigure(const NV_ENC_RECONFIGURE_PARAMS *pReconfigureParams)
@@ -809,7 +874,7 @@ int NvEncoder::GetCapabilityValue(GUID guidCodec, NV_ENC_CAPS capsToQuery)
 	}
 	NV_ENC_CAPS_PARAM capsParam = {NV_ENC_CAPS_PARAM_VER};
 	capsParam.capsToQuery = capsToQuery;
-	int v;
+	int v = 0;
 	m_nvenc.nvEncGetEncodeCaps(m_hEncoder, guidCodec, &capsParam, &v);
 	return v;
 }
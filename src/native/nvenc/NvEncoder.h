@@ -14,6 +14,7 @@
 #include <vector>
 #include <stdint.h>
 #include <mutex>
+#include <condition_variable>
 #include <string>
 #include <iostream>
 #include <sstream>
@@ -125,6 +126,28 @@ public:
 	*/
 	void EncodeFrame(std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams = nullptr);
 
+	/**
+	*  @brief  This function is used to encode a frame without waiting for it.
+	*  Asynchronous counterpart to EncodeFrame(). The encoded packets must be
+	*  collected with GetNextPacket(), usually from another thread. Returns once
+	*  the buffer handed out by the next GetNextInputFrame() call is free, so
+	*  submission only stalls when every buffer is still waiting to be collected.
+	*/
+	void SubmitFrame(NV_ENC_PIC_PARAMS *pPicParams = nullptr);
+
+	/**
+	*  @brief  This function waits for the oldest submitted frame to finish
+	*  encoding and copies out its packet. Packets come out in submission order.
+	*  Returns false once CancelWait() has been called.
+	*/
+	bool GetNextPacket(std::vector<uint8_t> &packet);
+
+	/**
+	*  @brief  This function wakes up anything blocked in SubmitFrame() or
+	*  GetNextPacket(). GetNextPacket() returns false from then on.
+	*/
+	void CancelWait();
+
 	/**
 	*  @brief  This function to flush the encoder queue.
 	*  The encoder might be queuing frames for B picture encoding or lookahead;
@@ -319,6 +342,18 @@ private:
 	*/
 	void DoEncode(NV_ENC_INPUT_PTR inputBuffer, std::vector<std::vector<uint8_t>> &vPacket, NV_ENC_PIC_PARAMS *pPicParams);
 
+	/**
+	*  @brief This is a private function which is used to submit a picture
+	*         to the NVENC hardware. Shared by DoEncode() and SubmitFrame().
+	*/
+	NVENCSTATUS EncodePicture(NV_ENC_INPUT_PTR inputBuffer, NV_ENC_PIC_PARAMS *pPicParams);
+
+	/**
+	*  @brief This is a private function which is used to copy out one packet
+	*         and release the buffers it used.
+	*/
+	void LockBitstream(std::vector<NV_ENC_OUTPUT_PTR> &vOutputBuffer, int iBuffer, std::vector<uint8_t> &packet);
+
 	/**
 	*  @brief This is a private function which is used to submit the encode
 	*         commands to the NVENC hardware for ME only mode.
@@ -406,4 +441,8 @@ private:
 	int32_t m_iGot = 0;
 	int32_t m_nEncoderBuffer = 0;
 	int32_t m_nOutputDelay = 0;
+	// Guards m_iToSend and m_iGot when frames are submitted and collected on different threads.
+	std::mutex m_asyncMutex;
+	std::condition_variable m_asyncCondition;
+	bool m_bCancelWait = false;
 };
\ No newline at end of file
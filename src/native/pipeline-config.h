@@ -2,6 +2,31 @@
 #define PIPELINE_CONFIG_H
 #include <string>
 
+class BitrateController;
+
+/**
+ * Compressed video formats an encoder may produce.
+ */
+enum VideoCodec
+{
+    H264,
+    HEVC
+};
+
+/**
+ * Bounds for the adaptive bitrate controller, in bits per second.
+ */
+struct PipelineBitrateConfig
+{
+    // Adjust the bitrate at runtime. Otherwise the encoders use their defaults.
+    bool adaptive = false;
+    unsigned initial = 5000000;
+    unsigned min = 1000000;
+    unsigned max = 10000000;
+    // Long run average the recording should stay under, 0 for no budget.
+    unsigned budget = 0;
+};
+
 /**
  * The pipleline config is specified by the client and should not change
  * over the course of the execution.
@@ -12,6 +37,11 @@ struct PipelineVideoConfig
     unsigned screenId = 0;
     std::string windowTitle;
     bool captureCursor = false;
+    // Skip frames that repeat the previous one rather than encoding them again.
+    // The writer records real timestamps so the output plays back correctly.
+    bool variableFrameRate = true;
+    VideoCodec codec = H264;
+    PipelineBitrateConfig bitrate;
 };
 
 struct PipelineAudioConfig
@@ -26,11 +56,51 @@ struct PipelineOutputConfig
     std::string fileName;
 };
 
+/**
+ * What an edge does when the stage downstream of it can not keep up.
+ */
+enum DropPolicy
+{
+    // Wait for the downstream stage, slowing down everything upstream.
+    BACKPRESSURE_BLOCK,
+    // Throw away the oldest queued frame to make room.
+    DROP_OLDEST,
+    // Throw away the frame being pushed.
+    DROP_NEWEST,
+    // Throw away the newest frame that nothing depends on, blocking if there is none.
+    DROP_NON_REFERENCE
+};
+
+/**
+ * Configuration for the edge leading into a stage. With a queue size of 0 the
+ * stage runs on the same thread as the stage before it. Otherwise it gets its
+ * own thread, fed by a queue of up to queueSize frames.
+ */
+struct PipelineEdgeConfig
+{
+    DropPolicy policy = BACKPRESSURE_BLOCK;
+    unsigned queueSize = 0;
+};
+
+/**
+ * What the pipeline publishes to JavaScript through its tap (see pipeline-tap.h).
+ * Video pipelines publish preview frames, audio pipelines their levels.
+ */
+struct PipelineTapConfig
+{
+    bool enabled = false;
+    // Preview frames are scaled down by halving until they are at most this wide.
+    unsigned maxWidth = 320;
+    // Most preview frames published per second.
+    unsigned frameRate = 10;
+};
+
 struct PipelineConfig
 {
     PipelineOutputConfig output;
     PipelineAudioConfig audio;
     PipelineVideoConfig video;
+    PipelineTapConfig tap;
 };
 
 /**
@@ -53,5 +123,8 @@ struct PipelineContext
     unsigned samplesPerSecond;
     unsigned channels;
     unsigned bitsPerSample;
+
+    // Shared by the encoder and the writer when the bitrate is adaptive, otherwise nullptr.
+    BitrateController *bitrateController = nullptr;
 };
 #endif
\ No newline at end of file
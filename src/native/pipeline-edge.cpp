@@ -0,0 +1,130 @@
+#include "pipeline-edge.h"
+
+// How many drop times to keep around for the stats.
+const unsigned MAX_RECENT_DROPS = 64;
+
+PipelineEdge::PipelineEdge(PipelineStage *producingStage, unsigned stage, PipelineEdgeConfig config)
+    : queue(config)
+{
+    producer = producingStage;
+    stats.stage = stage;
+    stats.config = config;
+    created = std::chrono::steady_clock::now();
+}
+
+PipelineEdge::~PipelineEdge()
+{
+    clear();
+}
+
+bool PipelineEdge::push(void *data, const FrameInfo &info)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (closed)
+    {
+        return false;
+    }
+
+    if (queue.isFull())
+    {
+        void *dropped;
+        switch (queue.makeRoom(info, &dropped))
+        {
+        case FrameQueue::DROPPED_INCOMING:
+            recordDrop();
+            return true;
+        case FrameQueue::DROPPED_QUEUED:
+            producer->releaseOutput(dropped);
+            recordDrop();
+            break;
+        case FrameQueue::DROPPED_NONE:
+            break;
+        }
+
+        // Anything that could not make room waits for the consumer.
+        notFull.wait(guard, [this] { return closed || !queue.isFull(); });
+        if (closed)
+        {
+            return false;
+        }
+    }
+
+    // Copy outside of the lock so that a slow copy (e.g. a texture) doesn't hold up the consumer.
+    guard.unlock();
+    void *copy = producer->copyOutput(data);
+    guard.lock();
+
+    queue.push(copy, info);
+    stats.pushed++;
+    if (queue.size() > stats.maxDepth)
+    {
+        stats.maxDepth = queue.size();
+    }
+    notEmpty.notify_one();
+    return true;
+}
+
+bool PipelineEdge::pop(void **data, FrameInfo *info)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    notEmpty.wait(guard, [this] { return closed || queue.size() > 0; });
+    FrameQueue::Frame frame;
+    if (!queue.pop(&frame))
+    {
+        return false;
+    }
+
+    *data = frame.data;
+    *info = frame.info;
+    notFull.notify_one();
+    return true;
+}
+
+void PipelineEdge::release(void *data)
+{
+    producer->releaseOutput(data);
+}
+
+void PipelineEdge::close()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+void PipelineEdge::clear()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &frame : queue.getFrames())
+    {
+        producer->releaseOutput(frame.data);
+    }
+    queue.clear();
+    notFull.notify_all();
+}
+
+PipelineEdgeStats PipelineEdge::getStats()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    PipelineEdgeStats snapshot = stats;
+    snapshot.depth = queue.size();
+    return snapshot;
+}
+
+double PipelineEdge::getFill()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return (double)queue.size() / stats.config.queueSize;
+}
+
+void PipelineEdge::recordDrop()
+{
+    stats.dropped++;
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - created;
+    if (stats.recentDrops.size() >= MAX_RECENT_DROPS)
+    {
+        stats.recentDrops.erase(stats.recentDrops.begin());
+    }
+    stats.recentDrops.push_back(elapsed.count());
+}
@@ -0,0 +1,83 @@
+#ifndef PIPELINE_EDGE_H
+#define PIPELINE_EDGE_H
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "stages/stage.h"
+#include "pipeline-config.h"
+#include "frame-info.h"
+#include "stages/common/frame-queue.h"
+
+/**
+ * A snapshot of the counters kept by an edge.
+ */
+struct PipelineEdgeStats
+{
+    // Index of the stage this edge feeds.
+    unsigned stage = 0;
+    PipelineEdgeConfig config;
+    unsigned depth = 0;
+    unsigned maxDepth = 0;
+    unsigned long long pushed = 0;
+    unsigned long long dropped = 0;
+    // When the most recent drops happened, in milliseconds since the edge was
+    // created. Oldest first.
+    std::vector<double> recentDrops;
+};
+
+/**
+ * A bounded queue between two stages running on different threads.
+ *
+ * The producing stage keeps ownership of whatever it returns from process, so
+ * the edge queues a copy made with PipelineStage::copyOutput and gives it back
+ * to the producer for release once it has been consumed or dropped.
+ */
+class PipelineEdge
+{
+public:
+    PipelineEdge(PipelineStage *producer, unsigned stage, PipelineEdgeConfig config);
+    ~PipelineEdge();
+
+    /**
+     * Queue a copy of data, applying the drop policy if the edge is full.
+     * Returns false if the edge has been closed.
+     */
+    bool push(void *data, const FrameInfo &info);
+
+    /**
+     * Wait for the next frame. Returns false once the edge is closed and empty.
+     * The frame must be handed back with release once it is no longer needed.
+     */
+    bool pop(void **data, FrameInfo *info);
+
+    /** Release a frame returned by pop. */
+    void release(void *data);
+
+    /** Stop accepting frames. Anything already queued can still be popped. */
+    void close();
+
+    /** Release everything still queued. */
+    void clear();
+
+    PipelineEdgeStats getStats();
+
+    /** How full the queue is, from 0 to 1. Cheaper than getStats. */
+    double getFill();
+
+private:
+    // Callers must hold lock.
+    void recordDrop();
+
+    PipelineStage *producer;
+    FrameQueue queue;
+    bool closed = false;
+    std::mutex lock;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    PipelineEdgeStats stats;
+    std::chrono::steady_clock::time_point created;
+};
+#endif
@@ -0,0 +1,117 @@
+#include <cmath>
+#include <cstring>
+
+#include "pipeline-tap.h"
+
+// "QTAP" read as a little endian int32.
+const int32_t TAP_MAGIC_VALUE = 0x50415451;
+const int32_t TAP_VERSION_VALUE = 1;
+// Each slot starts with its sequence number and the frame's timestamp.
+const size_t SLOT_HEADER_SIZE = 16;
+// The levels start with their timestamp, followed by the peaks and the RMS values.
+const size_t LEVELS_SIZE = 8 + MAX_TAP_CHANNELS * 2 * sizeof(float);
+// Timestamps are in 100ns units but published in milliseconds.
+const double TICKS_PER_MS = 10000;
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "The header is shared as plain int32s");
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+PipelineTap::PipelineTap(unsigned width, unsigned height, unsigned channels)
+{
+    frameWidth = width;
+    frameHeight = height;
+    channelCount = channels < MAX_TAP_CHANNELS ? channels : MAX_TAP_CHANNELS;
+
+    levelsOffset = TAP_HEADER_SIZE * sizeof(int32_t);
+    slotOffset = alignUp(levelsOffset + LEVELS_SIZE, 16);
+    slotSize = alignUp(SLOT_HEADER_SIZE + (size_t)stride() * height, 16);
+    memorySize = slotOffset + (width && height ? slotSize * TAP_SLOTS : 0);
+
+    // Zeroed memory reads as "nothing published yet".
+    memory = new unsigned char[memorySize]();
+    header(TAP_MAGIC) = TAP_MAGIC_VALUE;
+    header(TAP_VERSION) = TAP_VERSION_VALUE;
+    header(TAP_SLOT_COUNT) = width && height ? TAP_SLOTS : 0;
+    header(TAP_WIDTH) = width;
+    header(TAP_HEIGHT) = height;
+    header(TAP_STRIDE) = stride();
+    header(TAP_SLOT_OFFSET) = (int32_t)slotOffset;
+    header(TAP_SLOT_SIZE) = (int32_t)slotSize;
+    header(TAP_CHANNELS) = channelCount;
+    header(TAP_LEVELS_OFFSET) = (int32_t)levelsOffset;
+}
+
+PipelineTap::~PipelineTap()
+{
+    delete[] memory;
+}
+
+std::atomic<int32_t> &PipelineTap::header(unsigned index)
+{
+    return reinterpret_cast<std::atomic<int32_t> *>(memory)[index];
+}
+
+std::atomic<int32_t> &PipelineTap::slotSequence(unsigned index)
+{
+    return *reinterpret_cast<std::atomic<int32_t> *>(memory + slotOffset + slotSize * index);
+}
+
+unsigned char *PipelineTap::slot(unsigned index)
+{
+    return memory + slotOffset + slotSize * index;
+}
+
+unsigned char *PipelineTap::beginFrame()
+{
+    // Skip the slot readers are most likely looking at.
+    unsigned latest = header(TAP_LATEST_SLOT).load(std::memory_order_relaxed);
+    writingSlot = (latest + 1) % TAP_SLOTS;
+    // Sequence numbers are per frame, so a reader can also tell a slot was reused.
+    slotSequence(writingSlot).store(frameCount * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot(writingSlot) + SLOT_HEADER_SIZE;
+}
+
+void PipelineTap::endFrame(long long timestamp)
+{
+    double milliseconds = timestamp / TICKS_PER_MS;
+    memcpy(slot(writingSlot) + 8, &milliseconds, sizeof(milliseconds));
+    frameCount++;
+    slotSequence(writingSlot).store(frameCount * 2, std::memory_order_release);
+    header(TAP_LATEST_SLOT).store(writingSlot, std::memory_order_release);
+    header(TAP_FRAME_COUNT).store(frameCount, std::memory_order_release);
+}
+
+void PipelineTap::writeLevels(const short *samples, unsigned frames, unsigned channels, long long timestamp)
+{
+    float peaks[MAX_TAP_CHANNELS] = {0};
+    float rms[MAX_TAP_CHANNELS] = {0};
+    unsigned used = channels < channelCount ? channels : channelCount;
+    for (unsigned channel = 0; channel < used; channel++)
+    {
+        int peak = 0;
+        double sumOfSquares = 0;
+        for (const short *sample = samples + channel; sample < samples + frames * channels; sample += channels)
+        {
+            int value = *sample < 0 ? -*sample : *sample;
+            peak = value > peak ? value : peak;
+            sumOfSquares += (double)value * value;
+        }
+        peaks[channel] = peak / 32768.0f;
+        rms[channel] = frames ? (float)(std::sqrt(sumOfSquares / frames) / 32768.0) : 0;
+    }
+
+    double milliseconds = timestamp / TICKS_PER_MS;
+    auto &sequence = header(TAP_LEVELS_SEQUENCE);
+    sequence.store(++levelsSequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    unsigned char *levels = memory + levelsOffset;
+    memcpy(levels, &milliseconds, sizeof(milliseconds));
+    memcpy(levels + 8, peaks, sizeof(peaks));
+    memcpy(levels + 8 + sizeof(peaks), rms, sizeof(rms));
+    sequence.store(++levelsSequence, std::memory_order_release);
+}
@@ -0,0 +1,95 @@
+#ifndef PIPELINE_TAP_H
+#define PIPELINE_TAP_H
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Most channels the levels are kept for. WASAPI mixes rarely have more than 8.
+const unsigned MAX_TAP_CHANNELS = 8;
+// Frames are written round robin, never into the one published last, so a
+// reader holding the latest frame has two more frames' time to finish with it.
+const unsigned TAP_SLOTS = 3;
+
+/**
+ * Indices into the int32 header at the start of the tap memory. Keep in sync
+ * with src/pipeline-tap.ts.
+ */
+enum PipelineTapHeader
+{
+    TAP_MAGIC,
+    TAP_VERSION,
+    // Bumped once a frame has been completely written.
+    TAP_FRAME_COUNT,
+    // Slot of the most recent complete frame.
+    TAP_LATEST_SLOT,
+    TAP_SLOT_COUNT,
+    TAP_WIDTH,
+    TAP_HEIGHT,
+    // Bytes per row of a frame.
+    TAP_STRIDE,
+    // Byte offset of the first slot, and the byte size of each.
+    TAP_SLOT_OFFSET,
+    TAP_SLOT_SIZE,
+    // Odd while the levels are being written.
+    TAP_LEVELS_SEQUENCE,
+    TAP_CHANNELS,
+    // Byte offset of the levels.
+    TAP_LEVELS_OFFSET,
+    TAP_HEADER_SIZE = 16
+};
+
+/**
+ * Memory shared with JavaScript (as an external ArrayBuffer) through which a
+ * running pipeline publishes decimated preview frames and audio levels.
+ *
+ * Every slot and the levels are guarded by a sequence number that is odd
+ * while they are being written, so a reader can tell whether what it read is
+ * consistent without taking a lock or calling into native code. Frames are
+ * BGRA; levels are linear peak and RMS values from 0 to 1 per channel, peaks
+ * first.
+ *
+ * There is a single writer: the thread running the pipeline's first stage.
+ */
+class PipelineTap
+{
+public:
+    /** A tap without video has width and height 0, one without audio 0 channels. */
+    PipelineTap(unsigned width, unsigned height, unsigned channels);
+    ~PipelineTap();
+
+    void *data() { return memory; }
+    size_t size() { return memorySize; }
+    unsigned width() { return frameWidth; }
+    unsigned height() { return frameHeight; }
+    unsigned stride() { return frameWidth * 4; }
+
+    /**
+     * Claim the next slot. Returns where to write its pixels, which are not
+     * visible to readers until endFrame.
+     */
+    unsigned char *beginFrame();
+    /** Publish the frame started by beginFrame. */
+    void endFrame(long long timestamp);
+
+    /** Publish the levels of a chunk of interleaved 16 bit PCM. */
+    void writeLevels(const short *samples, unsigned frames, unsigned channels, long long timestamp);
+
+private:
+    std::atomic<int32_t> &header(unsigned index);
+    std::atomic<int32_t> &slotSequence(unsigned slot);
+    unsigned char *slot(unsigned slot);
+
+    unsigned char *memory = nullptr;
+    size_t memorySize = 0;
+    unsigned frameWidth;
+    unsigned frameHeight;
+    unsigned channelCount;
+    size_t slotOffset;
+    size_t slotSize;
+    size_t levelsOffset;
+
+    unsigned writingSlot = 0;
+    int32_t frameCount = 0;
+    int32_t levelsSequence = 0;
+};
+#endif
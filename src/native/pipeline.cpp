@@ -1,4 +1,6 @@
 #include <iostream>
+#include <map>
+#include <stdexcept>
 #include <thread>
 
 #include "pipeline.h"
@@ -11,59 +13,211 @@
 #include "stages/file-writer-stage.h"
 #include "stages/gdi-capture-stage.h"
 
-void processingThreadMain(std::vector<PipelineStage *> stages,
-                          std::atomic<bool> &finished,
-                          std::mutex &allowProcessing,
-                          std::string &error)
+// Hardware encoders, fastest first. NVENC's low latency preset keeps up with
+// higher frame rates than AMF's transcoding usage.
+const PipelineStageType VIDEO_ENCODERS[] = {NVENC, AMF};
+
+// FrameInfo timestamps are in 100ns units.
+typedef std::chrono::duration<long long, std::ratio<1, 10000000>> FrameTime;
+
+/**
+ * Runs data through the stages in [begin, end) and pushes whatever comes out
+ * the other end into output, if there is one. A stage may produce any number
+ * of outputs for one input (see PipelineStage::nextOutput), each of which is
+ * run through the rest of the stages in turn.
+ */
+void Pipeline::processStages(unsigned begin, unsigned end, void *data, const FrameInfo &info, PipelineEdge *output)
 {
+    if (begin == end)
+    {
+        if (output)
+        {
+            output->push(data, info);
+        }
+        return;
+    }
+
+    FrameInfo stageInfo = info;
+    auto processStart = std::chrono::steady_clock::now();
+    void *result = stages[begin]->process(data, stageInfo);
+    stageLatency[begin]->Record(std::chrono::duration_cast<FrameTime>(std::chrono::steady_clock::now() - processStart).count());
+    if (begin == 0 && tap && result != nullptr)
+    {
+        publishToTap(result, stageInfo);
+    }
+    // nullptr means this is either the end of a pipeline or a stage got held up.
+    // We don't want to continue processing in this case.
+    while (result != nullptr)
+    {
+        processStages(begin + 1, end, result, stageInfo, output);
+        result = stages[begin]->nextOutput(stageInfo);
+    }
+}
+
+/**
+ * Runs whatever the stages in [begin, end) are still holding on to through the
+ * rest of them, once their input has ended. Stages are flushed in order, so
+ * anything an earlier stage lets go of reaches a later one before it is
+ * flushed in turn.
+ */
+void Pipeline::flushStages(unsigned begin, unsigned end, PipelineEdge *output)
+{
+    try
+    {
+        for (unsigned i = begin; i < end; i++)
+        {
+            FrameInfo info;
+            void *result = stages[i]->flush(info);
+            while (result != nullptr)
+            {
+                processStages(i + 1, end, result, info, output);
+                result = stages[i]->nextOutput(info);
+            }
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cout << "Pipeline process thread failed to flush " << e.what() << std::endl;
+        setError(e.what());
+    }
+}
+
+/**
+ * Hands the output of the first stage to the tap. Only called from the head
+ * thread, which is the tap's single writer.
+ */
+void Pipeline::publishToTap(void *data, const FrameInfo &info)
+{
+    if (preview)
+    {
+        if (info.repeat)
+        {
+            // Nothing new to show, but the last frame may still need publishing.
+            preview->publishPending();
+        }
+        else
+        {
+            preview->capture((ID3D11Texture2D *)data, info.timestamp);
+        }
+    }
+    else if (stageTypes[0] == WASAPI)
+    {
+        auto samples = (DataAndSize *)data;
+        tap->writeLevels((const short *)samples->rawData, samples->size / (audioChannels * sizeof(short)), audioChannels, info.timestamp);
+    }
+}
+
+void Pipeline::setError(const std::string &error)
+{
+    std::lock_guard<std::mutex> guard(errorLock);
+    processingError = error;
+}
+
+/**
+ * Runs the first stages of the pipeline (up to the first queued edge). This is
+ * the thread that drives the pipeline, every other thread just consumes what
+ * it produces.
+ */
+void Pipeline::processHead(unsigned end)
+{
+    PipelineEdge *output = end < stages.size() ? edges[end] : nullptr;
     while (!finished)
     {
         auto hasLock = allowProcessing.try_lock();
         if (!hasLock)
         {
             // Suspend the pipeline stages
-            for (auto &stage : stages)
+            for (unsigned i = 0; i < end; i++)
             {
-                stage->pause();
+                stages[i]->pause();
             }
             // Wait to be allowed to proceed
             allowProcessing.lock();
             // Notify all of the stages that we'll be resuming.
-            for (auto &stage : stages)
+            for (unsigned i = 0; i < end; i++)
             {
-                stage->resume();
+                stages[i]->resume();
             }
         }
 
-        void *data = nullptr;
-        for (auto &stage : stages)
+        FrameInfo info;
+        info.timestamp = std::chrono::duration_cast<FrameTime>(std::chrono::steady_clock::now() - startTime).count();
+        try
         {
-            try
-            {
-                data = stage->process(data);
-            }
-            catch (std::exception e)
-            {
-                // Exceptions are considered unrecoverable. Just log the error, let go of our lock, and
-                // bail.
-                std::cout << "Pipeline process thread encountered an exception " << e.what() << std::endl;
-                allowProcessing.unlock();
-                error = e.what();
-                return;
-            }
-
-            if (data == nullptr)
+            processStages(0, end, nullptr, info, output);
+            if (bitrateController)
             {
-                // This is either the end of a pipeline or a stage got held up.
-                // We don't want to continue processing in this case.
-                break;
+                // Queues backing up is the first sign the encoder is producing more than we can keep up with.
+                double fill = 0;
+                for (auto &edge : edges)
+                {
+                    double edgeFill = edge ? edge->getFill() : 0;
+                    if (edgeFill > fill)
+                    {
+                        fill = edgeFill;
+                    }
+                }
+                bitrateController->observeQueue(fill);
             }
         }
+        catch (std::exception &e)
+        {
+            // Exceptions are considered unrecoverable. Just log the error, let go of our lock, and
+            // bail.
+            std::cout << "Pipeline process thread encountered an exception " << e.what() << std::endl;
+            allowProcessing.unlock();
+            setError(e.what());
+            break;
+        }
 
         // Allow the main thread to potential suspend us for the next iteration.
         allowProcessing.unlock();
     }
-};
+
+    // Let the rest of the pipeline drain whatever is still queued.
+    flushStages(0, end, output);
+    if (output)
+    {
+        output->close();
+    }
+}
+
+/**
+ * Runs the stages in [begin, end), fed by the queued edge in front of begin.
+ * Keeps going until that edge has been closed and drained.
+ */
+void Pipeline::processSegment(unsigned begin, unsigned end)
+{
+    PipelineEdge *input = edges[begin];
+    PipelineEdge *output = end < stages.size() ? edges[end] : nullptr;
+    void *queued = nullptr;
+    FrameInfo info;
+    while (input->pop(&queued, &info))
+    {
+        try
+        {
+            processStages(begin, end, queued, info, output);
+            input->release(queued);
+        }
+        catch (std::exception &e)
+        {
+            std::cout << "Pipeline process thread encountered an exception " << e.what() << std::endl;
+            input->release(queued);
+            setError(e.what());
+            // Stop everything upstream of us, nobody is going to consume their output.
+            finished = true;
+            input->close();
+            input->clear();
+            break;
+        }
+    }
+
+    flushStages(begin, end, output);
+    if (output)
+    {
+        output->close();
+    }
+}
 
 Pipeline::Pipeline(PipelineConfig pipelineConfig)
 {
@@ -72,10 +226,26 @@ Pipeline::Pipeline(PipelineConfig pipelineConfig)
 
 Pipeline::~Pipeline()
 {
+    for (auto &edge : edges)
+    {
+        delete edge;
+    }
     for (auto &stage : stages)
     {
         delete stage;
     }
+    for (auto &latency : stageLatency)
+    {
+        delete latency;
+    }
+    if (bitrateController)
+    {
+        delete bitrateController;
+    }
+    if (preview)
+    {
+        delete preview;
+    }
 }
 
 PipelineStage *createStage(PipelineStageType stageType)
@@ -108,18 +278,174 @@ PipelineStage *createStage(PipelineStageType stageType)
     return stage;
 }
 
-void Pipeline::addStage(PipelineStageType stageType)
+void Pipeline::addStage(PipelineStageType stageType, PipelineEdgeConfig edgeConfig)
 {
     PipelineStage *stage = createStage(stageType);
     stages.push_back(stage);
+    stageTypes.push_back(stageType);
+    stageLatency.push_back(new amf::AMFLatencyStats());
+    edgeConfigs.push_back(edgeConfig);
 };
 
+/**
+ * The cached capabilities of an encoder stage, or nullptr for any other stage.
+ */
+const VideoEncoderCaps *getEncoderCaps(PipelineStageType stageType)
+{
+    switch (stageType)
+    {
+    case NVENC:
+        return &NvencStage::probe();
+    case AMF:
+        return &AmfStage::probe();
+    default:
+        return nullptr;
+    }
+}
+
 bool Pipeline::supportsStage(PipelineStageType stageType)
 {
-    PipelineStage *stage = createStage(stageType);
-    bool isSupported = stage->isSupported();
-    delete stage;
-    return isSupported;
+    // Encoders are the only stages that depend on the hardware, and they cache
+    // what they find, so there's no need to build a stage just to ask.
+    const VideoEncoderCaps *caps = getEncoderCaps(stageType);
+    return caps == nullptr || caps->supported;
+}
+
+bool Pipeline::selectVideoEncoder(PipelineStageType *stageType)
+{
+    for (auto encoder : VIDEO_ENCODERS)
+    {
+        const VideoEncoderCaps *caps = getEncoderCaps(encoder);
+        if (caps->supported && caps->supportsCodec(config.video.codec))
+        {
+            *stageType = encoder;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Stages that produce frames of their own rather than processing their input.
+ */
+bool isCaptureStage(PipelineStageType stageType)
+{
+    return stageType == DESKTOP_DUPLICATION || stageType == GDI_CAPTURE || stageType == WASAPI;
+}
+
+void Pipeline::addGraph(const std::vector<PipelineGraphNode> &nodes, const std::vector<PipelineGraphEdge> &edges)
+{
+    if (stages.size())
+    {
+        throw std::runtime_error("The pipeline already has stages");
+    }
+    if (nodes.empty())
+    {
+        throw std::runtime_error("The graph has no nodes");
+    }
+
+    std::map<std::string, unsigned> indices;
+    for (unsigned i = 0; i < nodes.size(); i++)
+    {
+        if (!indices.emplace(nodes[i].id, i).second)
+        {
+            throw std::runtime_error("Node '" + nodes[i].id + "' is defined more than once");
+        }
+    }
+
+    // Resolve every node up front. Encoders cache what they probed, so this is cheap.
+    std::vector<PipelineStageType> types(nodes.size());
+    for (unsigned i = 0; i < nodes.size(); i++)
+    {
+        bool found = false;
+        if (nodes[i].videoEncoder)
+        {
+            found = selectVideoEncoder(&types[i]);
+        }
+        for (unsigned j = 0; !found && j < nodes[i].stages.size(); j++)
+        {
+            const VideoEncoderCaps *caps = getEncoderCaps(nodes[i].stages[j]);
+            if (caps == nullptr || (caps->supported && caps->supportsCodec(config.video.codec)))
+            {
+                types[i] = nodes[i].stages[j];
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            throw std::runtime_error("Node '" + nodes[i].id + "' has no stage this machine supports");
+        }
+    }
+
+    // Each node has at most one edge in and one edge out, so the graph is a chain.
+    const int NONE = -1;
+    std::vector<int> next(nodes.size(), NONE);
+    std::vector<int> input(nodes.size(), NONE);
+    for (unsigned i = 0; i < edges.size(); i++)
+    {
+        auto from = indices.find(edges[i].from);
+        auto to = indices.find(edges[i].to);
+        if (from == indices.end() || to == indices.end())
+        {
+            throw std::runtime_error("Edge from '" + edges[i].from + "' to '" + edges[i].to + "' refers to an unknown node");
+        }
+        if (next[from->second] != NONE)
+        {
+            throw std::runtime_error("Node '" + edges[i].from + "' has more than one output");
+        }
+        if (input[to->second] != NONE)
+        {
+            throw std::runtime_error("Node '" + edges[i].to + "' has more than one input");
+        }
+        int fromThread = nodes[from->second].thread;
+        int toThread = nodes[to->second].thread;
+        if (fromThread != NONE && toThread != NONE && (fromThread != toThread) != (edges[i].config.queueSize > 0))
+        {
+            throw std::runtime_error("Edge from '" + edges[i].from + "' to '" + edges[i].to +
+                                     (fromThread == toThread ? "' can't have a queue, both nodes are on the same thread"
+                                                             : "' needs a queue, the nodes are on different threads"));
+        }
+        next[from->second] = to->second;
+        input[to->second] = i;
+    }
+
+    int head = NONE;
+    for (unsigned i = 0; i < nodes.size(); i++)
+    {
+        if (input[i] != NONE)
+        {
+            if (isCaptureStage(types[i]))
+            {
+                throw std::runtime_error("Capture node '" + nodes[i].id + "' can't have an input");
+            }
+            continue;
+        }
+        if (head != NONE)
+        {
+            throw std::runtime_error("Nodes '" + nodes[head].id + "' and '" + nodes[i].id + "' both have no input");
+        }
+        head = i;
+    }
+    if (head == NONE || !isCaptureStage(types[head]))
+    {
+        throw std::runtime_error("The graph must start with a capture node");
+    }
+
+    std::vector<unsigned> order;
+    for (int node = head; node != NONE && order.size() < nodes.size(); node = next[node])
+    {
+        order.push_back(node);
+    }
+    if (order.size() != nodes.size())
+    {
+        // With a single head and no branches, whatever wasn't reached is a cycle.
+        throw std::runtime_error("The graph is not a single chain of nodes");
+    }
+
+    for (auto node : order)
+    {
+        addStage(types[node], input[node] == NONE ? PipelineEdgeConfig() : edges[input[node]].config);
+    }
 }
 
 void Pipeline::initialize()
@@ -127,22 +453,95 @@ void Pipeline::initialize()
     if (initialized)
         return;
     PipelineContext context;
+    if (config.video.bitrate.adaptive)
+    {
+        bitrateController = new BitrateController(config.video.bitrate);
+        context.bitrateController = bitrateController;
+    }
     for (auto &stage : stages)
     {
         // Note that initialize can throw, so the caller should be prepared to handle that.
         stage->initialize(&config, &context);
     }
+    if (config.tap.enabled && stages.size())
+    {
+        initializeTap(context);
+    }
     initialized = true;
 }
 
+/**
+ * Sizes the tap for whatever the first stage produces, now that the stages
+ * have filled in the context.
+ */
+void Pipeline::initializeTap(PipelineContext &context)
+{
+    switch (stageTypes[0])
+    {
+    case DESKTOP_DUPLICATION:
+    case GDI_CAPTURE:
+    {
+        unsigned level = TexturePreview::pickLevel(context.inputWidth, config.tap.maxWidth);
+        unsigned width = context.inputWidth >> level;
+        unsigned height = context.inputHeight >> level;
+        tap = std::make_shared<PipelineTap>(width, height > 0 ? height : 1, 0);
+        preview = new TexturePreview((ID3D11Device *)context.d3Device, tap.get(), context.inputWidth, context.inputHeight, level,
+                                     config.tap.frameRate);
+        break;
+    }
+    case WASAPI:
+        if (context.bitsPerSample != 16)
+        {
+            throw std::runtime_error("The tap only supports 16 bit audio");
+        }
+        audioChannels = context.channels;
+        tap = std::make_shared<PipelineTap>(0, 0, audioChannels);
+        break;
+    default:
+        // Nothing the tap knows how to show.
+        break;
+    }
+}
+
 void Pipeline::start()
 {
     initialize();
-    // Start the processing in a new thread.
     finished = false;
-    processingThread = new std::thread(processingThreadMain, stages,
-                                       std::ref(finished), std::ref(allowProcessing),
-                                       std::ref(processingError));
+    startTime = std::chrono::steady_clock::now();
+
+    // Edges from an earlier run are kept until now so their stats outlive stop.
+    for (auto &edge : edges)
+    {
+        delete edge;
+    }
+    // The first stage has nothing in front of it, so it never gets a queue.
+    edges.assign(stages.size(), nullptr);
+    for (unsigned i = 1; i < stages.size(); i++)
+    {
+        if (edgeConfigs[i].queueSize > 0)
+        {
+            edges[i] = new PipelineEdge(stages[i - 1], i, edgeConfigs[i]);
+        }
+    }
+
+    // Split the stages at every queued edge and start a processing thread for each run.
+    unsigned begin = 0;
+    for (unsigned end = 1; end <= stages.size(); end++)
+    {
+        if (end < stages.size() && !edges[end])
+        {
+            continue;
+        }
+        if (begin == 0)
+        {
+            processingThreads.push_back(new std::thread(&Pipeline::processHead, this, end));
+        }
+        else
+        {
+            processingThreads.push_back(new std::thread(&Pipeline::processSegment, this, begin, end));
+        }
+        begin = end;
+    }
 };
 
 void Pipeline::pause()
@@ -165,10 +564,22 @@ void Pipeline::stop()
     }
 
     finished = true;
-    if (processingThread)
+    // Threads are joined in pipeline order, each one drains its input before exiting.
+    for (auto &thread : processingThreads)
+    {
+        thread->join();
+        delete thread;
+    }
+    processingThreads.clear();
+
+    // After an error there may be frames left in a queue. They still belong to the
+    // stage that produced them, so release them before shutting it down.
+    for (auto &edge : edges)
     {
-        processingThread->join();
-        delete processingThread;
+        if (edge)
+        {
+            edge->clear();
+        }
     }
 
     for (auto &stage : stages)
@@ -180,10 +591,34 @@ void Pipeline::stop()
 std::vector<std::string> Pipeline::pollErrors()
 {
     std::vector<std::string> errors;
+    std::lock_guard<std::mutex> guard(errorLock);
     if (processingError.size())
     {
         errors.push_back(processingError);
         processingError.clear();
     }
     return errors;
+}
+
+std::vector<PipelineEdgeStats> Pipeline::getStats()
+{
+    std::vector<PipelineEdgeStats> stats;
+    for (auto &edge : edges)
+    {
+        if (edge)
+        {
+            stats.push_back(edge->getStats());
+        }
+    }
+    return stats;
+}
+
+std::vector<amf::AMFLatencySnapshot> Pipeline::getStageStats()
+{
+    std::vector<amf::AMFLatencySnapshot> stats(stageLatency.size());
+    for (unsigned i = 0; i < stageLatency.size(); i++)
+    {
+        stageLatency[i]->GetSnapshot(&stats[i]);
+    }
+    return stats;
 }
\ No newline at end of file
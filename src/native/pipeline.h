@@ -4,9 +4,17 @@
 #include <vector>
 #include <atomic>
 #include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
 
 #include "stages/stage.h"
 #include "pipeline-config.h"
+#include "pipeline-edge.h"
+#include "pipeline-tap.h"
+#include "stages/common/bitrate-controller.h"
+#include "stages/common/texture-preview.h"
+#include "amf/public/common/LatencyStats.h"
 
 enum PipelineStageType
 {
@@ -19,32 +27,108 @@ enum PipelineStageType
     GDI_CAPTURE
 };
 
+/**
+ * A stage in a graph given to Pipeline::addGraph.
+ */
+struct PipelineGraphNode
+{
+    std::string id;
+    // Alternatives in order of preference. The first one this machine supports is used.
+    std::vector<PipelineStageType> stages;
+    // Use the fastest encoder for the configured codec instead (see selectVideoEncoder).
+    bool videoEncoder = false;
+    // Nodes on different threads must be joined by a queue and nodes on the same
+    // thread must not be. -1 leaves it to the edges.
+    int thread = -1;
+};
+
+/**
+ * A connection between two nodes of a graph, configuring the edge leading into `to`.
+ */
+struct PipelineGraphEdge
+{
+    std::string from;
+    std::string to;
+    PipelineEdgeConfig config;
+};
+
 class Pipeline
 {
 public:
     Pipeline(PipelineConfig config);
     ~Pipeline();
-    void addStage(PipelineStageType stageType);
+    void addStage(PipelineStageType stageType, PipelineEdgeConfig edgeConfig = PipelineEdgeConfig());
+    /**
+     * Add every stage of a graph at once. The graph is checked and every node
+     * resolved to a supported stage before anything is added, and a
+     * std::runtime_error explains what is wrong with an invalid graph.
+     *
+     * Stages run one after the other, so the graph must be a single chain
+     * starting at a capture stage.
+     */
+    void addGraph(const std::vector<PipelineGraphNode> &nodes, const std::vector<PipelineGraphEdge> &edges);
     bool supportsStage(PipelineStageType stageType);
+    /**
+     * Pick the fastest encoder stage that works on this machine and supports
+     * the configured codec. Returns false if there is none.
+     */
+    bool selectVideoEncoder(PipelineStageType *stageType);
     void initialize();
     void start();
     void pause();
     void resume();
     void stop();
     std::vector<std::string> pollErrors();
+    std::vector<PipelineEdgeStats> getStats();
+    /**
+     * How long each stage's process call took, in 100ns units. For the first
+     * stage this includes waiting for the next capture.
+     */
+    std::vector<amf::AMFLatencySnapshot> getStageStats();
+    /**
+     * The tap the first stage's output is published to, or nullptr if the
+     * tap isn't enabled. Only available once initialized.
+     */
+    std::shared_ptr<PipelineTap> getTap() { return tap; }
+
 private:
+    void initializeTap(PipelineContext &context);
+    void publishToTap(void *data, const FrameInfo &info);
+    void processHead(unsigned end);
+    void processSegment(unsigned begin, unsigned end);
+    void processStages(unsigned begin, unsigned end, void *data, const FrameInfo &info, PipelineEdge *output);
+    void flushStages(unsigned begin, unsigned end, PipelineEdge *output);
+    void setError(const std::string &error);
+
     bool initialized = false;
 
     std::atomic<bool> finished;
+    std::mutex errorLock;
     std::string processingError;
     // If the pipeline needs to be paused it will acquire the
-    // allow processing lock and the processing thread will block
-    // until released.
+    // allow processing lock and the head processing thread will block
+    // until released. Threads behind a queued edge simply run dry.
     std::mutex allowProcessing;
     bool paused;
 
-    std::thread *processingThread = nullptr;
+    std::vector<std::thread *> processingThreads;
     std::vector<PipelineStage *> stages;
+    std::vector<PipelineStageType> stageTypes;
+    // stageLatency[i] is only recorded by the thread running stages[i].
+    std::vector<amf::AMFLatencyStats *> stageLatency;
+    // edgeConfigs[i] describes the edge leading into stages[i], and edges[i] is
+    // the matching queue (nullptr when the stage runs inline with the one before).
+    std::vector<PipelineEdgeConfig> edgeConfigs;
+    std::vector<PipelineEdge *> edges;
+    std::chrono::steady_clock::time_point startTime;
+    // Only created when the bitrate is adaptive.
+    BitrateController *bitrateController = nullptr;
+    // JavaScript may hold on to the tap after the pipeline is gone.
+    std::shared_ptr<PipelineTap> tap;
+    // Only created when the tap is enabled on a video pipeline.
+    TexturePreview *preview = nullptr;
+    // How the samples the tap gets are interleaved.
+    unsigned audioChannels = 0;
     PipelineConfig config;
 };
 #endif
\ No newline at end of file
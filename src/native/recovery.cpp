@@ -0,0 +1,427 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "recovery.h"
+#include "stages/common/bitstream.h"
+#include "stages/common/frame-index.h"
+
+// Header size by index version. Version 1 has no codec and is always H264.
+const size_t INDEX_HEADER_SIZES[] = {0, 16, sizeof(FrameIndexHeader)};
+const uint32_t MAX_INDEX_VERSION = 2;
+
+// Without an index the last access unit is searched for in a window at the end
+// of the stream, doubled until one turns up.
+const unsigned TAIL_WINDOW = 1 << 20;
+const unsigned MAX_TAIL_WINDOW = 64 << 20;
+
+// IVF is the simplest container ffmpeg reads that has per frame timestamps.
+const unsigned IVF_HEADER_SIZE = 32;
+const unsigned IVF_FRAME_HEADER_SIZE = 12;
+const uint32_t TIMESTAMPS_PER_SECOND = 10000000;
+
+const unsigned WAV_HEADER_READ = 4096;
+
+typedef std::unique_ptr<FILE, int (*)(FILE *)> File;
+
+static File openFile(const std::string &fileName, const char *mode)
+{
+    FILE *file = nullptr;
+#ifdef _WIN32
+    if (fopen_s(&file, fileName.c_str(), mode) != 0)
+    {
+        file = nullptr;
+    }
+#else
+    file = fopen(fileName.c_str(), mode);
+#endif
+    if (!file)
+    {
+        throw std::runtime_error("Failed to open " + fileName);
+    }
+    return File(file, fclose);
+}
+
+static void seekTo(FILE *file, unsigned long long offset)
+{
+#ifdef _WIN32
+    int failed = _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+    int failed = fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+    if (failed)
+    {
+        throw std::runtime_error("Failed to seek");
+    }
+}
+
+static unsigned long long getFileSize(FILE *file)
+{
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    return _ftelli64(file);
+#else
+    fseeko(file, 0, SEEK_END);
+    return ftello(file);
+#endif
+}
+
+static void readAt(FILE *file, unsigned long long offset, void *data, size_t size)
+{
+    seekTo(file, offset);
+    if (fread(data, 1, size, file) != size)
+    {
+        throw std::runtime_error("Failed to read");
+    }
+}
+
+static void writeAt(FILE *file, unsigned long long offset, const void *data, size_t size)
+{
+    seekTo(file, offset);
+    if (fwrite(data, 1, size, file) != size)
+    {
+        throw std::runtime_error("Failed to write");
+    }
+}
+
+static void truncateFile(FILE *file, unsigned long long size)
+{
+    fflush(file);
+#ifdef _WIN32
+    int failed = _chsize_s(_fileno(file), (long long)size);
+#else
+    int failed = ftruncate(fileno(file), (off_t)size);
+#endif
+    if (failed)
+    {
+        throw std::runtime_error("Failed to truncate");
+    }
+}
+
+static bool endsWith(const std::string &value, const std::string &suffix)
+{
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void putUint16(unsigned char *data, uint16_t value)
+{
+    data[0] = value & 0xff;
+    data[1] = value >> 8;
+}
+
+static void putUint32(unsigned char *data, uint32_t value)
+{
+    putUint16(data, value & 0xffff);
+    putUint16(data + 2, value >> 16);
+}
+
+static void putUint64(unsigned char *data, uint64_t value)
+{
+    putUint32(data, value & 0xffffffff);
+    putUint32(data + 4, value >> 32);
+}
+
+static uint32_t getUint32(const unsigned char *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+/**
+ * Where the stream should be cut when there is no index: in front of the last
+ * access unit, which is the only one that can be partial. Returns size if no
+ * access unit could be found near the end.
+ */
+static unsigned long long findStreamEnd(FILE *file, VideoCodec codec, unsigned long long size)
+{
+    std::vector<unsigned char> window;
+    for (unsigned long long windowSize = TAIL_WINDOW;; windowSize *= 2)
+    {
+        windowSize = std::min(windowSize, size);
+        window.resize((size_t)windowSize);
+        readAt(file, size - windowSize, window.data(), window.size());
+        unsigned start;
+        bool found = findLastAccessUnit(codec, window.data(), (unsigned)windowSize, &start);
+        if (found || windowSize == size)
+        {
+            // At the start of the stream "not found" means there's only the one.
+            return found ? size - windowSize + start : 0;
+        }
+        if (windowSize >= MAX_TAIL_WINDOW)
+        {
+            return size;
+        }
+    }
+}
+
+/**
+ * Read an index, keeping only whole entries. Returns false if there is no
+ * usable index.
+ */
+static bool readIndex(const std::string &fileName, FrameIndexHeader &header, size_t &headerSize,
+                      std::vector<FrameIndexEntry> &entries)
+{
+    FILE *opened = nullptr;
+#ifdef _WIN32
+    fopen_s(&opened, fileName.c_str(), "rb");
+#else
+    opened = fopen(fileName.c_str(), "rb");
+#endif
+    if (!opened)
+    {
+        return false;
+    }
+    File file(opened, fclose);
+    unsigned long long size = getFileSize(file.get());
+    memset(&header, 0, sizeof(header));
+    if (size < 8)
+    {
+        return false;
+    }
+    readAt(file.get(), 0, &header, 8);
+    if (memcmp(header.magic, FRAME_INDEX_MAGIC, sizeof(header.magic)) || header.version < 1 ||
+        header.version > MAX_INDEX_VERSION || size < INDEX_HEADER_SIZES[header.version])
+    {
+        return false;
+    }
+    headerSize = INDEX_HEADER_SIZES[header.version];
+    readAt(file.get(), 0, &header, headerSize);
+    if (header.version < 2)
+    {
+        header.codec = FRAME_INDEX_CODEC_H264;
+    }
+    // A partially written trailing entry is simply dropped.
+    entries.resize((size_t)((size - headerSize) / sizeof(FrameIndexEntry)));
+    if (entries.size())
+    {
+        readAt(file.get(), headerSize, entries.data(), entries.size() * sizeof(FrameIndexEntry));
+    }
+    return true;
+}
+
+/**
+ * Copy the frames of a stream into an IVF file, timed by their index entries.
+ */
+static void writeIvf(FILE *stream, const std::string &fileName, const FrameIndexHeader &header,
+                     const std::vector<FrameIndexEntry> &entries)
+{
+    File output = openFile(fileName, "wb");
+    unsigned char ivfHeader[IVF_HEADER_SIZE] = {'D', 'K', 'I', 'F'};
+    putUint16(ivfHeader + 4, 0);
+    putUint16(ivfHeader + 6, IVF_HEADER_SIZE);
+    memcpy(ivfHeader + 8, header.codec == FRAME_INDEX_CODEC_HEVC ? "HEVC" : "H264", 4);
+    putUint16(ivfHeader + 12, (uint16_t)header.width);
+    putUint16(ivfHeader + 14, (uint16_t)header.height);
+    putUint32(ivfHeader + 16, TIMESTAMPS_PER_SECOND);
+    putUint32(ivfHeader + 20, 1);
+    putUint32(ivfHeader + 24, (uint32_t)entries.size());
+    writeAt(output.get(), 0, ivfHeader, sizeof(ivfHeader));
+
+    // Entries are contiguous, so the stream is read front to back.
+    seekTo(stream, entries[0].offset);
+    std::vector<unsigned char> frame;
+    unsigned char frameHeader[IVF_FRAME_HEADER_SIZE];
+    for (auto &entry : entries)
+    {
+        frame.resize(entry.size);
+        if (fread(frame.data(), 1, frame.size(), stream) != frame.size())
+        {
+            throw std::runtime_error("Failed to read frame");
+        }
+        putUint32(frameHeader, entry.size);
+        putUint64(frameHeader + 4, entry.timestamp - entries[0].timestamp);
+        if (fwrite(frameHeader, 1, sizeof(frameHeader), output.get()) != sizeof(frameHeader) ||
+            fwrite(frame.data(), 1, frame.size(), output.get()) != frame.size())
+        {
+            throw std::runtime_error("Failed to write " + fileName);
+        }
+    }
+}
+
+void RecoveryJob::recoverVideo(RecoveryResult &result, bool complete)
+{
+    File stream = openFile(result.fileName, "r+b");
+    unsigned long long size = getFileSize(stream.get());
+    result.originalSize = size;
+
+    std::string indexName = result.fileName + ".index";
+    FrameIndexHeader header;
+    size_t headerSize = 0;
+    std::vector<FrameIndexEntry> entries;
+    bool indexed = readIndex(indexName, header, headerSize, entries);
+
+    // Keep the frames that made it into both the stream and the index.
+    unsigned long long end = 0;
+    unsigned kept = 0;
+    while (indexed && kept < entries.size() && entries[kept].offset == end && end + entries[kept].size <= size)
+    {
+        end += entries[kept].size;
+        kept++;
+    }
+    if (indexed && !kept && size)
+    {
+        // Nothing made it into the index (it is written in bigger chunks than
+        // the stream), but the stream itself may still be usable.
+        indexed = false;
+    }
+    if (kept)
+    {
+        // Every frame starts with a start code. If the last one doesn't, the
+        // index doesn't belong to this stream.
+        unsigned char startCode[4];
+        unsigned length = entries[kept - 1].size < 4 ? entries[kept - 1].size : 4;
+        readAt(stream.get(), entries[kept - 1].offset, startCode, length);
+        indexed = length >= 3 && startCode[0] == 0 && startCode[1] == 0 &&
+                  (startCode[2] == 1 || (length == 4 && startCode[2] == 0 && startCode[3] == 1));
+    }
+
+    if (indexed)
+    {
+        entries.resize(kept);
+        File index = openFile(indexName, "r+b");
+        truncateFile(index.get(), headerSize + kept * sizeof(FrameIndexEntry));
+        result.frames = kept;
+    }
+    else if (complete)
+    {
+        end = size;
+    }
+    else
+    {
+        VideoCodec codec = endsWith(result.fileName, ".hevc") ? HEVC : H264;
+        end = size ? findStreamEnd(stream.get(), codec, size) : 0;
+    }
+
+    if (end < size)
+    {
+        truncateFile(stream.get(), end);
+    }
+    result.recoveredSize = end;
+
+    if (indexed && kept)
+    {
+        result.wrappedFileName = result.fileName + ".ivf";
+        writeIvf(stream.get(), result.wrappedFileName, header, entries);
+    }
+}
+
+void RecoveryJob::recoverAudio(RecoveryResult &result)
+{
+    File file = openFile(result.fileName, "r+b");
+    unsigned long long size = getFileSize(file.get());
+    result.originalSize = size;
+
+    unsigned char header[WAV_HEADER_READ];
+    size_t headerSize = (size_t)std::min<unsigned long long>(size, sizeof(header));
+    readAt(file.get(), 0, header, headerSize);
+    if (headerSize < 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4))
+    {
+        throw std::runtime_error("Not a WAV file");
+    }
+
+    // Walk the chunks up to the samples. The data chunk's size is not to be
+    // trusted, it is what we're here to fix.
+    unsigned blockAlign = 0;
+    size_t dataOffset = 0;
+    for (size_t chunk = 12; chunk + 8 <= headerSize;)
+    {
+        uint32_t chunkSize = getUint32(header + chunk + 4);
+        if (!memcmp(header + chunk, "data", 4))
+        {
+            dataOffset = chunk + 8;
+            break;
+        }
+        if (!memcmp(header + chunk, "fmt ", 4) && chunk + 8 + 14 <= headerSize)
+        {
+            blockAlign = header[chunk + 8 + 12] | header[chunk + 8 + 13] << 8;
+        }
+        // Chunks are padded to an even size.
+        chunk += 8 + (size_t)chunkSize + (chunkSize & 1);
+    }
+    if (!dataOffset || !blockAlign)
+    {
+        throw std::runtime_error("WAV file has no format or data");
+    }
+
+    // Sizes in the header are 32 bits.
+    unsigned long long dataSize = std::min<unsigned long long>(size - dataOffset, 0xffffffffULL - dataOffset);
+    dataSize -= dataSize % blockAlign;
+    unsigned long long end = dataOffset + dataSize;
+    if (end < size)
+    {
+        truncateFile(file.get(), end);
+    }
+    unsigned char sizeField[4];
+    putUint32(sizeField, (uint32_t)(end - 8));
+    writeAt(file.get(), 4, sizeField, sizeof(sizeField));
+    putUint32(sizeField, (uint32_t)dataSize);
+    writeAt(file.get(), dataOffset - 4, sizeField, sizeof(sizeField));
+    result.recoveredSize = end;
+}
+
+RecoveryJob::RecoveryJob(std::vector<std::string> files, unsigned threads, bool completeFiles)
+{
+    fileNames = files;
+    complete = completeFiles;
+    threadCount = threads ? threads : std::thread::hardware_concurrency();
+    if (!threadCount)
+    {
+        threadCount = 1;
+    }
+}
+
+void RecoveryJob::work(ProgressCallback &onProgress)
+{
+    for (unsigned i = next++; i < fileNames.size(); i = next++)
+    {
+        RecoveryResult &result = results[i];
+        result.fileName = fileNames[i];
+        try
+        {
+            if (endsWith(result.fileName, ".wav"))
+            {
+                recoverAudio(result);
+            }
+            else
+            {
+                recoverVideo(result, complete);
+            }
+        }
+        catch (std::exception &e)
+        {
+            result.error = e.what();
+        }
+
+        std::lock_guard<std::mutex> guard(progressLock);
+        done++;
+        onProgress(result, done, (unsigned)fileNames.size());
+    }
+}
+
+std::vector<RecoveryResult> RecoveryJob::run(ProgressCallback onProgress)
+{
+    results.assign(fileNames.size(), RecoveryResult());
+    next = 0;
+    done = 0;
+
+    // The calling thread is one of the workers.
+    unsigned helpers = std::min<unsigned>(threadCount, (unsigned)fileNames.size());
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < helpers; i++)
+    {
+        threads.emplace_back(&RecoveryJob::work, this, std::ref(onProgress));
+    }
+    work(onProgress);
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return results;
+}
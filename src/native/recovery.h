@@ -0,0 +1,69 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * What became of one raw file left behind by an interrupted recording.
+ */
+struct RecoveryResult
+{
+    std::string fileName;
+    // Empty if the file was recovered.
+    std::string error;
+    unsigned long long originalSize = 0;
+    unsigned long long recoveredSize = 0;
+    // Video frames kept, counting only those with an index entry.
+    unsigned frames = 0;
+    // The video rewrapped as IVF with the real frame timestamps from its index
+    // (see stages/common/frame-index.h), or empty if it has no usable index.
+    std::string wrappedFileName;
+};
+
+/**
+ * Repairs the raw streams (.h264, .hevc and .wav) of interrupted recordings
+ * so they can be muxed without re-encoding.
+ *
+ * - Video is cut after the last frame that is complete in both the stream and
+ *   its index, and rewrapped as IVF using the index. Without an index the
+ *   stream is cut in front of its last access unit, which may be partial.
+ * - Audio is cut to whole sample frames and gets the sizes in its header
+ *   filled in, which the writer never does.
+ *
+ * Files are repaired in place, several at a time.
+ */
+class RecoveryJob
+{
+public:
+    /** Called on a worker thread as each file is finished. */
+    typedef std::function<void(const RecoveryResult &result, unsigned done, unsigned total)> ProgressCallback;
+
+    /**
+     * threads = 0 uses one thread per core. complete means the files were
+     * closed properly, so streams without an index are kept whole rather than
+     * losing their last access unit.
+     */
+    RecoveryJob(std::vector<std::string> fileNames, unsigned threads = 0, bool complete = false);
+
+    /** Repair every file, blocking until done. Results are in input order. */
+    std::vector<RecoveryResult> run(ProgressCallback onProgress);
+
+    static void recoverVideo(RecoveryResult &result, bool complete = false);
+    static void recoverAudio(RecoveryResult &result);
+
+private:
+    void work(ProgressCallback &onProgress);
+
+    std::vector<std::string> fileNames;
+    unsigned threadCount;
+    bool complete;
+    std::vector<RecoveryResult> results;
+    std::atomic<unsigned> next;
+    // Serializes progress callbacks and counts the files finished.
+    std::mutex progressLock;
+    unsigned done = 0;
+};
+#endif
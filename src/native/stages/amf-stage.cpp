@@ -1,9 +1,16 @@
 #include "../amf/public/include/components/VideoEncoderVCE.h"
+#include "../amf/public/include/components/VideoEncoderHEVC.h"
 #include "../amf/public/common/AMFFactory.h"
+#include "../amf/public/common/TraceAdapter.h"
 
 #include "amf-stage.h"
+#include "common/bitstream.h"
+#include "common/bitrate-controller.h"
+#include "common/d3d11-utils.h"
 #include <d3d11.h>
 #include <dxgi1_2.h>
+#include <chrono>
+#include <thread>
 
 inline void throwIfFailAmd(AMF_RESULT res, const char *prefix)
 {
@@ -16,57 +23,180 @@ inline void throwIfFailAmd(AMF_RESULT res, const char *prefix)
     }
 }
 
+// Used when the bitrate isn't adaptive.
+const unsigned DEFAULT_BITRATE = 5000000;
+
+/**
+ * The AVC and HEVC encoders take the same settings under different names.
+ */
+struct AmfEncoderProperties
+{
+    const wchar_t *component;
+    const wchar_t *usage;
+    const wchar_t *targetBitrate;
+    const wchar_t *frameSize;
+    const wchar_t *frameRate;
+    const wchar_t *forcePictureType;
+};
+
+const AmfEncoderProperties AVC_PROPERTIES = {
+    AMFVideoEncoderVCE_AVC,
+    AMF_VIDEO_ENCODER_USAGE,
+    AMF_VIDEO_ENCODER_TARGET_BITRATE,
+    AMF_VIDEO_ENCODER_FRAMESIZE,
+    AMF_VIDEO_ENCODER_FRAMERATE,
+    AMF_VIDEO_ENCODER_FORCE_PICTURE_TYPE,
+};
+
+const AmfEncoderProperties HEVC_PROPERTIES = {
+    AMFVideoEncoder_HEVC,
+    AMF_VIDEO_ENCODER_HEVC_USAGE,
+    AMF_VIDEO_ENCODER_HEVC_TARGET_BITRATE,
+    AMF_VIDEO_ENCODER_HEVC_FRAMESIZE,
+    AMF_VIDEO_ENCODER_HEVC_FRAMERATE,
+    AMF_VIDEO_ENCODER_HEVC_FORCE_PICTURE_TYPE,
+};
+
 void AmfStage::initialize(PipelineConfig *pipelineConfig,
                           PipelineContext *pipelineContext)
 {
     unsigned width = pipelineContext->inputWidth;
     unsigned height = pipelineContext->inputHeight;
     frameRate = pipelineConfig->video.frameRate;
+    variableFrameRate = pipelineConfig->video.variableFrameRate;
+    codec = pipelineConfig->video.codec;
+    const AmfEncoderProperties &properties = codec == HEVC ? HEVC_PROPERTIES : AVC_PROPERTIES;
+    forcePictureType = properties.forcePictureType;
+    if (!probe().supportsCodec(codec))
+    {
+        throw std::runtime_error("AMF does not support the requested codec");
+    }
+    if (!probe().supportsSize(width, height))
+    {
+        throw std::runtime_error("Capture is too large for AMF");
+    }
 
     throwIfFailAmd(g_AMFFactory.Init(), "init");
+    // Keep tracing from the AMF helpers we compile off the encoding thread.
+    traceDeferred = amf::AMFTraceEnableDeferred(true) == AMF_OK;
     // Create the context
     throwIfFailAmd(g_AMFFactory.GetFactory()->CreateContext(&context), "context");
     throwIfFailAmd(context->InitDX11(pipelineContext->d3Device), "initDX11");
-    throwIfFailAmd(g_AMFFactory.GetFactory()->CreateComponent(context, AMFVideoEncoderVCE_AVC, &encoder), "createEncoder");
+    throwIfFailAmd(g_AMFFactory.GetFactory()->CreateComponent(context, properties.component, &encoder), "createEncoder");
 
-    // Configure encoder
-    throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_USAGE, AMF_VIDEO_ENCODER_USAGE_TRANSCONDING), "setEncoder");
-    throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_TARGET_BITRATE, 5000000), "setBitrate");
-    throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_FRAMESIZE, ::AMFConstructSize(width, height)), "setSize");
-    throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_FRAMERATE, ::AMFConstructRate(frameRate, 1)), "setFramerate");
+    // Configure encoder. Both codecs number their usages the same way.
+    throwIfFailAmd(encoder->SetProperty(properties.usage, AMF_VIDEO_ENCODER_USAGE_TRANSCONDING), "setEncoder");
+    bitrateController = pipelineContext->bitrateController;
+    bitrate = bitrateController ? bitrateController->getTargetBitrate(0) : DEFAULT_BITRATE;
+    targetBitrateProperty = properties.targetBitrate;
+    throwIfFailAmd(encoder->SetProperty(properties.targetBitrate, (amf_int64)bitrate), "setBitrate");
+    throwIfFailAmd(encoder->SetProperty(properties.frameSize, ::AMFConstructSize(width, height)), "setSize");
+    throwIfFailAmd(encoder->SetProperty(properties.frameRate, ::AMFConstructRate(frameRate, 1)), "setFramerate");
+    // Every GOP starts with an IDR carrying the parameter sets, so the output can be
+    // decoded from any keyframe.
+    amf_int64 gopLength = frameRate * 2;
+    if (codec == HEVC)
+    {
+        throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_HEVC_GOP_SIZE, gopLength), "setGopSize");
+        throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_HEVC_NUM_GOPS_PER_IDR, 1), "setGopsPerIdr");
+        throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_HEVC_HEADER_INSERTION_MODE, AMF_VIDEO_ENCODER_HEVC_HEADER_INSERTION_MODE_IDR_ALIGNED), "setHeaderInsertion");
+    }
+    else
+    {
+        throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_IDR_PERIOD, gopLength), "setIdrPeriod");
+        throwIfFailAmd(encoder->SetProperty(AMF_VIDEO_ENCODER_HEADER_INSERTION_SPACING, gopLength), "setHeaderInsertion");
+    }
     // Init the encoder and set up a surface to use as an intermediate placeholder.
     throwIfFailAmd(encoder->Init(amf::AMF_SURFACE_BGRA, width, height), "initEncoder");
     throwIfFailAmd(context->AllocSurface(amf::AMF_MEMORY_DX11, amf::AMF_SURFACE_BGRA, width, height, &surface), "allocSurface");
     // Final buffer wher we store transcoded frames. Probably doesn't need to be this big, but whatever.
     result.rawData = new char[width * height * 4];
 }
-void *AmfStage::process(void *input)
+void *AmfStage::process(void *input, FrameInfo &info)
 {
-    // Right now the texture needs to be copied to our surface.
-    // TODO: Can we use the input texture directly?
-    ID3D11DeviceContext *deviceContextDX11 = nullptr;
-    ID3D11Device *deviceDX11 = (ID3D11Device *)context->GetDX11Device();                   // no reference counting - do not Release()
-    ID3D11Texture2D *surfaceDX11 = (ID3D11Texture2D *)surface->GetPlaneAt(0)->GetNative(); // no reference counting - do not Release()
-    deviceDX11->GetImmediateContext(&deviceContextDX11);
-    deviceContextDX11->CopyResource(surfaceDX11, (ID3D11Texture2D *)input);
+    if (info.repeat && variableFrameRate)
+    {
+        // Nothing changed, the previous frame just lasts a little longer. There may
+        // still be packets to hand on though.
+        return nextOutput(info);
+    }
+
+    if (info.repeat)
+    {
+        // Our surface still holds the previous frame, so there is nothing to copy and the
+        // encoder can emit a skip picture.
+        throwIfFailAmd(surface->SetProperty(forcePictureType, AMF_VIDEO_ENCODER_PICTURE_TYPE_SKIP), "forceSkip");
+    }
+    else
+    {
+        // Right now the texture needs to be copied to our surface.
+        // TODO: Can we use the input texture directly?
+        ID3D11DeviceContext *deviceContextDX11 = nullptr;
+        ID3D11Device *deviceDX11 = (ID3D11Device *)context->GetDX11Device();                   // no reference counting - do not Release()
+        ID3D11Texture2D *surfaceDX11 = (ID3D11Texture2D *)surface->GetPlaneAt(0)->GetNative(); // no reference counting - do not Release()
+        deviceDX11->GetImmediateContext(&deviceContextDX11);
+        deviceContextDX11->CopyResource(surfaceDX11, (ID3D11Texture2D *)input);
+        throwIfFailAmd(surface->SetProperty(forcePictureType, AMF_VIDEO_ENCODER_PICTURE_TYPE_NONE), "clearForceSkip");
+    }
+    if (bitrateController)
+    {
+        // The encoder picks up bitrate changes on the next frame.
+        unsigned target = bitrateController->getTargetBitrate(info.timestamp);
+        if (target != bitrate)
+        {
+            bitrate = target;
+            throwIfFailAmd(encoder->SetProperty(targetBitrateProperty, (amf_int64)bitrate), "setBitrate");
+        }
+    }
     surface->SetDuration(1000 / frameRate);
+    // The encoder carries the pts through to its output, which may come out a few frames later.
+    surface->SetPts(info.timestamp);
 
     throwIfFailAmd(encoder->SubmitInput(surface), "submitInput");
+    return nextOutput(info);
+}
 
+void *AmfStage::nextOutput(FrameInfo &info)
+{
     amf::AMFDataPtr data;
-    encoder->QueryOutput(&data);
+    AMF_RESULT res = encoder->QueryOutput(&data);
+    // Once draining, the last frames may still be in the works, so wait for them
+    // until the encoder signals the end.
+    while (draining && data == nullptr && (res == AMF_OK || res == AMF_REPEAT))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        res = encoder->QueryOutput(&data);
+    }
     if (data == nullptr)
     {
         // We're probably still waiting for the pipeline to fill up.
         return nullptr;
     }
     // Copy the data out of the buffer into our raw data.
+    info.timestamp = data->GetPts();
+    info.repeat = false;
     amf::AMFBufferPtr buffer(data);
     memcpy(result.rawData, buffer->GetNative(), buffer->GetSize());
     result.size = buffer->GetSize();
+    describePacket(codec, (unsigned char *)result.rawData, result.size, info);
+    if (bitrateController)
+    {
+        bitrateController->observeFrame(result.size);
+    }
     return &result;
 }
 
+void *AmfStage::flush(FrameInfo &info)
+{
+    if (!encoder)
+    {
+        return nullptr;
+    }
+    throwIfFailAmd(encoder->Drain(), "drain");
+    draining = true;
+    return nextOutput(info);
+}
+
 void AmfStage::shutdown()
 {
     if (encoder)
@@ -80,6 +210,11 @@ void AmfStage::shutdown()
         context->Terminate();
     }
 
+    if (traceDeferred)
+    {
+        amf::AMFTraceEnableDeferred(false);
+        traceDeferred = false;
+    }
     g_AMFFactory.Terminate();
     if (result.rawData)
     {
@@ -88,9 +223,77 @@ void AmfStage::shutdown()
     }
 }
 
-bool AmfStage::isSupported()
+/**
+ * Creates throwaway encoder components to find out what the hardware can do.
+ */
+static VideoEncoderCaps probeAmf()
 {
-    auto result = g_AMFFactory.Init();
+    VideoEncoderCaps caps;
+    if (g_AMFFactory.Init() != AMF_OK)
+    {
+        return caps;
+    }
+
+    ID3D11Device *device = nullptr;
+    ID3D11DeviceContext *deviceContext = nullptr;
+    try
+    {
+        createDeviceAndContext(&device, &deviceContext);
+        amf::AMFContextPtr context;
+        throwIfFailAmd(g_AMFFactory.GetFactory()->CreateContext(&context), "context");
+        throwIfFailAmd(context->InitDX11(device), "initDX11");
+
+        amf::AMFComponentPtr encoder;
+        if (g_AMFFactory.GetFactory()->CreateComponent(context, AMFVideoEncoderVCE_AVC, &encoder) == AMF_OK)
+        {
+            caps.codecs.push_back(H264);
+            amf::AMFCapsPtr encoderCaps;
+            amf::AMFIOCapsPtr inputCaps;
+            if (encoder->GetCaps(&encoderCaps) == AMF_OK && encoderCaps->GetInputCaps(&inputCaps) == AMF_OK)
+            {
+                amf_int32 minWidth, maxWidth, minHeight, maxHeight;
+                inputCaps->GetWidthRange(&minWidth, &maxWidth);
+                inputCaps->GetHeightRange(&minHeight, &maxHeight);
+                caps.maxWidth = maxWidth;
+                caps.maxHeight = maxHeight;
+                encoderCaps->GetProperty(AMF_VIDEO_ENCODER_CAP_BFRAMES, &caps.bFrames);
+            }
+            encoder->Terminate();
+        }
+
+        amf::AMFComponentPtr hevcEncoder;
+        if (g_AMFFactory.GetFactory()->CreateComponent(context, AMFVideoEncoder_HEVC, &hevcEncoder) == AMF_OK)
+        {
+            caps.codecs.push_back(HEVC);
+            hevcEncoder->Terminate();
+        }
+        context->Terminate();
+
+        // Output is always queried separately from input, so AMF never blocks on a frame.
+        caps.async = true;
+        caps.supported = !caps.codecs.empty();
+    }
+    catch (std::exception &e)
+    {
+        std::cout << "AMF probe failed " << e.what() << std::endl;
+        caps = VideoEncoderCaps();
+    }
+
+    if (deviceContext)
+    {
+        deviceContext->Release();
+    }
+    if (device)
+    {
+        device->Release();
+    }
     g_AMFFactory.Terminate();
-    return result == 0;
-}
\ No newline at end of file
+    return caps;
+}
+
+const VideoEncoderCaps &AmfStage::probe()
+{
+    // Initialized once, even if several pipelines ask at the same time.
+    static const VideoEncoderCaps caps = probeAmf();
+    return caps;
+}
@@ -1,19 +1,26 @@
 #ifndef AMF_STAGE_H
 #define AMF_STAGE_H
-#include "stage.h"
+#include "video-encoder.h"
 
 #include "../amf/public/common/AMFFactory.h"
 
 #include "../common.h "
 
-class AmfStage : public PipelineStage
+class AmfStage : public VideoEncoder
 {
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
+    void *nextOutput(FrameInfo &info);
+    void *flush(FrameInfo &info);
     void shutdown();
-    bool isSupported();
+    void *copyOutput(void *output) { return copyDataAndSize(output); };
+    void releaseOutput(void *output) { releaseDataAndSize(output); };
+    const VideoEncoderCaps &getCaps() { return probe(); };
+
+    /** Capabilities of the AMD encoder, probed on first use. */
+    static const VideoEncoderCaps &probe();
 
 private:
     amf::AMFComponentPtr encoder = nullptr;
@@ -21,5 +28,16 @@ private:
     amf::AMFSurfacePtr surface = nullptr;
     DataAndSize result;
     unsigned frameRate;
+    bool variableFrameRate = true;
+    VideoCodec codec = H264;
+    // Names of properties we change while encoding, for the codec being used.
+    const wchar_t *forcePictureType = nullptr;
+    const wchar_t *targetBitrateProperty = nullptr;
+    BitrateController *bitrateController = nullptr;
+    unsigned bitrate = 0;
+    // Whether we turned on deferred AMF tracing, which has to be turned off before the runtime is unloaded.
+    bool traceDeferred = false;
+    // Set once the encoder has been told there is no more input.
+    bool draining = false;
 };
 #endif
\ No newline at end of file
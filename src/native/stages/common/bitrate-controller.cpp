@@ -0,0 +1,91 @@
+#include <algorithm>
+
+#include "bitrate-controller.h"
+
+// How often the target is re-evaluated, in 100ns units.
+const long long UPDATE_INTERVAL = 10000000;
+const double TIMESTAMPS_PER_SECOND = 10000000.0;
+
+// Above this fill the queues are backing up and the bitrate is cut.
+const double QUEUE_HIGH_WATER = 0.5;
+const double DECREASE_FACTOR = 0.7;
+// Increases are a fraction of the configured maximum per interval, so
+// recovering from the minimum takes a little while.
+const double INCREASE_STEP = 0.05;
+// Share of the measured disk throughput the video may use.
+const double DISK_HEADROOM = 0.8;
+// How quickly an overspent storage budget is paid back.
+const double BUDGET_PAYBACK_SECONDS = 60;
+
+BitrateController::BitrateController(PipelineBitrateConfig bitrateConfig)
+{
+    config = bitrateConfig;
+    target = std::min(std::max(config.initial, config.min), config.max);
+}
+
+void BitrateController::observeFrame(unsigned size)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    totalBytes += size;
+}
+
+void BitrateController::observeWrite(unsigned size, double seconds)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    writtenBytes += size;
+    writeSeconds += seconds;
+}
+
+void BitrateController::observeQueue(double fill)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    queueFill = std::max(queueFill, fill);
+}
+
+unsigned BitrateController::getTargetBitrate(long long timestamp)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (!started)
+    {
+        started = true;
+        startTime = timestamp;
+        windowStart = timestamp;
+    }
+    if (timestamp - windowStart >= UPDATE_INTERVAL)
+    {
+        windowStart = timestamp;
+        update((timestamp - startTime) / TIMESTAMPS_PER_SECOND);
+    }
+    return target;
+}
+
+void BitrateController::update(double elapsed)
+{
+    double ceiling = config.max;
+    if (config.budget)
+    {
+        // Spend less than the budget until whatever was overspent has been paid back.
+        double overspent = totalBytes * 8.0 - config.budget * elapsed;
+        ceiling = std::min(ceiling, config.budget - overspent / BUDGET_PAYBACK_SECONDS);
+    }
+    if (writeSeconds > 0)
+    {
+        ceiling = std::min(ceiling, writtenBytes * 8.0 / writeSeconds * DISK_HEADROOM);
+    }
+
+    double next = target;
+    if (queueFill > QUEUE_HIGH_WATER)
+    {
+        next *= DECREASE_FACTOR;
+    }
+    else
+    {
+        next += config.max * INCREASE_STEP;
+    }
+    next = std::min(next, ceiling);
+    target = (unsigned)std::max(next, (double)config.min);
+
+    writtenBytes = 0;
+    writeSeconds = 0;
+    queueFill = 0;
+}
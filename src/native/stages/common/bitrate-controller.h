@@ -0,0 +1,54 @@
+#ifndef BITRATE_CONTROLLER_H
+#define BITRATE_CONTROLLER_H
+
+#include <mutex>
+
+#include "../../pipeline-config.h"
+
+/**
+ * Picks the bitrate the encoder should be using, based on how the rest of the
+ * pipeline is coping. The writer reports how fast it gets data to disk, the
+ * pipeline reports how full its queues are and the encoder reports what it
+ * actually produced. Once per interval of frame time the target is adjusted:
+ * cut sharply when queues back up, otherwise raised slowly towards a ceiling
+ * set by the disk speed, the storage budget and the configured maximum.
+ *
+ * All times come from the caller, so the controller can be driven by a
+ * simulated encoder. Every method may be called from any thread.
+ */
+class BitrateController
+{
+public:
+    BitrateController(PipelineBitrateConfig config);
+
+    /** The encoder produced a frame of size bytes. */
+    void observeFrame(unsigned size);
+
+    /** The writer spent seconds getting size bytes onto the disk. */
+    void observeWrite(unsigned size, double seconds);
+
+    /** How full the fullest queue in the pipeline is, from 0 to 1. */
+    void observeQueue(double fill);
+
+    /** The bitrate to use for the frame captured at timestamp (100ns units). */
+    unsigned getTargetBitrate(long long timestamp);
+
+private:
+    // Callers must hold lock. Elapsed is the frame time since the first frame, in seconds.
+    void update(double elapsed);
+
+    PipelineBitrateConfig config;
+    std::mutex lock;
+    unsigned target;
+
+    bool started = false;
+    long long startTime = 0;
+    long long windowStart = 0;
+    unsigned long long totalBytes = 0;
+
+    // Observations since the last update.
+    unsigned long long writtenBytes = 0;
+    double writeSeconds = 0;
+    double queueFill = 0;
+};
+#endif
@@ -0,0 +1,136 @@
+#include "bitstream.h"
+
+// H264 NAL unit types (ITU-T H.264 table 7-1)
+const unsigned H264_NAL_SLICE = 1;
+const unsigned H264_NAL_IDR = 5;
+const unsigned H264_NAL_SEI = 6;
+const unsigned H264_NAL_SPS = 7;
+const unsigned H264_NAL_PPS = 8;
+const unsigned H264_NAL_AUD = 9;
+
+// HEVC NAL unit types (ITU-T H.265 table 7-1)
+const unsigned HEVC_NAL_MAX_VCL = 31;
+const unsigned HEVC_NAL_MAX_SUB_LAYER_NON_REFERENCE = 14;
+const unsigned HEVC_NAL_BLA_W_LP = 16;
+const unsigned HEVC_NAL_CRA = 21;
+const unsigned HEVC_NAL_VPS = 32;
+const unsigned HEVC_NAL_PPS = 34;
+const unsigned HEVC_NAL_AUD = 35;
+const unsigned HEVC_NAL_PREFIX_SEI = 39;
+
+static unsigned getNalType(VideoCodec codec, unsigned char header)
+{
+    return codec == HEVC ? (header >> 1) & 0x3f : header & 0x1f;
+}
+
+std::vector<NalUnit> findNalUnits(VideoCodec codec, const unsigned char *data, unsigned size)
+{
+    std::vector<NalUnit> units;
+    unsigned zeros = 0;
+    for (unsigned i = 0; i + 1 < size; i++)
+    {
+        // Start codes are two or more zero bytes followed by a one.
+        if (data[i] == 0)
+        {
+            zeros++;
+            continue;
+        }
+        if (data[i] == 1 && zeros >= 2)
+        {
+            // Leading zeros belong to the start code, not to the previous unit.
+            unsigned start = i - (zeros > 3 ? 3 : zeros);
+            if (units.size())
+            {
+                units.back().end = start;
+            }
+            units.push_back({start, i + 1, size, getNalType(codec, data[i + 1])});
+        }
+        zeros = 0;
+    }
+    return units;
+}
+
+void describePacket(VideoCodec codec, const unsigned char *data, unsigned size, FrameInfo &info)
+{
+    info.keyframe = false;
+    info.reference = false;
+    for (auto &unit : findNalUnits(codec, data, size))
+    {
+        if (codec == HEVC)
+        {
+            if (unit.type > HEVC_NAL_MAX_VCL)
+            {
+                continue;
+            }
+            // Even types up to 14 are sub-layer non-reference pictures.
+            bool nonReference = unit.type <= HEVC_NAL_MAX_SUB_LAYER_NON_REFERENCE && unit.type % 2 == 0;
+            info.reference = info.reference || !nonReference;
+            // BLA, IDR and CRA pictures are all random access points.
+            info.keyframe = info.keyframe || (unit.type >= HEVC_NAL_BLA_W_LP && unit.type <= HEVC_NAL_CRA);
+        }
+        else
+        {
+            if (unit.type < H264_NAL_SLICE || unit.type > H264_NAL_IDR)
+            {
+                continue;
+            }
+            // nal_ref_idc is non zero for anything later pictures may reference.
+            info.reference = info.reference || (data[unit.header] & 0x60) != 0;
+            info.keyframe = info.keyframe || unit.type == H264_NAL_IDR;
+        }
+    }
+}
+
+bool extractParameterSets(VideoCodec codec, const unsigned char *data, unsigned size,
+                          std::vector<unsigned char> &parameterSets)
+{
+    parameterSets.clear();
+    for (auto &unit : findNalUnits(codec, data, size))
+    {
+        bool isParameterSet = codec == HEVC
+                                  ? unit.type >= HEVC_NAL_VPS && unit.type <= HEVC_NAL_PPS
+                                  : unit.type == H264_NAL_SPS || unit.type == H264_NAL_PPS;
+        if (isParameterSet)
+        {
+            parameterSets.insert(parameterSets.end(), data + unit.start, data + unit.end);
+        }
+    }
+    return parameterSets.size() > 0;
+}
+
+/**
+ * Units that only ever come before the first slice of an access unit.
+ */
+static bool isAccessUnitPrefix(VideoCodec codec, unsigned type)
+{
+    if (codec == HEVC)
+    {
+        return (type >= HEVC_NAL_VPS && type <= HEVC_NAL_AUD) || type == HEVC_NAL_PREFIX_SEI;
+    }
+    return type >= H264_NAL_SEI && type <= H264_NAL_AUD;
+}
+
+bool findLastAccessUnit(VideoCodec codec, const unsigned char *data, unsigned size, unsigned *start)
+{
+    auto units = findNalUnits(codec, data, size);
+    unsigned headerSize = codec == HEVC ? 2 : 1;
+    for (unsigned i = units.size(); i-- > 0;)
+    {
+        auto &unit = units[i];
+        bool isSlice = codec == HEVC ? unit.type <= HEVC_NAL_MAX_VCL
+                                     : unit.type >= H264_NAL_SLICE && unit.type <= H264_NAL_IDR;
+        // The first bit after the header is first_slice_segment_in_pic_flag for HEVC.
+        // For H264 it is first_mb_in_slice, whose exp-Golomb code for 0 is a single 1.
+        if (!isSlice || unit.header + headerSize >= size || !(data[unit.header + headerSize] & 0x80))
+        {
+            continue;
+        }
+        while (i > 0 && isAccessUnitPrefix(codec, units[i - 1].type))
+        {
+            i--;
+        }
+        *start = units[i].start;
+        return i > 0;
+    }
+    return false;
+}
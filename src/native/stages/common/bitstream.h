@@ -0,0 +1,52 @@
+#ifndef BITSTREAM_H
+#define BITSTREAM_H
+#include <vector>
+
+#include "../../pipeline-config.h"
+#include "../../frame-info.h"
+
+/**
+ * Helpers for the Annex B elementary streams our encoders produce. Everything
+ * here only looks at NAL unit headers, so it works the same for every codec
+ * and doesn't depend on any platform APIs.
+ */
+
+/**
+ * A NAL unit within a packet. Offsets are relative to the start of the packet.
+ */
+struct NalUnit
+{
+    // Where the start code begins.
+    unsigned start;
+    // Where the NAL unit header begins, right after the start code.
+    unsigned header;
+    // One past the last byte of the NAL unit.
+    unsigned end;
+    unsigned type;
+};
+
+/** Split a packet into its NAL units. */
+std::vector<NalUnit> findNalUnits(VideoCodec codec, const unsigned char *data, unsigned size);
+
+/**
+ * Fill in the reference/keyframe flags of info from the NAL units of an
+ * access unit.
+ */
+void describePacket(VideoCodec codec, const unsigned char *data, unsigned size, FrameInfo &info);
+
+/**
+ * Copy the parameter sets (SPS and PPS, plus VPS for HEVC) in a packet,
+ * start codes included, into parameterSets. Returns false if there are none.
+ */
+bool extractParameterSets(VideoCodec codec, const unsigned char *data, unsigned size,
+                          std::vector<unsigned char> &parameterSets);
+
+/**
+ * Find where the last access unit in data begins, counting any delimiter,
+ * parameter sets and SEI in front of its first slice. Returns false if there
+ * is none, or if it begins with the first unit in data. A caller looking at
+ * the tail of a stream can't tell where that one really starts, so should
+ * look further back.
+ */
+bool findLastAccessUnit(VideoCodec codec, const unsigned char *data, unsigned size, unsigned *start);
+#endif
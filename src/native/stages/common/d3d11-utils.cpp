@@ -3,6 +3,7 @@
 #include <sstream>
 #include <vector>
 #include <dxgi1_2.h>
+#include <d3d10.h>
 
 #include "../../common.h"
 
@@ -90,4 +91,79 @@ void createDeviceAndContext(ID3D11Device **device, ID3D11DeviceContext **context
     searchStrings.push_back(L"NVIDIA");
     searchStrings.push_back(L"AMD");
     createSpecificDeviceAndContext(device, context, searchStrings);
+
+    // Stages separated by a queued edge share the immediate context from different threads.
+    ID3D10Multithread *multithread = nullptr;
+    if (SUCCEEDED((*context)->QueryInterface(__uuidof(ID3D10Multithread), (void **)&multithread)))
+    {
+        multithread->SetMultithreadProtected(TRUE);
+        multithread->Release();
+    }
+}
+
+TexturePool::TexturePool(ID3D11Device *poolDevice, ID3D11DeviceContext *poolContext)
+{
+    device = poolDevice;
+    context = poolContext;
+}
+
+TexturePool::~TexturePool()
+{
+    releaseFree();
+}
+
+ID3D11Texture2D *TexturePool::copy(ID3D11Texture2D *source)
+{
+    D3D11_TEXTURE2D_DESC sourceDesc;
+    source->GetDesc(&sourceDesc);
+
+    ID3D11Texture2D *texture = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (sourceDesc.Width != desc.Width || sourceDesc.Height != desc.Height || sourceDesc.Format != desc.Format)
+        {
+            // The source changed shape (e.g. a resolution change), so none of our textures fit anymore.
+            releaseFree();
+            desc = sourceDesc;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.CPUAccessFlags = 0;
+            desc.BindFlags = D3D11_BIND_RENDER_TARGET;
+            desc.MiscFlags = 0;
+        }
+        if (free.size())
+        {
+            texture = free.back();
+            free.pop_back();
+        }
+    }
+
+    if (!texture)
+    {
+        throwIfFail(device->CreateTexture2D(&desc, nullptr, &texture), "Create pooled texture");
+    }
+    context->CopyResource(texture, source);
+    return texture;
+}
+
+void TexturePool::release(ID3D11Texture2D *texture)
+{
+    D3D11_TEXTURE2D_DESC textureDesc;
+    texture->GetDesc(&textureDesc);
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (textureDesc.Width != desc.Width || textureDesc.Height != desc.Height || textureDesc.Format != desc.Format)
+    {
+        texture->Release();
+        return;
+    }
+    free.push_back(texture);
+}
+
+void TexturePool::releaseFree()
+{
+    for (auto &texture : free)
+    {
+        texture->Release();
+    }
+    free.clear();
 }
\ No newline at end of file
@@ -1,7 +1,36 @@
 #ifndef D3D11_UTILS_H
 #define D3D11_UTILS_H
 
+#include <mutex>
+#include <vector>
 #include <d3d11.h>
 
 void createDeviceAndContext(ID3D11Device **device, ID3D11DeviceContext **context);
+
+/**
+ * Hands out copies of a texture, reusing textures that have been given back
+ * rather than creating a new one for every copy. Textures can be given back
+ * from any thread.
+ */
+class TexturePool
+{
+public:
+    TexturePool(ID3D11Device *device, ID3D11DeviceContext *context);
+    ~TexturePool();
+
+    /** Copy source into a texture from the pool. */
+    ID3D11Texture2D *copy(ID3D11Texture2D *source);
+
+    /** Return a texture from copy to the pool. */
+    void release(ID3D11Texture2D *texture);
+
+private:
+    void releaseFree();
+
+    ID3D11Device *device;
+    ID3D11DeviceContext *context;
+    D3D11_TEXTURE2D_DESC desc = {0};
+    std::vector<ID3D11Texture2D *> free;
+    std::mutex lock;
+};
 #endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include "damage-tracker.h"
+
+DamageTracker::DamageTracker(unsigned frameWidth, unsigned frameHeight, unsigned size)
+{
+    width = frameWidth;
+    height = frameHeight;
+    blockSize = size;
+    blocksWide = (width + blockSize - 1) / blockSize;
+    blocksHigh = (height + blockSize - 1) / blockSize;
+    blocks.assign(blocksWide * blocksHigh, 0);
+}
+
+void DamageTracker::add(const DamageRect &rect)
+{
+    int left = std::max(rect.left, 0);
+    int top = std::max(rect.top, 0);
+    int right = std::min(rect.right, (int)width);
+    int bottom = std::min(rect.bottom, (int)height);
+    if (left >= right || top >= bottom)
+    {
+        return;
+    }
+
+    // Round outwards to whole blocks.
+    unsigned firstColumn = left / blockSize;
+    unsigned lastColumn = (right - 1) / blockSize;
+    unsigned firstRow = top / blockSize;
+    unsigned lastRow = (bottom - 1) / blockSize;
+    for (unsigned row = firstRow; row <= lastRow; row++)
+    {
+        unsigned char *block = &blocks[row * blocksWide + firstColumn];
+        for (unsigned column = firstColumn; column <= lastColumn; column++, block++)
+        {
+            damagedBlocks += !*block;
+            *block = 1;
+        }
+    }
+}
+
+void DamageTracker::addAll()
+{
+    std::fill(blocks.begin(), blocks.end(), 1);
+    damagedBlocks = blocks.size();
+}
+
+void DamageTracker::reset()
+{
+    if (damagedBlocks)
+    {
+        std::fill(blocks.begin(), blocks.end(), 0);
+        damagedBlocks = 0;
+    }
+}
+
+std::vector<DamageRect> DamageTracker::getRegions(unsigned maxRegions)
+{
+    std::vector<DamageRect> regions;
+    if (isEmpty())
+    {
+        return regions;
+    }
+    if (damagedBlocks == blocks.size())
+    {
+        regions.push_back({0, 0, (int)width, (int)height});
+        return regions;
+    }
+
+    // Scan a row at a time, turning each horizontal run of damaged blocks into a
+    // rectangle. A run that lines up exactly with a rectangle that ended on the row
+    // above extends that rectangle downwards instead. Everything is in blocks until
+    // the end. open holds the indexes of rectangles that reached the previous row.
+    std::vector<unsigned> open;
+    std::vector<unsigned> stillOpen;
+    for (unsigned row = 0; row < blocksHigh; row++)
+    {
+        const unsigned char *line = &blocks[row * blocksWide];
+        unsigned next = 0;
+        stillOpen.clear();
+        unsigned column = 0;
+        while (column < blocksWide)
+        {
+            if (!line[column])
+            {
+                column++;
+                continue;
+            }
+            unsigned start = column;
+            while (column < blocksWide && line[column])
+            {
+                column++;
+            }
+
+            // Open rectangles are sorted by their left edge, so we only ever move forward.
+            while (next < open.size() && regions[open[next]].left < (int)start)
+            {
+                next++;
+            }
+            if (next < open.size() && regions[open[next]].left == (int)start && regions[open[next]].right == (int)column)
+            {
+                regions[open[next]].bottom = row + 1;
+                stillOpen.push_back(open[next]);
+                next++;
+            }
+            else
+            {
+                regions.push_back({(int)start, (int)row, (int)column, (int)row + 1});
+                stillOpen.push_back(regions.size() - 1);
+            }
+        }
+        open.swap(stillOpen);
+    }
+
+    if (regions.size() > maxRegions)
+    {
+        DamageRect bounds = regions[0];
+        for (auto &region : regions)
+        {
+            bounds.left = std::min(bounds.left, region.left);
+            bounds.top = std::min(bounds.top, region.top);
+            bounds.right = std::max(bounds.right, region.right);
+            bounds.bottom = std::max(bounds.bottom, region.bottom);
+        }
+        regions.clear();
+        regions.push_back(bounds);
+    }
+
+    // Back to pixels, clipping the last row and column of blocks to the frame.
+    for (auto &region : regions)
+    {
+        region.left *= blockSize;
+        region.top *= blockSize;
+        region.right = std::min(region.right * blockSize, width);
+        region.bottom = std::min(region.bottom * blockSize, height);
+    }
+    return regions;
+}
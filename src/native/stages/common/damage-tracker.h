@@ -0,0 +1,58 @@
+#ifndef DAMAGE_TRACKER_H
+#define DAMAGE_TRACKER_H
+
+#include <vector>
+
+/** A rectangle in pixels. Right and bottom are exclusive. */
+struct DamageRect
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+/**
+ * Collects the parts of a frame that changed (e.g. DXGI dirty and move rects)
+ * and merges them into as few block aligned rectangles as possible. Blocks
+ * line up with encoder macroblocks so the regions can be turned directly into
+ * a per macroblock QP map.
+ */
+class DamageTracker
+{
+public:
+    DamageTracker(unsigned width, unsigned height, unsigned blockSize = 16);
+
+    /** Mark a rectangle as changed. It is clipped to the frame. */
+    void add(const DamageRect &rect);
+
+    /** Mark the whole frame as changed. */
+    void addAll();
+
+    /** Forget everything added so far. */
+    void reset();
+
+    bool isEmpty() { return damagedBlocks == 0; }
+
+    /**
+     * The merged regions, in pixels, clipped to the frame. If merging would
+     * produce more than maxRegions rectangles their bounding box is returned instead.
+     */
+    std::vector<DamageRect> getRegions(unsigned maxRegions = 32);
+
+    /** One byte per block in raster order, non zero where the block changed. */
+    const std::vector<unsigned char> &getBlockMap() { return blocks; }
+
+    unsigned getBlocksWide() { return blocksWide; }
+    unsigned getBlocksHigh() { return blocksHigh; }
+
+private:
+    unsigned width;
+    unsigned height;
+    unsigned blockSize;
+    unsigned blocksWide;
+    unsigned blocksHigh;
+    unsigned damagedBlocks = 0;
+    std::vector<unsigned char> blocks;
+};
+#endif
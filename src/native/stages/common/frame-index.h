@@ -0,0 +1,47 @@
+#ifndef FRAME_INDEX_H
+#define FRAME_INDEX_H
+
+#include <stdint.h>
+
+/**
+ * The file writer keeps an index next to every raw stream it writes
+ * (<fileName>.index). It is a header followed by one entry per frame, and is
+ * what lets post-processing recover the real timestamps of a variable frame
+ * rate recording. Every keyframe entry starts with the stream's parameter
+ * sets, so decoding can begin at any of them. Everything is little endian.
+ * The FFmpeg demuxer's KeyframeIndex.cpp reads the same layout with its own
+ * copy of these definitions, and test/native/keyframe-index-test.cpp checks
+ * that the two agree.
+ */
+const char FRAME_INDEX_MAGIC[4] = {'Q', 'I', 'D', 'X'};
+// Version 2 added the codec to the header. Version 1 streams are always H264.
+const uint32_t FRAME_INDEX_VERSION = 2;
+
+// Header codecs
+const uint32_t FRAME_INDEX_CODEC_H264 = 0;
+const uint32_t FRAME_INDEX_CODEC_HEVC = 1;
+
+// Entry flags
+const uint32_t FRAME_INDEX_KEYFRAME = 1;
+
+#pragma pack(push, 1)
+struct FrameIndexHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t codec;
+};
+
+struct FrameIndexEntry
+{
+    // Where the frame starts in the raw stream, and how many bytes it takes.
+    uint64_t offset;
+    uint32_t size;
+    uint32_t flags;
+    // FrameInfo timestamp, in 100ns units since the pipeline started.
+    int64_t timestamp;
+};
+#pragma pack(pop)
+#endif
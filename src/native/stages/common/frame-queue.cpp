@@ -0,0 +1,94 @@
+#include <iterator>
+
+#include "frame-queue.h"
+
+FrameQueue::FrameQueue(PipelineEdgeConfig edgeConfig)
+{
+    config = edgeConfig;
+}
+
+FrameQueue::Drop FrameQueue::makeRoom(const FrameInfo &incoming, void **droppedData)
+{
+    switch (config.policy)
+    {
+    case DROP_NEWEST:
+        // Cheapest case, we never need to copy the frame.
+        dropped(incoming, frames.size());
+        return DROPPED_INCOMING;
+    case DROP_OLDEST:
+    {
+        Frame oldest = frames.front();
+        frames.pop_front();
+        dropped(oldest.info, 0);
+        *droppedData = oldest.data;
+        return DROPPED_QUEUED;
+    }
+    case DROP_NON_REFERENCE:
+        if (!incoming.reference)
+        {
+            dropped(incoming, frames.size());
+            return DROPPED_INCOMING;
+        }
+        // Look for the newest queued frame that nothing else depends on.
+        for (auto it = frames.rbegin(); it != frames.rend(); it++)
+        {
+            if (!it->info.reference)
+            {
+                Frame frame = *it;
+                size_t next = frames.erase(std::next(it).base()) - frames.begin();
+                dropped(frame.info, next);
+                *droppedData = frame.data;
+                return DROPPED_QUEUED;
+            }
+        }
+        return DROPPED_NONE;
+    case BACKPRESSURE_BLOCK:
+        break;
+    }
+    return DROPPED_NONE;
+}
+
+void FrameQueue::push(void *data, const FrameInfo &info)
+{
+    frames.push_back({data, info});
+    if (changeDropped)
+    {
+        forgetPrevious(frames.back().info);
+        changeDropped = false;
+    }
+}
+
+bool FrameQueue::pop(Frame *frame)
+{
+    if (frames.empty())
+    {
+        return false;
+    }
+    *frame = frames.front();
+    frames.pop_front();
+    return true;
+}
+
+void FrameQueue::dropped(const FrameInfo &info, size_t next)
+{
+    // Whatever came after a frame with changes was described relative to it, so
+    // once it is gone the next frame is neither a repeat nor only partly changed.
+    if (info.repeat)
+    {
+        return;
+    }
+    if (next < frames.size())
+    {
+        forgetPrevious(frames[next].info);
+    }
+    else
+    {
+        changeDropped = true;
+    }
+}
+
+void FrameQueue::forgetPrevious(FrameInfo &info)
+{
+    info.repeat = false;
+    info.damage.clear();
+}
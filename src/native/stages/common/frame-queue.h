@@ -0,0 +1,67 @@
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+#include <deque>
+
+#include "../../pipeline-config.h"
+#include "../../frame-info.h"
+
+/**
+ * The frames queued on a pipeline edge, and which of them go when it is full.
+ *
+ * Frames are described relative to the one before them (see FrameInfo), so a
+ * drop also rewrites whatever followed the dropped frame. Not thread safe, the
+ * edge holds its lock around every call.
+ */
+class FrameQueue
+{
+public:
+    struct Frame
+    {
+        void *data;
+        FrameInfo info;
+    };
+
+    enum Drop
+    {
+        // Nothing could be dropped, the caller has to wait for room.
+        DROPPED_NONE,
+        // The incoming frame should not be queued.
+        DROPPED_INCOMING,
+        // A queued frame was removed, its data has to be released.
+        DROPPED_QUEUED
+    };
+
+    FrameQueue(PipelineEdgeConfig config);
+
+    /**
+     * Apply the drop policy to a full queue before incoming is pushed. When a
+     * queued frame is dropped, its data is returned through dropped.
+     */
+    Drop makeRoom(const FrameInfo &incoming, void **dropped);
+
+    void push(void *data, const FrameInfo &info);
+
+    /** Take the oldest frame. Returns false if there is none. */
+    bool pop(Frame *frame);
+
+    /** Everything still queued, oldest first. */
+    const std::deque<Frame> &getFrames() { return frames; }
+    void clear() { frames.clear(); }
+
+    unsigned size() { return frames.size(); }
+    bool isFull() { return frames.size() >= config.queueSize; }
+
+    /** Make info stand on its own, now that the frame before it is gone. */
+    static void forgetPrevious(FrameInfo &info);
+
+private:
+    // next is the index of the frame that followed the dropped one, or the size
+    // of the queue if that is the next one pushed.
+    void dropped(const FrameInfo &info, size_t next);
+
+    PipelineEdgeConfig config;
+    std::deque<Frame> frames;
+    // A frame with changes was dropped and the next frame pushed has to make up for it.
+    bool changeDropped = false;
+};
+#endif
@@ -0,0 +1,140 @@
+#include <cstring>
+
+#include "../../common.h"
+
+#include "texture-preview.h"
+
+const long long TIMESTAMPS_PER_SECOND = 10000000;
+const DXGI_FORMAT PREVIEW_FORMAT = DXGI_FORMAT_B8G8R8A8_UNORM;
+
+TexturePreview::TexturePreview(ID3D11Device *previewDevice, PipelineTap *previewTap, unsigned frameWidth, unsigned frameHeight,
+                               unsigned mipLevel, unsigned frameRate)
+{
+    device = previewDevice;
+    tap = previewTap;
+    width = frameWidth;
+    height = frameHeight;
+    level = mipLevel;
+    interval = TIMESTAMPS_PER_SECOND / (frameRate ? frameRate : 1);
+    device->GetImmediateContext(&context);
+
+    D3D11_TEXTURE2D_DESC desc = {0};
+    desc.ArraySize = 1;
+    desc.SampleDesc.Count = 1;
+    desc.Format = PREVIEW_FORMAT;
+    if (level > 0)
+    {
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = level + 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+        desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+        throwIfFail(device->CreateTexture2D(&desc, nullptr, &mipTexture), "Create preview mip texture");
+        throwIfFail(device->CreateShaderResourceView(mipTexture, nullptr, &mipView), "Create preview view");
+    }
+
+    desc.Width = tap->width();
+    desc.Height = tap->height();
+    desc.MipLevels = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.MiscFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    throwIfFail(device->CreateTexture2D(&desc, nullptr, &staging), "Create preview staging texture");
+}
+
+TexturePreview::~TexturePreview()
+{
+    if (staging)
+    {
+        staging->Release();
+    }
+    if (mipView)
+    {
+        mipView->Release();
+    }
+    if (mipTexture)
+    {
+        mipTexture->Release();
+    }
+    if (context)
+    {
+        context->Release();
+    }
+}
+
+unsigned TexturePreview::pickLevel(unsigned width, unsigned maxWidth)
+{
+    unsigned level = 0;
+    while ((width >> level) > maxWidth && (width >> (level + 1)) > 0)
+    {
+        level++;
+    }
+    return level;
+}
+
+void TexturePreview::publishPending()
+{
+    if (!pending)
+    {
+        return;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT hr = context->Map(staging, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+    {
+        // Try again with the next frame rather than stalling the capture.
+        return;
+    }
+    throwIfFail(hr, "Map preview");
+
+    unsigned char *destination = tap->beginFrame();
+    const unsigned char *source = (const unsigned char *)mapped.pData;
+    for (unsigned y = 0; y < tap->height(); y++)
+    {
+        memcpy(destination + y * tap->stride(), source + y * mapped.RowPitch, tap->stride());
+    }
+    context->Unmap(staging, 0);
+    tap->endFrame(pendingTimestamp);
+    pending = false;
+}
+
+void TexturePreview::capture(ID3D11Texture2D *texture, long long timestamp)
+{
+    publishPending();
+    // The staging texture is still in use, so this frame is skipped.
+    if (pending || timestamp < nextFrame)
+    {
+        return;
+    }
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+    if (desc.Width != width || desc.Height != height || desc.Format != PREVIEW_FORMAT)
+    {
+        // The capture changed shape under us, which the tap can't describe.
+        return;
+    }
+
+    if (mipTexture)
+    {
+        context->CopySubresourceRegion(mipTexture, 0, 0, 0, 0, texture, 0, nullptr);
+        context->GenerateMips(mipView);
+        context->CopySubresourceRegion(staging, 0, 0, 0, 0, mipTexture, level, nullptr);
+    }
+    else
+    {
+        context->CopyResource(staging, texture);
+    }
+    pending = true;
+    pendingTimestamp = timestamp;
+
+    // Keep to the frame rate on average, but don't try to catch up after a stall.
+    nextFrame += interval;
+    if (nextFrame <= timestamp)
+    {
+        nextFrame = timestamp + interval;
+    }
+}
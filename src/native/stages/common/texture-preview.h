@@ -0,0 +1,50 @@
+#ifndef TEXTURE_PREVIEW_H
+#define TEXTURE_PREVIEW_H
+
+#include <d3d11.h>
+
+#include "../../pipeline-tap.h"
+
+/**
+ * Scales captured frames down on the GPU and publishes them to a tap at a
+ * limited frame rate.
+ *
+ * The frame is reduced by generating mips, and the mip the tap is sized for is
+ * copied to a staging texture. That copy is only read back on a later capture,
+ * once the GPU is done with it, so the capture thread never waits on the GPU.
+ */
+class TexturePreview
+{
+public:
+    /** width and height are the size of the captured frames. */
+    TexturePreview(ID3D11Device *device, PipelineTap *tap, unsigned width, unsigned height, unsigned mipLevel, unsigned frameRate);
+    ~TexturePreview();
+
+    /** The smallest mip level of a frame that is at most maxWidth wide. */
+    static unsigned pickLevel(unsigned width, unsigned maxWidth);
+
+    /** Start scaling down a frame, if one is due. */
+    void capture(ID3D11Texture2D *texture, long long timestamp);
+
+    /** Publish the frame started by an earlier capture if the GPU has finished it. */
+    void publishPending();
+
+private:
+    ID3D11Device *device;
+    ID3D11DeviceContext *context = nullptr;
+    PipelineTap *tap;
+    unsigned width;
+    unsigned height;
+    unsigned level;
+    // Only created when the frame is actually scaled down (level > 0).
+    ID3D11Texture2D *mipTexture = nullptr;
+    ID3D11ShaderResourceView *mipView = nullptr;
+    ID3D11Texture2D *staging = nullptr;
+
+    bool pending = false;
+    long long pendingTimestamp = 0;
+    // In 100ns units, like frame timestamps.
+    long long interval;
+    long long nextFrame = 0;
+};
+#endif
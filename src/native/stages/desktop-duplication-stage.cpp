@@ -3,8 +3,13 @@
 #include "desktop-duplication-stage.h"
 #include "common/d3d11-utils.h"
 
-void *DesktopDuplicationStage::process(void *input)
+void *DesktopDuplicationStage::process(void *input, FrameInfo &info)
 {
+	// Raw frames don't depend on each other, so any of them can be encoded alone. Repeats
+	// can be dropped freely, while frames with changes are marked as references below.
+	info.keyframe = true;
+	info.reference = false;
+
 	if (!duplication)
 	{
 		// Normally we should have a duplication, but during screen size changes we may not.
@@ -13,6 +18,7 @@ void *DesktopDuplicationStage::process(void *input)
 		if (!duplication)
 		{
 			totalFrameCount++;
+			info.repeat = true;
 			return texture; // Return the most recent frame we were able to capture.
 		}
 	}
@@ -31,6 +37,7 @@ void *DesktopDuplicationStage::process(void *input)
 		// If we got a timeout that's fine, we'll return our most recent texture and hang out for a minute.
 		if (hr == DXGI_ERROR_WAIT_TIMEOUT)
 		{
+			info.repeat = true;
 			return texture;
 		}
 		else if (hr == DXGI_ERROR_ACCESS_LOST || hr == DXGI_ERROR_INVALID_CALL)
@@ -40,6 +47,7 @@ void *DesktopDuplicationStage::process(void *input)
 			// the output.
 			duplication->Release();
 			duplication = nullptr;
+			info.repeat = true;
 			return texture;
 		}
 		else
@@ -51,9 +59,31 @@ void *DesktopDuplicationStage::process(void *input)
 	// If we get at least one frame you can try to reinit the next time you hit an error.
 	canReinitialize = true;
 
+	// A frame with no accumulated frames only carries a pointer update. Unless we draw the
+	// cursor ourselves the image is unchanged, so skip the copy and flag it as a repeat.
+	bool pointerMoved = captureCursor && frameInfo.LastMouseUpdateTime.QuadPart != 0;
+	if (texture && frameInfo.AccumulatedFrames == 0 && !pointerMoved)
+	{
+		resource->Release();
+		duplication->ReleaseFrame();
+		info.repeat = true;
+		return texture;
+	}
+
+	// The repeats that follow this frame only show its changes if it gets through.
+	info.reference = true;
+
 	ID3D11Texture2D *frameTexture;
 	throwIfFail(resource->QueryInterface(IID_PPV_ARGS(&frameTexture)), "Query texture");
 
+	// Work out which parts of the frame changed, so we only have to copy those. A fresh
+	// texture has nothing in it yet, so it needs everything.
+	damage->reset();
+	if (!texture || !addFrameDamage(frameInfo))
+	{
+		damage->addAll();
+	}
+
 	// Create our middle man texture if necessary
 	if (!texture)
 	{
@@ -71,34 +101,63 @@ void *DesktopDuplicationStage::process(void *input)
 		throwIfFail(device->CreateTexture2D(&desc, nullptr, &texture), "Create texture");
 	}
 
+	// The cursor we drew last time is baked into our texture, so that area has to be
+	// restored. Wherever we draw it this time changes as well.
+	CURSORINFO cursorInfo = {0};
+	bool drawCursor = false;
+	if (captureCursor)
+	{
+		if (hasCursorRect)
+		{
+			damage->add(cursorRect);
+			hasCursorRect = false;
+		}
+		cursorInfo.cbSize = sizeof(cursorInfo);
+		if (GetCursorInfo(&cursorInfo) && cursorInfo.flags == CURSOR_SHOWING)
+		{
+			drawCursor = true;
+			cursorRect.left = cursorInfo.ptScreenPos.x;
+			cursorRect.top = cursorInfo.ptScreenPos.y;
+			cursorRect.right = cursorRect.left + GetSystemMetrics(SM_CXICON);
+			cursorRect.bottom = cursorRect.top + GetSystemMetrics(SM_CYICON);
+			damage->add(cursorRect);
+		}
+	}
+
 	// Copy out of the frame texture into our own.
-	context->CopyResource(texture, frameTexture);
+	info.damage = damage->getRegions();
+	if (info.damage.size() == 1 && info.damage[0].right - info.damage[0].left == (int)width &&
+		info.damage[0].bottom - info.damage[0].top == (int)height)
+	{
+		context->CopyResource(texture, frameTexture);
+	}
+	else
+	{
+		for (auto &region : info.damage)
+		{
+			D3D11_BOX box = {(UINT)region.left, (UINT)region.top, 0, (UINT)region.right, (UINT)region.bottom, 1};
+			context->CopySubresourceRegion(texture, 0, region.left, region.top, 0, frameTexture, 0, &box);
+		}
+	}
 
 	// Now that we've gotten a frame we can release it from the duplication.
 	duplication->ReleaseFrame();
 
 	// Apply the cursor if necessary
-	if (captureCursor)
+	if (drawCursor)
 	{
-		CURSORINFO cursorInfo = {0};
-		cursorInfo.cbSize = sizeof(cursorInfo);
-		if (GetCursorInfo(&cursorInfo))
+		IDXGISurface1 *surface;
+		auto hr = texture->QueryInterface(IID_PPV_ARGS(&surface));
+		if (!FAILED(hr))
 		{
-			if (cursorInfo.flags == CURSOR_SHOWING)
-			{
-				IDXGISurface1 *surface;
-				auto hr = texture->QueryInterface(IID_PPV_ARGS(&surface));
-				if (!FAILED(hr))
-				{
-					HDC hdc;
-					surface->GetDC(FALSE, &hdc);
-					DrawIconEx(hdc, cursorInfo.ptScreenPos.x, cursorInfo.ptScreenPos.y,
-							   cursorInfo.hCursor, 0, 0, 0, 0, DI_NORMAL | DI_DEFAULTSIZE);
-					surface->ReleaseDC(nullptr);
-				}
-				surface->Release();
-			}
+			HDC hdc;
+			surface->GetDC(FALSE, &hdc);
+			DrawIconEx(hdc, cursorInfo.ptScreenPos.x, cursorInfo.ptScreenPos.y,
+					   cursorInfo.hCursor, 0, 0, 0, 0, DI_NORMAL | DI_DEFAULTSIZE);
+			surface->ReleaseDC(nullptr);
+			hasCursorRect = true;
 		}
+		surface->Release();
 	}
 
 	return texture;
@@ -126,13 +185,21 @@ void DesktopDuplicationStage::initialize(PipelineConfig *pipelineConfig,
 	pipelineContext->d3Device = (void *)device;
 	pipelineContext->inputWidth = duplDesc.ModeDesc.Width;
 	pipelineContext->inputHeight = duplDesc.ModeDesc.Height;
+	width = duplDesc.ModeDesc.Width;
+	height = duplDesc.ModeDesc.Height;
+	damage = new DamageTracker(width, height);
 
 	// Mark the start time so we can aim for our target fps.
 	limiter = new Limiter(frameRate);
+	texturePool = new TexturePool(device, context);
 }
 
 void DesktopDuplicationStage::shutdown()
 {
+	if (texturePool)
+		delete texturePool;
+	if (damage)
+		delete damage;
 	if (context)
 		context->Release();
 	if (device)
@@ -174,8 +241,65 @@ void DesktopDuplicationStage::initializeDuplication()
 	DxgiOutput1->Release();
 }
 
+/**
+ * Adds the move and dirty rects of the frame we just acquired to the damage tracker.
+ * Returns false if we couldn't get them, in which case the whole frame should be
+ * treated as changed.
+ */
+bool DesktopDuplicationStage::addFrameDamage(DXGI_OUTDUPL_FRAME_INFO &frameInfo)
+{
+	if (frameInfo.AccumulatedFrames == 0)
+	{
+		// Only the pointer changed.
+		return true;
+	}
+	if (frameInfo.TotalMetadataBufferSize == 0)
+	{
+		return false;
+	}
+	if (metadata.size() < frameInfo.TotalMetadataBufferSize)
+	{
+		metadata.resize(frameInfo.TotalMetadataBufferSize);
+	}
+
+	// Move rects come first in the buffer, dirty rects fill the rest. A moved region only
+	// changes where it lands, whatever it uncovered is reported as dirty.
+	UINT moveSize = 0;
+	auto moves = (DXGI_OUTDUPL_MOVE_RECT *)metadata.data();
+	if (FAILED(duplication->GetFrameMoveRects(metadata.size(), moves, &moveSize)))
+	{
+		return false;
+	}
+	for (unsigned i = 0; i < moveSize / sizeof(DXGI_OUTDUPL_MOVE_RECT); i++)
+	{
+		RECT &rect = moves[i].DestinationRect;
+		damage->add({rect.left, rect.top, rect.right, rect.bottom});
+	}
+
+	UINT dirtySize = 0;
+	auto dirty = (RECT *)(metadata.data() + moveSize);
+	if (FAILED(duplication->GetFrameDirtyRects(metadata.size() - moveSize, dirty, &dirtySize)))
+	{
+		return false;
+	}
+	for (unsigned i = 0; i < dirtySize / sizeof(RECT); i++)
+	{
+		damage->add({dirty[i].left, dirty[i].top, dirty[i].right, dirty[i].bottom});
+	}
+	return true;
+}
+
 void DesktopDuplicationStage::resume()
 {
 	if (limiter)
 		limiter->reset();
+}
+void *DesktopDuplicationStage::copyOutput(void *output)
+{
+	return texturePool->copy((ID3D11Texture2D *)output);
+}
+
+void DesktopDuplicationStage::releaseOutput(void *output)
+{
+	texturePool->release((ID3D11Texture2D *)output);
 }
\ No newline at end of file
@@ -1,24 +1,30 @@
 #ifndef DESKTOP_DUPLICATION_STAGE_H
 #define DESKTOP_DUPLICATION_STAGE_H
 
+#include <vector>
 #include <d3d11.h>
 #include <dxgi1_2.h>
 
 #include "stage.h"
 #include "common/limiter.h"
+#include "common/d3d11-utils.h"
+#include "common/damage-tracker.h"
 
 class DesktopDuplicationStage : public PipelineStage
 {
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
     void shutdown();
+    void *copyOutput(void *output);
+    void releaseOutput(void *output);
 
     void resume();
 
 private:
     void initializeDuplication();
+    bool addFrameDamage(DXGI_OUTDUPL_FRAME_INFO &frameInfo);
 
     ID3D11Device *device = nullptr;
     ID3D11DeviceContext *context = nullptr;
@@ -27,9 +33,18 @@ private:
     ID3D11Texture2D *texture = nullptr;
 
     Limiter *limiter = nullptr;
+    TexturePool *texturePool = nullptr;
+    DamageTracker *damage = nullptr;
+    // Scratch space for the move and dirty rects of a frame.
+    std::vector<unsigned char> metadata;
+    // Where we drew the cursor into texture last, if we did.
+    DamageRect cursorRect;
+    bool hasCursorRect = false;
     unsigned long totalFrameCount = 0;
     unsigned screenId = 0;
     unsigned frameRate = 0;
+    unsigned width = 0;
+    unsigned height = 0;
     bool canReinitialize = true;
     bool captureCursor = false;
 };
@@ -1,5 +1,13 @@
+#include <io.h>
+
 #include "../common.h"
 #include "file-writer-stage.h"
+#include "common/frame-index.h"
+#include "common/bitstream.h"
+#include "common/bitrate-controller.h"
+
+// How often the file is committed to disk to measure its throughput.
+const std::chrono::seconds WRITE_WINDOW(1);
 
 void FileWriterStage::initialize(PipelineConfig *pipelineConfig,
                                  PipelineContext *pipelineContext)
@@ -9,20 +17,146 @@ void FileWriterStage::initialize(PipelineConfig *pipelineConfig,
     {
         throw std::runtime_error("Failed to open file, error code=" + std::to_string(opened));
     }
+
+    opened = fopen_s(&indexFile, (pipelineConfig->output.fileName + ".index").c_str(), "wb");
+    if (opened != 0)
+    {
+        throw std::runtime_error("Failed to open index file, error code=" + std::to_string(opened));
+    }
+    codec = pipelineConfig->video.codec;
+    bitrateController = pipelineContext->bitrateController;
+    FrameIndexHeader header;
+    memcpy(header.magic, FRAME_INDEX_MAGIC, sizeof(header.magic));
+    header.version = FRAME_INDEX_VERSION;
+    header.width = pipelineContext->inputWidth;
+    header.height = pipelineContext->inputHeight;
+    header.codec = codec == HEVC ? FRAME_INDEX_CODEC_HEVC : FRAME_INDEX_CODEC_H264;
+    fwrite(&header, sizeof(header), 1, indexFile);
+    if (bitrateController)
+    {
+        commitThread = new std::thread(&FileWriterStage::commitWindows, this);
+    }
 }
-void *FileWriterStage::process(void *data)
+void *FileWriterStage::process(void *data, FrameInfo &info)
 {
     unsigned size = ((DataAndSize *)data)->size;
     void *rawData = ((DataAndSize *)data)->rawData;
 
+    FrameIndexEntry entry;
+    entry.offset = offset;
+    if (info.keyframe)
+    {
+        if (extractParameterSets(codec, (unsigned char *)rawData, size, packetParameterSets))
+        {
+            parameterSets.swap(packetParameterSets);
+        }
+        else if (parameterSets.size())
+        {
+            // Not every encoder repeats its parameter sets. Doing it for them means
+            // playback (or recovery) can start at any keyframe.
+            fwrite(parameterSets.data(), 1, parameterSets.size(), file);
+            offset += parameterSets.size();
+        }
+    }
+    auto writeStart = std::chrono::steady_clock::now();
     fwrite(rawData, 1, size, file);
+    if (bitrateController)
+    {
+        measureWrite(size, writeStart);
+    }
+
+    entry.size = offset + size - entry.offset;
+    entry.flags = info.keyframe ? FRAME_INDEX_KEYFRAME : 0;
+    entry.timestamp = info.timestamp;
+    fwrite(&entry, sizeof(entry), 1, indexFile);
+    offset += size;
     return nullptr;
 }
+/**
+ * fwrite only hands the data to the OS cache, which takes it at memory speed
+ * whatever the disk can do. So once per window the file is committed, which
+ * waits for the disk, and the window's bytes are reported along with the time
+ * spent writing and committing them. The writer may be running inline with
+ * capture, so the commit is left to commitThread and a window that ends while
+ * the last one is still being committed just grows until it's done.
+ */
+void FileWriterStage::measureWrite(unsigned size, std::chrono::steady_clock::time_point writeStart)
+{
+    auto writeEnd = std::chrono::steady_clock::now();
+    if (!windowBytes)
+    {
+        windowStart = writeStart;
+    }
+    windowBytes += size;
+    windowSeconds += std::chrono::duration<double>(writeEnd - writeStart).count();
+    if (writeEnd - windowStart < WRITE_WINDOW)
+    {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(commitLock, std::try_to_lock);
+    if (!lock.owns_lock() || commitPending)
+    {
+        return;
+    }
+    // Only the buffered tail goes to the OS here, the commit waits for the disk.
+    fflush(file);
+    windowSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - writeEnd).count();
+    commitBytes = windowBytes;
+    commitSeconds = windowSeconds;
+    commitPending = true;
+    commitChanged.notify_one();
+    windowBytes = 0;
+    windowSeconds = 0;
+}
+
+void FileWriterStage::commitWindows()
+{
+    // Flushing the OS handle directly, _commit would hold the CRT's lock on the
+    // file and stall the writer for as long as the disk takes.
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    std::unique_lock<std::mutex> lock(commitLock);
+    while (true)
+    {
+        commitChanged.wait(lock, [this] { return commitPending || stopCommitting; });
+        if (stopCommitting)
+        {
+            return;
+        }
+        unsigned bytes = commitBytes;
+        double seconds = commitSeconds;
+        lock.unlock();
+
+        auto commitStart = std::chrono::steady_clock::now();
+        FlushFileBuffers(handle);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - commitStart).count();
+        bitrateController->observeWrite(bytes, seconds);
+
+        lock.lock();
+        commitPending = false;
+    }
+}
+
 void FileWriterStage::shutdown()
 {
+    if (commitThread)
+    {
+        {
+            std::lock_guard<std::mutex> guard(commitLock);
+            stopCommitting = true;
+            commitChanged.notify_one();
+        }
+        commitThread->join();
+        delete commitThread;
+    }
     if (file)
     {
         fflush(file);
         fclose(file);
     }
+    if (indexFile)
+    {
+        fflush(indexFile);
+        fclose(indexFile);
+    }
 }
\ No newline at end of file
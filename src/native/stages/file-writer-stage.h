@@ -1,6 +1,11 @@
 #ifndef FILE_WRITER_STAGE_H
 #define FILE_WRITER_STAGE_H
 #include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "stage.h"
 class FileWriterStage : public PipelineStage
@@ -8,10 +13,35 @@ class FileWriterStage : public PipelineStage
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
     void shutdown();
 
 private:
+    void measureWrite(unsigned size, std::chrono::steady_clock::time_point writeStart);
+    /** Commits windows handed over by measureWrite. Runs on its own thread. */
+    void commitWindows();
+
     FILE *file = nullptr;
+    // Frame index, see common/frame-index.h
+    FILE *indexFile = nullptr;
+    unsigned long long offset = 0;
+    VideoCodec codec = H264;
+    // The most recent parameter sets, repeated before keyframes that lack them.
+    std::vector<unsigned char> parameterSets;
+    std::vector<unsigned char> packetParameterSets;
+    // Told how long writes take when the bitrate is adaptive.
+    BitrateController *bitrateController = nullptr;
+    // What has been written since the file was last committed to disk.
+    std::chrono::steady_clock::time_point windowStart;
+    unsigned windowBytes = 0;
+    double windowSeconds = 0;
+    // A window waiting for commitThread, guarded by commitLock.
+    std::thread *commitThread = nullptr;
+    std::mutex commitLock;
+    std::condition_variable commitChanged;
+    bool commitPending = false;
+    bool stopCommitting = false;
+    unsigned commitBytes = 0;
+    double commitSeconds = 0;
 };
-#endif
\ No newline at end of file
+#endif
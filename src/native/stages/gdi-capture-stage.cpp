@@ -88,13 +88,18 @@ void GdiCaptureStage::initialize(PipelineConfig *pipelineConfig,
 
     // Mark the start time so we can aim for our target fps.
     limiter = new Limiter(pipelineConfig->video.frameRate);
+    texturePool = new TexturePool(device, context);
 }
 
-void *GdiCaptureStage::process(void *input)
+void *GdiCaptureStage::process(void *input, FrameInfo &info)
 {
     // Use the limiter for timing.
     limiter->wait();
 
+    // Raw frames don't depend on each other, so any of them can be dropped.
+    info.keyframe = true;
+    info.reference = false;
+
     // BitBlt into our texture.
     HDC destHdc;
     surface->GetDC(true, &destHdc);
@@ -126,6 +131,8 @@ void *GdiCaptureStage::process(void *input)
 
 void GdiCaptureStage::shutdown()
 {
+    if (texturePool)
+        delete texturePool;
     if (limiter)
         delete limiter;
     if (hdcWindow)
@@ -142,4 +149,14 @@ void GdiCaptureStage::resume()
 {
     if (limiter)
         limiter->reset();
+}
+
+void *GdiCaptureStage::copyOutput(void *output)
+{
+    return texturePool->copy((ID3D11Texture2D *)output);
+}
+
+void GdiCaptureStage::releaseOutput(void *output)
+{
+    texturePool->release((ID3D11Texture2D *)output);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "stage.h"
 
 #include "common/limiter.h"
+#include "common/d3d11-utils.h"
 
 #include "../common.h "
 
@@ -11,8 +12,10 @@ class GdiCaptureStage : public PipelineStage
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
     void shutdown();
+    void *copyOutput(void *output);
+    void releaseOutput(void *output);
     void resume();
 
 private:
@@ -26,6 +29,7 @@ private:
     HDC hdcWindow;
 
     Limiter *limiter = nullptr;
+    TexturePool *texturePool = nullptr;
     bool captureCursor = false;
 };
 #endif
\ No newline at end of file
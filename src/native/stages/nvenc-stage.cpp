@@ -1,52 +1,264 @@
+#include <chrono>
 #include <iostream>
 #include <stdio.h>
 
 #include "../common.h"
 #include "nvenc-stage.h"
+#include "common/bitstream.h"
+#include "common/d3d11-utils.h"
 
-bool NvencStage::isSupported()
+// QP offset for macroblocks that didn't change. They mostly end up skipped anyway, this
+// just stops the encoder from spending bits refining them.
+const int8_t UNCHANGED_QP_DELTA = 6;
+
+// Size of the session opened to probe the encoder. Anything the encoder accepts will do.
+const unsigned PROBE_SIZE = 256;
+
+/**
+ * Opens a throwaway encode session to find out what the hardware can do.
+ */
+static VideoEncoderCaps probeNvenc()
 {
-	return NvEncoder::HasDrivers();
+	VideoEncoderCaps caps;
+	if (!NvEncoder::HasDrivers())
+	{
+		return caps;
+	}
+
+	ID3D11Device *device = nullptr;
+	ID3D11DeviceContext *context = nullptr;
+	try
+	{
+		createDeviceAndContext(&device, &context);
+		NvEncoderD3D11 encoder(device, PROBE_SIZE, PROBE_SIZE, NV_ENC_BUFFER_FORMAT_ARGB);
+		caps.maxWidth = encoder.GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_WIDTH_MAX);
+		caps.maxHeight = encoder.GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_HEIGHT_MAX);
+		caps.bFrames = encoder.GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_NUM_MAX_BFRAMES) > 0;
+		caps.async = encoder.GetCapabilityValue(NV_ENC_CODEC_H264_GUID, NV_ENC_CAPS_ASYNC_ENCODE_SUPPORT) != 0;
+		if (caps.maxWidth > 0)
+		{
+			caps.codecs.push_back(H264);
+		}
+		// Unsupported codecs report no capabilities at all.
+		if (encoder.GetCapabilityValue(NV_ENC_CODEC_HEVC_GUID, NV_ENC_CAPS_WIDTH_MAX) > 0)
+		{
+			caps.codecs.push_back(HEVC);
+		}
+		caps.supported = !caps.codecs.empty();
+	}
+	catch (std::exception &e)
+	{
+		// Drivers without a usable GPU behind them end up here.
+		std::cout << "NVENC probe failed " << e.what() << std::endl;
+		caps = VideoEncoderCaps();
+	}
+
+	if (context)
+	{
+		context->Release();
+	}
+	if (device)
+	{
+		device->Release();
+	}
+	return caps;
 }
 
-void *NvencStage::process(void *input)
+const VideoEncoderCaps &NvencStage::probe()
 {
-	ID3D11Texture2D *texture = (ID3D11Texture2D *)input;
-	const NvEncInputFrame *encoderInput = encoder->GetNextInputFrame();
-	ID3D11Texture2D *encoderBuffer = (ID3D11Texture2D *)encoderInput->inputPtr;
-	context->CopySubresourceRegion(encoderBuffer, D3D11CalcSubresource(0, 0, 1), 0, 0, 0, texture, 0, NULL);
-	encoder->EncodeFrame(packets);
+	// Initialized once, even if several pipelines ask at the same time.
+	static const VideoEncoderCaps caps = probeNvenc();
+	return caps;
+}
 
-	if (packets.size() == 0)
+void *NvencStage::process(void *input, FrameInfo &info)
+{
 	{
-		return nullptr;
+		std::lock_guard<std::mutex> guard(packetLock);
+		if (retrievalError.size())
+		{
+			throw std::runtime_error(retrievalError);
+		}
 	}
 
-	if (packets.size() > 1)
+	// Repeats are skipped, the previous frame just lasts a little longer. There may
+	// still be packets to hand on though.
+	if (!info.repeat || !variableFrameRate)
 	{
-		throw std::runtime_error("Got more packets than expected");
+		ID3D11Texture2D *texture = (ID3D11Texture2D *)input;
+		const NvEncInputFrame *encoderInput = encoder->GetNextInputFrame();
+		ID3D11Texture2D *encoderBuffer = (ID3D11Texture2D *)encoderInput->inputPtr;
+		context->CopySubresourceRegion(encoderBuffer, D3D11CalcSubresource(0, 0, 1), 0, 0, 0, texture, 0, NULL);
+
+		// Spend the bits where the frame actually changed.
+		NV_ENC_PIC_PARAMS picParams = {NV_ENC_PIC_PARAMS_VER};
+		if (info.damage.size())
+		{
+			damage->reset();
+			for (auto &region : info.damage)
+			{
+				damage->add(region);
+			}
+			auto &blocks = damage->getBlockMap();
+			for (unsigned i = 0; i < blocks.size(); i++)
+			{
+				qpDeltaMap[i] = blocks[i] ? 0 : UNCHANGED_QP_DELTA;
+			}
+			picParams.qpDeltaMap = qpDeltaMap.data();
+			picParams.qpDeltaMapSize = qpDeltaMap.size();
+		}
+
+		if (bitrateController)
+		{
+			setBitrate(bitrateController->getTargetBitrate(info.timestamp));
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(packetLock);
+			pendingFrames.push_back(info);
+		}
+		// Doesn't wait for the frame to be encoded, the retrieval thread picks it up.
+		encoder->SubmitFrame(&picParams);
+	}
+
+	return nextOutput(info);
+}
+
+void *NvencStage::nextOutput(FrameInfo &info)
+{
+	std::lock_guard<std::mutex> guard(packetLock);
+	if (current.data.capacity())
+	{
+		spareBuffers.push_back(std::move(current.data));
+		current.data = std::vector<uint8_t>();
+	}
+	if (readyPackets.empty())
+	{
+		return nullptr;
 	}
 
-	std::vector<uint8_t> &packet = packets.at(0);
-	results.rawData = packet.data();
-	results.size = packet.size();
+	current = std::move(readyPackets.front());
+	readyPackets.pop_front();
+	results.rawData = current.data.data();
+	results.size = current.data.size();
+	info = current.info;
 	return &results;
 }
 
+void NvencStage::setBitrate(unsigned target)
+{
+	if (target == bitrate)
+	{
+		return;
+	}
+	bitrate = target;
+	encConfig.rcParams.averageBitRate = bitrate;
+	NV_ENC_RECONFIGURE_PARAMS reconfigureParams = {NV_ENC_RECONFIGURE_PARAMS_VER};
+	reconfigureParams.reInitEncodeParams = encInitParams;
+	encoder->Reconfigure(&reconfigureParams);
+}
+
+void NvencStage::queuePacket(std::vector<uint8_t> &packet)
+{
+	// The encoder delays its output by a few frames, so the packet belongs to an earlier input.
+	FrameInfo info = pendingFrames.front();
+	pendingFrames.pop_front();
+	describePacket(codec, packet.data(), packet.size(), info);
+	if (bitrateController)
+	{
+		bitrateController->observeFrame(packet.size());
+	}
+	readyPackets.push_back({std::move(packet), info});
+	packet = std::vector<uint8_t>();
+	if (spareBuffers.size())
+	{
+		packet.swap(spareBuffers.back());
+		spareBuffers.pop_back();
+	}
+}
+
+void NvencStage::retrievePackets()
+{
+	std::vector<uint8_t> packet;
+	try
+	{
+		while (encoder->GetNextPacket(packet))
+		{
+			std::lock_guard<std::mutex> guard(packetLock);
+			queuePacket(packet);
+		}
+	}
+	catch (std::exception &e)
+	{
+		// Reported by the next call to process.
+		std::lock_guard<std::mutex> guard(packetLock);
+		retrievalError = e.what();
+	}
+}
+
+void *NvencStage::flush(FrameInfo &info)
+{
+	if (!encoder)
+	{
+		return nullptr;
+	}
+	// Let the retrieval thread collect everything submitted so far. It then waits for
+	// more, which keeps it out of the way of EndEncode collecting on this thread.
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> guard(packetLock);
+			if (retrievalError.size())
+			{
+				throw std::runtime_error(retrievalError);
+			}
+			if (pendingFrames.empty())
+			{
+				break;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	std::vector<std::vector<uint8_t>> packets;
+	encoder->EndEncode(packets);
+	{
+		std::lock_guard<std::mutex> guard(packetLock);
+		for (auto &packet : packets)
+		{
+			// End of stream markers don't belong to any frame.
+			if (pendingFrames.empty())
+			{
+				break;
+			}
+			queuePacket(packet);
+		}
+	}
+	return nextOutput(info);
+}
+
 void NvencStage::initialize(PipelineConfig *pipelineConfig,
 							PipelineContext *pipelineContext)
 {
 	// Note that this height/width come directly from the capture surface.
 	unsigned width = pipelineContext->inputWidth;
 	unsigned height = pipelineContext->inputHeight;
+	variableFrameRate = pipelineConfig->video.variableFrameRate;
+	codec = pipelineConfig->video.codec;
 	ID3D11Device *device = (ID3D11Device *)pipelineContext->d3Device;
+	if (!probe().supportsCodec(codec))
+	{
+		throw std::runtime_error("NVENC does not support the requested codec");
+	}
+	if (!probe().supportsSize(width, height))
+	{
+		throw std::runtime_error("Capture is too large for NVENC");
+	}
 
 	device->GetImmediateContext(&context);
 	encoder = new NvEncoderD3D11(device, width, height, NV_ENC_BUFFER_FORMAT_ARGB);
 
-	NV_ENC_INITIALIZE_PARAMS encInitParams = {0};
-	NV_ENC_CONFIG encConfig = {0};
-
+	// Both are kept around since reconfiguring the encoder needs the full set of parameters.
 	ZeroMemory(&encInitParams, sizeof(encInitParams));
 	ZeroMemory(&encConfig, sizeof(encConfig));
 	encInitParams.encodeConfig = &encConfig;
@@ -55,18 +267,60 @@ void NvencStage::initialize(PipelineConfig *pipelineConfig,
 	encInitParams.maxEncodeWidth = width;
 	encInitParams.maxEncodeHeight = height;
 
-	encoder->CreateDefaultEncoderParams(&encInitParams, NV_ENC_CODEC_H264_GUID, NV_ENC_PRESET_LOW_LATENCY_HP_GUID);
+	GUID codecGuid = codec == HEVC ? NV_ENC_CODEC_HEVC_GUID : NV_ENC_CODEC_H264_GUID;
+	encoder->CreateDefaultEncoderParams(&encInitParams, codecGuid, NV_ENC_PRESET_LOW_LATENCY_HP_GUID);
 	encInitParams.frameRateNum = pipelineConfig->video.frameRate;
-	encInitParams.encodeConfig->gopLength = pipelineConfig->video.frameRate * 2;
+	NV_ENC_CONFIG *config = encInitParams.encodeConfig;
+	config->gopLength = pipelineConfig->video.frameRate * 2;
+	config->rcParams.qpMapMode = NV_ENC_QP_MAP_DELTA;
+	bitrateController = pipelineContext->bitrateController;
+	if (bitrateController)
+	{
+		// The default constant QP can't follow a bitrate, let the rate control pick QPs instead.
+		bitrate = bitrateController->getTargetBitrate(0);
+		config->rcParams.rateControlMode = NV_ENC_PARAMS_RC_VBR;
+		config->rcParams.averageBitRate = bitrate;
+		config->rcParams.maxBitRate = pipelineConfig->video.bitrate.max;
+	}
+	// Every GOP starts with an IDR carrying the parameter sets, so the output can be
+	// decoded from any keyframe.
+	unsigned blockSize;
+	if (codec == HEVC)
+	{
+		config->encodeCodecConfig.hevcConfig.idrPeriod = config->gopLength;
+		config->encodeCodecConfig.hevcConfig.repeatSPSPPS = 1;
+		// The QP map has one entry per CTB, so pin the CTB size.
+		config->encodeCodecConfig.hevcConfig.maxCUSize = NV_ENC_HEVC_CUSIZE_32x32;
+		blockSize = 32;
+	}
+	else
+	{
+		config->encodeCodecConfig.h264Config.idrPeriod = config->gopLength;
+		config->encodeCodecConfig.h264Config.repeatSPSPPS = 1;
+		blockSize = 16;
+	}
 	encoder->CreateEncoder(&encInitParams);
+	retrievalThread = new std::thread(&NvencStage::retrievePackets, this);
+
+	damage = new DamageTracker(width, height, blockSize);
+	qpDeltaMap.resize(damage->getBlocksWide() * damage->getBlocksHigh());
 }
 void NvencStage::shutdown()
 {
-	// TODO: There may be some frames hanging out in the queue. We can get these out with EndEncode, but
-	// nobody else is ready to accept them...
+	// By now flush has drained the encoder, so the retrieval thread is just waiting.
 	if (encoder)
 	{
+		encoder->CancelWait();
+		if (retrievalThread)
+		{
+			retrievalThread->join();
+			delete retrievalThread;
+		}
 		encoder->DestroyEncoder();
 		delete encoder;
 	}
+	if (damage)
+	{
+		delete damage;
+	}
 }
\ No newline at end of file
@@ -1,23 +1,72 @@
 #ifndef NVENC_STAGE_H
 #define NVENC_STAGE_H
-#include "stage.h"
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "video-encoder.h"
 
 #include "../common.h "
 #include "../nvenc/NvEncoderD3D11.h"
+#include "common/damage-tracker.h"
+#include "common/bitrate-controller.h"
 
-class NvencStage : public PipelineStage
+class NvencStage : public VideoEncoder
 {
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
+    void *nextOutput(FrameInfo &info);
+    void *flush(FrameInfo &info);
     void shutdown();
-    bool isSupported();
+    void *copyOutput(void *output) { return copyDataAndSize(output); };
+    void releaseOutput(void *output) { releaseDataAndSize(output); };
+    const VideoEncoderCaps &getCaps() { return probe(); };
+
+    /** Capabilities of the NVIDIA encoder, probed on first use. */
+    static const VideoEncoderCaps &probe();
 
 private:
+    struct EncodedPacket
+    {
+        std::vector<uint8_t> data;
+        FrameInfo info;
+    };
+
+    /** Collects packets as the encoder finishes them. Runs on its own thread. */
+    void retrievePackets();
+
+    /** Tags an encoded packet with its frame's info and queues it for the next stage. Needs packetLock. */
+    void queuePacket(std::vector<uint8_t> &packet);
+
+    /** Reconfigure the encoder if target differs from the current bitrate. */
+    void setBitrate(unsigned target);
+
     NvEncoderD3D11 *encoder = nullptr;
+    NV_ENC_INITIALIZE_PARAMS encInitParams;
+    NV_ENC_CONFIG encConfig;
+    BitrateController *bitrateController = nullptr;
+    unsigned bitrate = 0;
     ID3D11DeviceContext *context;
-    std::vector<std::vector<uint8_t>> packets;
+    std::thread *retrievalThread = nullptr;
+    // Guards everything shared with the retrieval thread below.
+    std::mutex packetLock;
+    // Info for frames submitted to the encoder that haven't come out yet.
+    std::deque<FrameInfo> pendingFrames;
+    // Packets waiting to be handed to the next stage, oldest first.
+    std::deque<EncodedPacket> readyPackets;
+    // Buffers of packets that have been handed out, kept for reuse.
+    std::vector<std::vector<uint8_t>> spareBuffers;
+    std::string retrievalError;
+    // The packet results currently points into.
+    EncodedPacket current;
     DataAndSize results;
+    bool variableFrameRate = true;
+    VideoCodec codec = H264;
+    // Per macroblock QP deltas, built from the damaged regions of each frame.
+    DamageTracker *damage = nullptr;
+    std::vector<int8_t> qpDeltaMap;
 };
 #endif
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef STAGE_H
 #define STAGE_H
+#include <stdexcept>
+
 #include "../pipeline-config.h"
+#include "../frame-info.h"
 
 class PipelineStage
 {
@@ -15,9 +18,40 @@ public:
      * Process the pipeline. Data is fed in via a void * and should be outputed
      * in whatever format is expected by the next stage. Note that input should
      * be read only. The previous stage will maintain ownership over the underlying
-     * data.
+     * data. Info describes the input on the way in and should describe the output
+     * on the way out.
+     */
+    virtual void *process(void *input, FrameInfo &info) = 0;
+
+    /**
+     * Return the next of any further outputs produced by the last call to
+     * process, or nullptr once there are none. The pipeline keeps calling this
+     * after each output has been handled, so the previous output no longer
+     * needs to stay valid. Info should describe the returned output.
+     */
+    virtual void *nextOutput(FrameInfo &info) { return nullptr; };
+
+    /**
+     * Called once after the last input, before shutdown. Return the first of
+     * any outputs the stage is still holding back (e.g. frames inside an
+     * encoder), or nullptr if there are none. The rest are returned by
+     * nextOutput as usual.
+     */
+    virtual void *flush(FrameInfo &info) { return nullptr; };
+
+    /**
+     * Copy an output of this stage so it stays valid across further calls to
+     * process. Only needed when the stage is followed by a queued edge.
+     */
+    virtual void *copyOutput(void *output)
+    {
+        throw std::runtime_error("Stage output can not be queued");
+    };
+
+    /**
+     * Release a copy made by copyOutput. May be called from any thread.
      */
-    virtual void *process(void *input) = 0;
+    virtual void releaseOutput(void *output){};
 
     /**
      * Shutdown this stage and release all resources.
@@ -0,0 +1,49 @@
+#ifndef VIDEO_ENCODER_H
+#define VIDEO_ENCODER_H
+#include <algorithm>
+#include <vector>
+
+#include "stage.h"
+
+/**
+ * What a hardware encoder can do on this machine.
+ */
+struct VideoEncoderCaps
+{
+    bool supported = false;
+    std::vector<VideoCodec> codecs;
+    unsigned maxWidth = 0;
+    unsigned maxHeight = 0;
+    // Whether the encoder can produce B-frames. We don't ask for them since they
+    // add latency, but it is a decent hint of how capable the hardware is.
+    bool bFrames = false;
+    // Whether the encoder can signal finished frames instead of being polled.
+    bool async = false;
+
+    bool supportsCodec(VideoCodec codec) const
+    {
+        return std::find(codecs.begin(), codecs.end(), codec) != codecs.end();
+    }
+
+    bool supportsSize(unsigned width, unsigned height) const
+    {
+        return width <= maxWidth && height <= maxHeight;
+    }
+};
+
+/**
+ * A stage turning captured textures into compressed video.
+ *
+ * Finding out what an encoder supports means loading its driver and opening a
+ * session, which is slow. Each encoder does it once per process and keeps the
+ * result around, so asking again (e.g. for every new recording) is free.
+ */
+class VideoEncoder : public PipelineStage
+{
+public:
+    /** The cached capabilities of this encoder. */
+    virtual const VideoEncoderCaps &getCaps() = 0;
+
+    bool isSupported() { return getCaps().supported; };
+};
+#endif
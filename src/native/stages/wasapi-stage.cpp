@@ -94,7 +94,7 @@ void WasapiStage::initialize(PipelineConfig *pipelineConfig,
     }
 };
 
-void *WasapiStage::process(void *data)
+void *WasapiStage::process(void *data, FrameInfo &info)
 {
     UINT32 nextPacketSize;
     audioCaptureClient->GetNextPacketSize(&nextPacketSize);
@@ -11,8 +11,10 @@ class WasapiStage : public PipelineStage
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
     void shutdown();
+    void *copyOutput(void *output) { return copyDataAndSize(output); };
+    void releaseOutput(void *output) { releaseDataAndSize(output); };
 
 private:
     IAudioCaptureClient *audioCaptureClient;
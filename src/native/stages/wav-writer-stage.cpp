@@ -86,7 +86,7 @@ void WavWriterStage::initialize(PipelineConfig *pipelineConfig,
 	fwrite(&header, sizeof(WaveHeader), 1, file);
 }
 
-void *WavWriterStage::process(void *data)
+void *WavWriterStage::process(void *data, FrameInfo &info)
 {
 	unsigned size = ((DataAndSize *)data)->size;
 	void *rawData = ((DataAndSize *)data)->rawData;
@@ -9,7 +9,7 @@ class WavWriterStage : public PipelineStage
 public:
     void initialize(PipelineConfig *pipelineConfig,
                     PipelineContext *pipelineContext);
-    void *process(void *input);
+    void *process(void *input, FrameInfo &info);
     void shutdown();
 
 private:
@@ -0,0 +1,164 @@
+/**
+ * This module reads the tap a native pipeline publishes preview frames and
+ * audio levels to (see src/native/pipeline-tap.h). The tap is memory shared
+ * with the pipeline, so reading it needs no copies and no calls into native
+ * code. Instead every frame and the levels carry a sequence number that is
+ * odd while they are being written.
+ */
+
+const TAP_MAGIC = 0x50415451;
+const TAP_VERSION = 1;
+
+// Indices into the int32 header, matching PipelineTapHeader.
+const MAGIC = 0;
+const VERSION = 1;
+const FRAME_COUNT = 2;
+const LATEST_SLOT = 3;
+const SLOT_COUNT = 4;
+const WIDTH = 5;
+const HEIGHT = 6;
+const STRIDE = 7;
+const SLOT_OFFSET = 8;
+const SLOT_SIZE = 9;
+const LEVELS_SEQUENCE = 10;
+const CHANNELS = 11;
+const LEVELS_OFFSET = 12;
+
+// Each slot starts with its sequence number and, at byte 8, its timestamp.
+const SLOT_HEADER_SIZE = 16;
+const MAX_TAP_CHANNELS = 8;
+
+// The levels are only ever half written for a moment, so give up after a few
+// tries rather than spinning.
+const LEVELS_RETRIES = 4;
+
+export interface PreviewFrame {
+  // Increases with every published frame.
+  sequence: number;
+  width: number;
+  height: number;
+  // Milliseconds since the pipeline started.
+  timestamp: number;
+  // BGRA pixels, width * 4 bytes per row. This is a view of the tap, so it
+  // will be overwritten by later frames (see PipelineTapReader.isCurrent).
+  data: Uint8Array;
+}
+
+export interface AudioLevels {
+  // Milliseconds since the pipeline started.
+  timestamp: number;
+  // Linear values from 0 to 1, one per channel.
+  peak: number[];
+  rms: number[];
+}
+
+// Views of one frame slot.
+interface TapSlot {
+  sequence: Int32Array;
+  timestamp: Float64Array;
+  data: Uint8Array;
+}
+
+/** Reads frames and levels from the ArrayBuffer returned by Pipeline.getTap. */
+export class PipelineTapReader {
+  private header: Int32Array;
+  private slots: TapSlot[];
+  private levelsTimestamp: Float64Array;
+  private peaks: Float32Array;
+  private rms: Float32Array;
+
+  constructor(buffer: ArrayBuffer) {
+    this.header = new Int32Array(buffer, 0, LEVELS_OFFSET + 1);
+    if (
+      this.header[MAGIC] !== TAP_MAGIC ||
+      this.header[VERSION] !== TAP_VERSION
+    ) {
+      throw new Error("Not a pipeline tap this version understands");
+    }
+
+    const stride = this.header[STRIDE];
+    const height = this.header[HEIGHT];
+    this.slots = [];
+    for (let i = 0; i < this.header[SLOT_COUNT]; i++) {
+      const offset = this.header[SLOT_OFFSET] + this.header[SLOT_SIZE] * i;
+      this.slots.push({
+        sequence: new Int32Array(buffer, offset, 1),
+        timestamp: new Float64Array(buffer, offset + 8, 1),
+        data: new Uint8Array(
+          buffer,
+          offset + SLOT_HEADER_SIZE,
+          stride * height
+        )
+      });
+    }
+
+    const levelsOffset = this.header[LEVELS_OFFSET];
+    this.levelsTimestamp = new Float64Array(buffer, levelsOffset, 1);
+    this.peaks = new Float32Array(buffer, levelsOffset + 8, MAX_TAP_CHANNELS);
+    this.rms = new Float32Array(
+      buffer,
+      levelsOffset + 8 + MAX_TAP_CHANNELS * 4,
+      MAX_TAP_CHANNELS
+    );
+  }
+
+  /** How many frames have been published so far. */
+  public get frameCount() {
+    return Atomics.load(this.header, FRAME_COUNT);
+  }
+
+  /** The most recent complete frame, or null if there is none yet. */
+  public latestFrame(): PreviewFrame | null {
+    if (!this.slots.length || !this.frameCount) {
+      return null;
+    }
+    const slot = this.slots[Atomics.load(this.header, LATEST_SLOT)];
+    const sequence = Atomics.load(slot.sequence, 0);
+    // The writer has already moved on to this slot again.
+    if (sequence === 0 || sequence & 1) {
+      return null;
+    }
+    return {
+      sequence,
+      width: this.header[WIDTH],
+      height: this.header[HEIGHT],
+      timestamp: slot.timestamp[0],
+      data: slot.data
+    };
+  }
+
+  /**
+   * Whether a frame from latestFrame is still intact. Check this after using
+   * the frame's data to know that it wasn't overwritten in the meantime.
+   */
+  public isCurrent(frame: PreviewFrame) {
+    return this.slots.some(
+      slot =>
+        slot.data === frame.data &&
+        Atomics.load(slot.sequence, 0) === frame.sequence
+    );
+  }
+
+  /** The most recent audio levels, or null if there are none yet. */
+  public levels(): AudioLevels | null {
+    const channels = this.header[CHANNELS];
+    for (let i = 0; channels && i < LEVELS_RETRIES; i++) {
+      const before = Atomics.load(this.header, LEVELS_SEQUENCE);
+      if (before === 0) {
+        return null;
+      }
+      if (before & 1) {
+        continue;
+      }
+      const levels = {
+        timestamp: this.levelsTimestamp[0],
+        peak: Array.from(this.peaks.subarray(0, channels)),
+        rms: Array.from(this.rms.subarray(0, channels))
+      };
+      if (Atomics.load(this.header, LEVELS_SEQUENCE) === before) {
+        return levels;
+      }
+    }
+    return null;
+  }
+}
@@ -1,41 +1,138 @@
 import fs from "fs";
+import os from "os";
 import path from "path";
 
 import ffmpegWrapper from "./ffmpeg-wrapper";
+import { indexFileName, keyframeIndexFileName } from "./frame-index";
+
+const ScreenCaptureNative = require("../build/Release/screen-capture-native");
+
+/** What the native recovery made of one raw file. */
+export interface RecoveredFile {
+  fileName: string;
+  // Null if the file was recovered.
+  error: string | null;
+  originalSize: number;
+  recoveredSize: number;
+  // Video frames kept along with their timestamps.
+  frames: number;
+  // The video rewrapped with its timestamps, or null if it has no index.
+  wrappedFileName: string | null;
+}
+
+/** How far postProcessDirectory has got. */
+export interface RecoveryProgress {
+  // Every raw file is repaired first, then each recording is muxed.
+  phase: "repair" | "mux";
+  // The raw file just repaired, or the recording just muxed.
+  fileName: string;
+  done: number;
+  total: number;
+}
+
+/**
+ * Repairs raw recording files on native worker threads (see
+ * src/native/recovery.h), reporting each file as it is finished. Resolves to
+ * what became of every file, in order. Set complete for files that were closed
+ * properly, which are then never cut short.
+ */
+const recoverRecordings: (
+  fileNames: string[],
+  onProgress: (progress: {
+    result: RecoveredFile;
+    done: number;
+    total: number;
+  }) => void,
+  complete?: boolean
+) => Promise<RecoveredFile[]> = ScreenCaptureNative.recoverRecordings;
+
+/** Runs task on every item, with at most limit of them running at once. */
+const forEachConcurrently = async <T>(
+  items: T[],
+  limit: number,
+  task: (item: T) => Promise<void>
+) => {
+  let next = 0;
+  const worker = async () => {
+    while (next < items.length) {
+      await task(items[next++]);
+    }
+  };
+  await Promise.all(
+    Array.from({ length: Math.min(limit, items.length) }, worker)
+  );
+};
 
 /**
  * Look for any temporary files that we may have created and run
  * post processing on them (this can happen if a recording is
  * interrupted).
+ *
+ * The raw files are repaired natively, several at a time, which cuts off
+ * whatever was only partially written and rewraps video with its frame
+ * timestamps. The recordings are then muxed by ffmpeg processes running side
+ * by side.
  */
-export const postProcessDirectory = async (dir: string): Promise<void> => {
+export const postProcessDirectory = async (
+  dir: string,
+  onProgress: (progress: RecoveryProgress) => void = () => undefined
+): Promise<void> => {
   const fileNames = fs
     .readdirSync(dir)
-    .filter(x => x.endsWith(".h264") || x.endsWith(".wav"));
-  const prefixes = fileNames.reduce((a, fileName) => {
-    const prefix = fileName.split(".")[0];
-    if (a.indexOf(prefix) === -1) {
-      return [...a, prefix];
-    } else {
-      return a;
-    }
-  }, [] as string[]);
+    .filter(
+      x => x.endsWith(".h264") || x.endsWith(".hevc") || x.endsWith(".wav")
+    );
+
+  const recovered = await recoverRecordings(
+    fileNames.map(fileName => path.join(dir, fileName)),
+    progress =>
+      onProgress({
+        phase: "repair",
+        fileName: progress.result.fileName,
+        done: progress.done,
+        total: progress.total
+      })
+  );
 
-  for (const prefix of prefixes) {
+  // Group the files by recording once, so no two workers share a file. A
+  // prefix match would put rec10.h264 with rec1 as well.
+  const recordings: { [prefix: string]: RecoveredFile[] } = {};
+  recovered.forEach(x => {
+    const prefix = path.basename(x.fileName).split(".")[0];
+    recordings[prefix] = [...(recordings[prefix] || []), x];
+  });
+  const prefixes = Object.keys(recordings);
+
+  let muxed = 0;
+  await forEachConcurrently(prefixes, os.cpus().length, async prefix => {
+    const outputFile = path.join(dir, `${prefix}.mp4`);
+    const files = recordings[prefix];
     try {
-      await doPostProcessing(
-        path.join(dir, `${prefix}.mp4`),
-        fileNames
-          .filter(x => x.startsWith(prefix))
-          .map(fileName => {
-            return path.join(dir, fileName);
-          })
+      // Files that couldn't be repaired, or had nothing left, are left out.
+      const usable = files.filter(x => !x.error && x.recoveredSize > 0);
+      if (!usable.length) {
+        throw new Error(`Nothing to recover for ${outputFile}`);
+      }
+      const wrappedFiles = files
+        .map(x => x.wrappedFileName)
+        .filter(x => x !== null) as string[];
+      await muxAndCleanUp(
+        outputFile,
+        files.map(x => x.fileName),
+        usable.map(x => x.wrappedFileName || x.fileName),
+        wrappedFiles
       );
     } catch (e) {
       // A single bad file should not stop us from processing the rest.
       console.log(e);
     }
-  }
+    onProgress({
+      phase: "mux",
+      fileName: outputFile,
+      done: ++muxed,
+      total: prefixes.length
+    });
+  });
 };
 
 /** Post process temporary recording files through ffmpeg. */
@@ -43,11 +140,45 @@ export const doPostProcessing = async (
   ouptutFile: string,
   inputFiles: string[]
 ) => {
-  await ffmpegWrapper.process(ouptutFile, inputFiles);
+  // Raw video with a frame index is rewrapped so ffmpeg sees the real frame
+  // timestamps. That happens natively, off the event loop. Without an index
+  // we fall back to the raw stream.
+  const results = await recoverRecordings(inputFiles, () => undefined, true);
+  const wrappedFiles = results
+    .map(x => x.wrappedFileName)
+    .filter(x => x !== null) as string[];
+  await muxAndCleanUp(
+    ouptutFile,
+    inputFiles,
+    results.map(x => x.wrappedFileName || x.fileName),
+    wrappedFiles
+  );
+};
+
+/**
+ * Mux processInputs (the raw files, or what they were wrapped in) into
+ * outputFile, then remove the raw files and everything kept next to them.
+ */
+const muxAndCleanUp = async (
+  outputFile: string,
+  inputFiles: string[],
+  processInputs: string[],
+  wrappedFiles: string[]
+) => {
+  await ffmpegWrapper.process(outputFile, processInputs);
   // Clean up temp files.
   inputFiles.forEach(fileName => {
     if (fileName) {
       fs.unlinkSync(fileName);
     }
   });
+  [
+    ...inputFiles.map(indexFileName),
+    ...inputFiles.map(keyframeIndexFileName),
+    ...wrappedFiles
+  ].forEach(fileName => {
+    if (fs.existsSync(fileName)) {
+      fs.unlinkSync(fileName);
+    }
+  });
 };
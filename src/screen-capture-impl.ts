@@ -1,10 +1,61 @@
 const ScreenCaptureNative = require("../build/Release/screen-capture-native");
 
-import { ScreenCapture, ScreenCaptureConfig } from "./screen-capture";
+import {
+  DropPolicy,
+  QueueConfig,
+  ScreenCapture,
+  ScreenCaptureConfig
+} from "./screen-capture";
 import { doPostProcessing } from "./post-processing";
+import { AudioLevels, PipelineTapReader, PreviewFrame } from "./pipeline-tap";
+
+/** Configuration for the edge leading into a native pipeline stage. */
+export interface EdgeConfig {
+  queueSize?: number;
+  policy?: DropPolicy;
+}
+
+/** Counters for a queue between two pipeline stages. */
+export interface EdgeStats {
+  // Index of the stage the queue feeds.
+  stage: number;
+  policy: DropPolicy;
+  queueSize: number;
+  depth: number;
+  maxDepth: number;
+  pushed: number;
+  dropped: number;
+  // Milliseconds since the pipeline started of the most recent drops.
+  recentDrops: number[];
+}
+
+/** How long a pipeline stage takes to process each frame, in milliseconds. */
+export interface StageStats {
+  stage: number;
+  count: number;
+  mean: number;
+  stddev: number;
+  min: number;
+  max: number;
+  // Percentiles are within about 6% of the exact value.
+  p50: number;
+  p90: number;
+  p99: number;
+  p999: number;
+  // Frames per second over the last second.
+  rate: number;
+}
+
+/** Stats for one pipeline, identified by the file it writes. */
+export interface PipelineStats {
+  fileName: string;
+  edges: EdgeStats[];
+  stages: StageStats[];
+}
 
 /** Simple interface for the native Pipeline class. */
 export interface Pipeline {
+  addStage: (stage: string, edge?: EdgeConfig) => void;
   initialize: () => void;
   start: () => void;
   pause: () => void;
@@ -12,6 +63,48 @@ export interface Pipeline {
   stop: () => void;
   pollErrors: () => string[];
   supportsStage: (str: string) => boolean;
+  // The fastest hardware encoder available, or null if there is none.
+  selectVideoEncoder: () => string | null;
+  getStats: () => EdgeStats[];
+  getStageStats: () => StageStats[];
+  // Memory shared with the pipeline (see pipeline-tap.ts), or null if the
+  // pipeline was created without a tap. Only available once initialized.
+  getTap: () => ArrayBuffer | null;
+}
+
+/**
+ * A stage of a pipeline graph. The stage is a native stage name, a list of
+ * alternatives to pick the first supported one from, or "VIDEO_ENCODER" for
+ * the fastest encoder that supports the configured codec.
+ */
+export interface GraphNode {
+  id: string;
+  stage: string | string[];
+  // Merged into the config section the stage reads (video, audio or output).
+  // Sections are global, every stage reading one sees the same options, so
+  // two nodes setting a key to different values is rejected.
+  options?: object;
+  // Nodes on different threads must be joined by a queue, and nodes on the
+  // same thread must not be. Default = whatever the edges say
+  thread?: number;
+}
+
+/** Connects two nodes, configuring the queue leading into `to`. */
+export interface GraphEdge extends EdgeConfig {
+  from: string;
+  to: string;
+}
+
+/**
+ * Everything needed to build a pipeline in one call to Pipeline.fromGraph.
+ * Stages run one after the other, so the nodes must form a single chain
+ * starting at a capture stage.
+ */
+export interface PipelineGraph {
+  // As passed to the Pipeline constructor.
+  config: any;
+  nodes: GraphNode[];
+  edges: GraphEdge[];
 }
 
 /** Possible pipeline types. */
@@ -20,6 +113,18 @@ export enum PipelineType {
   AUDIO
 }
 
+/** Converts a user facing queue config to the native edge config. */
+const toEdgeConfig = (queue?: QueueConfig): EdgeConfig => {
+  const edge: EdgeConfig = {};
+  if (queue && queue.size !== undefined) {
+    edge.queueSize = queue.size;
+  }
+  if (queue && queue.policy !== undefined) {
+    edge.policy = queue.policy;
+  }
+  return edge;
+};
+
 /**
  * Some of the resources (specifically files) used by the pipeline
  * may not be released immediatly. To compensate for this we introduce
@@ -50,6 +155,9 @@ export class ScreenCaptureImpl implements ScreenCapture {
   private state: CaptureState;
   private outputFiles: string[];
   private errorCallbacks: Array<(err: string) => void>;
+  // Readers for the pipelines that have a tap, by the source they show.
+  private previewTap: PipelineTapReader | null = null;
+  private levelTaps: PipelineTapReader[] = [];
   constructor(config: ScreenCaptureConfig) {
     this.config = config;
     this.state = CaptureState.UNSTARTED;
@@ -60,12 +168,19 @@ export class ScreenCaptureImpl implements ScreenCapture {
   public async start() {
     this.ensureState([CaptureState.UNSTARTED]);
     if (this.config.video !== false) {
-      const fileName = `${this.config.output.fileName}.h264`;
+      // The extension doubles as the codec name, which is what ffmpeg needs
+      // to read the raw stream.
+      const codec = (this.config.video && this.config.video.codec) || "h264";
+      const fileName = `${this.config.output.fileName}.${codec}`;
       this.outputFiles.push(fileName);
-      this.createPipeline(PipelineType.VIDEO, {
+      const config: any = {
         video: { ...this.config.video },
         output: { fileName }
-      });
+      };
+      if (this.config.video && this.config.video.preview) {
+        config.tap = { ...this.config.video.preview };
+      }
+      this.createPipeline(PipelineType.VIDEO, config);
     }
     if (this.config.audio !== false) {
       const sources =
@@ -75,14 +190,19 @@ export class ScreenCaptureImpl implements ScreenCapture {
       sources.forEach(source => {
         const fileName = `${this.config.output.fileName}.${source.type}.wav`;
         this.outputFiles.push(fileName);
-        this.createPipeline(PipelineType.AUDIO, {
+        const config: any = {
           audio: { source },
           output: { fileName }
-        });
+        };
+        if (this.config.audio && this.config.audio.levels) {
+          config.tap = {};
+        }
+        this.createPipeline(PipelineType.AUDIO, config);
       });
     }
     try {
       this.pipelines.forEach(p => p.initialize());
+      this.createTapReaders();
       this.pipelines.forEach(p => p.start());
     } catch (e) {
       // Publish to any listeners, but also rethrow
@@ -127,6 +247,29 @@ export class ScreenCaptureImpl implements ScreenCapture {
     }
   }
 
+  /** Queue, drop and stage latency stats for each running pipeline. */
+  public getStats(): PipelineStats[] {
+    return this.pipelines.map((pipeline, i) => ({
+      fileName: this.outputFiles[i],
+      edges: pipeline.getStats(),
+      stages: pipeline.getStageStats()
+    }));
+  }
+
+  /**
+   * The most recent preview frame, or null if there is none (yet). The frame
+   * is a view of memory the capture keeps writing to, see
+   * PipelineTapReader.isCurrent.
+   */
+  public getPreviewFrame(): PreviewFrame | null {
+    return this.previewTap ? this.previewTap.latestFrame() : null;
+  }
+
+  /** The most recent levels of each audio source, in the configured order. */
+  public getAudioLevels(): Array<AudioLevels | null> {
+    return this.levelTaps.map(tap => tap.levels());
+  }
+
   /** Installs an error handler. */
   public onError(callback: (err: string) => void) {
     this.errorCallbacks.push(callback);
@@ -134,49 +277,63 @@ export class ScreenCaptureImpl implements ScreenCapture {
 
   /** Creates either an audio or video pipeline. */
   private createPipeline(pipelineType: PipelineType, config: any) {
-    const VIDEO_STAGES = [
-      // Note that the capture stage is specified below, based on the config.
-      ["NVENC", "AMF"],
-      "FILE_WRITER"
-    ];
-    const AUDIO_STAGES = ["WASAPI", "WAV_WRITER"];
-    const pipeline = new ScreenCaptureNative.Pipeline(config);
-    let stages: Array<string | string[]> = [];
+    // The node id, stage and queue leading into the stage, in pipeline order.
+    let stages: Array<[string, string | string[], QueueConfig | undefined]>;
     switch (pipelineType) {
       case PipelineType.AUDIO:
-        stages = AUDIO_STAGES;
+        stages = [
+          ["capture", "WASAPI", undefined],
+          [
+            "writer",
+            "WAV_WRITER",
+            this.config.audio ? this.config.audio.writerQueue : undefined
+          ]
+        ];
         break;
       case PipelineType.VIDEO:
-        stages = VIDEO_STAGES;
-        // Determine which stage we should use based on the source.
-        stages.unshift(
-          config &&
-            config.video &&
-            config.video.source &&
-            config.video.source.type == "window"
-            ? "GDI_CAPTURE"
-            : "DESKTOP_DUPLICATION"
-        );
+      default:
+        stages = [
+          [
+            "capture",
+            // Determine which stage we should use based on the source.
+            config.video.source && config.video.source.type == "window"
+              ? "GDI_CAPTURE"
+              : "DESKTOP_DUPLICATION",
+            undefined
+          ],
+          // Encoder capabilities are probed once per process, so this is cheap.
+          ["encoder", "VIDEO_ENCODER", config.video.encoderQueue],
+          ["writer", "FILE_WRITER", config.video.writerQueue]
+        ];
         break;
     }
-    stages.forEach(stage => {
-      if (Array.isArray(stage)) {
-        let added = false;
-        for (const s of stage) {
-          if (pipeline.supportsStage(s)) {
-            pipeline.addStage(s);
-            added = true;
-            break;
-          }
-        }
-        if (!added) {
-          throw new Error("Could not find suitable stage from " + stage);
-        }
+    const graph: PipelineGraph = {
+      config,
+      nodes: stages.map(([id, stage]) => ({ id, stage })),
+      edges: stages.slice(1).map(([id, , queue], i) => ({
+        from: stages[i][0],
+        to: id,
+        ...toEdgeConfig(queue)
+      }))
+    };
+    const pipeline: Pipeline = ScreenCaptureNative.Pipeline.fromGraph(graph);
+    this.pipelines.push(pipeline);
+  }
+
+  /** Wraps the taps of the pipelines that were created with one. */
+  private createTapReaders() {
+    this.pipelines.forEach((pipeline, i) => {
+      const tap = pipeline.getTap();
+      if (!tap) {
+        return;
+      }
+      const reader = new PipelineTapReader(tap);
+      if (i === 0 && this.config.video !== false) {
+        this.previewTap = reader;
       } else {
-        pipeline.addStage(stage);
+        this.levelTaps.push(reader);
       }
     });
-    this.pipelines.push(pipeline);
   }
 
   /** Run the captured files through ffmpeg to do muxing/minor transcoding. */
@@ -1,7 +1,9 @@
 import { fork, ChildProcess } from "child_process";
 import path from "path";
 
+import { AudioLevels, PreviewFrame } from "./pipeline-tap";
 import { ScreenCapture, ScreenCaptureConfig } from "./screen-capture";
+import { PipelineStats } from "./screen-capture-impl";
 
 class PromiseWithResolvers {
   public resolve: any;
@@ -29,6 +31,7 @@ export class ScreenCaptureSubprocess implements ScreenCapture {
   private errorCallbacks: Array<(error: any) => void>;
   private startedPromise: PromiseWithResolvers | null = null;
   private stoppedPromise: PromiseWithResolvers | null = null;
+  private stats: PipelineStats[] = [];
 
   constructor(config: ScreenCaptureConfig) {
     this.errorCallbacks = [];
@@ -52,6 +55,27 @@ export class ScreenCaptureSubprocess implements ScreenCapture {
     return this.stoppedPromise.promise;
   }
 
+  /**
+   * The stats the subprocess last sent. It sends them every STATS_INTERVAL
+   * (see subprocess-entry.ts) while recording, so they may be that old.
+   */
+  public getStats() {
+    return this.stats;
+  }
+
+  /**
+   * Always null. Preview frames live in memory shared with the recording
+   * process, which is not this one.
+   */
+  public getPreviewFrame(): PreviewFrame | null {
+    return null;
+  }
+
+  /** Always empty, for the same reason as getPreviewFrame. */
+  public getAudioLevels(): Array<AudioLevels | null> {
+    return [];
+  }
+
   public onError(callback: (error: any) => void) {
     this.errorCallbacks.push(callback);
   }
@@ -77,6 +101,10 @@ export class ScreenCaptureSubprocess implements ScreenCapture {
       this.handleError(message.error);
     }
 
+    if (message.type === "stats") {
+      this.stats = message.stats;
+    }
+
     if (message.type === "started" && this.startedPromise) {
       this.startedPromise.resolve();
       this.startedPromise = null;
@@ -1,7 +1,19 @@
+import { AudioLevels, PreviewFrame } from "./pipeline-tap";
+import { PipelineStats } from "./screen-capture-impl";
+
 export interface ScreenCapture {
   start: () => Promise<void>; // Resolved when the pipeline has initialized.
   stop: () => Promise<string>; // Resolved when the final video is ready.
   onError: (callback: (err: string) => void) => void;
+  // Queue, drop and stage latency stats for each running pipeline. Empty
+  // until started.
+  getStats: () => PipelineStats[];
+  // The most recent preview frame, or null if there is none (see
+  // VideoCaptureConfig.preview).
+  getPreviewFrame: () => PreviewFrame | null;
+  // The most recent levels of each audio source, in the configured order (see
+  // AudioCaptureConfig.levels).
+  getAudioLevels: () => Array<AudioLevels | null>;
 }
 
 export interface WindowVideoSource {
@@ -16,6 +28,24 @@ export interface DesktopVideoSource {
 
 export type VideoSource = WindowVideoSource | DesktopVideoSource;
 
+/**
+ * What a queue does when the stage reading from it can not keep up.
+ * - block: wait for the reader, slowing down everything before the queue.
+ * - dropOldest: throw away the oldest queued frame.
+ * - dropNewest: throw away the frame being added.
+ * - dropNonReference: throw away the newest frame no other frame depends on,
+ *   waiting if there is none.
+ */
+export type DropPolicy = "block" | "dropOldest" | "dropNewest" | "dropNonReference";
+
+export interface QueueConfig {
+  // Maximum number of frames held in the queue. Default = 0, which runs both
+  // sides of the queue on the same thread.
+  size?: number;
+  // Default = "block"
+  policy?: DropPolicy;
+}
+
 export interface VideoCaptureConfig {
   // FPS of the output video (frames will be inserted if the capture rate can not keep up).
   frameRate?: number;
@@ -23,6 +53,47 @@ export interface VideoCaptureConfig {
   source?: VideoSource;
   // Whether to capture the cursor. Default = false
   captureCursor?: boolean;
+  // Skip encoding frames that are identical to the previous one, and keep
+  // the real frame timestamps in the output. Default = true
+  variableFrameRate?: boolean;
+  // Compression format of the video. HEVC files are considerably smaller at
+  // the same quality, but not every encoder supports it. Default = "h264"
+  codec?: VideoCodec;
+  // Adapt the bitrate to what the disk and the storage budget allow. Without
+  // this the encoder's default rate control is used.
+  bitrate?: BitrateConfig;
+  // Queue between the capture and the encoder.
+  encoderQueue?: QueueConfig;
+  // Queue between the encoder and the file writer.
+  writerQueue?: QueueConfig;
+  // Publish scaled down frames for a live preview (see
+  // ScreenCapture.getPreviewFrame). Default = no preview
+  preview?: PreviewConfig;
+}
+
+/**
+ * Preview frames are shared with the recording process rather than copied,
+ * so they are not available when capturing in a subprocess.
+ */
+export interface PreviewConfig {
+  // Frames are halved in size until they are at most this wide. Default = 320
+  maxWidth?: number;
+  // Default = 10
+  frameRate?: number;
+}
+
+export type VideoCodec = "h264" | "hevc";
+
+/** Bounds for the adaptive bitrate, all in bits per second. */
+export interface BitrateConfig {
+  // Default = 5000000
+  initial?: number;
+  // Default = 1000000
+  min?: number;
+  // Default = 10000000
+  max?: number;
+  // Long run average the recording should stay under. Default = no budget
+  budget?: number;
 }
 
 export interface AudioSource {
@@ -31,6 +102,12 @@ export interface AudioSource {
 
 export interface AudioCaptureConfig {
   sources?: AudioSource[];
+  // Queue between the audio capture and the file writer.
+  writerQueue?: QueueConfig;
+  // Publish peak and RMS levels for a live meter (see
+  // ScreenCapture.getAudioLevels). Not available when capturing in a
+  // subprocess. Default = false
+  levels?: boolean;
 }
 
 export interface OutputConfig {
@@ -1,7 +1,11 @@
 import { ScreenCapture, ScreenCaptureConfig } from "./screen-capture";
 import { ScreenCaptureImpl } from "./screen-capture-impl";
 
+// How often the stats are sent to the parent, in milliseconds.
+const STATS_INTERVAL = 1000;
+
 let SCREEN_CAPTURE: ScreenCapture | null = null;
+let STATS_TIMER: ReturnType<typeof setInterval> | null = null;
 
 /** Send a message to the parent process. */
 const sendMessage = (msg: any) => {
@@ -24,7 +28,10 @@ const handleStart = async () => {
   }
 
   SCREEN_CAPTURE.start().then(
-    () => sendMessage({ type: "started" }),
+    () => {
+      sendMessage({ type: "started" });
+      STATS_TIMER = setInterval(sendStats, STATS_INTERVAL);
+    },
     e => {
       handleError(e.message);
       process.exit(-1);
@@ -39,6 +46,11 @@ const handleStop = async () => {
     return;
   }
 
+  if (STATS_TIMER) {
+    clearInterval(STATS_TIMER);
+    STATS_TIMER = null;
+  }
+
   SCREEN_CAPTURE.stop().then(
     output => {
       sendMessage({ type: "stopped", output });
@@ -50,6 +62,13 @@ const handleStop = async () => {
   );
 };
 
+/** Sends the current stats to the parent, for ScreenCaptureSubprocess.getStats. */
+const sendStats = () => {
+  if (SCREEN_CAPTURE) {
+    sendMessage({ type: "stats", stats: SCREEN_CAPTURE.getStats() });
+  }
+};
+
 /** Handles any errors and broadcasts to the parent. */
 const handleError = async (error: any) => {
   if (process.send) {
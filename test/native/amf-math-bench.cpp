@@ -0,0 +1,42 @@
+#include <random>
+#include <vector>
+
+#include "amf-math-ops.h"
+#include "test.h"
+
+const size_t MATRICES = 1024;
+// A 128 by 128 stitch mesh.
+const size_t POINTS = 129 * 129;
+
+int main()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> value(-1, 1);
+    std::vector<float> a(MATRICES * 16), b(MATRICES * 16), out(MATRICES * 16);
+    for (float &x : a)
+    {
+        x = value(random);
+    }
+    for (float &x : b)
+    {
+        x = value(random);
+    }
+    std::vector<float> points(POINTS * POINT_FLOATS);
+    for (float &x : points)
+    {
+        x = value(random);
+    }
+
+    bench("Matrix * Matrix, SIMD", 100,
+          [&](unsigned) { simdOps::multiplyMatrices(a.data(), b.data(), out.data(), MATRICES); });
+    bench("Matrix * Matrix, no SIMD", 100,
+          [&](unsigned) { scalarOps::multiplyMatrices(a.data(), b.data(), out.data(), MATRICES); });
+    bench("Matrix inverse, SIMD", 100, [&](unsigned) { simdOps::invertMatrices(a.data(), out.data(), MATRICES); });
+    bench("Matrix inverse, no SIMD", 100, [&](unsigned) { scalarOps::invertMatrices(a.data(), out.data(), MATRICES); });
+    bench("Mesh points, SIMD", 100,
+          [&](unsigned i) { simdOps::transformPoints(&a[(i % MATRICES) * 16], points.data(), points.data(), POINTS); });
+    bench("Mesh points, no SIMD", 100, [&](unsigned i) {
+        scalarOps::transformPoints(&a[(i % MATRICES) * 16], points.data(), points.data(), POINTS);
+    });
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <cstring>
+
+#include "../../src/native/amf/public/common/AMFMath.h"
+#include "amf-math-ops.h"
+
+static amf::Vector loadVector(const float *p)
+{
+    return amf::Vector(p[0], p[1], p[2], p[3]);
+}
+
+static void storeVector(float *out, const amf::Vector &v)
+{
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+    out[3] = v.w;
+}
+
+static amf::Matrix loadMatrix(const float *p)
+{
+    return amf::Matrix(const_cast<float *>(p));
+}
+
+static void storeMatrix(float *out, const amf::Matrix &m)
+{
+    memcpy(out, m.k, sizeof(m.k));
+}
+
+namespace AMF_MATH_OPS
+{
+void vectorOps(const float *a, const float *b, float *out)
+{
+    amf::Vector A = loadVector(a);
+    amf::Vector B = loadVector(b);
+    storeVector(out, A + B);
+    storeVector(out + 4, A - B);
+    storeVector(out + 8, A * B);
+    storeVector(out + 12, A.Dot3(B));
+    storeVector(out + 16, A.Dot4(B));
+    storeVector(out + 20, A.Length3());
+    storeVector(out + 24, A.Length4());
+    storeVector(out + 28, A.Normalize3());
+    storeVector(out + 32, A.Cross3(B));
+    storeVector(out + 36, A.Negate());
+    storeVector(out + 40, A.Reciprocal());
+    storeVector(out + 44, A.Sqrt());
+    amf::Vector C = A;
+    C += B;
+    C -= A;
+    C *= B;
+    storeVector(out + 48, C);
+}
+
+void quaternionOps(const float *a, const float *b, float *out)
+{
+    amf::Quaternion A(a[0], a[1], a[2], a[3]);
+    amf::Quaternion B(b[0], b[1], b[2], b[3]);
+    storeVector(out, A * B);
+    amf::Quaternion euler(a[0], a[1], a[2]);
+    storeVector(out + 4, euler);
+    storeVector(out + 8, euler.ToEulerAngles());
+    storeVector(out + 12, A.DistanceAngles(B));
+    amf::Quaternion rotated = A;
+    rotated.RotateBy(B);
+    storeVector(out + 16, rotated);
+}
+
+void matrixOps(const float *a, const float *b, const float *v, float *out)
+{
+    amf::Matrix A = loadMatrix(a);
+    amf::Matrix B = loadMatrix(b);
+    storeMatrix(out, A * B);
+    storeMatrix(out + 16, A.Transpose());
+    amf::Vector determinant;
+    storeMatrix(out + 32, A.Inverse(&determinant));
+    out[48] = determinant.x;
+    out[49] = A.Determinant().x;
+    out[50] = 0;
+    out[51] = 0;
+    storeVector(out + 52, A * loadVector(v));
+
+    amf::Matrix rotation;
+    rotation.RotationRollPitchYaw(v[0], v[1], v[2]);
+    storeMatrix(out + 56, rotation);
+    amf::Matrix view;
+    view.LookToLH(loadVector(a), loadVector(b), amf::Vector(0, 1, 0, 0));
+    storeMatrix(out + 72, view);
+    amf::Matrix projection;
+    projection.PerspectiveFovLH(1.2f, 1.7f, 0.1f, 100.0f);
+    storeMatrix(out + 88, projection * A);
+
+    amf::Quaternion orientation;
+    amf::Vector position;
+    amf::Vector scale;
+    bool decomposed = rotation.DecomposeMatrix(orientation, position, scale);
+    storeVector(out + 104, orientation);
+    out[108] = decomposed ? 1.0f : 0.0f;
+}
+
+void transformPoints(const float *matrix, const float *in, float *out, size_t count)
+{
+    loadMatrix(matrix).TransformPoints(in, POINT_FLOATS * sizeof(float), out, POINT_FLOATS * sizeof(float), count);
+}
+
+void multiplyMatrices(const float *a, const float *b, float *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        storeMatrix(out + i * 16, loadMatrix(a + i * 16) * loadMatrix(b + i * 16));
+    }
+}
+
+void invertMatrices(const float *in, float *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        amf::Vector determinant;
+        storeMatrix(out + i * 16, loadMatrix(in + i * 16).Inverse(&determinant));
+    }
+}
+} // namespace AMF_MATH_OPS
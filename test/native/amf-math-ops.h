@@ -0,0 +1,35 @@
+#ifndef AMF_MATH_OPS_H
+#define AMF_MATH_OPS_H
+#include <cstddef>
+
+/**
+ * AMFMath operations on plain floats, so the SIMD build of AMFMath and the
+ * AMF_MATH_NO_SIMD build can be linked into one program and compared.
+ * amf-math-ops.cpp is compiled once into simdOps and once into scalarOps.
+ *
+ * vectorOps covers the arithmetic, dot and cross products, lengths and
+ * normalization, quaternionOps the products, Euler angles and rotations, and
+ * matrixOps the products, inverse, determinant, the view and projection
+ * matrices and decomposition. Each writes its results one after another.
+ */
+
+const int VECTOR_RESULTS = 52;
+const int QUATERNION_RESULTS = 20;
+const int MATRIX_RESULTS = 109;
+// Points are laid out like the stitcher's vertices: position, then texture.
+const int POINT_FLOATS = 7;
+
+#define AMF_MATH_DECLARE_OPS(name)                                                        \
+    namespace name                                                                        \
+    {                                                                                     \
+    void vectorOps(const float *a, const float *b, float *out);                           \
+    void quaternionOps(const float *a, const float *b, float *out);                       \
+    void matrixOps(const float *a, const float *b, const float *v, float *out);           \
+    void transformPoints(const float *matrix, const float *in, float *out, size_t count); \
+    void multiplyMatrices(const float *a, const float *b, float *out, size_t count);      \
+    void invertMatrices(const float *in, float *out, size_t count);                       \
+    }
+
+AMF_MATH_DECLARE_OPS(simdOps)
+AMF_MATH_DECLARE_OPS(scalarOps)
+#endif
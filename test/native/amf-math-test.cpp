@@ -0,0 +1,103 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "amf-math-ops.h"
+#include "test.h"
+
+const int CASES = 20000;
+const size_t POINTS = 10000;
+
+/** Bit for bit, apart from NaNs, whose payload SSE and plain floats don't agree on. */
+static bool same(const float *a, const float *b, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (memcmp(&a[i], &b[i], sizeof(float)) != 0 && !(std::isnan(a[i]) && std::isnan(b[i])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Every operation gives exactly what the AMF_MATH_NO_SIMD build gives. */
+static void testAgainstScalar()
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> value(-3, 3);
+    for (int i = 0; i < CASES; i++)
+    {
+        float a[16], b[16], v[4];
+        for (float &x : a)
+        {
+            x = value(random);
+        }
+        for (float &x : b)
+        {
+            x = value(random);
+        }
+        for (float &x : v)
+        {
+            x = value(random);
+        }
+        // Plenty of zeros, for the degenerate cases.
+        if (i % 7 == 0)
+        {
+            a[3] = 0;
+            a[7] = 0;
+        }
+
+        float simd[MATRIX_RESULTS], scalar[MATRIX_RESULTS];
+        simdOps::vectorOps(a, b, simd);
+        scalarOps::vectorOps(a, b, scalar);
+        CHECK(same(simd, scalar, VECTOR_RESULTS));
+        simdOps::quaternionOps(a, b, simd);
+        scalarOps::quaternionOps(a, b, scalar);
+        CHECK(same(simd, scalar, QUATERNION_RESULTS));
+        simdOps::matrixOps(a, b, v, simd);
+        scalarOps::matrixOps(a, b, v, scalar);
+        CHECK(same(simd, scalar, MATRIX_RESULTS));
+    }
+}
+
+/** Transforming points writes x, y and z and leaves the rest of each vertex alone. */
+static void testTransformPoints()
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<float> value(-3, 3);
+    float matrix[16];
+    for (float &x : matrix)
+    {
+        x = value(random);
+    }
+    std::vector<float> points(POINTS * POINT_FLOATS);
+    for (float &x : points)
+    {
+        x = value(random);
+    }
+
+    std::vector<float> simd = points;
+    std::vector<float> scalar = points;
+    simdOps::transformPoints(matrix, points.data(), simd.data(), POINTS);
+    scalarOps::transformPoints(matrix, points.data(), scalar.data(), POINTS);
+    CHECK(same(simd.data(), scalar.data(), simd.size()));
+    for (size_t i = 0; i < POINTS; i++)
+    {
+        CHECK(same(&simd[i * POINT_FLOATS + 3], &points[i * POINT_FLOATS + 3], POINT_FLOATS - 3));
+    }
+
+    // In place gives the same as out of place.
+    std::vector<float> inPlace = points;
+    simdOps::transformPoints(matrix, inPlace.data(), inPlace.data(), POINTS);
+    CHECK(same(inPlace.data(), simd.data(), simd.size()));
+}
+
+int main()
+{
+    testAgainstScalar();
+    testTransformPoints();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <algorithm>
+
+#include "../../src/native/stages/common/bitrate-controller.h"
+#include "test.h"
+
+const unsigned FRAME_RATE = 30;
+const long long TIMESTAMPS_PER_SECOND = 10000000;
+
+/**
+ * An encoder feeding a writer through a queue, one frame at a time. The
+ * encoder hits whatever target it is given, times overshoot, and the disk
+ * takes diskRate bytes a second. Everything is reported to the controller the
+ * way the pipeline and the writer do, once a second.
+ */
+struct Simulation
+{
+    BitrateController controller;
+    double diskRate;
+    double queueCapacity;
+    double overshoot = 1;
+
+    unsigned frames = 0;
+    double queued = 0;
+    double totalBits = 0;
+    unsigned target = 0;
+    // Per second, since the last report.
+    double written = 0;
+    double fill = 0;
+
+    Simulation(PipelineBitrateConfig config, double diskRate, double queueCapacity)
+        : controller(config), diskRate(diskRate), queueCapacity(queueCapacity)
+    {
+    }
+
+    double elapsed() { return (double)frames / FRAME_RATE; }
+
+    void step()
+    {
+        target = controller.getTargetBitrate(frames * TIMESTAMPS_PER_SECOND / FRAME_RATE);
+        double size = target / 8.0 / FRAME_RATE * overshoot;
+        controller.observeFrame((unsigned)size);
+        totalBits += (unsigned)size * 8.0;
+        queued = std::min(queued + size, queueCapacity);
+        double drained = std::min(queued, diskRate / FRAME_RATE);
+        queued -= drained;
+        written += drained;
+        fill = std::max(fill, queued / queueCapacity);
+        frames++;
+        if (frames % FRAME_RATE == 0)
+        {
+            controller.observeQueue(fill);
+            if (written > 0)
+            {
+                controller.observeWrite((unsigned)written, written / diskRate);
+            }
+            written = 0;
+            fill = 0;
+        }
+    }
+
+    void run(unsigned seconds)
+    {
+        for (unsigned i = 0; i < seconds * FRAME_RATE; i++)
+        {
+            step();
+        }
+    }
+};
+
+static PipelineBitrateConfig bitrates(unsigned initial, unsigned budget)
+{
+    PipelineBitrateConfig config;
+    config.adaptive = true;
+    config.initial = initial;
+    config.min = 1000000;
+    config.max = 10000000;
+    config.budget = budget;
+    return config;
+}
+
+/** A stalled disk backs the queue up, which cuts the bitrate a step per interval. */
+static void testQueueBackup()
+{
+    Simulation simulation(bitrates(8000000, 0), 1e9, 2000000);
+    simulation.run(5);
+    CHECK(simulation.target == 10000000);
+
+    simulation.diskRate = 0;
+    simulation.run(2);
+    unsigned before = simulation.target;
+    simulation.run(1);
+    CHECK(simulation.target < before);
+    CHECK(simulation.target >= before * 0.69 && simulation.target <= before * 0.71);
+    simulation.run(10);
+    CHECK(simulation.target == 1000000);
+
+    // Once the disk is back and the queue has drained, the bitrate climbs again.
+    simulation.diskRate = 1e9;
+    simulation.run(3);
+    before = simulation.target;
+    simulation.run(1);
+    CHECK(simulation.target > before);
+}
+
+/** However long it runs, a slow disk keeps the bitrate under what it can write. */
+static void testSlowDisk()
+{
+    // 4 Mbit/s of disk.
+    Simulation simulation(bitrates(8000000, 0), 500000, 4000000);
+    simulation.run(3);
+    for (unsigned second = 0; second < 120; second++)
+    {
+        simulation.run(1);
+        CHECK(simulation.target <= 4000000);
+    }
+    CHECK(simulation.target >= 2500000);
+    CHECK(simulation.queued < simulation.queueCapacity / 2);
+}
+
+/** Overspending the budget holds the bitrate below it until the overspend is paid back. */
+static void testBudgetPayback()
+{
+    const unsigned BUDGET = 3000000;
+    Simulation simulation(bitrates(BUDGET, BUDGET), 1e9, 4000000);
+    // A scene the encoder can't hit its target on.
+    simulation.overshoot = 2;
+    simulation.run(20);
+    CHECK(simulation.totalBits > BUDGET * simulation.elapsed() * 1.2);
+
+    simulation.overshoot = 1;
+    unsigned previous = 0;
+    bool paidBack = false;
+    for (unsigned second = 0; second < 300; second++)
+    {
+        simulation.run(1);
+        double overspent = simulation.totalBits - BUDGET * simulation.elapsed();
+        // Still overspent, so spending stays under the budget. The ceiling rises as
+        // it is paid back, but never past the budget.
+        CHECK(simulation.target < BUDGET);
+        CHECK(simulation.target >= previous);
+        previous = simulation.target;
+        paidBack = paidBack || overspent < BUDGET * 0.5;
+    }
+    CHECK(paidBack);
+    CHECK(simulation.target > BUDGET * 0.99);
+}
+
+int main()
+{
+    testQueueBackup();
+    testSlowDisk();
+    testBudgetPayback();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <vector>
+
+#include "../../src/native/stages/common/bitstream.h"
+#include "test.h"
+
+typedef std::vector<unsigned char> Bytes;
+
+static Bytes join(std::initializer_list<Bytes> parts)
+{
+    Bytes bytes;
+    for (auto &part : parts)
+    {
+        bytes.insert(bytes.end(), part.begin(), part.end());
+    }
+    return bytes;
+}
+
+// H264 units. The byte after the header starts the slice header, where a set top
+// bit means first_mb_in_slice is 0, so it is the first slice of its picture.
+const Bytes H264_AUD = {0, 0, 0, 1, 0x09, 0xf0};
+const Bytes H264_SPS = {0, 0, 0, 1, 0x67, 0x42, 0xc0, 0x1f, 0x00, 0x00, 0x03, 0x00, 0x01};
+const Bytes H264_PPS = {0, 0, 1, 0x68, 0xce, 0x3c, 0x80};
+const Bytes H264_SEI = {0, 0, 1, 0x06, 0x05, 0x01, 0x00, 0x80};
+const Bytes H264_IDR = {0, 0, 1, 0x65, 0x88, 0x84, 0x00, 0x00, 0x03, 0x01, 0x21};
+const Bytes H264_REFERENCE_SLICE = {0, 0, 1, 0x41, 0x9a, 0x02, 0x00, 0x00, 0x03, 0x00, 0x7f};
+const Bytes H264_NON_REFERENCE_SLICE = {0, 0, 1, 0x01, 0x9e, 0x04, 0x11};
+// A second slice of the same picture, first_mb_in_slice isn't 0.
+const Bytes H264_LATER_SLICE = {0, 0, 1, 0x41, 0x40, 0x11, 0x22};
+
+// HEVC units, with the two byte header.
+const Bytes HEVC_AUD = {0, 0, 0, 1, 0x46, 0x01, 0x50};
+const Bytes HEVC_VPS = {0, 0, 0, 1, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff};
+const Bytes HEVC_SPS = {0, 0, 0, 1, 0x42, 0x01, 0x01, 0x00, 0x00, 0x03, 0x00, 0xb0};
+const Bytes HEVC_PPS = {0, 0, 0, 1, 0x44, 0x01, 0xc1, 0x72, 0xb4};
+const Bytes HEVC_SEI = {0, 0, 1, 0x4e, 0x01, 0x05, 0x10, 0x80};
+const Bytes HEVC_IDR = {0, 0, 1, 0x26, 0x01, 0xaf, 0x00, 0x00, 0x03, 0x02, 0x14};
+const Bytes HEVC_CRA = {0, 0, 1, 0x2a, 0x01, 0xaf, 0x1c, 0x33};
+const Bytes HEVC_TRAIL_R = {0, 0, 1, 0x02, 0x01, 0xd0, 0x00, 0x00, 0x03, 0x00, 0x44};
+const Bytes HEVC_TRAIL_N = {0, 0, 1, 0x00, 0x01, 0xd2, 0x0a, 0x56};
+
+static FrameInfo describe(VideoCodec codec, const Bytes &packet)
+{
+    FrameInfo info;
+    // Start from the opposite of what's expected, so every flag has to be set.
+    info.keyframe = true;
+    info.reference = false;
+    describePacket(codec, packet.data(), packet.size(), info);
+    return info;
+}
+
+/** Units split at both start code lengths and not at emulation prevention bytes. */
+static void testSplitting()
+{
+    Bytes packet = join({H264_AUD, H264_SPS, H264_PPS, H264_IDR});
+    auto units = findNalUnits(H264, packet.data(), packet.size());
+    CHECK(units.size() == 4);
+    unsigned types[] = {9, 7, 8, 5};
+    unsigned offset = 0;
+    const Bytes *parts[] = {&H264_AUD, &H264_SPS, &H264_PPS, &H264_IDR};
+    for (unsigned i = 0; i < units.size(); i++)
+    {
+        unsigned startCode = (*parts[i])[2] == 1 ? 3 : 4;
+        CHECK(units[i].type == types[i]);
+        CHECK(units[i].start == offset);
+        CHECK(units[i].header == offset + startCode);
+        offset += parts[i]->size();
+        CHECK(units[i].end == offset);
+    }
+
+    // Trailing zeros in front of a 4 byte start code stay with the previous unit.
+    Bytes padded = join({H264_PPS, {0, 0}, H264_AUD});
+    units = findNalUnits(H264, padded.data(), padded.size());
+    CHECK(units.size() == 2);
+    CHECK(units[0].end == H264_PPS.size() + 2);
+    CHECK(units[1].start == H264_PPS.size() + 2);
+    CHECK(units[1].header == padded.size() - 2);
+
+    packet = join({HEVC_AUD, HEVC_VPS, HEVC_SPS, HEVC_PPS, HEVC_SEI, HEVC_IDR});
+    units = findNalUnits(HEVC, packet.data(), packet.size());
+    CHECK(units.size() == 6);
+    unsigned hevcTypes[] = {35, 32, 33, 34, 39, 19};
+    for (unsigned i = 0; i < units.size(); i++)
+    {
+        CHECK(units[i].type == hevcTypes[i]);
+    }
+    CHECK(units[5].end == packet.size());
+
+    // Nothing to split without a start code.
+    Bytes noise = {0x00, 0x00, 0x03, 0x01, 0x00, 0x02};
+    CHECK(findNalUnits(H264, noise.data(), noise.size()).empty());
+}
+
+static void testFlags()
+{
+    FrameInfo info = describe(H264, join({H264_AUD, H264_SPS, H264_PPS, H264_SEI, H264_IDR}));
+    CHECK(info.keyframe && info.reference);
+    info = describe(H264, join({H264_AUD, H264_REFERENCE_SLICE, H264_LATER_SLICE}));
+    CHECK(!info.keyframe && info.reference);
+    info = describe(H264, join({H264_AUD, H264_NON_REFERENCE_SLICE}));
+    CHECK(!info.keyframe && !info.reference);
+    // Parameter sets alone aren't a picture.
+    info = describe(H264, join({H264_SPS, H264_PPS}));
+    CHECK(!info.keyframe && !info.reference);
+
+    info = describe(HEVC, join({HEVC_AUD, HEVC_VPS, HEVC_SPS, HEVC_PPS, HEVC_IDR}));
+    CHECK(info.keyframe && info.reference);
+    info = describe(HEVC, join({HEVC_AUD, HEVC_CRA}));
+    CHECK(info.keyframe && info.reference);
+    info = describe(HEVC, join({HEVC_AUD, HEVC_TRAIL_R}));
+    CHECK(!info.keyframe && info.reference);
+    info = describe(HEVC, join({HEVC_AUD, HEVC_SEI, HEVC_TRAIL_N}));
+    CHECK(!info.keyframe && !info.reference);
+}
+
+static void testParameterSets()
+{
+    Bytes parameterSets;
+    Bytes packet = join({H264_AUD, H264_SPS, H264_PPS, H264_SEI, H264_IDR});
+    CHECK(extractParameterSets(H264, packet.data(), packet.size(), parameterSets));
+    CHECK(parameterSets == join({H264_SPS, H264_PPS}));
+    packet = join({H264_AUD, H264_REFERENCE_SLICE});
+    CHECK(!extractParameterSets(H264, packet.data(), packet.size(), parameterSets));
+    CHECK(parameterSets.empty());
+
+    packet = join({HEVC_AUD, HEVC_VPS, HEVC_SPS, HEVC_PPS, HEVC_SEI, HEVC_IDR});
+    CHECK(extractParameterSets(HEVC, packet.data(), packet.size(), parameterSets));
+    CHECK(parameterSets == join({HEVC_VPS, HEVC_SPS, HEVC_PPS}));
+    packet = join({HEVC_AUD, HEVC_TRAIL_R});
+    CHECK(!extractParameterSets(HEVC, packet.data(), packet.size(), parameterSets));
+}
+
+/** The tail of a stream cut off in the middle of its last access unit. */
+static void testLastAccessUnit()
+{
+    Bytes keyframe = join({H264_AUD, H264_SPS, H264_PPS, H264_SEI, H264_IDR});
+    Bytes second = join({H264_AUD, H264_REFERENCE_SLICE, H264_LATER_SLICE});
+    Bytes stream = join({keyframe, second, H264_AUD, H264_NON_REFERENCE_SLICE});
+    Bytes truncated(stream.begin(), stream.end() - 2);
+    unsigned start = 0;
+    CHECK(findLastAccessUnit(H264, truncated.data(), truncated.size(), &start));
+    CHECK(start == keyframe.size() + second.size());
+
+    // Cut right after the slice's header, there's no telling whether it starts a
+    // picture, so the one before it is the last one known.
+    Bytes header(stream.begin(), stream.end() - H264_NON_REFERENCE_SLICE.size() + 4);
+    CHECK(findLastAccessUnit(H264, header.data(), header.size(), &start));
+    CHECK(start == keyframe.size());
+
+    // The later slice belongs to the picture in front of it.
+    Bytes twoSlices = join({keyframe, second});
+    CHECK(findLastAccessUnit(H264, twoSlices.data(), twoSlices.size(), &start));
+    CHECK(start == keyframe.size());
+
+    // A single access unit might have begun before the data does.
+    CHECK(!findLastAccessUnit(H264, keyframe.data(), keyframe.size(), &start));
+    CHECK(start == 0);
+    Bytes empty;
+    CHECK(!findLastAccessUnit(H264, empty.data(), empty.size(), &start));
+
+    // HEVC, with the parameter sets and SEI counted as part of the access unit.
+    Bytes hevcKeyframe = join({HEVC_AUD, HEVC_VPS, HEVC_SPS, HEVC_PPS, HEVC_IDR});
+    Bytes hevcStream = join({hevcKeyframe, HEVC_AUD, HEVC_TRAIL_R, HEVC_SEI, HEVC_TRAIL_N});
+    Bytes hevcTruncated(hevcStream.begin(), hevcStream.end() - 1);
+    CHECK(findLastAccessUnit(HEVC, hevcTruncated.data(), hevcTruncated.size(), &start));
+    CHECK(start == hevcKeyframe.size() + HEVC_AUD.size() + HEVC_TRAIL_R.size());
+}
+
+int main()
+{
+    testSplitting();
+    testFlags();
+    testParameterSets();
+    testLastAccessUnit();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "public/src/components/ComponentsFFMPEG/ContactSheetScale.h"
+#include "../../src/native/amf/public/common/WorkStealingPool.h"
+#include "test.h"
+
+using namespace amf;
+
+// The component's defaults, over a 1080p NV12 recording.
+const amf_int32 COLUMNS = 5;
+const amf_int32 ROWS = 4;
+const amf_int32 TILES = COLUMNS * ROWS;
+const amf_int32 TILE_WIDTH = 320;
+const amf_int32 TILE_HEIGHT = 180;
+const amf_int32 FRAME_WIDTH = 1920;
+const amf_int32 FRAME_HEIGHT = 1080;
+const unsigned SHEETS = 20;
+
+/** A decoded frame per tile, and the YUV420P sheet they are drawn into. */
+struct Sheet
+{
+    std::vector<std::vector<amf_uint8>> frames;
+    std::vector<amf_uint8> planes[3];
+
+    Sheet()
+    {
+        for (amf_int32 tile = 0; tile < TILES; tile++)
+        {
+            std::vector<amf_uint8> frame(FRAME_WIDTH * FRAME_HEIGHT * 3 / 2);
+            for (size_t i = 0; i < frame.size(); i++)
+            {
+                frame[i] = (amf_uint8)(i * 7 + tile * 13);
+            }
+            frames.push_back(frame);
+        }
+        planes[0].resize(COLUMNS * TILE_WIDTH * ROWS * TILE_HEIGHT);
+        planes[1].resize(planes[0].size() / 4);
+        planes[2].resize(planes[0].size() / 4);
+    }
+
+    /** What AMFContactSheetJob::DrawTile does once the tile's frame is decoded. */
+    void drawTile(amf_int32 tile)
+    {
+        const amf_int32 left = (tile % COLUMNS) * TILE_WIDTH;
+        const amf_int32 top = (tile / COLUMNS) * TILE_HEIGHT;
+        const amf_int32 pitch = COLUMNS * TILE_WIDTH;
+        amf_uint8 *tiles[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const amf_int32 shift = i == 0 ? 0 : 1;
+            tiles[i] = planes[i].data() + (top >> shift) * (pitch >> shift) + (left >> shift);
+        }
+        const amf_uint8 *y = frames[tile].data();
+        const amf_uint8 *uv = y + FRAME_WIDTH * FRAME_HEIGHT;
+        AMFContactSheetScalePlane(y, FRAME_WIDTH, FRAME_WIDTH, FRAME_HEIGHT, 1, &tiles[0], pitch, TILE_WIDTH,
+                                  TILE_HEIGHT, AMFContactSheetLumaLevels());
+        AMFContactSheetScalePlane(uv, FRAME_WIDTH, FRAME_WIDTH / 2, FRAME_HEIGHT / 2, 2, &tiles[1], pitch / 2,
+                                  TILE_WIDTH / 2, TILE_HEIGHT / 2, AMFContactSheetChromaLevels());
+    }
+};
+
+/** Like the component's TileTask, minus the decode. */
+class TileTask : public AMFWorkStealingPool::Task
+{
+public:
+    TileTask(Sheet &sheet, amf_int32 tile, std::atomic<amf_int32> &remaining)
+        : sheet(sheet), tile(tile), remaining(remaining)
+    {
+    }
+
+    void Run()
+    {
+        sheet.drawTile(tile);
+        remaining--;
+    }
+
+private:
+    Sheet &sheet;
+    amf_int32 tile;
+    std::atomic<amf_int32> &remaining;
+};
+
+int main()
+{
+    Sheet sheet;
+    bench("contact sheet, serial", SHEETS, [&](unsigned) {
+        for (amf_int32 tile = 0; tile < TILES; tile++)
+        {
+            sheet.drawTile(tile);
+        }
+    });
+
+    AMFWorkStealingPool pool;
+    bench("contact sheet, work stealing pool", SHEETS, [&](unsigned) {
+        std::atomic<amf_int32> remaining(TILES);
+        for (amf_int32 tile = 0; tile < TILES; tile++)
+        {
+            pool.Submit(new TileTask(sheet, tile, remaining));
+        }
+        while (remaining > 0)
+        {
+            std::this_thread::yield();
+        }
+    });
+    printf("(%zu threads, %d)\n", (size_t)pool.GetThreadCount(), sheet.planes[0][TILE_WIDTH / 2]);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "public/include/core/Platform.h"
+#include "../../src/native/amf/public/src/components/AmbisonicRenderer/convolution.h"
+#include "test.h"
+
+const amf_size BLOCK = 256;
+const unsigned BLOCKS = 200;
+
+/** Time one block of one channel through each convolution path. */
+static void run(int length)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> sample(-1, 1);
+    std::vector<float> response(length);
+    std::vector<float> input(BLOCK * BLOCKS);
+    for (float &value : response)
+    {
+        value = sample(random);
+    }
+    for (float &value : input)
+    {
+        value = sample(random);
+    }
+    std::vector<float> output(BLOCK);
+
+    convolution timeDomain(1, length);
+    convolution frequencyDomain(1, length);
+    convolution cached(1, length);
+    timeDomain.init();
+    frequencyDomain.init();
+    cached.init();
+    frequencyDomain.initPartitioned(BLOCK);
+    cached.initPartitioned(BLOCK);
+    std::vector<float> spectrum(cached.spectrumLength());
+    std::vector<float> acc(cached.blockSpectrumLength());
+    cached.computeResponseSpectrum(response.data(), spectrum.data());
+
+    std::string taps = std::to_string(length) + " taps, ";
+    bench((taps + "time domain").c_str(), BLOCKS, [&](unsigned i) {
+        timeDomain.timeDomainCPU(response.data(), 0, length, &input[i * BLOCK], output.data(), 0, BLOCK, length);
+    });
+    bench((taps + "FFT").c_str(), BLOCKS, [&](unsigned i) {
+        frequencyDomain.frequencyDomainCPU(response.data(), 0, length, &input[i * BLOCK], output.data(), 0, BLOCK,
+                                           length);
+    });
+    bench((taps + "FFT, cached spectrum").c_str(), BLOCKS, [&](unsigned i) {
+        cached.pushInput(0, &input[i * BLOCK]);
+        std::fill(acc.begin(), acc.end(), 0.0f);
+        cached.multiplyAccumulate(0, spectrum.data(), acc.data());
+        cached.inverse(acc.data(), output.data());
+    });
+}
+
+int main()
+{
+    for (int length : {512, 2048, 8192})
+    {
+        run(length);
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "public/include/core/Platform.h"
+#include "../../src/native/amf/public/src/components/AmbisonicRenderer/convolution.h"
+#include "test.h"
+
+const amf_size BLOCK = 128;
+const int BLOCKS = 40;
+const int CHANNELS = 3;
+// Both paths add up float products, in different orders, so they only agree to
+// within float rounding of the largest output.
+const double TOLERANCE = 1e-5;
+
+/** A response with taps in [first, last) and zeros everywhere else. */
+static std::vector<float> makeResponse(std::mt19937 &random, int length, int first, int last)
+{
+    std::uniform_real_distribution<float> tap(-1, 1);
+    std::vector<float> response(length, 0.0f);
+    for (int k = first; k < last; k++)
+    {
+        response[k] = tap(random);
+    }
+    return response;
+}
+
+static std::vector<float> makeInput(std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> sample(-1, 1);
+    std::vector<float> input(BLOCK * BLOCKS);
+    for (float &value : input)
+    {
+        value = sample(random);
+    }
+    return input;
+}
+
+/** The convolution of the whole input with the response, in doubles. */
+static std::vector<double> reference(const std::vector<float> &input, const std::vector<float> &response)
+{
+    std::vector<double> output(input.size());
+    for (size_t n = 0; n < input.size(); n++)
+    {
+        double sum = 0;
+        for (size_t k = 0; k < response.size() && k <= n; k++)
+        {
+            sum += (double)input[n - k] * response[k];
+        }
+        output[n] = sum;
+    }
+    return output;
+}
+
+static void checkClose(const std::vector<float> &output, const std::vector<double> &expected)
+{
+    double peak = 0;
+    for (double value : expected)
+    {
+        peak = std::max(peak, std::fabs(value));
+    }
+    for (size_t n = 0; n < output.size(); n++)
+    {
+        CHECK(std::fabs(output[n] - expected[n]) <= TOLERANCE * peak);
+    }
+}
+
+/**
+ * The time domain path, the drop in FFT path and the cached spectrum path all
+ * give the convolution of the input with the response, on every channel.
+ */
+static void testAgainstReference(int length, int first, int last)
+{
+    std::mt19937 random(length + first);
+    std::vector<float> response = makeResponse(random, length, first, last);
+    std::vector<std::vector<float>> inputs;
+    for (int c = 0; c < CHANNELS; c++)
+    {
+        inputs.push_back(makeInput(random));
+    }
+
+    convolution timeDomain(CHANNELS, length);
+    convolution frequencyDomain(CHANNELS, length);
+    convolution cached(CHANNELS, length);
+    CHECK(timeDomain.init());
+    CHECK(frequencyDomain.init());
+    CHECK(cached.init());
+    CHECK(frequencyDomain.initPartitioned(BLOCK));
+    CHECK(cached.initPartitioned(BLOCK));
+
+    std::vector<float> spectrum(cached.spectrumLength());
+    std::vector<float> acc(cached.blockSpectrumLength());
+    cached.computeResponseSpectrum(response.data(), spectrum.data());
+
+    std::vector<std::vector<float>> timeOutputs(CHANNELS, std::vector<float>(BLOCK * BLOCKS));
+    std::vector<std::vector<float>> frequencyOutputs = timeOutputs;
+    std::vector<std::vector<float>> cachedOutputs = timeOutputs;
+    // Channels are interleaved block by block, like the renderer runs them.
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            float *in = &inputs[c][b * BLOCK];
+            timeDomain.timeDomainCPU(response.data(), first, last, in, &timeOutputs[c][b * BLOCK], c, BLOCK, length);
+            frequencyDomain.frequencyDomainCPU(response.data(), first, last, in, &frequencyOutputs[c][b * BLOCK], c,
+                                               BLOCK, length);
+            cached.pushInput(c, in);
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            cached.multiplyAccumulate(c, spectrum.data(), acc.data());
+            cached.inverse(acc.data(), &cachedOutputs[c][b * BLOCK]);
+        }
+    }
+
+    for (int c = 0; c < CHANNELS; c++)
+    {
+        std::vector<double> expected = reference(inputs[c], response);
+        checkClose(timeOutputs[c], expected);
+        checkClose(frequencyOutputs[c], expected);
+        checkClose(cachedOutputs[c], expected);
+    }
+}
+
+/** Blocks that aren't the partition length fall back to the time domain, and give the same output. */
+static void testFallback()
+{
+    const int length = 300;
+    std::mt19937 random(7);
+    std::vector<float> response = makeResponse(random, length, 0, length);
+    std::vector<float> input = makeInput(random);
+
+    convolution timeDomain(1, length);
+    convolution frequencyDomain(1, length);
+    CHECK(timeDomain.init());
+    CHECK(frequencyDomain.init());
+    CHECK(frequencyDomain.initPartitioned(BLOCK));
+
+    const amf_size odd = 96;
+    std::vector<float> expected(input.size());
+    std::vector<float> output(input.size());
+    for (amf_size done = 0; done + odd <= input.size(); done += odd)
+    {
+        timeDomain.timeDomainCPU(response.data(), 0, length, &input[done], &expected[done], 0, odd, length);
+        frequencyDomain.frequencyDomainCPU(response.data(), 0, length, &input[done], &output[done], 0, odd, length);
+    }
+    CHECK(memcmp(expected.data(), output.data(), output.size() * sizeof(float)) == 0);
+}
+
+/** A weighted sum of spectra is the spectrum of the weighted sum of the responses. */
+static void testLinearity()
+{
+    const int length = 512;
+    std::mt19937 random(11);
+    std::vector<float> first = makeResponse(random, length, 0, length);
+    std::vector<float> second = makeResponse(random, length, 0, length);
+    std::vector<float> mixed(length);
+    for (int k = 0; k < length; k++)
+    {
+        mixed[k] = 0.25f * first[k] + 0.5f * second[k];
+    }
+
+    convolution conv(1, length);
+    CHECK(conv.init());
+    CHECK(conv.initPartitioned(BLOCK));
+    std::vector<float> firstSpectrum(conv.spectrumLength());
+    std::vector<float> secondSpectrum(conv.spectrumLength());
+    std::vector<float> mixedSpectrum(conv.spectrumLength());
+    conv.computeResponseSpectrum(first.data(), firstSpectrum.data());
+    conv.computeResponseSpectrum(second.data(), secondSpectrum.data());
+    conv.computeResponseSpectrum(mixed.data(), mixedSpectrum.data());
+
+    double peak = 0;
+    for (float value : mixedSpectrum)
+    {
+        peak = std::max(peak, (double)std::fabs(value));
+    }
+    for (size_t i = 0; i < mixedSpectrum.size(); i++)
+    {
+        float sum = 0.25f * firstSpectrum[i] + 0.5f * secondSpectrum[i];
+        CHECK(std::fabs(sum - mixedSpectrum[i]) <= TOLERANCE * peak);
+    }
+}
+
+static void testInitPartitioned()
+{
+    convolution conv(1, 256);
+    CHECK(conv.init());
+    CHECK(!conv.initPartitioned(96));
+    CHECK(!conv.initPartitioned(2));
+    CHECK(conv.initPartitioned(64));
+    // Only once.
+    CHECK(!conv.initPartitioned(64));
+}
+
+int main()
+{
+    for (int length : {128, 512, 2048})
+    {
+        testAgainstReference(length, 0, length);
+        testAgainstReference(length, 100, length - 20);
+    }
+    testFallback();
+    testLinearity();
+    testInitPartitioned();
+    printf("ok\n");
+    return 0;
+}
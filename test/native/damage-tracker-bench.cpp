@@ -0,0 +1,66 @@
+#include <random>
+#include <vector>
+
+#include "../../src/native/stages/common/damage-tracker.h"
+#include "test.h"
+
+const unsigned WIDTH = 1920;
+const unsigned HEIGHT = 1080;
+const unsigned FRAMES = 2000;
+// Distinct sets of rectangles to cycle through, so the frames aren't all alike.
+const unsigned SETS = 64;
+
+/** Sets of count rectangles of up to maxSize pixels, anywhere in the frame. */
+static std::vector<std::vector<DamageRect>> makeRects(unsigned count, unsigned maxSize)
+{
+    std::mt19937 random(1);
+    std::vector<std::vector<DamageRect>> sets(SETS);
+    for (auto &set : sets)
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            int left = random() % WIDTH;
+            int top = random() % HEIGHT;
+            set.push_back({left, top, left + 1 + (int)(random() % maxSize), top + 1 + (int)(random() % maxSize)});
+        }
+    }
+    return sets;
+}
+
+/** One frame's worth of work in the capture stage: reset, add and merge. */
+static void run(const char *name, const std::vector<std::vector<DamageRect>> &sets)
+{
+    DamageTracker tracker(WIDTH, HEIGHT);
+    unsigned regions = 0;
+    bench(name, FRAMES, [&](unsigned i) {
+        tracker.reset();
+        for (auto &rect : sets[i % SETS])
+        {
+            tracker.add(rect);
+        }
+        regions += tracker.getRegions().size();
+    });
+    // Keeps the work from being optimized away.
+    if (!regions)
+    {
+        printf("no regions\n");
+    }
+}
+
+int main()
+{
+    // A cursor, a caret and a bit of text changing.
+    run("few small rects", makeRects(3, 64));
+    // Windows being dragged around.
+    run("few large rects", makeRects(4, 800));
+    // A busy screen reported as lots of small dirty rects.
+    run("many small rects", makeRects(200, 48));
+
+    DamageTracker tracker(WIDTH, HEIGHT);
+    bench("full frame", FRAMES, [&](unsigned) {
+        tracker.reset();
+        tracker.addAll();
+        tracker.getRegions();
+    });
+    return 0;
+}
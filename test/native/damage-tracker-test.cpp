@@ -0,0 +1,212 @@
+#include <random>
+#include <vector>
+
+#include "../../src/native/stages/common/damage-tracker.h"
+#include "test.h"
+
+static bool equals(const DamageRect &a, const DamageRect &b)
+{
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+static unsigned countBlocks(DamageTracker &tracker)
+{
+    unsigned count = 0;
+    for (auto block : tracker.getBlockMap())
+    {
+        count += block != 0;
+    }
+    return count;
+}
+
+static void testClipping()
+{
+    // Neither dimension is a multiple of the block size.
+    DamageTracker tracker(100, 50, 16);
+    CHECK(tracker.getBlocksWide() == 7);
+    CHECK(tracker.getBlocksHigh() == 4);
+
+    // Entirely outside the frame, or empty.
+    tracker.add({-20, -20, 0, 10});
+    tracker.add({100, 0, 120, 10});
+    tracker.add({10, 10, 10, 20});
+    CHECK(tracker.isEmpty());
+    CHECK(tracker.getRegions().empty());
+
+    // Hanging off the bottom right corner, so the last row and column of blocks
+    // are clipped to the frame.
+    tracker.add({90, 40, 200, 200});
+    auto regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {80, 32, 100, 50}));
+
+    // Hanging off the top left corner.
+    tracker.reset();
+    tracker.add({-5, -5, 3, 3});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 16, 16}));
+
+    // Everything, one way or another, comes back as exactly the frame.
+    tracker.reset();
+    tracker.add({-1000, -1000, 1000, 1000});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 100, 50}));
+    tracker.reset();
+    tracker.addAll();
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 100, 50}));
+}
+
+static void testRowRuns()
+{
+    DamageTracker tracker(160, 160, 16);
+
+    // Rounded out to whole blocks, then merged down the rows into one rectangle.
+    tracker.add({17, 17, 63, 63});
+    auto regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {16, 16, 64, 64}));
+
+    // Two runs on the same rows stay apart.
+    tracker.reset();
+    tracker.add({0, 0, 16, 32});
+    tracker.add({48, 0, 64, 32});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 2);
+    CHECK(equals(regions[0], {0, 0, 16, 32}));
+    CHECK(equals(regions[1], {48, 0, 64, 32}));
+
+    // A run only extends the rectangle above it if it lines up exactly.
+    tracker.reset();
+    tracker.add({0, 0, 64, 16});
+    tracker.add({0, 16, 32, 32});
+    tracker.add({0, 32, 32, 48});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 2);
+    CHECK(equals(regions[0], {0, 0, 64, 16}));
+    CHECK(equals(regions[1], {0, 16, 32, 48}));
+
+    // A gap of one row starts a new rectangle.
+    tracker.reset();
+    tracker.add({0, 0, 32, 16});
+    tracker.add({0, 32, 32, 48});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 2);
+}
+
+static void testOverlappingAndAdjacent()
+{
+    DamageTracker tracker(160, 160, 16);
+
+    // Overlapping rectangles mark their blocks once.
+    tracker.add({0, 0, 48, 48});
+    tracker.add({16, 16, 64, 64});
+    CHECK(countBlocks(tracker) == 9 + 9 - 4);
+
+    // Overlaps covering the whole frame come back as the frame, which relies on
+    // every block being counted once.
+    tracker.reset();
+    tracker.add({0, 0, 160, 96});
+    tracker.add({0, 64, 160, 160});
+    auto regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 160, 160}));
+
+    // Side by side rectangles become one run per row, and so one rectangle.
+    tracker.reset();
+    tracker.add({0, 0, 32, 32});
+    tracker.add({32, 0, 64, 32});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 64, 32}));
+
+    // Stacked rectangles of the same width merge down the rows.
+    tracker.reset();
+    tracker.add({32, 0, 64, 32});
+    tracker.add({32, 32, 64, 64});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {32, 0, 64, 64}));
+
+    // Rectangles sharing a block without touching in pixels still share it.
+    tracker.reset();
+    tracker.add({0, 0, 20, 16});
+    tracker.add({24, 0, 40, 16});
+    regions = tracker.getRegions();
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 48, 16}));
+}
+
+static void testTooManyRegions()
+{
+    DamageTracker tracker(160, 160, 16);
+    // A checkerboard of single blocks can't be merged at all.
+    for (int y = 0; y < 160; y += 32)
+    {
+        for (int x = 0; x < 160; x += 32)
+        {
+            tracker.add({x, y, x + 16, y + 16});
+        }
+    }
+    CHECK(tracker.getRegions(25).size() == 25);
+    auto regions = tracker.getRegions(24);
+    CHECK(regions.size() == 1);
+    CHECK(equals(regions[0], {0, 0, 144, 144}));
+}
+
+/**
+ * Whatever goes in, the regions have to cover exactly the damaged blocks, each
+ * of them once.
+ */
+static void testRandomCoverage()
+{
+    std::mt19937 random(1);
+    for (unsigned round = 0; round < 500; round++)
+    {
+        unsigned width = 1 + random() % 400;
+        unsigned height = 1 + random() % 300;
+        DamageTracker tracker(width, height, 16);
+        unsigned rects = random() % 12;
+        for (unsigned i = 0; i < rects; i++)
+        {
+            int left = (int)(random() % (width + 40)) - 20;
+            int top = (int)(random() % (height + 40)) - 20;
+            tracker.add({left, top, left + (int)(random() % 120), top + (int)(random() % 120)});
+        }
+
+        auto regions = tracker.getRegions(1000);
+        std::vector<unsigned char> covered(tracker.getBlockMap().size(), 0);
+        for (auto &region : regions)
+        {
+            CHECK(region.left >= 0 && region.top >= 0);
+            CHECK(region.right <= (int)width && region.bottom <= (int)height);
+            CHECK(region.left < region.right && region.top < region.bottom);
+            CHECK(region.left % 16 == 0 && region.top % 16 == 0);
+            for (int row = region.top / 16; row * 16 < region.bottom; row++)
+            {
+                for (int column = region.left / 16; column * 16 < region.right; column++)
+                {
+                    covered[row * tracker.getBlocksWide() + column]++;
+                }
+            }
+        }
+        for (unsigned i = 0; i < covered.size(); i++)
+        {
+            CHECK(covered[i] == (tracker.getBlockMap()[i] ? 1 : 0));
+        }
+    }
+}
+
+int main()
+{
+    testClipping();
+    testRowRuns();
+    testOverlappingAndAdjacent();
+    testTooManyRegions();
+    testRandomCoverage();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "../../src/native/stages/common/frame-queue.h"
+#include "test.h"
+
+// Stand ins for the frames' data, only their addresses are used.
+static int frames[8];
+
+/** A frame with some changes, described relative to the one before it. */
+static FrameInfo changed(bool reference = true)
+{
+    FrameInfo info;
+    info.reference = reference;
+    info.damage.push_back({0, 0, 64, 64});
+    return info;
+}
+
+/** A frame identical to the one before it. */
+static FrameInfo repeat()
+{
+    FrameInfo info;
+    info.repeat = true;
+    info.reference = false;
+    return info;
+}
+
+static FrameQueue queueOf(DropPolicy policy, unsigned size)
+{
+    PipelineEdgeConfig config;
+    config.policy = policy;
+    config.queueSize = size;
+    return FrameQueue(config);
+}
+
+/**
+ * Pushes a frame the way PipelineEdge does. Returns what was dropped to make
+ * room, which is DROPPED_NONE when the edge would have had to wait.
+ */
+static FrameQueue::Drop offer(FrameQueue &queue, int index, const FrameInfo &info, void **dropped = nullptr)
+{
+    void *droppedData = nullptr;
+    FrameQueue::Drop drop = FrameQueue::DROPPED_NONE;
+    if (queue.isFull())
+    {
+        drop = queue.makeRoom(info, &droppedData);
+        if (drop == FrameQueue::DROPPED_INCOMING || queue.isFull())
+        {
+            return drop;
+        }
+    }
+    if (dropped)
+    {
+        *dropped = droppedData;
+    }
+    queue.push(&frames[index], info);
+    return drop;
+}
+
+static FrameQueue::Frame next(FrameQueue &queue)
+{
+    FrameQueue::Frame frame;
+    CHECK(queue.pop(&frame));
+    return frame;
+}
+
+static void testDropNewest()
+{
+    FrameQueue queue = queueOf(DROP_NEWEST, 2);
+    CHECK(offer(queue, 0, changed()) == FrameQueue::DROPPED_NONE);
+    CHECK(offer(queue, 1, repeat()) == FrameQueue::DROPPED_NONE);
+    CHECK(queue.isFull());
+
+    // Dropping a repeat changes nothing, the next repeat still repeats frame 0.
+    CHECK(offer(queue, 2, repeat()) == FrameQueue::DROPPED_INCOMING);
+    next(queue);
+    CHECK(offer(queue, 3, repeat()) == FrameQueue::DROPPED_NONE);
+    CHECK(next(queue).data == &frames[1]);
+    CHECK(next(queue).info.repeat);
+
+    // Dropping a change means the next frame pushed has to carry it.
+    CHECK(offer(queue, 4, changed()) == FrameQueue::DROPPED_NONE);
+    CHECK(offer(queue, 5, changed()) == FrameQueue::DROPPED_NONE);
+    CHECK(offer(queue, 6, changed()) == FrameQueue::DROPPED_INCOMING);
+    next(queue);
+    next(queue);
+    CHECK(offer(queue, 7, repeat()) == FrameQueue::DROPPED_NONE);
+    FrameQueue::Frame promoted = next(queue);
+    CHECK(promoted.data == &frames[7]);
+    CHECK(!promoted.info.repeat);
+    CHECK(!queue.pop(&promoted));
+}
+
+static void testDropOldest()
+{
+    FrameQueue queue = queueOf(DROP_OLDEST, 2);
+    offer(queue, 0, changed());
+    offer(queue, 1, changed());
+    void *dropped = nullptr;
+    CHECK(offer(queue, 2, repeat(), &dropped) == FrameQueue::DROPPED_QUEUED);
+    CHECK(dropped == &frames[0]);
+
+    // Frame 1 only described what changed since frame 0, so now it's the whole frame.
+    FrameQueue::Frame frame = next(queue);
+    CHECK(frame.data == &frames[1]);
+    CHECK(frame.info.damage.empty());
+    frame = next(queue);
+    CHECK(frame.data == &frames[2]);
+    CHECK(frame.info.repeat);
+
+    // Dropping a repeat leaves the frame after it alone.
+    offer(queue, 3, repeat());
+    offer(queue, 4, changed());
+    CHECK(offer(queue, 5, changed(), &dropped) == FrameQueue::DROPPED_QUEUED);
+    CHECK(dropped == &frames[3]);
+    CHECK(next(queue).info.damage.size() == 1);
+}
+
+static void testDropNonReference()
+{
+    FrameQueue queue = queueOf(DROP_NON_REFERENCE, 3);
+    offer(queue, 0, changed());
+    offer(queue, 1, changed(false));
+    offer(queue, 2, changed());
+
+    // Nothing depends on an incoming non reference frame, so it goes first.
+    CHECK(offer(queue, 3, changed(false)) == FrameQueue::DROPPED_INCOMING);
+    CHECK(queue.size() == 3);
+
+    // A reference frame pushes out the newest queued frame nothing depends on.
+    void *dropped = nullptr;
+    CHECK(offer(queue, 4, changed(), &dropped) == FrameQueue::DROPPED_QUEUED);
+    CHECK(dropped == &frames[1]);
+
+    // Nothing left that can go, so the edge has to wait.
+    CHECK(offer(queue, 5, changed()) == FrameQueue::DROPPED_NONE);
+    CHECK(queue.size() == 3);
+
+    // Frame 2 followed the dropped frame 1 and frame 4 the dropped frame 3.
+    CHECK(next(queue).info.damage.size() == 1);
+    CHECK(next(queue).info.damage.empty());
+    FrameQueue::Frame frame = next(queue);
+    CHECK(frame.data == &frames[4]);
+    CHECK(frame.info.damage.empty());
+}
+
+static void testBackpressure()
+{
+    FrameQueue queue = queueOf(BACKPRESSURE_BLOCK, 1);
+    offer(queue, 0, changed(false));
+    CHECK(offer(queue, 1, changed(false)) == FrameQueue::DROPPED_NONE);
+    CHECK(queue.size() == 1);
+    CHECK(queue.getFrames().front().data == &frames[0]);
+    queue.clear();
+    CHECK(queue.size() == 0);
+    CHECK(!queue.isFull());
+}
+
+int main()
+{
+    testDropNewest();
+    testDropOldest();
+    testDropNonReference();
+    testBackpressure();
+    printf("ok\n");
+    return 0;
+}
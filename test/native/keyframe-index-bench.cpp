@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "public/src/components/ComponentsFFMPEG/KeyframeIndex.h"
+#include "../../src/native/stages/common/frame-index.h"
+#include "test.h"
+
+using namespace amf;
+
+const char *STREAM = "keyframe-index-bench.h264";
+const wchar_t *STREAM_PATH = L"keyframe-index-bench.h264";
+
+// Three hours at 60 fps, with a keyframe every two seconds.
+const unsigned FRAMES = 3 * 60 * 60 * 60;
+const unsigned GOP = 120;
+const long long FRAME_TIME = 166667;
+const unsigned SEEKS = 10000;
+
+static void writeFile(const std::string &name, const void *data, size_t size)
+{
+    FILE *file = fopen(name.c_str(), "wb");
+    fwrite(data, 1, size, file);
+    fclose(file);
+}
+
+/** The recorder's index for the whole recording. The stream only has to be big enough. */
+static void writeRecording()
+{
+    std::vector<unsigned char> index(sizeof(FrameIndexHeader) + FRAMES * sizeof(FrameIndexEntry));
+    FrameIndexHeader header;
+    memcpy(header.magic, FRAME_INDEX_MAGIC, sizeof(header.magic));
+    header.version = FRAME_INDEX_VERSION;
+    header.width = 1920;
+    header.height = 1080;
+    header.codec = FRAME_INDEX_CODEC_H264;
+    memcpy(index.data(), &header, sizeof(header));
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        FrameIndexEntry entry;
+        entry.offset = i;
+        entry.size = 1;
+        entry.flags = i % GOP == 0 ? FRAME_INDEX_KEYFRAME : 0;
+        entry.timestamp = i * FRAME_TIME;
+        memcpy(&index[sizeof(header) + i * sizeof(entry)], &entry, sizeof(entry));
+    }
+    std::vector<unsigned char> stream(FRAMES);
+    writeFile(STREAM, stream.data(), stream.size());
+    writeFile(std::string(STREAM) + ".index", index.data(), index.size());
+}
+
+int main()
+{
+    writeRecording();
+    AMFKeyframeIndex index;
+    bench("load recorder index", 5, [&](unsigned) { index.LoadRecorderIndex(STREAM_PATH); });
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<amf_pts> position(0, FRAMES * FRAME_TIME);
+    std::vector<amf_pts> targets(SEEKS);
+    for (amf_pts &target : targets)
+    {
+        target = position(random);
+    }
+    // What a seek cost without the index to search: a walk over every frame before the target.
+    std::vector<AMFKeyframeIndex::Keyframe> frames;
+    for (unsigned i = 0; i < FRAMES; i++)
+    {
+        frames.push_back({i * FRAME_TIME, (amf_int64)i, i});
+    }
+    unsigned long long found = 0;
+    bench("find keyframe, linear scan", SEEKS / 10, [&](unsigned i) {
+        unsigned keyframe = 0;
+        for (unsigned frame = 0; frame < FRAMES && frames[frame].pts <= targets[i]; frame++)
+        {
+            keyframe = frame % GOP == 0 ? frame : keyframe;
+        }
+        found += keyframe;
+    });
+    bench("find keyframe, index", SEEKS, [&](unsigned i) { found += index.FindKeyframe(targets[i], false)->frame; });
+    bench("frame from pts", SEEKS, [&](unsigned i) { found += index.GetFrameFromPts(targets[i]); });
+
+    bench("save sidecar", 5, [&](unsigned) { index.SaveSidecar(STREAM_PATH); });
+    bench("load sidecar", 5, [&](unsigned) { index.LoadSidecar(STREAM_PATH); });
+    printf("(%llu)\n", found);
+
+    remove(STREAM);
+    remove((std::string(STREAM) + ".index").c_str());
+    remove((std::string(STREAM) + ".kidx").c_str());
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "public/src/components/ComponentsFFMPEG/KeyframeIndex.h"
+#include "../../src/native/stages/common/frame-index.h"
+#include "test.h"
+
+using namespace amf;
+
+// Written to the working directory, next to the test.
+const char *STREAM = "keyframe-index-test.h264";
+const wchar_t *STREAM_PATH = L"keyframe-index-test.h264";
+
+// 100ns units
+const long long FRAME_TIME = 166667;
+const unsigned FRAME_SIZE = 1000;
+const unsigned KEYFRAME_SIZE = 20000;
+const unsigned GOP = 120;
+
+static void writeFile(const std::string &name, const void *data, size_t size)
+{
+    FILE *file = fopen(name.c_str(), "wb");
+    CHECK(file != nullptr);
+    CHECK(fwrite(data, 1, size, file) == size);
+    fclose(file);
+}
+
+/**
+ * A stream of frames with a keyframe every GOP, and the index the file writer
+ * would have kept for it, at the given index version. Timestamps start at
+ * start and jitter, like a variable frame rate capture's.
+ */
+static unsigned writeRecording(unsigned frames, long long start, uint32_t version)
+{
+    std::vector<unsigned char> index;
+    FrameIndexHeader header;
+    memcpy(header.magic, FRAME_INDEX_MAGIC, sizeof(header.magic));
+    header.version = version;
+    header.width = 1920;
+    header.height = 1080;
+    header.codec = FRAME_INDEX_CODEC_H264;
+    size_t headerSize = version == 1 ? sizeof(header) - sizeof(header.codec) : sizeof(header);
+    index.insert(index.end(), (unsigned char *)&header, (unsigned char *)&header + headerSize);
+
+    unsigned long long offset = 0;
+    for (unsigned i = 0; i < frames; i++)
+    {
+        FrameIndexEntry entry;
+        entry.offset = offset;
+        entry.size = i % GOP == 0 ? KEYFRAME_SIZE : FRAME_SIZE;
+        entry.flags = i % GOP == 0 ? FRAME_INDEX_KEYFRAME : 0;
+        entry.timestamp = start + i * FRAME_TIME + (i % 3) * 1000;
+        index.insert(index.end(), (unsigned char *)&entry, (unsigned char *)&entry + sizeof(entry));
+        offset += entry.size;
+    }
+    std::vector<unsigned char> stream(offset);
+    writeFile(STREAM, stream.data(), stream.size());
+    writeFile(std::string(STREAM) + ".index", index.data(), index.size());
+    remove((std::string(STREAM) + ".kidx").c_str());
+    return offset;
+}
+
+static amf_pts framePts(unsigned frame)
+{
+    return frame * FRAME_TIME + (frame % 3) * 1000;
+}
+
+/** The index the file writer keeps, at both versions, gives every frame's real time. */
+static void testRecorderIndex()
+{
+    for (uint32_t version : {1u, FRAME_INDEX_VERSION})
+    {
+        writeRecording(1000, 5000000, version);
+        AMFKeyframeIndex index;
+        CHECK(index.LoadRecorderIndex(STREAM_PATH) == AMF_OK);
+        CHECK(index.HasFrameTimes());
+        CHECK(index.GetFrameCount() == 1000);
+
+        // Seeks land on the keyframe before the target, or after it when asked.
+        const AMFKeyframeIndex::Keyframe *keyframe = index.FindKeyframe(framePts(500), false);
+        CHECK(keyframe->frame == 480);
+        CHECK(keyframe->pts == framePts(480));
+        CHECK(keyframe->offset == 4 * KEYFRAME_SIZE + (480 - 4) * FRAME_SIZE);
+        CHECK(index.FindKeyframe(framePts(500), true)->frame == 600);
+        CHECK(index.FindKeyframe(framePts(480), false)->frame == 480);
+        CHECK(index.FindKeyframe(framePts(480), true)->frame == 480);
+        // Before the start and past the end, the first and last keyframes.
+        CHECK(index.FindKeyframe(-1, false)->frame == 0);
+        CHECK(index.FindKeyframe(framePts(999), true)->frame == 960);
+
+        for (unsigned frame : {0u, 1u, 2u, 479u, 500u, 999u})
+        {
+            CHECK(index.GetPtsFromFrame(frame) == framePts(frame));
+            CHECK(index.GetFrameFromPts(framePts(frame)) == frame);
+            CHECK(index.GetFrameFromPts(framePts(frame) + 1) == frame);
+        }
+    }
+}
+
+/** A crash leaves entries for frames that never made it into the stream. */
+static void testTruncatedRecording()
+{
+    unsigned size = writeRecording(300, 0, FRAME_INDEX_VERSION);
+    // Cut the stream in the middle of frame 250, the third keyframe was 240.
+    std::vector<unsigned char> stream(3 * KEYFRAME_SIZE + 247 * FRAME_SIZE + FRAME_SIZE / 2);
+    CHECK(stream.size() < size);
+    writeFile(STREAM, stream.data(), stream.size());
+
+    AMFKeyframeIndex index;
+    CHECK(index.LoadRecorderIndex(STREAM_PATH) == AMF_OK);
+    CHECK(index.GetFrameCount() == 250);
+    CHECK(index.FindKeyframe(framePts(299), false)->frame == 240);
+
+    // An index from something else isn't read at all.
+    const char junk[] = "not an index, but long enough to hold a header";
+    writeFile(std::string(STREAM) + ".index", junk, sizeof(junk));
+    CHECK(index.LoadRecorderIndex(STREAM_PATH) == AMF_INVALID_FORMAT);
+    CHECK(index.IsEmpty());
+}
+
+/** The sidecar saved after a scan loads back, until the stream changes. */
+static void testSidecar()
+{
+    unsigned size = writeRecording(1000, 0, FRAME_INDEX_VERSION);
+    AMFKeyframeIndex index;
+    CHECK(index.LoadSidecar(STREAM_PATH) != AMF_OK);
+    for (unsigned frame = 0; frame < 1000; frame++)
+    {
+        index.AddFrame(framePts(frame), frame * FRAME_SIZE, frame % GOP == 0);
+    }
+    CHECK(!index.HasFrameTimes());
+    CHECK(index.SaveSidecar(STREAM_PATH) == AMF_OK);
+
+    AMFKeyframeIndex loaded;
+    CHECK(loaded.LoadSidecar(STREAM_PATH) == AMF_OK);
+    CHECK(loaded.GetFrameCount() == 1000);
+    for (unsigned frame = 0; frame < 1000; frame += 37)
+    {
+        const AMFKeyframeIndex::Keyframe *expected = index.FindKeyframe(framePts(frame), false);
+        const AMFKeyframeIndex::Keyframe *keyframe = loaded.FindKeyframe(framePts(frame), false);
+        CHECK(keyframe->frame == expected->frame);
+        CHECK(keyframe->pts == expected->pts);
+        CHECK(keyframe->offset == expected->offset);
+    }
+
+    // Appending to the stream makes the sidecar stale.
+    std::vector<unsigned char> longer(size + FRAME_SIZE);
+    writeFile(STREAM, longer.data(), longer.size());
+    CHECK(loaded.LoadSidecar(STREAM_PATH) == AMF_NOT_FOUND);
+}
+
+int main()
+{
+    testRecorderIndex();
+    testTruncatedRecording();
+    testSidecar();
+    remove(STREAM);
+    remove((std::string(STREAM) + ".index").c_str());
+    remove((std::string(STREAM) + ".kidx").c_str());
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "../../src/native/amf/public/common/LatencyStats.h"
+#include "../../src/native/amf/public/common/Thread.h"
+#include "test.h"
+
+using namespace amf;
+
+const unsigned RECORDS = 10000000;
+const unsigned SNAPSHOTS = 100000;
+
+int main()
+{
+    AMFLatencyStats stats;
+    bench("Record, caller's clock", RECORDS, [&](unsigned i) { stats.Record(i % 100000, i * 10LL); });
+    bench("Record", RECORDS, [&](unsigned i) { stats.Record(i % 100000); });
+
+    AMFLatencySnapshot snapshot;
+    amf_pts sum = 0;
+    bench("GetSnapshot", SNAPSHOTS, [&](unsigned) {
+        stats.GetSnapshot(&snapshot);
+        sum += snapshot.p99;
+    });
+    printf("(%lld)\n", (long long)sum);
+    return 0;
+}
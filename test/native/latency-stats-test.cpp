@@ -0,0 +1,101 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "../../src/native/amf/public/common/LatencyStats.h"
+#include "test.h"
+
+using namespace amf;
+
+const amf_uint64 RECORDS = 20000000;
+// The writer pauses between bursts so the reader gets consistent snapshots at
+// all, otherwise it would retry until the writer was done. The bursts are long
+// enough for the scheduler to preempt the writer in the middle of one.
+const amf_uint64 BURST = 200000;
+const std::chrono::microseconds PAUSE(200);
+
+/** Percentiles and extremes of a known set of durations. */
+static void testSnapshot()
+{
+    AMFLatencyStats stats(AMF_SECOND);
+    AMFLatencySnapshot snapshot;
+    stats.GetSnapshot(&snapshot);
+    CHECK(snapshot.count == 0);
+    CHECK(snapshot.p50 == 0);
+
+    // 1000 samples a second, for a second.
+    for (amf_pts i = 1; i <= 1000; i++)
+    {
+        stats.Record(i * 100, AMF_SECOND + i * AMF_MILLISECOND);
+    }
+    stats.Record(-5, 2 * AMF_SECOND);
+    stats.GetSnapshot(&snapshot);
+    CHECK(snapshot.count == 1001);
+    CHECK(snapshot.min == 0);
+    CHECK(snapshot.max == 100000);
+    // Percentiles are within a bucket of the real value.
+    CHECK(snapshot.p50 > 50000 * 0.93 && snapshot.p50 < 50000 * 1.07);
+    CHECK(snapshot.p99 > 99000 * 0.93 && snapshot.p99 <= snapshot.max);
+    CHECK(stats.GetPercentile(1.0) == snapshot.max);
+    CHECK(stats.GetPercentile(0.0) == snapshot.min);
+
+    stats.Reset();
+    stats.GetSnapshot(&snapshot);
+    CHECK(snapshot.count == 0);
+    CHECK(snapshot.max == 0);
+}
+
+/**
+ * A writer records 0, 1, 2... while a reader takes snapshots. Any snapshot that
+ * mixed fields from before and after a Record breaks the relations between them.
+ */
+static void testConcurrentSnapshots()
+{
+    AMFLatencyStats stats;
+    std::atomic<bool> done(false);
+    std::thread writer([&] {
+        for (amf_uint64 i = 0; i < RECORDS; i++)
+        {
+            stats.Record((amf_pts)i, (amf_pts)i);
+            if (i % BURST == 0)
+            {
+                std::this_thread::sleep_for(PAUSE);
+            }
+        }
+        done = true;
+    });
+
+    amf_uint64 overlapping = 0;
+    amf_uint64 lastCount = 0;
+    while (!done)
+    {
+        AMFLatencySnapshot snapshot;
+        stats.GetSnapshot(&snapshot);
+        CHECK(snapshot.count >= lastCount);
+        lastCount = snapshot.count;
+        if (snapshot.count == 0)
+        {
+            continue;
+        }
+        CHECK(snapshot.min == 0);
+        CHECK(snapshot.max == (amf_pts)snapshot.count - 1);
+        // Welford's mean of 0..n-1 is exact, every step adds exactly a half.
+        CHECK(snapshot.mean == (snapshot.count - 1) / 2.0);
+        CHECK(snapshot.p50 <= snapshot.max);
+        if (snapshot.count < RECORDS)
+        {
+            overlapping++;
+        }
+    }
+    writer.join();
+    // Otherwise nothing above ran while the writer was busy.
+    CHECK(overlapping > 0);
+}
+
+int main()
+{
+    testSnapshot();
+    testConcurrentSnapshots();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <ctime>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "../../src/native/amf/public/common/Thread.h"
+#include "test.h"
+
+using namespace amf;
+
+const int WAITS = 200;
+
+/** How AMFPreciseWaiter::WaitEx used to wait: 1ms event timeouts, then a 2ms spin. */
+class EventWaiter
+{
+public:
+    amf_pts WaitEx(amf_pts waittime)
+    {
+        amf_pts start = amf_high_precision_clock();
+        amf_pts waited = 0;
+        while (waited < waittime)
+        {
+            if (waittime - waited < 2 * AMF_SECOND / 1000)
+            {
+                for (volatile int i = 0; i < 1000; i++)
+                {
+                }
+            }
+            else
+            {
+                event.LockTimeout(1);
+            }
+            waited = amf_high_precision_clock() - start;
+        }
+        return waited;
+    }
+
+private:
+    AMFEvent event;
+};
+
+/** CPU time used by this thread, in microseconds. */
+static double threadCpu()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    // 100ns units.
+    return ((double)kernel.dwLowDateTime + (double)kernel.dwHighDateTime * 4294967296.0 +
+            (double)user.dwLowDateTime + (double)user.dwHighDateTime * 4294967296.0) / 10;
+#else
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec * 1e6 + time.tv_nsec / 1e3;
+#endif
+}
+
+template <typename Waiter>
+static void run(const char *name, Waiter &waiter, amf_pts wait)
+{
+    std::vector<double> late;
+    double cpuStart = threadCpu();
+    for (int i = 0; i < WAITS; i++)
+    {
+        late.push_back((waiter.WaitEx(wait) - wait) / 10.0);
+    }
+    double cpu = (threadCpu() - cpuStart) / WAITS;
+    std::sort(late.begin(), late.end());
+    printf("%-8s %5.1fms waits: %7.1f us CPU each, late by %6.1f us median, %6.1f us p95\n", name, wait / 1e4,
+           cpu, late[WAITS / 2], late[WAITS * 95 / 100]);
+}
+
+int main()
+{
+    for (amf_pts wait : {AMF_SECOND / 200, AMF_SECOND / 60})
+    {
+        EventWaiter events;
+        AMFPreciseWaiter timer;
+        run("events", events, wait);
+        run("timer", timer, wait);
+    }
+    return 0;
+}
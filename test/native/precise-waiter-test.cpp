@@ -0,0 +1,95 @@
+#include <thread>
+
+#include "../../src/native/amf/public/common/Thread.h"
+#include "test.h"
+
+using namespace amf;
+
+// Waits may run late on a busy machine, so only the lower bounds are tight. The
+// upper bounds just tell a wait that ended from one that ran its full length.
+const amf_pts MILLISECOND = AMF_SECOND / 1000;
+const amf_pts LONG_WAIT = 5 * AMF_SECOND;
+const amf_pts EARLY = AMF_SECOND;
+
+static amf_pts since(amf_pts start)
+{
+    return amf_high_precision_clock() - start;
+}
+
+/** Wake the timer (or cancel the waiter) from another thread once it is asleep. */
+template <typename Wake>
+static std::thread wakeLater(Wake wake)
+{
+    return std::thread([wake]() {
+        amf_sleep(50);
+        wake();
+    });
+}
+
+static void testTimer()
+{
+    amf_handle timer = amf_create_precise_timer();
+    CHECK(timer != NULL);
+
+    // Never wakes early.
+    for (int i = 0; i < 20; i++)
+    {
+        amf_pts start = amf_high_precision_clock();
+        CHECK(amf_wait_precise_timer(timer, 2 * MILLISECOND));
+        CHECK(since(start) >= 2 * MILLISECOND);
+    }
+
+    // Nothing to wait for.
+    amf_pts start = amf_high_precision_clock();
+    CHECK(amf_wait_precise_timer(timer, 0));
+    CHECK(amf_wait_precise_timer(timer, -MILLISECOND));
+    CHECK(since(start) < EARLY);
+
+    // Woken from another thread.
+    std::thread waker = wakeLater([timer]() { amf_wake_precise_timer(timer); });
+    start = amf_high_precision_clock();
+    CHECK(!amf_wait_precise_timer(timer, LONG_WAIT));
+    CHECK(since(start) < EARLY);
+    waker.join();
+
+    // A wake that comes before the wait ends the next wait only.
+    CHECK(amf_wake_precise_timer(timer));
+    start = amf_high_precision_clock();
+    CHECK(!amf_wait_precise_timer(timer, LONG_WAIT));
+    CHECK(since(start) < EARLY);
+    start = amf_high_precision_clock();
+    CHECK(amf_wait_precise_timer(timer, 2 * MILLISECOND));
+    CHECK(since(start) >= 2 * MILLISECOND);
+
+    CHECK(amf_delete_precise_timer(timer));
+}
+
+static void testWaiter()
+{
+    AMFPreciseWaiter waiter;
+    for (amf_pts wait : {MILLISECOND, 3 * MILLISECOND, AMF_SECOND / 60})
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            CHECK(waiter.Wait(wait) >= wait);
+            CHECK(waiter.WaitEx(wait) >= wait);
+        }
+    }
+    CHECK(waiter.Wait(-1) == 0);
+
+    // Cancel ends a sleeping wait right away.
+    std::thread canceller = wakeLater([&waiter]() { waiter.Cancel(); });
+    CHECK(waiter.Wait(LONG_WAIT) < EARLY);
+    canceller.join();
+    canceller = wakeLater([&waiter]() { waiter.Cancel(); });
+    CHECK(waiter.WaitEx(LONG_WAIT) < EARLY);
+    canceller.join();
+}
+
+int main()
+{
+    testTimer();
+    testWaiter();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <map>
+
+#include "../../src/native/amf/public/common/PropertyStorageImpl.h"
+#include "test.h"
+
+using namespace amf;
+
+class TestStorage : public AMFInterfaceImpl<AMFPropertyStorageImpl<AMFPropertyStorage>>
+{
+};
+
+const unsigned LOOKUPS = 10000000;
+
+// Roughly what an encoder or a packet carries.
+const wchar_t *NAMES[] = {L"OutputDataType", L"PTS", L"Duration", L"FrameSize", L"Bitrate", L"Quality",
+                          L"Usage", L"Profile", L"Level", L"IdrPeriod", L"Slices", L"Extra"};
+const unsigned NAME_COUNT = sizeof(NAMES) / sizeof(NAMES[0]);
+
+int main()
+{
+    TestStorage storage;
+    std::map<amf_wstring, AMFVariant> oldMap;
+    for (unsigned i = 0; i < NAME_COUNT; i++)
+    {
+        storage.SetProperty(NAMES[i], AMFVariant((amf_int64)i));
+        oldMap[NAMES[i]] = AMFVariant((amf_int64)i);
+    }
+
+    amf_int64 sum = 0;
+    // How the storages looked things up before.
+    bench("ordered map by name", LOOKUPS, [&](unsigned) {
+        auto found = oldMap.find(amf_wstring(L"OutputDataType"));
+        sum += AMFVariantGetInt64(&found->second);
+    });
+    bench("storage by name", LOOKUPS, [&](unsigned) {
+        AMFVariant value;
+        storage.GetProperty(L"OutputDataType", &value);
+        sum += AMFVariantGetInt64(&value);
+    });
+    static const AMFPropertyKey key(L"OutputDataType");
+    bench("storage by key", LOOKUPS, [&](unsigned) {
+        amf_int64 value = 0;
+        storage.GetProperty(key, &value);
+        sum += value;
+    });
+    bench("storage by index", LOOKUPS, [&](unsigned i) {
+        wchar_t name[64];
+        AMFVariant value;
+        storage.GetPropertyAt(i % NAME_COUNT, name, 64, &value);
+        sum += AMFVariantGetInt64(&value);
+    });
+    // Keeps the lookups from being optimized away.
+    printf("(%lld)\n", (long long)sum);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <map>
+#include <random>
+#include <string>
+
+#include "../../src/native/amf/public/common/PropertyStorageImpl.h"
+#include "test.h"
+
+using namespace amf;
+
+class TestStorage : public AMFInterfaceImpl<AMFPropertyStorageImpl<AMFPropertyStorage>>
+{
+};
+
+static void testInterning()
+{
+    wchar_t first[] = L"FrameSize";
+    wchar_t second[] = L"FrameSize";
+    const wchar_t *interned = AMFInternPropertyName(first);
+    CHECK(interned != first);
+    CHECK(AMFInternPropertyName(second) == interned);
+    CHECK(wcscmp(interned, L"FrameSize") == 0);
+    CHECK(AMFInternPropertyName(L"FrameRate") != interned);
+
+    // The interned copy outlives the name it was made from.
+    first[0] = L'X';
+    CHECK(wcscmp(interned, L"FrameSize") == 0);
+
+    AMFPropertyKey key(second);
+    CHECK(key.GetName() == interned);
+    CHECK(key.GetHash() == AMFHashPropertyName(L"FrameSize"));
+}
+
+static void testLookups()
+{
+    AMFPropertyMap map;
+    CHECK(map.empty());
+    CHECK(map.find(L"PTS") == map.end());
+
+    map[L"PTS"] = AMFVariant((amf_int64)1);
+    map[amf_wstring(L"Duration")] = AMFVariant((amf_int64)2);
+    static const AMFPropertyKey bitrate(L"Bitrate");
+    map[bitrate] = AMFVariant((amf_int64)3);
+    CHECK(map.size() == 3);
+
+    // Every way of naming a property finds the same entry.
+    CHECK(map.find(L"Bitrate") == map.find(bitrate));
+    CHECK(map.find(amf_wstring(L"Bitrate")) == map.find(bitrate));
+    CHECK(map.find(AMFPropertyKey(L"PTS")) == map.find(L"PTS"));
+    CHECK(AMFVariantGetInt64(&map.find(L"Duration")->second) == 2);
+    CHECK(map.find(L"Missing") == map.end());
+    CHECK(map.find(AMFPropertyKey(L"Missing")) == map.end());
+
+    // Assigning again replaces the value rather than adding an entry.
+    map[L"Bitrate"] = AMFVariant((amf_int64)4);
+    CHECK(map.size() == 3);
+    CHECK(AMFVariantGetInt64(&map.find(bitrate)->second) == 4);
+
+    // Entries are ordered by hash.
+    amf_uint32 previous = 0;
+    for (auto &entry : map)
+    {
+        amf_uint32 hash = AMFHashPropertyName(entry.first);
+        CHECK(hash >= previous);
+        previous = hash;
+    }
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(map.find(bitrate) == map.end());
+}
+
+/** Two names with the same hash have to sit side by side and both be found. */
+static void testCollisions()
+{
+    // A known FNV-1a collision.
+    const wchar_t *first = L"costarring";
+    const wchar_t *second = L"liquid";
+    CHECK(AMFHashPropertyName(first) == AMFHashPropertyName(second));
+
+    AMFPropertyMap map;
+    map[L"Before"] = AMFVariant((amf_int64)0);
+    map[first] = AMFVariant((amf_int64)1);
+    map[second] = AMFVariant((amf_int64)2);
+    map[L"After"] = AMFVariant((amf_int64)3);
+    CHECK(map.size() == 4);
+    CHECK(AMFVariantGetInt64(&map.find(first)->second) == 1);
+    CHECK(AMFVariantGetInt64(&map.find(second)->second) == 2);
+    CHECK(AMFVariantGetInt64(&map.find(AMFPropertyKey(first))->second) == 1);
+    CHECK(AMFVariantGetInt64(&map.find(AMFPropertyKey(second))->second) == 2);
+}
+
+/** The map has to behave like the ordered map it replaced, apart from the order. */
+static void testAgainstMap()
+{
+    std::mt19937 random(1);
+    AMFPropertyMap map;
+    std::map<std::wstring, amf_int64> expected;
+    for (unsigned i = 0; i < 20000; i++)
+    {
+        std::wstring name = L"Name" + std::to_wstring(random() % 300);
+        if (random() % 2)
+        {
+            amf_int64 value = random();
+            map[name.c_str()] = AMFVariant(value);
+            expected[name] = value;
+        }
+        else
+        {
+            auto found = map.find(name.c_str());
+            auto wanted = expected.find(name);
+            CHECK((found == map.end()) == (wanted == expected.end()));
+            if (found != map.end())
+            {
+                CHECK(AMFVariantGetInt64(&found->second) == wanted->second);
+            }
+        }
+    }
+    CHECK(map.size() == expected.size());
+}
+
+static void testStorage()
+{
+    TestStorage storage;
+    CHECK(storage.SetProperty(L"Usage", AMFVariant((amf_int64)5)) == AMF_OK);
+    CHECK(storage.SetProperty(L"Profile", AMFVariant((amf_int64)6)) == AMF_OK);
+    CHECK(storage.GetPropertyCount() == 2);
+
+    AMFVariant value;
+    CHECK(storage.GetProperty(L"Usage", &value) == AMF_OK);
+    CHECK(AMFVariantGetInt64(&value) == 5);
+    CHECK(storage.GetProperty(L"Level", &value) == AMF_NOT_FOUND);
+
+    static const AMFPropertyKey profile(L"Profile");
+    amf_int64 number = 0;
+    CHECK(storage.GetProperty(profile, &number) == AMF_OK);
+    CHECK(number == 6);
+    CHECK(storage.HasProperty(profile));
+    CHECK(!storage.HasProperty(AMFPropertyKey(L"Level")));
+
+    // Every index names a property that can be looked up again.
+    for (amf_size i = 0; i < storage.GetPropertyCount(); i++)
+    {
+        wchar_t name[64];
+        CHECK(storage.GetPropertyAt(i, name, 64, &value) == AMF_OK);
+        AMFVariant again;
+        CHECK(storage.GetProperty(name, &again) == AMF_OK);
+        CHECK(AMFVariantGetInt64(&again) == AMFVariantGetInt64(&value));
+    }
+    wchar_t name[64];
+    CHECK(storage.GetPropertyAt(2, name, 64, &value) == AMF_INVALID_ARG);
+}
+
+int main()
+{
+    testInterning();
+    testLookups();
+    testCollisions();
+    testAgainstMap();
+    testStorage();
+    printf("ok\n");
+    return 0;
+}
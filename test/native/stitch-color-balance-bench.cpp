@@ -0,0 +1,90 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../../src/native/amf/public/common/WorkStealingPool.h"
+#include "stitch-color-balance-reference.h"
+#include "test.h"
+
+using namespace amf;
+
+const double PI = 3.14159265358979323846;
+const int CHANNELS = 6;
+const int CORNERS = 8;
+
+int main()
+{
+    HistogramParameters params = {{90, 20, 20}, 217, 20, 100, 0.1f, {}, 0};
+    for (int i = 0; i < LUT_CURVE_TABLE_SIZE; i++)
+    {
+        params.lutCurveTable[i] = float((cos(i * PI / LUT_CURVE_TABLE_SIZE) + 1.0) / 2.0);
+    }
+
+    // A six camera rig with three cameras at each corner.
+    CornerList corners;
+    for (int i = 0; i < CORNERS; i++)
+    {
+        Corner corner = {};
+        corner.count = 3;
+        corner.index = i;
+        for (int j = 0; j < 3; j++)
+        {
+            corner.channel[j] = (i + j * 2) % CHANNELS;
+            corner.corner[j] = (i / 2 + j) % 4;
+        }
+        corners.push_back(corner);
+    }
+    std::mt19937 random(1);
+    std::vector<amf_int32> histograms(CHANNELS * 4 * 3 * HIST_SIZE);
+    for (amf_int32 &count : histograms)
+    {
+        count = random() % 50000;
+    }
+    size_t lutSize = CHANNELS * 5 * 3 * HIST_SIZE;
+    std::vector<float> lut(lutSize), prev(lutSize), brightness(CHANNELS * 4 * 3), shifts(CORNERS * 3 * 3);
+
+    StitchColorBalance balance;
+    AMFWorkStealingPool pool;
+    bench("cross correlation before", 20, [&](unsigned) {
+        reference::Adjust(corners, CHANNELS, histograms.data(), lut.data(), prev.data(), brightness.data(),
+                          shifts.data(), params, 1);
+    });
+    bench("Adjust", 200, [&](unsigned) {
+        balance.Adjust(corners, CHANNELS, histograms.data(), lut.data(), prev.data(), brightness.data(), params, 1,
+                       NULL);
+    });
+    bench("Adjust on a pool", 200, [&](unsigned) {
+        balance.Adjust(corners, CHANNELS, histograms.data(), lut.data(), prev.data(), brightness.data(), params, 1,
+                       &pool);
+    });
+
+    // A 1080p frame with three map cells of border on each side.
+    int width = 1920, height = 1080, widthMap = width / 8, heightMap = (height + 7) / 8;
+    std::vector<amf_uint8> y(width * height), uv(width * height / 2), map(widthMap * heightMap);
+    for (amf_uint8 &value : y)
+    {
+        value = (amf_uint8)random();
+    }
+    for (amf_uint8 &value : uv)
+    {
+        value = (amf_uint8)random();
+    }
+    for (int my = 0; my < heightMap; my++)
+    {
+        for (int mx = 0; mx < widthMap; mx++)
+        {
+            map[my * widthMap + mx] = (mx < 3 ? 1 : 0) | (mx >= widthMap - 3 ? 2 : 0) | (my < 3 ? 4 : 0) |
+                                      (my >= heightMap - 3 ? 8 : 0);
+        }
+    }
+    std::vector<amf_int32> frame(4 * 3 * HIST_SIZE);
+    bench("1080p histograms, pixel by pixel", 50, [&](unsigned) {
+        reference::AccumulateNV12(frame.data(), 0, y.data(), width, uv.data(), width, width, height, map.data(),
+                                  widthMap);
+    });
+    bench("1080p histograms, AccumulateNV12", 50, [&](unsigned) {
+        StitchColorBalance::AccumulateNV12(frame.data(), 0, y.data(), width, uv.data(), width, width, height,
+                                           map.data(), widthMap, widthMap, heightMap);
+    });
+    return 0;
+}
@@ -0,0 +1,354 @@
+#ifndef STITCH_COLOR_BALANCE_REFERENCE_H
+#define STITCH_COLOR_BALANCE_REFERENCE_H
+#include <cmath>
+
+#include "../../src/native/amf/public/src/components/VideoStitch/StitchColorBalance.h"
+
+/**
+ * The CPU color balancing HistogramImpl did before StitchColorBalance, to
+ * check it against: the BuildShifts, BuildLUT and BuildLUTCenter kernels run
+ * one corner at a time, with a full cross correlation for every tried shift.
+ * The arithmetic and its order are unchanged.
+ */
+namespace reference
+{
+using amf::Corner;
+using amf::CornerList;
+using amf::HistogramParameters;
+
+inline void BuildOneLUT(amf_int32 col, float brightness, float *lut, float *prev, const HistogramParameters &params,
+                        amf_int32 frameCount)
+{
+    for (amf_int32 k = 0; k < HIST_SIZE; k++)
+    {
+        float lutCurr = brightness;
+        if (col == 0)
+        {
+            if (k < params.blackCutOffY)
+            {
+                lutCurr = 0.0f;
+            }
+            else if (k < LUT_CURVE_TABLE_SIZE + params.blackCutOffY)
+            {
+                lutCurr *= 1.0f - params.lutCurveTable[k - params.blackCutOffY];
+            }
+            else if (k > params.whiteCutOffY)
+            {
+                lutCurr = 0.0f;
+            }
+            else if (k >= params.whiteCutOffY - LUT_CURVE_TABLE_SIZE)
+            {
+                lutCurr *= params.lutCurveTable[k - (params.whiteCutOffY - LUT_CURVE_TABLE_SIZE)];
+            }
+        }
+        lutCurr += (float)k / 255.f;
+        if (prev != NULL)
+        {
+            if (frameCount != 0)
+            {
+                lutCurr = prev[k] + params.alphaLUT * (lutCurr - prev[k]);
+            }
+            prev[k] = lutCurr;
+        }
+        lut[k] = lutCurr;
+    }
+}
+
+/** The normalized cross correlation of two histograms, with the second shifted by delay - maxdelay. */
+inline float OneCrossCorrelation(const amf_int32 *data1, const amf_int32 *data2, amf_int32 delay, amf_int32 maxdelay,
+                                 const HistogramParameters &params)
+{
+    float x[HIST_SIZE];
+    float y[HIST_SIZE];
+    for (amf_int32 i = 0; i < HIST_SIZE; i++)
+    {
+        if (i > params.blackCutOffY || i < params.whiteCutOffY)
+        {
+            x[i] = (float)data1[i];
+            y[i] = (float)data2[i];
+        }
+        else
+        {
+            x[i] = 0;
+            y[i] = 0;
+        }
+    }
+    if (delay - maxdelay >= maxdelay)
+    {
+        return 0;
+    }
+
+    float mx = 0;
+    float my = 0;
+    for (amf_int32 i = 0; i < HIST_SIZE; i++)
+    {
+        mx += x[i];
+        my += y[i];
+    }
+    mx /= HIST_SIZE;
+    my /= HIST_SIZE;
+    for (amf_int32 i = 0; i < HIST_SIZE; i++)
+    {
+        x[i] -= mx;
+        y[i] -= my;
+    }
+    float sx = 0;
+    float sy = 0;
+    for (amf_int32 i = 0; i < HIST_SIZE; i++)
+    {
+        sx += x[i] * x[i];
+        sy += y[i] * y[i];
+    }
+    float denom = sqrtf(sx * sy);
+
+    float sxy = 0;
+    for (amf_int32 i = 0; i < HIST_SIZE; i++)
+    {
+        amf_int32 j = i + delay - maxdelay;
+        if (j >= 0 && j < HIST_SIZE)
+        {
+            sxy += x[i] * y[j];
+        }
+    }
+    return sxy / denom;
+}
+
+/**
+ * The shift with the best correlation between each pair of cameras at a
+ * corner, [corner][color][side]. A pair without any valid correlation keeps
+ * its previous shift.
+ */
+inline void BuildShifts(float *pShifts, const amf_int32 *pHistogram, const CornerList &corners,
+                        const HistogramParameters &params)
+{
+    for (size_t corner = 0; corner < corners.size(); corner++)
+    {
+        const Corner &it = corners[corner];
+        for (amf_int32 col = 0; col < 3; col++)
+        {
+            amf_int32 maxdelay = params.maxDistanceBetweenPeaks[col];
+            for (amf_int32 side = 0; side < it.count; side++)
+            {
+                const amf_int32 *pHist[4];
+                for (amf_int32 i = 0; i < it.count; i++)
+                {
+                    pHist[i] = pHistogram + it.channel[i] * 4 * 3 * HIST_SIZE + it.corner[i] * HIST_SIZE * 3 +
+                               col * HIST_SIZE;
+                }
+                // Neighbours around the corner: 0-1, 1-2, 2-0 for three cameras, 0-1, 1-0 for two.
+                int h1 = side;
+                int h2 = (side + 1) % it.count;
+
+                float corrs[HIST_SIZE * 2];
+                for (amf_int32 delay = 0; delay < maxdelay * 2; delay++)
+                {
+                    corrs[delay] = OneCrossCorrelation(pHist[h1], pHist[h2], delay, maxdelay, params);
+                }
+                float corrMax = -1.0e5f;
+                for (amf_int32 i = 0; i < maxdelay * 2; i++)
+                {
+                    if (corrMax < corrs[i])
+                    {
+                        corrMax = corrs[i];
+                        pShifts[corner * 3 * it.count + col * it.count + side] = (float)i - maxdelay;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/** Spreads the shifts at each corner over its cameras as brightness offsets, and builds their LUTs. */
+inline void BuildLUT(float *pLUT, float *pLUTPrev, float *pBrightness, const float *pShifts, const CornerList &corners,
+                     const HistogramParameters &params, amf_int32 frameCount)
+{
+    for (size_t corner = 0; corner < corners.size(); corner++)
+    {
+        const Corner &it = corners[corner];
+        for (int col = 0; col < 3; col++)
+        {
+            float brightness[3] = {0, 0, 0};
+            const float *shifts = pShifts + corner * 3 * it.count + col * it.count;
+            if (it.count == 2)
+            {
+                brightness[0] = shifts[0] / 2.0f;
+                brightness[1] = shifts[1] / 2.0f;
+            }
+            else if (it.count == 3)
+            {
+                int shiftMaxIndex = 0;
+                int shiftMinIndex = HIST_SIZE * 2;
+                float shiftMin = 10000.0f;
+                float shiftMax = 0.0f;
+                for (int side = 0; side < it.count; side++)
+                {
+                    if (fabs(shiftMin) > fabs(shifts[side]))
+                    {
+                        shiftMin = shifts[side];
+                        shiftMinIndex = side;
+                    }
+                    if (fabs(shiftMax) < fabs(shifts[side]))
+                    {
+                        shiftMax = shifts[side];
+                        shiftMaxIndex = side;
+                    }
+                }
+                int shiftMinIndexSecond = 0;
+                for (int side = 0; side < it.count; side++)
+                {
+                    if (side != shiftMinIndex && side != shiftMaxIndex)
+                    {
+                        shiftMinIndexSecond = side;
+                        break;
+                    }
+                }
+                shiftMin = shifts[shiftMinIndex];
+                float shiftMinSecond = shifts[shiftMinIndexSecond];
+
+                if (shiftMinIndex == 0)
+                {
+                    brightness[0] = shiftMin / 2.0f;
+                    brightness[1] = -shiftMin / 2.0f;
+                    if (shiftMinIndexSecond == 1)
+                    {
+                        brightness[2] = -shiftMinSecond * 2.0f / 3.0f - shiftMin / 2.0f;
+                        brightness[0] += shiftMinSecond / 3.0f;
+                        brightness[1] += shiftMinSecond / 3.0f;
+                    }
+                    else
+                    {
+                        brightness[2] = shiftMinSecond * 2.0f / 3.0f + shiftMin / 2.0f;
+                        brightness[0] -= shiftMinSecond / 3.0f;
+                        brightness[1] -= shiftMinSecond / 3.0f;
+                    }
+                }
+                else if (shiftMinIndex == 1)
+                {
+                    brightness[1] = shiftMin / 2.0f;
+                    brightness[2] = -shiftMin / 2.0f;
+                    if (shiftMinIndexSecond == 0)
+                    {
+                        brightness[0] = shiftMinSecond * 2.0f / 3.0f + shiftMin / 2.0f;
+                        brightness[1] -= shiftMinSecond / 3.0f;
+                        brightness[2] -= shiftMinSecond / 3.0f;
+                    }
+                    else
+                    {
+                        brightness[0] = -shiftMinSecond * 2.0f / 3.0f - shiftMin / 2.0f;
+                        brightness[1] += shiftMinSecond / 3.0f;
+                        brightness[2] += shiftMinSecond / 3.0f;
+                    }
+                }
+                else if (shiftMinIndex == 2)
+                {
+                    brightness[2] = shiftMin / 2.0f;
+                    brightness[0] = -shiftMin / 2.0f;
+                    if (shiftMinIndexSecond == 0)
+                    {
+                        brightness[1] = -shiftMinSecond * 2.0f / 3.0f - shiftMin / 2.0f;
+                        brightness[2] += shiftMinSecond / 3.0f;
+                        brightness[0] += shiftMinSecond / 3.0f;
+                    }
+                    else
+                    {
+                        brightness[1] = shiftMinSecond * 2.0f / 3.0f + shiftMin / 2.0f;
+                        brightness[2] -= shiftMinSecond / 3.0f;
+                        brightness[0] -= shiftMinSecond / 3.0f;
+                    }
+                }
+            }
+
+            for (amf_int32 i = 0; i < it.count; i++)
+            {
+                amf_int32 offset = it.channel[i] * 3 * 5 * HIST_SIZE + it.corner[i] * 3 * HIST_SIZE + col * HIST_SIZE;
+                BuildOneLUT(col, brightness[i] / 255.f, pLUT + offset, pLUTPrev + offset, params, frameCount);
+                pBrightness[it.channel[i] * 4 * 3 + it.corner[i] * 3 + col] = brightness[i];
+            }
+        }
+    }
+}
+
+/** The LUT for the middle of each camera, from the average of its four sides. */
+inline void BuildLUTCenter(float *pLUT, float *pLUTPrev, const float *pBrightness, amf_int32 channels,
+                           const HistogramParameters &params, amf_int32 frameCount)
+{
+    for (amf_int32 channel = 0; channel < channels; channel++)
+    {
+        for (amf_int32 col = 0; col < 3; col++)
+        {
+            float brightnessCenter = 0;
+            for (amf_int32 side = 0; side < 4; side++)
+            {
+                brightnessCenter += pBrightness[channel * 4 * 3 + side * 3 + col];
+            }
+            brightnessCenter /= 4.0f;
+            amf_int32 offset = channel * 3 * 5 * HIST_SIZE + 4 * 3 * HIST_SIZE + col * HIST_SIZE;
+            BuildOneLUT(col, brightnessCenter / 255.f, pLUT + offset, pLUTPrev + offset, params, frameCount);
+        }
+    }
+}
+
+/** What StitchColorBalance::Adjust replaces. pShifts has to persist between frames. */
+inline void Adjust(const CornerList &corners, amf_int32 channels, const amf_int32 *pHistograms, float *pLUT,
+                   float *pLUTPrev, float *pBrightness, float *pShifts, const HistogramParameters &params,
+                   amf_int32 frameCount)
+{
+    BuildShifts(pShifts, pHistograms, corners, params);
+    BuildLUT(pLUT, pLUTPrev, pBrightness, pShifts, corners, params, frameCount);
+    BuildLUTCenter(pLUT, pLUTPrev, pBrightness, channels, params, frameCount);
+}
+
+/**
+ * StitchHistogramMapNV12 one chroma sample at a time: each 2x2 luma block
+ * and its chroma go into the histograms of every border its map cell marks.
+ * Only one horizontal and one vertical border count, right and bottom winning.
+ */
+inline void AccumulateNV12(amf_int32 *pHistograms, amf_int32 channel, const amf_uint8 *pY, amf_int32 pitchY,
+                           const amf_uint8 *pUV, amf_int32 pitchUV, amf_int32 width, amf_int32 height,
+                           const amf_uint8 *pMap, amf_int32 pitchMap)
+{
+    for (amf_int32 uy = 0; uy < height / 2; uy++)
+    {
+        for (amf_int32 ux = 0; ux < width / 2; ux++)
+        {
+            amf_int32 px = ux * 2;
+            amf_int32 py = uy * 2;
+            amf_uint8 map = pMap[(py / 8) * pitchMap + px / 8];
+            int sides[2] = {-1, -1};
+            if (map & 1)
+            {
+                sides[0] = 0;
+            }
+            if (map & 2)
+            {
+                sides[0] = 1;
+            }
+            if (map & 4)
+            {
+                sides[1] = 2;
+            }
+            if (map & 8)
+            {
+                sides[1] = 3;
+            }
+            int u = pUV[uy * pitchUV + ux * 2];
+            int v = pUV[uy * pitchUV + ux * 2 + 1];
+            for (int side : sides)
+            {
+                if (side < 0)
+                {
+                    continue;
+                }
+                amf_int32 *hist = pHistograms + channel * 4 * 3 * HIST_SIZE + side * 3 * HIST_SIZE;
+                for (int i = 0; i < 4; i++)
+                {
+                    hist[pY[(py + i / 2) * pitchY + px + i % 2]]++;
+                }
+                hist[HIST_SIZE + u]++;
+                hist[2 * HIST_SIZE + v]++;
+            }
+        }
+    }
+}
+} // namespace reference
+#endif
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../../src/native/amf/public/common/WorkStealingPool.h"
+#include "stitch-color-balance-reference.h"
+#include "test.h"
+
+using namespace amf;
+
+const double PI = 3.14159265358979323846;
+const int CHANNELS = 6;
+const int FRAMES = 5;
+
+static HistogramParameters parameters()
+{
+    HistogramParameters params = {{90, 20, 20}, 217, 20, 100, 0.1f, {}, 0};
+    for (int i = 0; i < LUT_CURVE_TABLE_SIZE; i++)
+    {
+        params.lutCurveTable[i] = float((cos(i * PI / LUT_CURVE_TABLE_SIZE) + 1.0) / 2.0);
+    }
+    return params;
+}
+
+/** Corners where count cameras meet, each camera side used at most once. */
+static CornerList makeCorners(std::mt19937 &random, int count)
+{
+    std::vector<std::pair<int, int>> sides;
+    for (int channel = 0; channel < CHANNELS; channel++)
+    {
+        for (int side = 0; side < 4; side++)
+        {
+            sides.push_back(std::make_pair(channel, side));
+        }
+    }
+    std::shuffle(sides.begin(), sides.end(), random);
+
+    CornerList corners;
+    size_t next = 0;
+    for (int i = 0; i < CHANNELS * 4 / count; i++)
+    {
+        Corner corner = {};
+        corner.count = count;
+        corner.index = i;
+        for (int j = 0; j < count; j++, next++)
+        {
+            corner.channel[j] = sides[next].first;
+            corner.corner[j] = sides[next].second;
+        }
+        corners.push_back(corner);
+    }
+    return corners;
+}
+
+/** Noisy bell shaped histograms, some of them empty if empties is set. */
+static void fillHistograms(std::mt19937 &random, std::vector<amf_int32> &histograms, bool empties)
+{
+    std::uniform_real_distribution<float> uniform(0, 1);
+    std::normal_distribution<float> noise(0, 1);
+    for (size_t offset = 0; offset < histograms.size(); offset += HIST_SIZE)
+    {
+        amf_int32 *hist = &histograms[offset];
+        if (empties && uniform(random) < 0.1f)
+        {
+            std::fill(hist, hist + HIST_SIZE, 0);
+            continue;
+        }
+        float center = 40 + uniform(random) * 170;
+        float width = 5 + uniform(random) * 40;
+        float scale = 100 + uniform(random) * 100000;
+        for (int i = 0; i < HIST_SIZE; i++)
+        {
+            float d = (i - center) / width;
+            hist[i] = (amf_int32)(scale * expf(-d * d) + fabsf(noise(random)) * scale * 0.02f);
+        }
+    }
+}
+
+static bool same(const std::vector<float> &a, const std::vector<float> &b)
+{
+    return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+/**
+ * Adjust gives bit for bit the LUTs and brightness of the old cross
+ * correlation, on two and three camera corners, on the calling thread and on
+ * a pool, including histograms with nothing in them.
+ */
+static void testAgainstReference()
+{
+    HistogramParameters params = parameters();
+    std::mt19937 random(1234);
+    AMFWorkStealingPool pool(4);
+    for (int trial = 0; trial < 20; trial++)
+    {
+        CornerList corners = makeCorners(random, trial % 2 ? 3 : 2);
+        size_t lutSize = CHANNELS * 5 * 3 * HIST_SIZE;
+        std::vector<amf_int32> histograms(CHANNELS * 4 * 3 * HIST_SIZE);
+        std::vector<float> expectedLUT(lutSize), expectedPrev(lutSize), expectedBrightness(CHANNELS * 4 * 3);
+        std::vector<float> shifts(corners.size() * 3 * 3);
+        std::vector<float> lut(lutSize), prev(lutSize), brightness(CHANNELS * 4 * 3);
+        StitchColorBalance balance;
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            fillHistograms(random, histograms, trial % 5 == 0);
+            reference::Adjust(corners, CHANNELS, histograms.data(), expectedLUT.data(), expectedPrev.data(),
+                              expectedBrightness.data(), shifts.data(), params, frame);
+            balance.Adjust(corners, CHANNELS, histograms.data(), lut.data(), prev.data(), brightness.data(), params,
+                           frame, trial & 2 ? &pool : NULL);
+            CHECK(same(lut, expectedLUT));
+            CHECK(same(prev, expectedPrev));
+            CHECK(same(brightness, expectedBrightness));
+        }
+    }
+}
+
+/** A new corner list is planned again rather than reusing the old plan. */
+static void testCornerChange()
+{
+    HistogramParameters params = parameters();
+    std::mt19937 random(99);
+    std::vector<amf_int32> histograms(CHANNELS * 4 * 3 * HIST_SIZE);
+    fillHistograms(random, histograms, false);
+    size_t lutSize = CHANNELS * 5 * 3 * HIST_SIZE;
+    StitchColorBalance balance;
+    for (int count : {3, 2, 3})
+    {
+        CornerList corners = makeCorners(random, count);
+        std::vector<float> expectedLUT(lutSize), expectedPrev(lutSize), expectedBrightness(CHANNELS * 4 * 3);
+        std::vector<float> shifts(corners.size() * 3 * 3);
+        std::vector<float> lut(lutSize), prev(lutSize), brightness(CHANNELS * 4 * 3);
+        reference::Adjust(corners, CHANNELS, histograms.data(), expectedLUT.data(), expectedPrev.data(),
+                          expectedBrightness.data(), shifts.data(), params, 0);
+        balance.Adjust(corners, CHANNELS, histograms.data(), lut.data(), prev.data(), brightness.data(), params, 0,
+                       NULL);
+        CHECK(same(lut, expectedLUT));
+        CHECK(same(brightness, expectedBrightness));
+    }
+}
+
+/** AccumulateNV12 counts exactly what the kernel does pixel by pixel, for odd sizes and pitches too. */
+static void testAccumulateNV12()
+{
+    std::mt19937 random(5);
+    for (int trial = 0; trial < 20; trial++)
+    {
+        int width = 2 * (8 + random() % 600);
+        int height = 2 * (8 + random() % 400);
+        int pitchY = width + random() % 64;
+        int pitchUV = width + random() % 64;
+        int widthMap = (width + 7) / 8;
+        int heightMap = (height + 7) / 8;
+        int pitchMap = widthMap + random() % 32;
+        std::vector<amf_uint8> y(pitchY * height), uv(pitchUV * height / 2), map(pitchMap * heightMap);
+        for (amf_uint8 &value : y)
+        {
+            value = (amf_uint8)random();
+        }
+        for (amf_uint8 &value : uv)
+        {
+            value = (amf_uint8)random();
+        }
+        // Borders along the edges, a few stray marks inside, and junk in the unused high bits.
+        for (int my = 0; my < heightMap; my++)
+        {
+            for (int mx = 0; mx < pitchMap; mx++)
+            {
+                amf_uint8 marks = (mx < 3 ? 1 : 0) | (mx >= widthMap - 3 ? 2 : 0) | (my < 2 ? 4 : 0) |
+                                  (my >= heightMap - 2 ? 8 : 0);
+                if (random() % 50 == 0)
+                {
+                    marks |= random() & 0xF;
+                }
+                map[my * pitchMap + mx] = marks | (random() & 0xF0);
+            }
+        }
+
+        int channels = 3;
+        int channel = random() % channels;
+        std::vector<amf_int32> expected(channels * 4 * 3 * HIST_SIZE), histograms(expected.size());
+        reference::AccumulateNV12(expected.data(), channel, y.data(), pitchY, uv.data(), pitchUV, width, height,
+                                  map.data(), pitchMap);
+        StitchColorBalance::AccumulateNV12(histograms.data(), channel, y.data(), pitchY, uv.data(), pitchUV, width,
+                                           height, map.data(), pitchMap, widthMap, heightMap);
+        CHECK(histograms == expected);
+    }
+}
+
+int main()
+{
+    testAgainstReference();
+    testCornerChange();
+    testAccumulateNV12();
+    printf("ok\n");
+    return 0;
+}
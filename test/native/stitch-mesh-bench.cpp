@@ -0,0 +1,38 @@
+#include "../../src/native/amf/public/common/WorkStealingPool.h"
+#include "stitch-mesh-reference.h"
+#include "test.h"
+
+using namespace amf;
+
+const unsigned MESHES = 20;
+
+int main()
+{
+    AMFWorkStealingPool pool;
+    const char *lenses[] = {"rectilinear", "full frame fisheye", "circular fisheye"};
+    for (amf_int64 lensMode : {AMF_VIDEO_STITCH_LENS_RECTILINEAR, AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME,
+                               AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR})
+    {
+        StitchMeshParams params;
+        params.widthInput = 1920;
+        params.heightInput = 1080;
+        params.streamCount = 4;
+        params.lensMode = lensMode;
+        params.lensCorrK1 = 0.05;
+        params.lensCorrK2 = -0.1;
+        params.lensCorrK3 = 0.02;
+        params.pitch = 0.2;
+        params.yaw = 1.1;
+        params.hfov = lensMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR ? 1.6 : 3.3;
+        printf("%s, %zu threads\n", lenses[lensMode], (size_t)pool.GetThreadCount());
+
+        reference::Mesh old;
+        StitchMesh mesh;
+        bench("  PrepareMesh before", MESHES, [&](unsigned) { reference::PrepareMesh(params, old); });
+        bench("  serial", MESHES, [&](unsigned) { StitchMeshBuilder::Generate(params, mesh, NULL); });
+        bench("  pool", MESHES, [&](unsigned) { StitchMeshBuilder::Generate(params, mesh, &pool); });
+        StitchMeshBuilder::Build(params, mesh, &pool);
+        bench("  cache hit", MESHES, [&](unsigned) { StitchMeshBuilder::Build(params, mesh, &pool); });
+    }
+    return 0;
+}
@@ -0,0 +1,350 @@
+#ifndef STITCH_MESH_REFERENCE_H
+#define STITCH_MESH_REFERENCE_H
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "public/include/components/VideoStitch.h"
+#include "../../src/native/amf/public/src/components/VideoStitch/StitchMesh.h"
+
+/**
+ * StitchEngineBase::PrepareMesh as it was before StitchMeshBuilder, to check
+ * the builder against. DirectXMath only exists on Windows, so the few parts
+ * of it the mesh used are written out in scalar code, doing the same
+ * arithmetic in the same order.
+ */
+namespace reference
+{
+using amf::StitchMeshParams;
+using amf::StitchMeshVertex;
+
+const double PI = 3.14159265358979323846;
+
+struct XMVECTOR
+{
+    float v[4];
+};
+
+struct XMMATRIX
+{
+    XMVECTOR r[4];
+};
+
+inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+{
+    XMVECTOR result = {{x, y, z, w}};
+    return result;
+}
+
+inline XMMATRIX XMMatrixIdentity()
+{
+    XMMATRIX m = {};
+    for (int i = 0; i < 4; i++)
+    {
+        m.r[i].v[i] = 1.0f;
+    }
+    return m;
+}
+
+inline XMMATRIX XMMatrixScaling(float x, float y, float z)
+{
+    XMMATRIX m = XMMatrixIdentity();
+    m.r[0].v[0] = x;
+    m.r[1].v[1] = y;
+    m.r[2].v[2] = z;
+    return m;
+}
+
+inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+{
+    XMMATRIX m = XMMatrixIdentity();
+    m.r[3] = XMVectorSet(x, y, z, 1.0f);
+    return m;
+}
+
+inline XMMATRIX XMMatrixRotationRollPitchYaw(float pitch, float yaw, float roll)
+{
+    float cp = cosf(pitch), sp = sinf(pitch);
+    float cy = cosf(yaw), sy = sinf(yaw);
+    float cr = cosf(roll), sr = sinf(roll);
+    XMMATRIX m = XMMatrixIdentity();
+    m.r[0] = XMVectorSet(cr * cy + sr * sp * sy, sr * cp, sr * sp * cy - cr * sy, 0.0f);
+    m.r[1] = XMVectorSet(cr * sp * sy - sr * cy, cr * cp, sr * sy + cr * sp * cy, 0.0f);
+    m.r[2] = XMVectorSet(cp * sy, -sp, cp * cy, 0.0f);
+    return m;
+}
+
+/** z * r2 + r3 first, then y * r1, then x * r0, like DirectXMath. */
+inline XMVECTOR XMVector3Transform(XMVECTOR v, const XMMATRIX &m)
+{
+    XMVECTOR result;
+    for (int i = 0; i < 4; i++)
+    {
+        float sum = v.v[2] * m.r[2].v[i] + m.r[3].v[i];
+        sum = v.v[1] * m.r[1].v[i] + sum;
+        result.v[i] = v.v[0] * m.r[0].v[i] + sum;
+    }
+    return result;
+}
+
+inline XMVECTOR XMPlaneFromPoints(XMVECTOR p1, XMVECTOR p2, XMVECTOR p3)
+{
+    float ax = p1.v[0] - p2.v[0], ay = p1.v[1] - p2.v[1], az = p1.v[2] - p2.v[2];
+    float bx = p1.v[0] - p3.v[0], by = p1.v[1] - p3.v[1], bz = p1.v[2] - p3.v[2];
+    float nx = ay * bz - az * by;
+    float ny = az * bx - ax * bz;
+    float nz = ax * by - ay * bx;
+    float length = sqrtf(nx * nx + ny * ny + nz * nz);
+    nx /= length;
+    ny /= length;
+    nz /= length;
+    return XMVectorSet(nx, ny, nz, -(nx * p1.v[0] + ny * p1.v[1] + nz * p1.v[2]));
+}
+
+inline XMVECTOR CorrectLensRadial(XMVECTOR src, double a, double b, double c)
+{
+    double d = 1.0 - a - b - c;
+    double x = src.v[0];
+    double y = src.v[1];
+    double r2 = x * x + y * y;
+    double r1 = sqrt(r2);
+    double r3 = r2 * r1;
+    double cDist = d + a * r3 + b * r2 + c * r1;
+    return XMVectorSet((float)(x * cDist), (float)(y * cDist), src.v[2], src.v[3]);
+}
+
+inline XMVECTOR CorrectLensRadialInverse(XMVECTOR src, double a, double b, double c)
+{
+    double d = 1.0 - a - b - c;
+    double x = src.v[0];
+    double y = src.v[1];
+    double rd = sqrt(x * x + y * y);
+    double rs = rd;
+    double f = (((a * rs + b) * rs + c) * rs + d) * rs;
+    int iter = 0;
+    while (std::abs(f - rd) > 1.0e-6 && iter++ < 100)
+    {
+        rs = rs - (f - rd) / (((4 * a * rs + 3 * b) * rs + 2 * c) * rs + 1 * d);
+        f = (((a * rs + b) * rs + c) * rs + d) * rs;
+    }
+    double scale = rd == 0.0 || iter >= 100 ? 1.0 : rs / rd;
+    return XMVectorSet((float)(x * scale), (float)(y * scale), src.v[2], src.v[3]);
+}
+
+inline XMVECTOR CorrectLensCircularFishEye(XMVECTOR src, double hfov, double f, float &transparency)
+{
+    double x = src.v[0];
+    double y = src.v[1];
+    double pheta = atan2(y, x);
+    double theta = sqrt(x * x + y * y) / f * (hfov / 2.0);
+    transparency = fabs(theta) > PI / 2.0 ? 0.0f : 1.0f;
+    return XMVectorSet((float)(sin(theta) * cos(pheta)), (float)(sin(theta) * sin(pheta)), (float)-cos(theta),
+                       src.v[3]);
+}
+
+/** Fades the alpha to zero over the outer 1% of the texture. */
+inline float FadeEdge(float pos, float alpha)
+{
+    const float border = 0.01f;
+    if (pos < border)
+    {
+        return alpha * (1.0f + (0.0f - 1.0f) * (pos - border) / (0.0f - border));
+    }
+    if (pos > 1.0f - border)
+    {
+        float x0 = 1.0f - border;
+        return alpha * (1.0f + (0.0f - 1.0f) * (pos - x0) / (1.0f - x0));
+    }
+    return alpha;
+}
+
+inline float CalcTransparencyTex(float posx, float posy)
+{
+    if (posx < 0 || posx > 1.0f || posy < 0 || posy > 1.0f)
+    {
+        return 0.0f;
+    }
+    return FadeEdge(posy, FadeEdge(posx, 1.0f));
+}
+
+/** The old mesh, with the StitchMesh fields PrepareMesh used to fill in. */
+struct Mesh
+{
+    std::vector<StitchMeshVertex> vertices;
+    std::vector<amf_uint32> verticesRowSize;
+    AMFRect borderRect;
+    XMVECTOR texRect;
+    std::vector<XMVECTOR> sides;
+    std::vector<XMVECTOR> corners;
+    XMVECTOR plane;
+    XMVECTOR planeCenter;
+};
+
+inline void PrepareMesh(const StitchMeshParams &params, Mesh &mesh)
+{
+    mesh.vertices.clear();
+    mesh.verticesRowSize.clear();
+    mesh.sides.clear();
+    mesh.corners.clear();
+
+    amf_int32 widthInput = params.widthInput;
+    amf_int32 heightInput = params.heightInput;
+    double lensCorrOffX = params.lensCorrOffX;
+    double lensCorrOffY = params.lensCorrOffY;
+    double offset_z = params.scale;
+    amf_int64 lensCorrectionMode = params.lensMode;
+    AMFRect crop = params.crop;
+    double hfov = params.hfov;
+
+    amf_int32 widthInputOrg = widthInput;
+    amf_int32 heightInputOrg = heightInput;
+    if (crop.Width() > 0 && crop.Height() > 0)
+    {
+        widthInput = crop.Width();
+        heightInput = crop.Height();
+    }
+
+    if (lensCorrectionMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR)
+    {
+        offset_z = 1.0 / tan(hfov / 2.0);
+    }
+    offset_z = 1.0 - ((double)widthInput / heightInput) * offset_z;
+
+    switch (lensCorrectionMode)
+    {
+    case AMF_VIDEO_STITCH_LENS_RECTILINEAR:
+        lensCorrOffX /= widthInputOrg / 2.0;
+        lensCorrOffY /= heightInputOrg / 2.0;
+        break;
+    case AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME:
+        lensCorrOffX /= widthInputOrg / 2.0;
+        lensCorrOffY /= heightInputOrg / 2.0;
+        offset_z *= 1.11;
+        break;
+    case AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR:
+        lensCorrOffX /= widthInputOrg / 2.0;
+        lensCorrOffY /= widthInputOrg / 2.0;
+        break;
+    }
+
+    float tex_l = 0.0f, tex_t = 0.0f, tex_w = 1.0f, tex_h = 1.0f;
+    if (crop.Width() > 0 && crop.Height() > 0)
+    {
+        tex_l = (float)crop.left / widthInputOrg;
+        tex_t = (float)crop.top / heightInputOrg;
+        tex_w = (float)crop.Width() / widthInputOrg;
+        tex_h = (float)crop.Height() / heightInputOrg;
+    }
+
+    double aspectX = 1.0f;
+    double aspectY = 1.0f;
+    if (widthInput > heightInput)
+    {
+        aspectX = (float)widthInput / heightInput;
+    }
+    else
+    {
+        aspectY = (float)heightInput / widthInput;
+    }
+
+    XMMATRIX orientation = XMMatrixRotationRollPitchYaw((float)params.pitch, (float)params.yaw, (float)params.roll);
+    XMMATRIX textureReverse = XMMatrixRotationRollPitchYaw(0.0f, 0.0f, (float)PI);
+    XMMATRIX aspect = XMMatrixScaling((float)aspectX, (float)aspectY, 1.0f);
+    XMMATRIX translation = XMMatrixTranslation((float)lensCorrOffX, (float)lensCorrOffY, 0);
+    XMMATRIX zoom = XMMatrixTranslation(0, 0, (float)offset_z);
+    // The crop offset was always zero.
+    XMMATRIX cropTranslation = XMMatrixTranslation(0, 0, 0);
+
+    double leftB = -1.0 / aspectX - lensCorrOffX;
+    double topB = -1.0 / aspectY - lensCorrOffY;
+    double rightB = 1.0 / aspectX - lensCorrOffX;
+    double bottomB = 1.0 / aspectY - lensCorrOffY;
+
+    switch (params.streamCount)
+    {
+    case 2:
+    case 4:
+    case 6:
+        mesh.corners.push_back(XMVector3Transform(XMVectorSet(1.0f, 1.0f, -1.0f, 0.0f), orientation));
+        mesh.corners.push_back(XMVector3Transform(XMVectorSet(-1.0f, 1.0f, -1.0f, 0.0f), orientation));
+        mesh.corners.push_back(XMVector3Transform(XMVectorSet(-1.0f, -1.0f, -1.0f, 0.0f), orientation));
+        mesh.corners.push_back(XMVector3Transform(XMVectorSet(1.0f, -1.0f, -1.0f, 0.0f), orientation));
+        mesh.sides.push_back(XMVector3Transform(XMVectorSet(1.0f, 0.0f, -1.0f, 0.0f), orientation));
+        mesh.sides.push_back(XMVector3Transform(XMVectorSet(0.0f, 1.0f, -1.0f, 0.0f), orientation));
+        mesh.sides.push_back(XMVector3Transform(XMVectorSet(-1.0f, 0.0f, -1.0f, 0.0f), orientation));
+        mesh.sides.push_back(XMVector3Transform(XMVectorSet(0.0f, -1.0f, -1.0f, 0.0f), orientation));
+        break;
+    }
+
+    leftB /= 1.0 + offset_z;
+    topB /= 1.0 + offset_z;
+    rightB /= 1.0 + offset_z;
+    bottomB /= 1.0 + offset_z;
+    mesh.texRect = XMVectorSet(float((leftB + 1.0) / 2.0), float((topB + 1.0) / 2.0), float((rightB + 1.0) / 2.0),
+                               float((bottomB + 1.0) / 2.0));
+    mesh.borderRect.left = amf_int32((leftB + 1.0) / 2.0 * widthInput);
+    mesh.borderRect.top = amf_int32((topB + 1.0) / 2.0 * heightInput);
+    mesh.borderRect.right = amf_int32((rightB + 1.0) / 2.0 * widthInput);
+    mesh.borderRect.bottom = amf_int32((bottomB + 1.0) / 2.0 * heightInput);
+
+    XMVECTOR points[4] = {XMVectorSet(-1.0f, -1.0f, -1.0f, 0.0f), XMVectorSet(1.0f, 0.0f, -1.0f, 0.0f),
+                          XMVectorSet(1.0f, 1.0f, -1.0f, 0.0f), XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f)};
+    for (XMVECTOR &point : points)
+    {
+        point = XMVector3Transform(point, textureReverse);
+        point = XMVector3Transform(point, aspect);
+        point = XMVector3Transform(point, translation);
+        point = XMVector3Transform(point, zoom);
+        point = XMVector3Transform(point, orientation);
+    }
+    mesh.plane = XMPlaneFromPoints(points[0], points[1], points[2]);
+    mesh.planeCenter = points[3];
+
+    for (int y = 0; y <= params.heightTriangle; y++)
+    {
+        amf_uint32 countInRow = 0;
+        for (int x = 0; x <= params.widthTriangle; x++)
+        {
+            StitchMeshVertex v = {};
+            float posx = -1.0f + (float)x / params.widthTriangle * 2.0f;
+            float posy = -1.0f + (float)y / params.heightTriangle * 2.0f;
+            v.Tex[0] = tex_l + ((float)x / params.widthTriangle) * tex_w;
+            v.Tex[1] = tex_t + ((float)y / params.heightTriangle) * tex_h;
+            if (v.Tex[0] < 0 || v.Tex[1] < 0 || v.Tex[0] > 1.0f || v.Tex[1] > 1.0f)
+            {
+                continue;
+            }
+            v.Tex[2] = CalcTransparencyTex(v.Tex[0], v.Tex[1]);
+
+            XMVECTOR vec = XMVectorSet(posx, posy, -1.0f, 0.0f);
+            vec = XMVector3Transform(vec, textureReverse);
+            vec = XMVector3Transform(vec, cropTranslation);
+            vec = XMVector3Transform(vec, translation);
+            vec = XMVector3Transform(vec, aspect);
+            switch (lensCorrectionMode)
+            {
+            case AMF_VIDEO_STITCH_LENS_RECTILINEAR:
+                vec = CorrectLensRadial(vec, params.lensCorrK1, params.lensCorrK2, params.lensCorrK3);
+                break;
+            case AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME:
+            case AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR:
+                vec = CorrectLensRadialInverse(vec, params.lensCorrK1, params.lensCorrK2, params.lensCorrK3);
+                vec = CorrectLensCircularFishEye(vec, hfov, 1.0, v.Tex[2]);
+                break;
+            }
+            vec = XMVector3Transform(vec, zoom);
+            vec = XMVector3Transform(vec, orientation);
+            v.Pos[0] = vec.v[0];
+            v.Pos[1] = vec.v[1];
+            v.Pos[2] = vec.v[2];
+            mesh.vertices.push_back(v);
+            countInRow++;
+        }
+        if (countInRow > 0)
+        {
+            mesh.verticesRowSize.push_back(countInRow);
+        }
+    }
+}
+} // namespace reference
+#endif
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "../../src/native/amf/public/common/WorkStealingPool.h"
+#include "stitch-mesh-reference.h"
+#include "test.h"
+
+using namespace amf;
+
+// The builder transforms vertices with precomputed, fused matrices, so
+// positions move by a few float roundings. Texture coordinates and alpha
+// don't go through the matrices and have to match exactly.
+const float POSITION_TOLERANCE = 1e-6f;
+
+static bool close(const float *a, const float *b, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (std::fabs(a[i] - b[i]) > POSITION_TOLERANCE)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameVertices(const StitchMesh &a, const StitchMesh &b)
+{
+    return a.vertices.size() == b.vertices.size() &&
+           memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(StitchMeshVertex)) == 0 &&
+           a.verticesRowSize == b.verticesRowSize;
+}
+
+static void checkAgainstReference(const StitchMeshParams &params)
+{
+    reference::Mesh expected;
+    reference::PrepareMesh(params, expected);
+    StitchMesh mesh;
+    StitchMeshBuilder::Generate(params, mesh, NULL);
+
+    CHECK(mesh.verticesRowSize.size() == expected.verticesRowSize.size());
+    for (size_t i = 0; i < expected.verticesRowSize.size(); i++)
+    {
+        CHECK(mesh.verticesRowSize[i] == expected.verticesRowSize[i]);
+    }
+    CHECK(mesh.vertices.size() == expected.vertices.size());
+    for (size_t i = 0; i < expected.vertices.size(); i++)
+    {
+        CHECK(close(mesh.vertices[i].Pos, expected.vertices[i].Pos, 3));
+        CHECK(memcmp(mesh.vertices[i].Tex, expected.vertices[i].Tex, sizeof(expected.vertices[i].Tex)) == 0);
+    }
+
+    CHECK(close(mesh.plane.v, expected.plane.v, 4));
+    CHECK(close(mesh.planeCenter.v, expected.planeCenter.v, 4));
+    CHECK(close(mesh.texRect.v, expected.texRect.v, 4));
+    CHECK(mesh.borderRect.left == expected.borderRect.left);
+    CHECK(mesh.borderRect.top == expected.borderRect.top);
+    CHECK(mesh.borderRect.right == expected.borderRect.right);
+    CHECK(mesh.borderRect.bottom == expected.borderRect.bottom);
+    CHECK(mesh.corners.size() == expected.corners.size());
+    for (size_t i = 0; i < expected.corners.size(); i++)
+    {
+        CHECK(close(mesh.corners[i].v, expected.corners[i].v, 4));
+    }
+    CHECK(mesh.sides.size() == expected.sides.size());
+    for (size_t i = 0; i < expected.sides.size(); i++)
+    {
+        CHECK(close(mesh.sides[i].v, expected.sides[i].v, 4));
+    }
+}
+
+static StitchMeshParams camera(amf_int64 lensMode, bool cropped)
+{
+    StitchMeshParams params;
+    params.widthInput = 1920;
+    params.heightInput = 1080;
+    params.widthOutput = 3840;
+    params.heightOutput = 1920;
+    params.streamCount = 4;
+    params.lensMode = lensMode;
+    params.lensCorrK1 = 0.05;
+    params.lensCorrK2 = -0.1;
+    params.lensCorrK3 = 0.02;
+    params.lensCorrOffX = 12;
+    params.lensCorrOffY = -7;
+    params.scale = 1.3;
+    params.pitch = 0.2;
+    params.yaw = 1.1;
+    params.roll = -0.05;
+    params.hfov = lensMode == AMF_VIDEO_STITCH_LENS_RECTILINEAR ? 1.6 : 3.3;
+    if (cropped)
+    {
+        params.crop = AMFConstructRect(200, 60, 1700, 1000);
+    }
+    return params;
+}
+
+/** Every lens, with and without a crop, gives the mesh PrepareMesh used to. */
+static void testAgainstReference()
+{
+    for (amf_int64 lensMode : {AMF_VIDEO_STITCH_LENS_RECTILINEAR, AMF_VIDEO_STITCH_LENS_FISHEYE_FULLFRAME,
+                               AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR})
+    {
+        checkAgainstReference(camera(lensMode, false));
+        checkAgainstReference(camera(lensMode, true));
+    }
+
+    // Portrait, a rig without corners and a grid that doesn't split into even bands.
+    StitchMeshParams params = camera(AMF_VIDEO_STITCH_LENS_RECTILINEAR, false);
+    params.widthInput = 1080;
+    params.heightInput = 1920;
+    params.streamCount = 3;
+    params.widthTriangle = 37;
+    params.heightTriangle = 53;
+    checkAgainstReference(params);
+}
+
+/** Generating on a pool and hitting the cache both give exactly the serial mesh. */
+static void testPoolAndCache()
+{
+    AMFWorkStealingPool pool(4);
+    for (amf_int64 lensMode : {AMF_VIDEO_STITCH_LENS_RECTILINEAR, AMF_VIDEO_STITCH_LENS_FISHEYE_CIRCULAR})
+    {
+        StitchMeshParams params = camera(lensMode, true);
+        StitchMesh serial;
+        StitchMesh pooled;
+        StitchMeshBuilder::Generate(params, serial, NULL);
+        StitchMeshBuilder::Generate(params, pooled, &pool);
+        CHECK(sameVertices(serial, pooled));
+
+        StitchMeshBuilder::ClearCache();
+        StitchMesh built;
+        StitchMesh cached;
+        StitchMeshBuilder::Build(params, built, &pool);
+        StitchMeshBuilder::Build(params, cached, NULL);
+        CHECK(sameVertices(serial, built));
+        CHECK(sameVertices(serial, cached));
+    }
+
+    // A change to any parameter misses the cache.
+    StitchMeshParams params = camera(AMF_VIDEO_STITCH_LENS_RECTILINEAR, false);
+    StitchMesh first;
+    StitchMeshBuilder::Build(params, first, NULL);
+    params.yaw += 0.5;
+    CHECK(!(params == camera(AMF_VIDEO_STITCH_LENS_RECTILINEAR, false)));
+    StitchMesh second;
+    StitchMesh expected;
+    StitchMeshBuilder::Build(params, second, NULL);
+    StitchMeshBuilder::Generate(params, expected, NULL);
+    CHECK(sameVertices(second, expected));
+    CHECK(!sameVertices(first, second));
+}
+
+int main()
+{
+    testAgainstReference();
+    testPoolAndCache();
+    printf("ok\n");
+    return 0;
+}
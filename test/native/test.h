@@ -0,0 +1,30 @@
+#ifndef TEST_H
+#define TEST_H
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+/** Fail the test with the failed condition and where it is, if it doesn't hold. */
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            exit(1);                                                                      \
+        }                                                                                 \
+    } while (0)
+
+/** Time iterations of body and print how long each one took on average. */
+template <typename Body>
+void bench(const char *name, unsigned iterations, Body body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; i++)
+    {
+        body(i);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-40s %12.1f ns\n", name, elapsed.count() / iterations);
+}
+#endif
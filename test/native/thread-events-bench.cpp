@@ -0,0 +1,58 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../src/native/amf/public/common/Thread.h"
+#include "test.h"
+
+using namespace amf;
+
+const int ITEMS = 20000;
+
+/**
+ * Push items through an AMFQueue, which sits on an event and a semaphore, and
+ * report how many get through per second.
+ */
+static void run(int producers, int consumers, amf_int32 queueSize)
+{
+    AMFQueue<int> queue(queueSize);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++)
+    {
+        threads.emplace_back([&]() {
+            for (int item = 0; item < ITEMS / producers; item++)
+            {
+                queue.Add(0, item);
+            }
+        });
+    }
+    for (int i = 0; i < consumers; i++)
+    {
+        threads.emplace_back([&]() {
+            amf_ulong id;
+            int item;
+            for (int got = 0; got < ITEMS / consumers; got++)
+            {
+                queue.Get(id, item, AMF_INFINITE);
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%d producers, %d consumers, queue of %3d: %6.2f M items/s\n", producers, consumers, queueSize,
+           ITEMS / elapsed.count() / 1e6);
+}
+
+int main()
+{
+    run(1, 1, 16);
+    run(2, 2, 16);
+    run(4, 4, 64);
+    // Unbounded, so only the event is involved.
+    run(1, 1, 0);
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../src/native/amf/public/common/Thread.h"
+#include "test.h"
+
+using namespace amf;
+
+// Timed waits may run late on a busy machine, so only the lower bounds are
+// tight. The upper bound just tells a wait that ended from one that timed out.
+const amf_ulong TIMEOUT = 30;
+const amf_ulong LONG_TIMEOUT = 5000;
+const double EARLY = 1000;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void testEventTimeouts()
+{
+    amf_handle event = amf_create_event(false, false, NULL);
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!amf_wait_for_event(event, TIMEOUT));
+    // Allow for the clock's millisecond rounding.
+    CHECK(millisecondsSince(start) >= TIMEOUT - 1);
+
+    // The _timeout variant reports a timeout as success, like it always has.
+    start = std::chrono::steady_clock::now();
+    CHECK(amf_wait_for_event_timeout(event, TIMEOUT));
+    CHECK(millisecondsSince(start) >= TIMEOUT - 1);
+
+    // A zero timeout only looks.
+    CHECK(!amf_wait_for_event(event, 0));
+    amf_delete_event(event);
+}
+
+static void testSetBeforeWait()
+{
+    // An auto reset event lets exactly one wait through per set.
+    amf_handle event = amf_create_event(false, false, NULL);
+    CHECK(amf_set_event(event));
+    CHECK(amf_set_event(event));
+    auto start = std::chrono::steady_clock::now();
+    CHECK(amf_wait_for_event(event, LONG_TIMEOUT));
+    CHECK(millisecondsSince(start) < EARLY);
+    CHECK(!amf_wait_for_event(event, 0));
+    amf_delete_event(event);
+
+    // A manual reset event stays set until it is reset.
+    event = amf_create_event(false, true, NULL);
+    CHECK(amf_set_event(event));
+    CHECK(amf_wait_for_event(event, 0));
+    CHECK(amf_wait_for_event(event, 0));
+    CHECK(amf_reset_event(event));
+    CHECK(!amf_wait_for_event(event, 0));
+    amf_delete_event(event);
+
+    // As does one created set.
+    event = amf_create_event(true, true, NULL);
+    CHECK(amf_wait_for_event(event, 0));
+    CHECK(amf_wait_for_event(event, 0));
+    amf_delete_event(event);
+}
+
+static void testWakeups()
+{
+    // A set from another thread wakes a sleeping wait.
+    amf_handle event = amf_create_event(false, false, NULL);
+    std::thread setter([event]() {
+        amf_sleep(50);
+        amf_set_event(event);
+    });
+    auto start = std::chrono::steady_clock::now();
+    CHECK(amf_wait_for_event(event, LONG_TIMEOUT));
+    CHECK(millisecondsSince(start) < EARLY);
+    setter.join();
+    amf_delete_event(event);
+
+    // Setting a manual reset event wakes everybody waiting on it.
+    event = amf_create_event(false, true, NULL);
+    std::atomic<int> woken(0);
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; i++)
+    {
+        waiters.emplace_back([event, &woken]() { woken += amf_wait_for_event(event, LONG_TIMEOUT); });
+    }
+    amf_sleep(50);
+    start = std::chrono::steady_clock::now();
+    amf_set_event(event);
+    for (auto &waiter : waiters)
+    {
+        waiter.join();
+    }
+    CHECK(woken == 4);
+    CHECK(millisecondsSince(start) < EARLY);
+    amf_delete_event(event);
+}
+
+/** Every set of an auto reset event lets one waiter through, never more. */
+static void testAutoResetContention()
+{
+    const int SETS = 2000;
+    amf_handle event = amf_create_event(false, false, NULL);
+    amf_handle taken = amf_create_semaphore(0, SETS, NULL);
+    std::atomic<bool> done(false);
+    std::atomic<int> woken(0);
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < 4; i++)
+    {
+        waiters.emplace_back([&]() {
+            while (!done)
+            {
+                if (amf_wait_for_event(event, 10))
+                {
+                    woken++;
+                    amf_release_semaphore(taken, 1, NULL);
+                }
+            }
+        });
+    }
+    for (int i = 0; i < SETS; i++)
+    {
+        amf_set_event(event);
+        // Wait for the set to be taken, so no two sets merge into one.
+        CHECK(amf_wait_for_semaphore(taken, LONG_TIMEOUT));
+    }
+    done = true;
+    for (auto &waiter : waiters)
+    {
+        waiter.join();
+    }
+    CHECK(woken == SETS);
+    amf_delete_semaphore(taken);
+    amf_delete_event(event);
+}
+
+static void testSemaphoreCounts()
+{
+    CHECK(amf_create_semaphore(3, 2, NULL) == NULL);
+
+    amf_handle semaphore = amf_create_semaphore(2, 5, NULL);
+    CHECK(amf_wait_for_semaphore(semaphore, 0));
+    CHECK(amf_wait_for_semaphore(semaphore, 0));
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!amf_wait_for_semaphore(semaphore, TIMEOUT));
+    CHECK(millisecondsSince(start) >= TIMEOUT - 1);
+
+    amf_long previous = -1;
+    CHECK(amf_release_semaphore(semaphore, 3, &previous));
+    CHECK(previous == 0);
+    // Passing the maximum fails and changes nothing, like ReleaseSemaphore.
+    CHECK(!amf_release_semaphore(semaphore, 3, &previous));
+    CHECK(amf_release_semaphore(semaphore, 2, &previous));
+    CHECK(previous == 3);
+    CHECK(!amf_release_semaphore(semaphore, 1, NULL));
+    CHECK(!amf_release_semaphore(semaphore, 0, NULL));
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK(amf_wait_for_semaphore(semaphore, 0));
+    }
+    CHECK(!amf_wait_for_semaphore(semaphore, 0));
+    amf_delete_semaphore(semaphore);
+}
+
+/**
+ * With producers and consumers hammering one semaphore, every count released
+ * is taken exactly once and the count never passes the maximum.
+ */
+static void testSemaphoreContention()
+{
+    const int THREADS = 4;
+    const int RELEASES = 5000;
+    const amf_long MAX_COUNT = 8;
+    amf_handle semaphore = amf_create_semaphore(0, MAX_COUNT, NULL);
+    std::atomic<int> taken(0);
+    std::atomic<int> overflows(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; i++)
+    {
+        threads.emplace_back([&]() {
+            for (int released = 0; released < RELEASES;)
+            {
+                amf_long previous = 0;
+                if (amf_release_semaphore(semaphore, 1, &previous))
+                {
+                    overflows += previous >= MAX_COUNT;
+                    released++;
+                }
+                else
+                {
+                    // Full, give the consumers a chance.
+                    std::this_thread::yield();
+                }
+            }
+        });
+        threads.emplace_back([&]() {
+            for (int i = 0; i < RELEASES; i++)
+            {
+                CHECK(amf_wait_for_semaphore(semaphore, LONG_TIMEOUT));
+                taken++;
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(taken == THREADS * RELEASES);
+    CHECK(overflows == 0);
+    CHECK(!amf_wait_for_semaphore(semaphore, 0));
+    amf_delete_semaphore(semaphore);
+}
+
+int main()
+{
+    testEventTimeouts();
+    testSetBeforeWait();
+    testWakeups();
+    testAutoResetContention();
+    testSemaphoreCounts();
+    testSemaphoreContention();
+    printf("ok\n");
+    return 0;
+}
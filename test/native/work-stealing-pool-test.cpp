@@ -0,0 +1,175 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../../src/native/amf/public/common/WorkStealingPool.h"
+#include "test.h"
+
+using namespace amf;
+
+const unsigned THREADS = 4;
+// Long enough for any task to have run, however busy the machine.
+const auto TIMEOUT = std::chrono::seconds(10);
+
+struct Counters
+{
+    std::atomic<unsigned> started{0};
+    std::atomic<unsigned> finished{0};
+    std::atomic<unsigned> deleted{0};
+};
+
+/** Counts how often it runs, and that the pool deletes it once. */
+class CountingTask : public AMFWorkStealingPool::Task
+{
+public:
+    CountingTask(Counters &counters, std::atomic<unsigned> *runs = nullptr, unsigned sleepMs = 0)
+        : counters(counters), runs(runs), sleepMs(sleepMs)
+    {
+    }
+    ~CountingTask() { counters.deleted++; }
+
+    void Run()
+    {
+        counters.started++;
+        if (runs)
+        {
+            (*runs)++;
+        }
+        if (sleepMs)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(sleepMs));
+        }
+        counters.finished++;
+    }
+
+private:
+    Counters &counters;
+    std::atomic<unsigned> *runs;
+    unsigned sleepMs;
+};
+
+/** Holds its worker until released. */
+class BlockingTask : public AMFWorkStealingPool::Task
+{
+public:
+    BlockingTask(std::atomic<bool> &started, std::atomic<bool> &release) : started(started), release(release) {}
+
+    void Run()
+    {
+        started = true;
+        while (!release)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    std::atomic<bool> &started;
+    std::atomic<bool> &release;
+};
+
+static bool waitFor(const std::atomic<unsigned> &value, unsigned expected)
+{
+    auto deadline = std::chrono::steady_clock::now() + TIMEOUT;
+    while (value < expected)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/**
+ * Submit deals tasks to every deque in turn, so while one worker is held up
+ * the tasks dealt to it only finish if the others steal them.
+ */
+static void testStealing()
+{
+    const unsigned TASKS = 100;
+    Counters counters;
+    std::atomic<bool> started(false);
+    std::atomic<bool> release(false);
+    {
+        AMFWorkStealingPool pool(THREADS);
+        pool.Submit(new BlockingTask(started, release));
+        while (!started)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for (unsigned i = 0; i < TASKS; i++)
+        {
+            pool.Submit(new CountingTask(counters));
+        }
+        CHECK(waitFor(counters.finished, TASKS));
+        release = true;
+    }
+    CHECK(counters.deleted == TASKS);
+}
+
+/** However they are dealt and stolen, every task runs once and is deleted once. */
+static void testRunsOnce()
+{
+    const unsigned TASKS = 100000;
+    Counters counters;
+    std::vector<std::atomic<unsigned>> runs(TASKS);
+    {
+        AMFWorkStealingPool pool(THREADS);
+        // From several threads, the way contact sheets share the pool.
+        std::vector<std::thread> submitters;
+        for (unsigned t = 0; t < 2; t++)
+        {
+            submitters.emplace_back([&, t]() {
+                for (unsigned i = t; i < TASKS; i += 2)
+                {
+                    pool.Submit(new CountingTask(counters, &runs[i]));
+                }
+            });
+        }
+        for (std::thread &submitter : submitters)
+        {
+            submitter.join();
+        }
+        CHECK(waitFor(counters.finished, TASKS));
+    }
+    for (unsigned i = 0; i < TASKS; i++)
+    {
+        CHECK(runs[i] == 1);
+    }
+    CHECK(counters.started == TASKS);
+    CHECK(counters.deleted == TASKS);
+}
+
+/**
+ * Destroying the pool with work queued lets the running tasks finish and
+ * deletes the rest without running them, so nothing leaks or is left half done.
+ */
+static void testShutdownWithPendingWork()
+{
+    const unsigned TASKS = 1000;
+    Counters counters;
+    {
+        AMFWorkStealingPool pool(THREADS);
+        for (unsigned i = 0; i < TASKS; i++)
+        {
+            pool.Submit(new CountingTask(counters, nullptr, 1));
+        }
+        CHECK(waitFor(counters.started, 1));
+    }
+    unsigned finished = counters.finished;
+    CHECK(counters.started == finished);
+    CHECK(finished > 0 && finished < TASKS);
+    CHECK(counters.deleted == TASKS);
+}
+
+int main()
+{
+    testStealing();
+    testRunsOnce();
+    testShutdownWithPendingWork();
+    printf("ok\n");
+    return 0;
+}